@@ -18,7 +18,9 @@ static void dummy(const std::shared_ptr<Channel>&)
 Hiredis::Hiredis(EventLoop* loop, const InetAddress& serverAddr)
   : loop_(loop),
     serverAddr_(serverAddr),
-    context_(NULL)
+    context_(NULL),
+    writeScheduled_(false),
+    writing_(false)
 {
 }
 
@@ -26,7 +28,11 @@ Hiredis::~Hiredis()
 {
   LOG_DEBUG << this;
   assert(!channel_ || channel_->isNoneEvent());
-  ::redisAsyncFree(context_);
+  // hiredis frees it after a disconnection or a failed connection
+  if (context_)
+  {
+    ::redisAsyncFree(context_);
+  }
 }
 
 bool Hiredis::connected() const
@@ -80,6 +86,7 @@ void Hiredis::setChannel()
 {
   LOG_DEBUG << this;
   assert(!channel_);
+  writeScheduled_ = false;
   channel_.reset(new Channel(loop_, fd()));
   channel_->setReadCallback(std::bind(&Hiredis::handleRead, this, _1));
   channel_->setWriteCallback(std::bind(&Hiredis::handleWrite, this));
@@ -106,7 +113,25 @@ void Hiredis::handleWrite()
   {
     removeChannel();
   }
+  writing_ = true;
   ::redisAsyncHandleWrite(context_);
+  writing_ = false;
+}
+
+void Hiredis::flushWrites(const std::weak_ptr<Channel>& channel)
+{
+  // a new connection may have been made since
+  if (channel.lock() != channel_)
+  {
+    return;
+  }
+  writeScheduled_ = false;
+  if (connected())
+  {
+    writing_ = true;
+    ::redisAsyncHandleWrite(context_);
+    writing_ = false;
+  }
 }
 
 /* static */ Hiredis* Hiredis::getHiredis(const redisAsyncContext* ac)
@@ -137,6 +162,10 @@ void Hiredis::connectCallback(int status)
   if (status != REDIS_OK)
   {
     LOG_ERROR << context_->errstr << " failed to connect to " << serverAddr_.toIpPort();
+    if (channel_)
+    {
+      removeChannel();
+    }
   }
   else
   {
@@ -148,6 +177,10 @@ void Hiredis::connectCallback(int status)
   {
     connectCb_(this, status);
   }
+  if (status != REDIS_OK)
+  {
+    context_ = NULL;
+  }
 }
 
 /* static */ void Hiredis::disconnectCallback(const redisAsyncContext* ac, int status)
@@ -165,34 +198,59 @@ void Hiredis::disconnectCallback(int status)
   {
     disconnectCb_(this, status);
   }
+  context_ = NULL;
 }
 
 void Hiredis::addRead(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->enableReading();
+  // hiredis asks after every write, an epoll_ctl(2) each time otherwise
+  if (!hiredis->channel_->isReading())
+  {
+    hiredis->channel_->enableReading();
+  }
 }
 
 void Hiredis::delRead(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->disableReading();
+  if (hiredis->channel_->isReading())
+  {
+    hiredis->channel_->disableReading();
+  }
 }
 
 void Hiredis::addWrite(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->enableWriting();
+  if (hiredis->writing_ || !hiredis->connected())
+  {
+    // the socket is full, or connecting, wait for POLLOUT
+    if (!hiredis->channel_->isWriting())
+    {
+      hiredis->channel_->enableWriting();
+    }
+  }
+  else if (!hiredis->writeScheduled_ && !hiredis->channel_->isWriting())
+  {
+    // a new command, pipelined with others of this loop iteration
+    hiredis->writeScheduled_ = true;
+    hiredis->loop_->queueInLoop(std::bind(&Hiredis::flushWrites, hiredis,
+                                          std::weak_ptr<Channel>(hiredis->channel_)));
+  }
 }
 
 void Hiredis::delWrite(void* privdata)
 {
   LOG_TRACE;
   Hiredis* hiredis = static_cast<Hiredis*>(privdata);
-  hiredis->channel_->disableWriting();
+  if (hiredis->channel_->isWriting())
+  {
+    hiredis->channel_->disableWriting();
+  }
 }
 
 void Hiredis::cleanup(void* privdata)
@@ -211,6 +269,24 @@ int Hiredis::command(const CommandCallback& cb, muduo::StringArg cmd, ...)
   va_start(args, cmd);
   int ret = ::redisvAsyncCommand(context_, commandCallback, p, cmd.c_str(), args);
   va_end(args);
+  if (ret != REDIS_OK)
+  {
+    delete p;
+  }
+  return ret;
+}
+
+int Hiredis::formattedCommand(const CommandCallback& cb, StringPiece cmd)
+{
+  if (!connected()) return REDIS_ERR;
+
+  CommandCallback* p = new CommandCallback(cb);
+  int ret = ::redisAsyncFormattedCommand(context_, commandCallback, p,
+                                         cmd.data(), static_cast<size_t>(cmd.size()));
+  if (ret != REDIS_OK)
+  {
+    delete p;
+  }
   return ret;
 }
 
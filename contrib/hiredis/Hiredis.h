@@ -45,13 +45,19 @@ class Hiredis : public std::enable_shared_from_this<Hiredis>,
   void connect();
   void disconnect();  // FIXME: implement this with redisAsyncDisconnect
 
+  // Commands issued in one loop iteration are written together,
+  // in one write(2), after the events of this iteration are handled.
   int command(const CommandCallback& cb, muduo::StringArg cmd, ...);
 
+  // cmd is already in the Redis protocol, eg. by redisFormatCommand().
+  int formattedCommand(const CommandCallback& cb, muduo::StringPiece cmd);
+
   int ping();
 
  private:
   void handleRead(muduo::Timestamp receiveTime);
   void handleWrite();
+  void flushWrites(const std::weak_ptr<muduo::net::Channel>& channel);
 
   int fd() const;
   void logConnection(bool up) const;
@@ -82,6 +88,8 @@ class Hiredis : public std::enable_shared_from_this<Hiredis>,
   const muduo::net::InetAddress serverAddr_;
   redisAsyncContext* context_;
   std::shared_ptr<muduo::net::Channel> channel_;
+  bool writeScheduled_;  // flushWrites() is queued
+  bool writing_;         // in redisAsyncHandleWrite()
   ConnectCallback connectCb_;
   DisconnectCallback disconnectCb_;
 };
@@ -0,0 +1,213 @@
+#include "contrib/hiredis/HiredisPool.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+using namespace hiredis;
+
+namespace
+{
+const double kReconnectDelay = 1.0;  // seconds
+}
+
+// touched in its loop only
+struct HiredisPool::Slot
+{
+  explicit Slot(EventLoop* l)
+    : loop(l),
+      connecting(false),
+      stopping(false),
+      latch(NULL)
+  {
+  }
+
+  EventLoop* loop;
+  std::unique_ptr<Hiredis> hiredis;
+  bool connecting;
+  bool stopping;
+  CountDownLatch* latch;
+};
+
+HiredisPool::HiredisPool(EventLoop* baseLoop,
+                         const InetAddress& serverAddr,
+                         int numThreads,
+                         int numConnections)
+  : baseLoop_(baseLoop),
+    serverAddr_(serverAddr),
+    threadPool_(new EventLoopThreadPool(baseLoop, "HiredisPool"))
+{
+  assert(numConnections > 0);
+  threadPool_->setThreadNum(numThreads);
+  slots_.resize(numConnections);
+}
+
+HiredisPool::~HiredisPool()
+{
+  if (!threadPool_->started())
+  {
+    return;
+  }
+  CountDownLatch latch(numConnections());
+  for (auto& slot : slots_)
+  {
+    slot->loop->runInLoop(std::bind(&HiredisPool::stopInLoop, this, slot.get(), &latch));
+  }
+  latch.wait();
+}
+
+void HiredisPool::start()
+{
+  baseLoop_->assertInLoopThread();
+  threadPool_->start();
+  for (auto& slot : slots_)
+  {
+    slot.reset(new Slot(threadPool_->getNextLoop()));
+    slot->loop->runInLoop(std::bind(&HiredisPool::connect, this, slot.get()));
+  }
+}
+
+HiredisPool::Slot& HiredisPool::nextSlot()
+{
+  assert(threadPool_->started());
+  uint32_t n = static_cast<uint32_t>(next_.getAndAdd(1));
+  return *slots_[n % slots_.size()];
+}
+
+int HiredisPool::command(const CommandCallback& cb, StringArg cmd, ...)
+{
+  char* buf = NULL;
+  va_list args;
+  va_start(args, cmd);
+  int len = ::redisvFormatCommand(&buf, cmd.c_str(), args);
+  va_end(args);
+  if (len < 0)
+  {
+    return REDIS_ERR;
+  }
+  // formatted here, so the loop of the connection only writes it
+  string formatted(buf, static_cast<size_t>(len));
+  ::free(buf);
+  formattedCommand(cb, formatted);
+  return REDIS_OK;
+}
+
+void HiredisPool::formattedCommand(const CommandCallback& cb, const string& cmd)
+{
+  Slot& slot = nextSlot();
+  slot.loop->runInLoop(std::bind(&HiredisPool::sendInLoop, this, &slot, cmd, cb));
+}
+
+void HiredisPool::get(StringPiece key, const GetCallback& cb)
+{
+  command(std::bind(&HiredisPool::onGetReply, cb, _2),
+          "GET %b", key.data(), static_cast<size_t>(key.size()));
+}
+
+void HiredisPool::sendInLoop(Slot* slot, const string& cmd, const CommandCallback& cb)
+{
+  slot->loop->assertInLoopThread();
+  if (!slot->hiredis || slot->hiredis->formattedCommand(cb, cmd) != REDIS_OK)
+  {
+    cb(slot->hiredis.get(), NULL);
+  }
+}
+
+void HiredisPool::onGetReply(const GetCallback& cb, redisReply* reply)
+{
+  if (reply && reply->type == REDIS_REPLY_STRING)
+  {
+    cb(true, StringPiece(reply->str, reply->len));
+  }
+  else
+  {
+    if (reply && reply->type == REDIS_REPLY_ERROR)
+    {
+      LOG_ERROR << "HiredisPool::get - " << reply->str;
+    }
+    cb(false, StringPiece());
+  }
+}
+
+void HiredisPool::connect(Slot* slot)
+{
+  slot->loop->assertInLoopThread();
+  slot->hiredis.reset(new Hiredis(slot->loop, serverAddr_));
+  slot->hiredis->setConnectCallback(
+      std::bind(&HiredisPool::onConnect, this, slot, _1, _2));
+  slot->hiredis->setDisconnectCallback(
+      std::bind(&HiredisPool::onDisconnect, this, slot, _1, _2));
+  slot->connecting = true;
+  slot->hiredis->connect();
+}
+
+void HiredisPool::reconnect(Slot* slot)
+{
+  if (!slot->stopping)
+  {
+    // the old one is no longer in its own callbacks
+    connect(slot);
+  }
+}
+
+void HiredisPool::onConnect(Slot* slot, Hiredis* c, int status)
+{
+  assert(slot->hiredis.get() == c);
+  slot->connecting = false;
+  if (status == REDIS_OK)
+  {
+    connected_.increment();
+    if (slot->stopping)
+    {
+      c->disconnect();
+    }
+  }
+  else if (slot->stopping)
+  {
+    slot->latch->countDown();
+  }
+  else
+  {
+    slot->loop->runAfter(kReconnectDelay, std::bind(&HiredisPool::reconnect, this, slot));
+  }
+}
+
+void HiredisPool::onDisconnect(Slot* slot, Hiredis* c, int status)
+{
+  assert(slot->hiredis.get() == c);
+  connected_.decrement();
+  if (status != REDIS_OK)
+  {
+    LOG_WARN << "HiredisPool - " << serverAddr_.toIpPort() << " " << c->errstr();
+  }
+  if (slot->stopping)
+  {
+    slot->latch->countDown();
+  }
+  else
+  {
+    slot->loop->runAfter(kReconnectDelay, std::bind(&HiredisPool::reconnect, this, slot));
+  }
+}
+
+void HiredisPool::stopInLoop(Slot* slot, CountDownLatch* latch)
+{
+  slot->stopping = true;
+  slot->latch = latch;
+  if (slot->hiredis && slot->hiredis->connected())
+  {
+    // after the replies of commands sent, see onDisconnect()
+    slot->hiredis->disconnect();
+  }
+  else if (!slot->connecting)
+  {
+    // waiting to reconnect
+    latch->countDown();
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef MUDUO_CONTRIB_HIREDIS_HIREDISPOOL_H
+#define MUDUO_CONTRIB_HIREDIS_HIREDISPOOL_H
+
+#include "contrib/hiredis/Hiredis.h"
+
+#include "muduo/base/Atomic.h"
+
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+class CountDownLatch;
+namespace net
+{
+class EventLoopThreadPool;
+}
+}
+
+namespace hiredis
+{
+
+// Connections to one Redis server, spread across the loops of an
+// EventLoopThreadPool.  Commands may be issued from any thread, each goes to
+// the next connection in turn and is pipelined with the other commands
+// issued to that connection in the same loop iteration.
+//
+// A lost connection is made again after a while; commands issued to it in
+// the meantime fail, their callbacks get a NULL reply.
+class HiredisPool : muduo::noncopyable
+{
+ public:
+  typedef Hiredis::CommandCallback CommandCallback;
+  // value points into the reply, it is valid during the callback only
+  typedef std::function<void(bool found, muduo::StringPiece value)> GetCallback;
+
+  HiredisPool(muduo::net::EventLoop* baseLoop,
+              const muduo::net::InetAddress& serverAddr,
+              int numThreads,
+              int numConnections);
+  // waits for the replies of commands issued
+  ~HiredisPool();
+
+  // in the thread of baseLoop
+  void start();
+
+  int numConnections() const { return static_cast<int>(slots_.size()); }
+  int numConnected() { return connected_.get(); }
+
+  // thread safe, callbacks run in the loop of the connection
+  int command(const CommandCallback& cb, muduo::StringArg cmd, ...);
+  void formattedCommand(const CommandCallback& cb, const muduo::string& cmd);
+  void get(muduo::StringPiece key, const GetCallback& cb);
+
+ private:
+  struct Slot;
+
+  Slot& nextSlot();
+  void connect(Slot* slot);
+  void reconnect(Slot* slot);
+  void stopInLoop(Slot* slot, muduo::CountDownLatch* latch);
+  void sendInLoop(Slot* slot, const muduo::string& cmd, const CommandCallback& cb);
+
+  void onConnect(Slot* slot, Hiredis* c, int status);
+  void onDisconnect(Slot* slot, Hiredis* c, int status);
+  static void onGetReply(const GetCallback& cb, redisReply* reply);
+
+  muduo::net::EventLoop* baseLoop_;
+  const muduo::net::InetAddress serverAddr_;
+  // before threadPool_, the loops are gone when Hiredis objects are destroyed
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::unique_ptr<muduo::net::EventLoopThreadPool> threadPool_;
+  muduo::AtomicInt32 next_;
+  muduo::AtomicInt32 connected_;
+};
+
+}  // namespace hiredis
+
+#endif  // MUDUO_CONTRIB_HIREDIS_HIREDISPOOL_H
@@ -1,10 +1,17 @@
 #include "contrib/hiredis/Hiredis.h"
+#include "contrib/hiredis/HiredisPool.h"
 
+#include "muduo/base/Atomic.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 
+#include <atomic>
 #include <string>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
@@ -105,8 +112,141 @@ void echo(hiredis::Hiredis* c, string* s)
   c->command(std::bind(echoCallback, _1, _2, s), "echo %s", s->c_str());
 }
 
+// Keeps pipeline GETs in flight per connection, each reply issues another.
+class Bench : muduo::noncopyable
+{
+ public:
+  Bench(EventLoop* loop, const InetAddress& serverAddr,
+        int threads, int connections, int pipeline, int valueSize)
+    : loop_(loop),
+      pool_(loop, serverAddr, threads, connections),
+      pipeline_(pipeline),
+      value_(valueSize, 'x'),
+      running_(false),
+      seconds_(0),
+      lastOps_(0)
+  {
+  }
+
+  void start(int seconds)
+  {
+    seconds_ = seconds;
+    pool_.start();
+    loop_->runEvery(0.1, std::bind(&Bench::waitConnected, this));
+  }
+
+ private:
+  void waitConnected()
+  {
+    if (running_ || pool_.numConnected() != pool_.numConnections())
+    {
+      return;
+    }
+    running_ = true;
+    pool_.command(std::bind(&Bench::onSet, this, _2),
+                  "SET %s %b", kKey, value_.data(), value_.size());
+  }
+
+  void onSet(redisReply* reply)
+  {
+    if (!reply || reply->type == REDIS_REPLY_ERROR)
+    {
+      LOG_FATAL << "SET failed";
+    }
+    start_ = Timestamp::now();
+    loop_->runAfter(seconds_, std::bind(&Bench::stop, this));
+    loop_->runEvery(1.0, std::bind(&Bench::report, this));
+    for (int i = 0; i < pipeline_ * pool_.numConnections(); ++i)
+    {
+      get();
+    }
+  }
+
+  void get()
+  {
+    pool_.get(kKey, std::bind(&Bench::onGet, this, _1, _2));
+  }
+
+  // in the threads of the pool
+  void onGet(bool found, StringPiece value)
+  {
+    if (!found || value.size() != static_cast<int>(value_.size()))
+    {
+      errors_.increment();
+    }
+    ops_.increment();
+    if (running_)
+    {
+      get();
+    }
+  }
+
+  void report()
+  {
+    int64_t ops = ops_.get();
+    printf("%lld ops/s, %lld errors\n",
+           static_cast<long long>(ops - lastOps_), static_cast<long long>(errors_.get()));
+    lastOps_ = ops;
+  }
+
+  void stop()
+  {
+    running_ = false;
+    double seconds = timeDifference(Timestamp::now(), start_);
+    printf("%d connections, %d in flight each, %zd-byte values\n",
+           pool_.numConnections(), pipeline_, value_.size());
+    printf("%lld GETs in %.3f seconds, %.1f ops/s\n",
+           static_cast<long long>(ops_.get()), seconds,
+           static_cast<double>(ops_.get()) / seconds);
+    loop_->quit();
+  }
+
+  static const char* const kKey;
+
+  EventLoop* loop_;
+  hiredis::HiredisPool pool_;
+  const int pipeline_;
+  const string value_;
+  std::atomic<bool> running_;
+  int seconds_;
+  Timestamp start_;
+  AtomicInt64 ops_;
+  AtomicInt64 errors_;
+  int64_t lastOps_;
+};
+
+const char* const Bench::kKey = "mrediscli:bench";
+
+int bench(int argc, char** argv)
+{
+  const int threads = argc > 2 ? atoi(argv[2]) : 2;
+  const int connections = argc > 3 ? atoi(argv[3]) : 4;
+  const int pipeline = argc > 4 ? atoi(argv[4]) : 32;
+  const int seconds = argc > 5 ? atoi(argv[5]) : 10;
+  const int valueSize = argc > 6 ? atoi(argv[6]) : 100;
+
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  InetAddress serverAddr("127.0.0.1", 6379);
+  Bench bench(&loop, serverAddr, threads, connections, pipeline, valueSize);
+  bench.start(seconds);
+  loop.loop();
+  return 0;
+}
+
 int main(int argc, char** argv)
 {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    return bench(argc, argv);
+  }
+  if (argc > 1)
+  {
+    printf("Usage: %s [bench [threads [connections [pipeline [seconds [valueSize]]]]]]\n",
+           argv[0]);
+    return 0;
+  }
+
   Logger::setLogLevel(Logger::DEBUG);
 
   EventLoop loop;
@@ -0,0 +1,119 @@
+#ifndef MUDUO_CONTRIB_THRIFT_THRIFTBUFFERTRANSPORT_H
+#define MUDUO_CONTRIB_THRIFT_THRIFTBUFFERTRANSPORT_H
+
+#include <algorithm>
+
+#include <string.h>
+
+#include "muduo/net/Buffer.h"
+
+#include <thrift/transport/TTransportException.h>
+#include <thrift/transport/TVirtualTransport.h>
+
+// Reads a request in place, from bytes owned by someone else, eg. the input
+// Buffer of a TcpConnection, and writes the response to a muduo Buffer.
+// There is no intermediate TMemoryBuffer, so a request is never copied
+// and a response is copied once, by the protocol.
+//
+// Protocols templated on it, eg. TBinaryProtocolT<ThriftBufferTransport>,
+// call it without virtual functions.
+class ThriftBufferTransport
+  : public apache::thrift::transport::TVirtualTransport<ThriftBufferTransport>
+{
+ public:
+  ThriftBufferTransport()
+    : rBase_(NULL),
+      rBound_(NULL),
+      output_(NULL)
+  {
+  }
+
+  // data must outlive the processing of the request
+  void resetInput(const char* data, size_t len)
+  {
+    rBase_ = reinterpret_cast<const uint8_t*>(data);
+    rBound_ = rBase_ + len;
+  }
+
+  void resetOutput(muduo::net::Buffer* output)
+  {
+    output_ = output;
+  }
+
+  bool isOpen()
+  {
+    return true;
+  }
+
+  bool peek()
+  {
+    return rBase_ < rBound_;
+  }
+
+  void open()
+  {
+  }
+
+  void close()
+  {
+  }
+
+  uint32_t read(uint8_t* buf, uint32_t len)
+  {
+    uint32_t n = std::min(len, available());
+    memcpy(buf, rBase_, n);
+    rBase_ += n;
+    return n;
+  }
+
+  uint32_t readAll(uint8_t* buf, uint32_t len)
+  {
+    if (available() < len)
+    {
+      throw apache::thrift::transport::TTransportException(
+          apache::thrift::transport::TTransportException::END_OF_FILE,
+          "request is truncated");
+    }
+    memcpy(buf, rBase_, len);
+    rBase_ += len;
+    return len;
+  }
+
+  void write(const uint8_t* buf, uint32_t len)
+  {
+    output_->append(buf, len);
+  }
+
+  const uint8_t* borrow(uint8_t* /*buf*/, uint32_t* len)
+  {
+    if (available() >= *len)
+    {
+      *len = available();
+      return rBase_;
+    }
+    return NULL;
+  }
+
+  void consume(uint32_t len)
+  {
+    if (available() < len)
+    {
+      throw apache::thrift::transport::TTransportException(
+          apache::thrift::transport::TTransportException::BAD_ARGS,
+          "consume did not follow a borrow");
+    }
+    rBase_ += len;
+  }
+
+ private:
+  uint32_t available() const
+  {
+    return static_cast<uint32_t>(rBound_ - rBase_);
+  }
+
+  const uint8_t* rBase_;
+  const uint8_t* rBound_;
+  muduo::net::Buffer* output_;
+};
+
+#endif  // MUDUO_CONTRIB_THRIFT_THRIFTBUFFERTRANSPORT_H
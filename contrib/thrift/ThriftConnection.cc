@@ -4,6 +4,8 @@
 
 #include "muduo/base/Logging.h"
 
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/transport/TTransportException.h>
 
 #include "contrib/thrift/ThriftServer.h"
@@ -11,18 +13,54 @@
 using namespace muduo;
 using namespace muduo::net;
 
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::protocol::TCompactProtocolT;
+
+namespace
+{
+
+const uint16_t kHeaderMagic = 0x0FFF;
+const size_t kHeaderFixedSize = 10;  // magic, flags, sequence id, header size
+
+// a worker gives the connection up after so many requests, to be fair
+const int kMaxRequestsPerRun = 16;
+
+uint16_t readUint16(const uint8_t* p)
+{
+  return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+bool readVarint(const uint8_t** p, const uint8_t* end, uint32_t* value)
+{
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35 && *p < end; shift += 7)
+  {
+    uint8_t byte = *(*p)++;
+    result |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
 ThriftConnection::ThriftConnection(ThriftServer* server,
-                                  const TcpConnectionPtr& conn)
+                                   const TcpConnectionPtr& conn)
   : server_(server),
     conn_(conn),
-    state_(kExpectFrameSize),
-    frameSize_(0)
+    failed_(false),
+    processing_(false),
+    readStopped_(false)
 {
-  conn_->setMessageCallback(boost::bind(&ThriftConnection::onMessage,
-                                        this, _1, _2, _3));
+  conn_->setMessageCallback(std::bind(&ThriftConnection::onMessage,
+                                      this, muduo::_1, muduo::_2, muduo::_3));
   nullTransport_.reset(new TNullTransport());
-  inputTransport_.reset(new TMemoryBuffer(NULL, 0));
-  outputTransport_.reset(new TMemoryBuffer());
+  inputTransport_.reset(new ThriftBufferTransport());
+  outputTransport_.reset(new ThriftBufferTransport());
 
   factoryInputTransport_ = server_->getInputTransportFactory()->getTransport(inputTransport_);
   factoryOutputTransport_ = server_->getOutputTransportFactory()->getTransport(outputTransport_);
@@ -37,85 +75,228 @@ void ThriftConnection::onMessage(const TcpConnectionPtr& conn,
                                  Buffer* buffer,
                                  Timestamp receiveTime)
 {
-  bool more = true;
-  while (more)
+  while (buffer->readableBytes() >= 4)
   {
-    if (state_ == kExpectFrameSize)
+    const uint32_t frameSize = static_cast<uint32_t>(buffer->peekInt32());
+    if (frameSize > server_->maxFrameSize())
+    {
+      LOG_ERROR << "ThriftConnection::onMessage - frame of " << frameSize
+                << " bytes from " << conn->peerAddress().toIpPort();
+      buffer->retrieveAll();
+      conn->forceClose();
+      return;
+    }
+    if (buffer->readableBytes() < 4 + static_cast<size_t>(frameSize))
+    {
+      break;
+    }
+
+    if (server_->isWorkerThreadPoolProcessing())
     {
-      if (buffer->readableBytes() >= 4)
+      Buffer request;
+      if (buffer->readableBytes() == 4 + static_cast<size_t>(frameSize))
       {
-        frameSize_ = static_cast<uint32_t>(buffer->readInt32());
-        state_ = kExpectFrame;
+        // the usual case, nothing pipelined behind, take the whole buffer
+        request.swap(*buffer);
+        request.retrieve(4);
       }
       else
       {
-        more = false;
+        request.append(buffer->peek() + 4, frameSize);
+        buffer->retrieve(4 + static_cast<size_t>(frameSize));
       }
-    }
-    else if (state_ == kExpectFrame)
-    {
-      if (buffer->readableBytes() >= frameSize_)
-      {
-        uint8_t* buf = reinterpret_cast<uint8_t*>((const_cast<char*>(buffer->peek())));
-
-        inputTransport_->resetBuffer(buf, frameSize_, TMemoryBuffer::COPY);
-        outputTransport_->resetBuffer();
-        outputTransport_->getWritePtr(4);
-        outputTransport_->wroteBytes(4);
 
-        if (server_->isWorkerThreadPoolProcessing())
-        {
-          server_->workerThreadPool().run(boost::bind(&ThriftConnection::process, this));
-        }
-        else
+      bool schedule = false;
+      bool stopRead = false;
+      {
+        MutexLockGuard lock(mutex_);
+        requests_.push_back(Buffer());
+        requests_.back().swap(request);
+        schedule = !processing_;
+        processing_ = true;
+        if (!readStopped_ && requests_.size() >= server_->maxPendingRequests())
         {
-          process();
+          readStopped_ = stopRead = true;
         }
+      }
+      if (stopRead)
+      {
+        // until the worker catches up
+        conn->stopRead();
+      }
+      if (schedule)
+      {
+        server_->workerThreadPool().run(
+            boost::bind(&ThriftConnection::processRequests, shared_from_this()));
+      }
+    }
+    else
+    {
+      // in place, the frame stays in buffer while being processed
+      bool ok = process(buffer->peek() + 4, frameSize);
+      buffer->retrieve(4 + static_cast<size_t>(frameSize));
+      if (!ok)
+      {
+        buffer->retrieveAll();
+        fail();
+        return;
+      }
+    }
+  }
+}
 
-        buffer->retrieve(frameSize_);
-        state_ = kExpectFrameSize;
+void ThriftConnection::processRequests()
+{
+  for (int i = 0; i < kMaxRequestsPerRun; ++i)
+  {
+    Buffer request;
+    bool startRead = false;
+    {
+      MutexLockGuard lock(mutex_);
+      if (requests_.empty())
+      {
+        processing_ = false;
+        return;
       }
-      else
+      request.swap(requests_.front());
+      requests_.pop_front();
+      if (readStopped_ && requests_.size() <= server_->maxPendingRequests() / 2)
       {
-        more = false;
+        readStopped_ = false;
+        startRead = true;
       }
     }
+    if (startRead)
+    {
+      conn_->startRead();
+    }
+    if (!failed_ && !process(request.peek(), static_cast<uint32_t>(request.readableBytes())))
+    {
+      fail();
+    }
   }
+  // still processing_, continue after other connections had their turn
+  server_->workerThreadPool().run(
+      boost::bind(&ThriftConnection::processRequests, shared_from_this()));
 }
 
-void ThriftConnection::process()
+bool ThriftConnection::process(const char* frame, uint32_t size)
 {
+  Buffer output;
+  bool ok = false;
   try
   {
-    processor_->process(inputProtocol_, outputProtocol_, NULL);
-
-    uint8_t* buf;
-    uint32_t size;
-    outputTransport_->getBuffer(&buf, &size);
-
-    assert(size >= 4);
-    uint32_t frameSize = static_cast<uint32_t>(htonl(size - 4));
-    memcpy(buf, &frameSize, 4);
-
-    conn_->send(buf, size);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(frame);
+    if (size >= kHeaderFixedSize && readUint16(p) == kHeaderMagic)
+    {
+      ok = processHeader(frame, size, &output);
+    }
+    else
+    {
+      inputTransport_->resetInput(frame, size);
+      outputTransport_->resetOutput(&output);
+      ok = processor_->process(inputProtocol_, outputProtocol_, NULL);
+    }
   } catch (const TTransportException& ex)
   {
     LOG_ERROR << "ThriftServer TTransportException: " << ex.what();
-    close();
   } catch (const std::exception& ex)
   {
     LOG_ERROR << "ThriftServer std::exception: " << ex.what();
-    close();
   } catch (...)
   {
     LOG_ERROR << "ThriftServer unknown exception";
-    close();
   }
+
+  // nothing for oneway calls
+  if (ok && output.readableBytes() > 0)
+  {
+    output.prependInt32(static_cast<int32_t>(output.readableBytes()));
+    conn_->send(&output);
+  }
+  return ok;
+}
+
+// THeader, see doc/specs/HeaderFormat.md in Thrift:
+//   magic:16 flags:16 sequence:32 headerWords:16
+//   header: protocol id (varint), number of transforms (varint), transforms,
+//           info headers, padding
+//   payload
+bool ThriftConnection::processHeader(const char* frame, uint32_t size, Buffer* output)
+{
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(frame);
+  const uint16_t flags = readUint16(p + 2);
+  int32_t sequence = 0;
+  memcpy(&sequence, p + 4, sizeof sequence);
+  const size_t headerSize = static_cast<size_t>(readUint16(p + 8)) * 4;
+  if (kHeaderFixedSize + headerSize > size)
+  {
+    LOG_ERROR << "ThriftConnection - bad header size " << headerSize;
+    return false;
+  }
+
+  const uint8_t* header = p + kHeaderFixedSize;
+  const uint8_t* headerEnd = header + headerSize;
+  uint32_t protocolId = 0;
+  uint32_t numTransforms = 0;
+  if (!readVarint(&header, headerEnd, &protocolId)
+      || !readVarint(&header, headerEnd, &numTransforms))
+  {
+    LOG_ERROR << "ThriftConnection - bad header";
+    return false;
+  }
+  if (numTransforms != 0)
+  {
+    LOG_ERROR << "ThriftConnection - header transforms are not supported";
+    return false;
+  }
+  // info headers are ignored
+
+  if (protocolId == kHeaderBinary && !headerInputProtocols_[kHeaderBinary])
+  {
+    headerInputProtocols_[kHeaderBinary].reset(
+        new TBinaryProtocolT<ThriftBufferTransport>(inputTransport_));
+    headerOutputProtocols_[kHeaderBinary].reset(
+        new TBinaryProtocolT<ThriftBufferTransport>(outputTransport_));
+  }
+  else if (protocolId == kHeaderCompact && !headerInputProtocols_[kHeaderCompact])
+  {
+    headerInputProtocols_[kHeaderCompact].reset(
+        new TCompactProtocolT<ThriftBufferTransport>(inputTransport_));
+    headerOutputProtocols_[kHeaderCompact].reset(
+        new TCompactProtocolT<ThriftBufferTransport>(outputTransport_));
+  }
+  else if (protocolId != kHeaderBinary && protocolId != kHeaderCompact)
+  {
+    LOG_ERROR << "ThriftConnection - unsupported header protocol " << protocolId;
+    return false;
+  }
+
+  // the reply echoes flags and sequence, with a 4-byte header
+  output->appendInt16(static_cast<int16_t>(kHeaderMagic));
+  output->appendInt16(static_cast<int16_t>(flags));
+  output->append(&sequence, sizeof sequence);
+  output->appendInt16(1);
+  const char replyHeader[4] = { static_cast<char>(protocolId), 0, 0, 0 };
+  output->append(replyHeader, sizeof replyHeader);
+  const size_t replyHeaderSize = output->readableBytes();
+
+  const size_t payloadOffset = kHeaderFixedSize + headerSize;
+  inputTransport_->resetInput(frame + payloadOffset, size - payloadOffset);
+  outputTransport_->resetOutput(output);
+  bool ok = processor_->process(headerInputProtocols_[protocolId],
+                                headerOutputProtocols_[protocolId],
+                                NULL);
+  if (output->readableBytes() == replyHeaderSize)
+  {
+    // oneway
+    output->retrieveAll();
+  }
+  return ok;
 }
 
-void ThriftConnection::close()
+void ThriftConnection::fail()
 {
-  nullTransport_->close();
-  factoryInputTransport_->close();
-  factoryOutputTransport_->close();
+  failed_ = true;
+  conn_->forceClose();
 }
@@ -1,44 +1,63 @@
 #ifndef MUDUO_CONTRIB_THRIFT_THRIFTCONNECTION_H
 #define MUDUO_CONTRIB_THRIFT_THRIFTCONNECTION_H
 
+#include <deque>
+
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/noncopyable.hpp>
 
+#include "muduo/base/Mutex.h"
 #include "muduo/net/TcpConnection.h"
 
 #include <thrift/protocol/TProtocol.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/TTransportUtils.h>
 
+#include "contrib/thrift/ThriftBufferTransport.h"
+
 using apache::thrift::TProcessor;
 using apache::thrift::protocol::TProtocol;
-using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::transport::TNullTransport;
 using apache::thrift::transport::TTransport;
 using apache::thrift::transport::TTransportException;
 
 class ThriftServer;
 
+// One client connection, speaking the framed transport or the header
+// transport (THeader without transforms, with binary or compact protocol).
+//
+// Without worker threads, requests are processed in the IO thread, in place
+// in the input Buffer.  With them, requests are queued and processed in
+// order by one worker at a time, so a client may pipeline requests while
+// different connections are served in parallel.
 class ThriftConnection : boost::noncopyable,
                          public boost::enable_shared_from_this<ThriftConnection>
 {
  public:
-  enum State
-  {
-    kExpectFrameSize,
-    kExpectFrame
-  };
-
   ThriftConnection(ThriftServer* server, const muduo::net::TcpConnectionPtr& conn);
 
  private:
+  friend class ThriftServer;
+
+  // protocol ids of THeader
+  enum HeaderProtocol
+  {
+    kHeaderBinary = 0,
+    kHeaderCompact = 2,
+  };
+
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
                  muduo::net::Buffer* buffer,
                  muduo::Timestamp receiveTime);
 
-  void process();
+  // worker threads
+  void processRequests();
+
+  // frame excludes the 4-byte size, returns false to close the connection
+  bool process(const char* frame, uint32_t size);
 
-  void close();
+  bool processHeader(const char* frame, uint32_t size, muduo::net::Buffer* output);
+
+  void fail();
 
  private:
   ThriftServer* server_;
@@ -46,8 +65,8 @@ class ThriftConnection : boost::noncopyable,
 
   boost::shared_ptr<TNullTransport> nullTransport_;
 
-  boost::shared_ptr<TMemoryBuffer> inputTransport_;
-  boost::shared_ptr<TMemoryBuffer> outputTransport_;
+  boost::shared_ptr<ThriftBufferTransport> inputTransport_;
+  boost::shared_ptr<ThriftBufferTransport> outputTransport_;
 
   boost::shared_ptr<TTransport> factoryInputTransport_;
   boost::shared_ptr<TTransport> factoryOutputTransport_;
@@ -55,10 +74,19 @@ class ThriftConnection : boost::noncopyable,
   boost::shared_ptr<TProtocol> inputProtocol_;
   boost::shared_ptr<TProtocol> outputProtocol_;
 
+  // for the header transport, made on first use
+  boost::shared_ptr<TProtocol> headerInputProtocols_[kHeaderCompact + 1];
+  boost::shared_ptr<TProtocol> headerOutputProtocols_[kHeaderCompact + 1];
+
   boost::shared_ptr<TProcessor> processor_;
 
-  enum State state_;
-  uint32_t frameSize_;
+  // used by one thread at a time, the IO thread or the worker processing
+  bool failed_;
+
+  muduo::MutexLock mutex_;
+  std::deque<muduo::net::Buffer> requests_ GUARDED_BY(mutex_);
+  bool processing_ GUARDED_BY(mutex_);
+  bool readStopped_ GUARDED_BY(mutex_);
 };
 
 typedef boost::shared_ptr<ThriftConnection> ThriftConnectionPtr;
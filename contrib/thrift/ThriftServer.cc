@@ -7,6 +7,9 @@
 using namespace muduo;
 using namespace muduo::net;
 
+const uint32_t ThriftServer::kDefaultMaxFrameSize;
+const size_t ThriftServer::kDefaultMaxPendingRequests;
+
 ThriftServer::~ThriftServer() = default;
 
 void ThriftServer::serve()
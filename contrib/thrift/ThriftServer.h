@@ -23,6 +23,9 @@ class ThriftServer : boost::noncopyable,
                      public TServer
 {
  public:
+  static const uint32_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+  static const size_t kDefaultMaxPendingRequests = 1024;
+
   template <typename ProcessorFactory>
   ThriftServer(const boost::shared_ptr<ProcessorFactory>& processorFactory,
                muduo::net::EventLoop* eventloop,
@@ -32,6 +35,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -47,6 +52,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -63,6 +70,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -81,6 +90,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -100,6 +111,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -121,6 +134,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -144,6 +159,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processorFactory),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -167,6 +184,8 @@ class ThriftServer : boost::noncopyable,
     : TServer(processor),
       server_(eventloop, addr, name),
       numWorkerThreads_(0),
+      maxFrameSize_(kDefaultMaxFrameSize),
+      maxPendingRequests_(kDefaultMaxPendingRequests),
       workerThreadPool_(name + muduo::string("WorkerThreadPool"))
   {
     server_.setConnectionCallback(boost::bind(&ThriftServer::onConnection,
@@ -206,6 +225,30 @@ class ThriftServer : boost::noncopyable,
     numWorkerThreads_ = numWorkerThreads;
   }
 
+  // larger frames close the connection
+  void setMaxFrameSize(uint32_t bytes)
+  {
+    maxFrameSize_ = bytes;
+  }
+
+  uint32_t maxFrameSize() const
+  {
+    return maxFrameSize_;
+  }
+
+  // with worker threads, a connection stops reading while it has so many
+  // requests queued, and resumes at half of it
+  void setMaxPendingRequests(size_t requests)
+  {
+    assert(requests > 0);
+    maxPendingRequests_ = requests;
+  }
+
+  size_t maxPendingRequests() const
+  {
+    return maxPendingRequests_;
+  }
+
  private:
   friend class ThriftConnection;
 
@@ -214,6 +257,8 @@ class ThriftServer : boost::noncopyable,
  private:
   muduo::net::TcpServer server_;
   int numWorkerThreads_;
+  uint32_t maxFrameSize_;
+  size_t maxPendingRequests_;
   muduo::ThreadPool workerThreadPool_;
   muduo::MutexLock mutex_;
   std::map<muduo::string, ThriftConnectionPtr> conns_;
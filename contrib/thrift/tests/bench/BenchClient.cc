@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TSocket.h>
+
+#include "Bench.h"
+
+using namespace muduo;
+
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransport;
+
+using namespace bench;
+
+struct Options
+{
+  const char* host;
+  int port;
+  int calls;      // per connection
+  int pipeline;   // calls in flight per connection
+  int payload;    // bytes
+};
+
+// one connection, sends pipeline calls then reads their replies
+void runClient(const Options& options, CountDownLatch* start,
+               std::vector<int64_t>* latencies)
+{
+  boost::shared_ptr<TSocket> socket(new TSocket(options.host, options.port));
+  socket->setNoDelay(true);
+  boost::shared_ptr<TTransport> transport(new TFramedTransport(socket));
+  boost::shared_ptr<TProtocol> protocol(new TBinaryProtocol(transport));
+  BenchClient client(protocol);
+  transport->open();
+
+  const std::string payload(options.payload, 'x');
+  std::string result;
+  latencies->reserve(options.calls / options.pipeline + 1);
+  start->wait();
+  for (int done = 0; done < options.calls; )
+  {
+    const int n = std::min(options.pipeline, options.calls - done);
+    Timestamp sent(Timestamp::now());
+    for (int i = 0; i < n; ++i)
+    {
+      client.send_echo(payload);
+    }
+    for (int i = 0; i < n; ++i)
+    {
+      client.recv_echo(result);
+      if (result.size() != payload.size())
+      {
+        fprintf(stderr, "bad reply of %zd bytes\n", result.size());
+        abort();
+      }
+    }
+    latencies->push_back(Timestamp::now().microSecondsSinceEpoch()
+                         - sent.microSecondsSinceEpoch());
+    done += n;
+  }
+  transport->close();
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s host [port [connections [callsPerConnection [pipeline [payloadBytes]]]]]\n",
+           argv[0]);
+    return 0;
+  }
+
+  Options options;
+  options.host = argv[1];
+  options.port = argc > 2 ? atoi(argv[2]) : 9090;
+  const int connections = argc > 3 ? atoi(argv[3]) : 4;
+  options.calls = argc > 4 ? atoi(argv[4]) : 100000;
+  options.pipeline = argc > 5 ? atoi(argv[5]) : 1;
+  options.payload = argc > 6 ? atoi(argv[6]) : 16;
+
+  CountDownLatch start(1);
+  std::vector<std::vector<int64_t> > latencies(connections);
+  boost::ptr_vector<Thread> threads;
+  for (int i = 0; i < connections; ++i)
+  {
+    threads.push_back(new Thread(boost::bind(runClient, boost::cref(options), &start,
+                                             &latencies[i])));
+    threads.back().start();
+  }
+
+  // connected or nearly, the connect time is not what we measure
+  sleep(1);
+  Timestamp begin(Timestamp::now());
+  start.countDown();
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    threads[i].join();
+  }
+  double seconds = timeDifference(Timestamp::now(), begin);
+
+  std::vector<int64_t> all;
+  for (size_t i = 0; i < latencies.size(); ++i)
+  {
+    all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+  }
+  std::sort(all.begin(), all.end());
+  const size_t n = all.size();
+  printf("%d connections, %d calls each, pipeline %d, payload %d bytes\n",
+         connections, options.calls, options.pipeline, options.payload);
+  printf("%.3f seconds, %.1f calls per second\n",
+         seconds, connections * static_cast<double>(options.calls) / seconds);
+  if (n > 0)
+  {
+    printf("round trip of %d calls, us: p50 %lld p99 %lld max %lld\n", options.pipeline,
+           static_cast<long long>(all[n / 2]),
+           static_cast<long long>(all[n * 99 / 100]),
+           static_cast<long long>(all[n - 1]));
+  }
+}
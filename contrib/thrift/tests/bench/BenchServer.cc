@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+
+#include <thrift/protocol/TBinaryProtocol.h>
+#ifdef HAVE_THRIFT_NB
+#include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/server/TNonblockingServer.h>
+#endif
+
+#include "ThriftServer.h"
+
+#include "Bench.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+using apache::thrift::protocol::TBinaryProtocolFactory;
+
+using namespace bench;
+
+class BenchHandler : virtual public BenchIf
+{
+ public:
+  void echo(std::string& result, const std::string& payload)
+  {
+    result = payload;
+  }
+};
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s muduo|nonblocking [ioThreads [workerThreads [port]]]\n", argv[0]);
+    return 0;
+  }
+
+  Logger::setLogLevel(Logger::WARN);
+  const bool nonblocking = strcmp(argv[1], "nonblocking") == 0;
+  const int ioThreads = argc > 2 ? atoi(argv[2]) : 1;
+  const int workerThreads = argc > 3 ? atoi(argv[3]) : 0;
+  const uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9090);
+
+  boost::shared_ptr<BenchHandler> handler(new BenchHandler());
+  boost::shared_ptr<TProcessor> processor(new BenchProcessor(handler));
+  boost::shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+
+  if (nonblocking)
+  {
+#ifdef HAVE_THRIFT_NB
+    using apache::thrift::concurrency::PlatformThreadFactory;
+    using apache::thrift::concurrency::ThreadManager;
+    using apache::thrift::server::TNonblockingServer;
+
+    boost::shared_ptr<ThreadManager> threadManager;
+    if (workerThreads > 0)
+    {
+      threadManager = ThreadManager::newSimpleThreadManager(workerThreads);
+      threadManager->threadFactory(
+          boost::shared_ptr<PlatformThreadFactory>(new PlatformThreadFactory()));
+      threadManager->start();
+    }
+    TNonblockingServer server(processor, protocolFactory, port, threadManager);
+    server.setNumIOThreads(ioThreads);
+    server.serve();
+#else
+    printf("built without TNonblockingServer\n");
+    return 1;
+#endif
+  }
+  else
+  {
+    EventLoop loop;
+    InetAddress addr(port);
+    ThriftServer server(processor, protocolFactory, &loop, addr, "BenchServer");
+    // the base loop accepts, others do IO
+    server.setThreadNum(ioThreads);
+    if (workerThreads > 0)
+    {
+      server.setWorkerThreadNum(workerThreads);
+    }
+    server.start();
+    loop.loop();
+  }
+}
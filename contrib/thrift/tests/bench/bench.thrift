@@ -0,0 +1,6 @@
+namespace cpp bench
+
+service Bench
+{
+  binary echo(1: binary payload);
+}
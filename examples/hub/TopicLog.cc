@@ -0,0 +1,414 @@
+#include "examples/hub/TopicLog.h"
+
+#include "muduo/base/Logging.h"
+
+#include <algorithm>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace pubsub;
+
+namespace
+{
+
+const char kSuffix[] = ".log";
+const size_t kSuffixLen = sizeof kSuffix - 1;
+
+// the end of the whole messages in data, whose positions go to positions
+size_t scan(const char* data, size_t len, std::vector<uint32_t>* positions)
+{
+  size_t pos = 0;
+  while (len - pos > 4 && memcmp(data + pos, "pub ", 4) == 0)
+  {
+    const char* crlf = static_cast<const char*>(memmem(data + pos, len - pos, "\r\n", 2));
+    if (crlf == NULL)
+    {
+      break;
+    }
+    const char* content = crlf + 2;
+    const char* end = static_cast<const char*>(
+        memmem(content, static_cast<size_t>(data + len - content), "\r\n", 2));
+    if (end == NULL)
+    {
+      break;
+    }
+    positions->push_back(static_cast<uint32_t>(pos));
+    pos = static_cast<size_t>(end + 2 - data);
+  }
+  return pos;
+}
+
+}  // namespace
+
+LogSegment::LogSegment(const string& path, int fd, int64_t baseOffset)
+  : path_(path),
+    fd_(fd),
+    baseOffset_(baseOffset),
+    data_(NULL),
+    capacity_(0),
+    size_(0)
+{
+}
+
+LogSegment::~LogSegment()
+{
+  if (data_)
+  {
+    ::munmap(data_, capacity_);
+  }
+  ::close(fd_);
+}
+
+std::shared_ptr<LogSegment> LogSegment::create(const string& path,
+                                               int64_t baseOffset,
+                                               size_t capacity)
+{
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    LOG_SYSERR << "LogSegment::create " << path;
+    return NULL;
+  }
+  std::shared_ptr<LogSegment> segment(new LogSegment(path, fd, baseOffset));
+  if (!segment->map(capacity))
+  {
+    segment->unlink();
+    return NULL;
+  }
+  segment->lastAppend_ = Timestamp::now();
+  return segment;
+}
+
+std::shared_ptr<LogSegment> LogSegment::open(const string& path,
+                                             int64_t baseOffset,
+                                             size_t capacity)
+{
+  int fd = ::open(path.c_str(), (capacity > 0 ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG_SYSERR << "LogSegment::open " << path;
+    return NULL;
+  }
+  std::shared_ptr<LogSegment> segment(new LogSegment(path, fd, baseOffset));
+  struct stat st;
+  if (::fstat(fd, &st) < 0)
+  {
+    LOG_SYSERR << "LogSegment::open " << path;
+    return NULL;
+  }
+  segment->lastAppend_ = Timestamp::fromUnixTime(st.st_mtime);
+  const size_t fileSize = static_cast<size_t>(st.st_size);
+  if (capacity > 0)
+  {
+    if (!segment->map(std::max(capacity, fileSize)))
+    {
+      return NULL;
+    }
+    segment->size_ = scan(segment->data_, fileSize, &segment->positions_);
+    // the tail of a message cut short by a crash
+    if (segment->size_ < fileSize && segment->data_[segment->size_] != '\0')
+    {
+      memset(segment->data_ + segment->size_, 0, fileSize - segment->size_);
+    }
+  }
+  else if (fileSize > 0)
+  {
+    void* data = ::mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+      LOG_SYSERR << "LogSegment::open " << path;
+      return NULL;
+    }
+    segment->size_ = scan(static_cast<const char*>(data), fileSize, &segment->positions_);
+    ::munmap(data, fileSize);
+  }
+  return segment;
+}
+
+bool LogSegment::map(size_t capacity)
+{
+  assert(data_ == NULL);
+  if (::ftruncate(fd_, static_cast<off_t>(capacity)) < 0)
+  {
+    LOG_SYSERR << "LogSegment::map " << path_;
+    return false;
+  }
+  void* data = ::mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED)
+  {
+    LOG_SYSERR << "LogSegment::map " << path_;
+    return false;
+  }
+  data_ = static_cast<char*>(data);
+  capacity_ = capacity;
+  return true;
+}
+
+bool LogSegment::append(StringPiece message, Timestamp now)
+{
+  assert(!sealed());
+  const size_t len = static_cast<size_t>(message.size());
+  if (len > capacity_ - size_)
+  {
+    return false;
+  }
+  memcpy(data_ + size_, message.data(), len);
+  positions_.push_back(static_cast<uint32_t>(size_));
+  size_ += len;
+  lastAppend_ = now;
+  return true;
+}
+
+void LogSegment::seal()
+{
+  if (data_)
+  {
+    ::munmap(data_, capacity_);
+    data_ = NULL;
+    capacity_ = 0;
+    if (::ftruncate(fd_, static_cast<off_t>(size_)) < 0)
+    {
+      LOG_SYSERR << "LogSegment::seal " << path_;
+    }
+  }
+}
+
+void LogSegment::unlink()
+{
+  if (::unlink(path_.c_str()) < 0)
+  {
+    LOG_SYSERR << "LogSegment::unlink " << path_;
+  }
+}
+
+TopicLog::Options::Options()
+  : segmentBytes(16 * 1024 * 1024),
+    retentionBytes(0),
+    retentionSeconds(0),
+    idleSeconds(60)
+{
+}
+
+TopicLog::TopicLog(const string& topic, const Options& options)
+  : options_(options),
+    dir_(options.dir + "/" + escape(topic)),
+    bytes_(0)
+{
+  if (::mkdir(dir_.c_str(), 0755) < 0 && errno != EEXIST)
+  {
+    LOG_SYSERR << "TopicLog " << dir_;
+  }
+
+  std::vector<int64_t> baseOffsets;
+  DIR* dir = ::opendir(dir_.c_str());
+  if (dir)
+  {
+    while (struct dirent* entry = ::readdir(dir))
+    {
+      const char* name = entry->d_name;
+      const size_t len = strlen(name);
+      char* end = NULL;
+      if (len > kSuffixLen && strcmp(name + len - kSuffixLen, kSuffix) == 0)
+      {
+        long long baseOffset = strtoll(name, &end, 10);
+        if (end == name + len - kSuffixLen && baseOffset >= 0)
+        {
+          baseOffsets.push_back(baseOffset);
+        }
+      }
+    }
+    ::closedir(dir);
+  }
+  std::sort(baseOffsets.begin(), baseOffsets.end());
+
+  for (size_t i = 0; i < baseOffsets.size(); ++i)
+  {
+    const bool last = i + 1 == baseOffsets.size();
+    std::shared_ptr<LogSegment> segment =
+      LogSegment::open(segmentPath(baseOffsets[i]), baseOffsets[i],
+                       last ? options_.segmentBytes : 0);
+    if (segment)
+    {
+      if (!segments_.empty() && segments_.back()->endOffset() != segment->baseOffset())
+      {
+        LOG_WARN << "TopicLog " << dir_ << " misses offsets "
+                 << segments_.back()->endOffset() << " to " << segment->baseOffset();
+      }
+      bytes_ += segment->size();
+      segments_.push_back(segment);
+    }
+  }
+  if (segments_.empty() || segments_.back()->sealed())
+  {
+    roll(0);
+  }
+  LOG_INFO << "TopicLog " << dir_ << " offsets " << beginOffset()
+           << " to " << endOffset() << ", " << bytes_ << " bytes";
+}
+
+TopicLog::~TopicLog()
+{
+}
+
+int64_t TopicLog::beginOffset() const
+{
+  return segments_.empty() ? 0 : segments_.front()->baseOffset();
+}
+
+int64_t TopicLog::endOffset() const
+{
+  return segments_.empty() ? 0 : segments_.back()->endOffset();
+}
+
+bool TopicLog::append(StringPiece message, Timestamp now)
+{
+  if (segments_.empty()
+      || segments_.back()->sealed()
+      || !segments_.back()->append(message, now))
+  {
+    if (!roll(static_cast<size_t>(message.size()))
+        || !segments_.back()->append(message, now))
+    {
+      LOG_ERROR << "TopicLog " << dir_ << " lost message " << endOffset();
+      return false;
+    }
+    retain(now);
+  }
+  bytes_ += message.size();
+  return true;
+}
+
+string TopicLog::lastMessage() const
+{
+  for (auto it = segments_.rbegin(); it != segments_.rend(); ++it)
+  {
+    const LogSegment& segment = **it;
+    if (segment.endOffset() > segment.baseOffset())
+    {
+      const size_t begin = segment.position(segment.endOffset() - 1);
+      string message(segment.size() - begin, '\0');
+      ssize_t n = ::pread(segment.fd(), &*message.begin(), message.size(), static_cast<off_t>(begin));
+      if (n != static_cast<ssize_t>(message.size()))
+      {
+        LOG_SYSERR << "TopicLog::lastMessage " << dir_;
+        message.clear();
+      }
+      return message;
+    }
+  }
+  return string();
+}
+
+std::vector<TopicLog::Range> TopicLog::read(int64_t offset) const
+{
+  std::vector<Range> ranges;
+  offset = std::max(offset, beginOffset());
+  for (const auto& segment : segments_)
+  {
+    if (segment->endOffset() > offset)
+    {
+      const size_t begin = segment->baseOffset() < offset ? segment->position(offset) : 0;
+      Range range = { segment->fd(), static_cast<int64_t>(begin), segment->size() - begin, segment };
+      ranges.push_back(range);
+    }
+  }
+  return ranges;
+}
+
+int TopicLog::retain(Timestamp now)
+{
+  int removed = 0;
+  while (segments_.size() > 1)
+  {
+    const LogSegment& oldest = *segments_.front();
+    const bool tooBig = options_.retentionBytes > 0 && bytes_ > options_.retentionBytes;
+    const bool tooOld = options_.retentionSeconds > 0
+      && timeDifference(now, oldest.lastAppend()) > options_.retentionSeconds;
+    if (!tooBig && !tooOld)
+    {
+      break;
+    }
+    bytes_ -= oldest.size();
+    segments_.front()->unlink();
+    segments_.pop_front();
+    ++removed;
+  }
+  if (removed > 0)
+  {
+    LOG_INFO << "TopicLog " << dir_ << " removed " << removed
+             << " segments, offsets from " << beginOffset();
+  }
+  return removed;
+}
+
+bool TopicLog::exists(const string& topic, const Options& options)
+{
+  struct stat st;
+  return ::stat((options.dir + "/" + escape(topic)).c_str(), &st) == 0;
+}
+
+string TopicLog::escape(const string& topic)
+{
+  string name;
+  for (size_t i = 0; i < topic.size(); ++i)
+  {
+    const char c = topic[i];
+    // no "." or ".."
+    if (isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || (c == '.' && i > 0))
+    {
+      name += c;
+    }
+    else
+    {
+      char buf[4];
+      snprintf(buf, sizeof buf, "%%%02X", static_cast<unsigned char>(c));
+      name += buf;
+    }
+  }
+  return name.empty() ? "%" : name;
+}
+
+string TopicLog::segmentPath(int64_t baseOffset) const
+{
+  char buf[32];
+  snprintf(buf, sizeof buf, "%020lld%s", static_cast<long long>(baseOffset), kSuffix);
+  return dir_ + "/" + buf;
+}
+
+bool TopicLog::roll(size_t minCapacity)
+{
+  const int64_t baseOffset = endOffset();
+  if (!segments_.empty())
+  {
+    std::shared_ptr<LogSegment>& last = segments_.back();
+    if (last->endOffset() == last->baseOffset())
+    {
+      // empty, the new one takes its name
+      last->unlink();
+      segments_.pop_back();
+    }
+    else
+    {
+      last->seal();
+    }
+  }
+  std::shared_ptr<LogSegment> segment =
+    LogSegment::create(segmentPath(baseOffset), baseOffset,
+                       std::max(options_.segmentBytes, minCapacity));
+  if (!segment)
+  {
+    return false;
+  }
+  segments_.push_back(segment);
+  return true;
+}
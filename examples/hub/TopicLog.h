@@ -0,0 +1,141 @@
+#ifndef MUDUO_EXAMPLES_HUB_TOPICLOG_H
+#define MUDUO_EXAMPLES_HUB_TOPICLOG_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace pubsub
+{
+using muduo::string;
+
+// A file of messages of a topic, named by the offset of its first message.
+//
+// The last segment of a log is preallocated and mapped, messages are copied
+// into the mapping.  Older ones are sealed, truncated to their size and
+// unmapped.  Either way, the file is read with sendfile(2), and the bytes
+// before size() never change, so a segment can be sent by other threads
+// while the log appends to it.
+class LogSegment : muduo::noncopyable
+{
+ public:
+  // NULL on errors
+  static std::shared_ptr<LogSegment> create(const string& path,
+                                            int64_t baseOffset,
+                                            size_t capacity);
+  // capacity is 0 for a sealed one, or its capacity for appending
+  static std::shared_ptr<LogSegment> open(const string& path,
+                                          int64_t baseOffset,
+                                          size_t capacity);
+  ~LogSegment();
+
+  int fd() const { return fd_; }
+  int64_t baseOffset() const { return baseOffset_; }
+  int64_t endOffset() const { return baseOffset_ + static_cast<int64_t>(positions_.size()); }
+  size_t size() const { return size_; }
+  bool sealed() const { return data_ == NULL; }
+  muduo::Timestamp lastAppend() const { return lastAppend_; }
+
+  // where the message at offset starts in the file
+  size_t position(int64_t offset) const
+  {
+    return positions_[static_cast<size_t>(offset - baseOffset_)];
+  }
+
+  // false if it does not fit
+  bool append(muduo::StringPiece message, muduo::Timestamp now);
+  void seal();
+  // the file, the fd stays for those still sending it
+  void unlink();
+
+ private:
+  LogSegment(const string& path, int fd, int64_t baseOffset);
+
+  bool map(size_t capacity);
+
+  const string path_;
+  const int fd_;
+  const int64_t baseOffset_;
+  char* data_;  // NULL if sealed
+  size_t capacity_;
+  size_t size_;
+  std::vector<uint32_t> positions_;
+  muduo::Timestamp lastAppend_;
+};
+
+// Messages of a topic on disk, numbered by offset from 0.
+//
+// A directory per topic holds a list of LogSegments.  A message is stored
+// as sent to subscribers, "pub topic offset\r\ncontent\r\n", so a replay
+// sends the segment files as they are.  Old segments are removed by size
+// or by age of the topic, the last one is always kept.
+//
+// Not thread safe.
+class TopicLog : muduo::noncopyable
+{
+ public:
+  struct Options
+  {
+    Options();
+    string dir;  // of all topics, empty for no log
+    size_t segmentBytes;
+    int64_t retentionBytes;  // of a topic, 0 for no limit
+    int retentionSeconds;  // 0 for no limit
+    int idleSeconds;  // closes the log of a topic unused for it, 0 for never
+  };
+
+  // bytes [begin, begin + count) of a segment file
+  struct Range
+  {
+    int fd;
+    int64_t begin;
+    size_t count;
+    std::shared_ptr<void> guard;  // keeps fd open
+  };
+
+  // opens the log of the topic in options.dir, or creates an empty one
+  TopicLog(const string& topic, const Options& options);
+  ~TopicLog();
+
+  // of the first message kept
+  int64_t beginOffset() const;
+  // of the next message
+  int64_t endOffset() const;
+  int64_t bytes() const { return bytes_; }
+
+  // message shall be encoded with endOffset(), false on errors
+  bool append(muduo::StringPiece message, muduo::Timestamp now);
+
+  // the last message, empty if none
+  string lastMessage() const;
+
+  // messages from offset, or from beginOffset() if that is older,
+  // to endOffset()
+  std::vector<Range> read(int64_t offset) const;
+
+  // removes segments out of the retention, returns how many
+  int retain(muduo::Timestamp now);
+
+  // whether the topic has a log in options.dir, without opening it
+  static bool exists(const string& topic, const Options& options);
+  // a topic as the name of a directory
+  static string escape(const string& topic);
+
+ private:
+  string segmentPath(int64_t baseOffset) const;
+  bool roll(size_t minCapacity);
+
+  const Options options_;
+  const string dir_;
+  std::deque<std::shared_ptr<LogSegment>> segments_;
+  int64_t bytes_;
+};
+
+}  // namespace pubsub
+
+#endif  // MUDUO_EXAMPLES_HUB_TOPICLOG_H
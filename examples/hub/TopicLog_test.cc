@@ -0,0 +1,160 @@
+#undef NDEBUG
+#include "examples/hub/TopicLog.h"
+
+#include "muduo/base/Logging.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace pubsub;
+
+const char kTopic[] = "sensors/1";
+
+string message(int64_t offset)
+{
+  // of different lengths
+  return "pub " + string(kTopic) + " " + std::to_string(offset) + "\r\n"
+      + string(static_cast<size_t>(offset % 50), 'x') + "\r\n";
+}
+
+string messages(int64_t begin, int64_t end)
+{
+  string result;
+  for (int64_t offset = begin; offset < end; ++offset)
+  {
+    result += message(offset);
+  }
+  return result;
+}
+
+// what a replay sends
+string read(const TopicLog& log, int64_t offset)
+{
+  string result;
+  for (const TopicLog::Range& range : log.read(offset))
+  {
+    string bytes(range.count, '\0');
+    ssize_t n = ::pread(range.fd, &*bytes.begin(), range.count, static_cast<off_t>(range.begin));
+    assert(n == static_cast<ssize_t>(range.count));
+    result += bytes;
+  }
+  return result;
+}
+
+void append(TopicLog* log, int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    assert(log->append(message(log->endOffset()), Timestamp::now()));
+  }
+}
+
+size_t numSegments(const string& dir)
+{
+  size_t n = 0;
+  DIR* d = ::opendir(dir.c_str());
+  assert(d);
+  while (struct dirent* entry = ::readdir(d))
+  {
+    if (entry->d_name[0] != '.')
+      ++n;
+  }
+  ::closedir(d);
+  return n;
+}
+
+void removeAll(const string& dir)
+{
+  if (DIR* d = ::opendir(dir.c_str()))
+  {
+    while (struct dirent* entry = ::readdir(d))
+    {
+      if (entry->d_name[0] != '.')
+      {
+        string path = dir + "/" + entry->d_name;
+        removeAll(path);
+        ::unlink(path.c_str());
+      }
+    }
+    ::closedir(d);
+    ::rmdir(dir.c_str());
+  }
+}
+
+void testRollAndReplay(const TopicLog::Options& options)
+{
+  const string dir = options.dir + "/" + TopicLog::escape(kTopic);
+  assert(!TopicLog::exists(kTopic, options));
+  {
+    TopicLog log(kTopic, options);
+    assert(TopicLog::exists(kTopic, options));
+    assert(log.beginOffset() == 0 && log.endOffset() == 0);
+    assert(log.lastMessage().empty());
+    assert(read(log, 0).empty());
+
+    append(&log, 100);
+    assert(log.endOffset() == 100);
+    assert(log.bytes() == static_cast<int64_t>(messages(0, 100).size()));
+    assert(log.lastMessage() == message(99));
+    // segments of 256 bytes
+    assert(numSegments(dir) > 10);
+    assert(log.read(0).size() == numSegments(dir));
+
+    // from any offset, within a segment or at its start
+    for (int64_t offset = 0; offset <= 100; ++offset)
+    {
+      assert(read(log, offset) == messages(offset, 100));
+    }
+    assert(read(log, 1000).empty());
+
+    // larger than a segment
+    const string large = "pub " + string(kTopic) + " 100\r\n" + string(1000, 'y') + "\r\n";
+    assert(log.append(large, Timestamp::now()));
+    assert(log.lastMessage() == large);
+    assert(read(log, 99) == message(99) + large);
+    assert(log.read(100).size() == 1);
+  }
+
+  // as it was, and appends go on from there
+  std::vector<TopicLog::Range> ranges;
+  {
+    TopicLog log(kTopic, options);
+    assert(log.beginOffset() == 0 && log.endOffset() == 101);
+    assert(read(log, 50) == messages(50, 100) + log.lastMessage());
+    append(&log, 10);
+    assert(log.endOffset() == 111);
+    assert(log.lastMessage() == message(110));
+    assert(read(log, 101) == messages(101, 111));
+    ranges = log.read(0);
+  }
+
+  // old segments go by retention, the ranges being sent keep their files
+  TopicLog::Options small = options;
+  small.retentionBytes = 1000;
+  TopicLog log(kTopic, small);
+  assert(log.retain(Timestamp::now()) > 0);
+  assert(log.beginOffset() > 100 && log.endOffset() == 111);
+  assert(log.bytes() <= 1000);
+  assert(read(log, 0) == messages(log.beginOffset(), 111));
+  assert(numSegments(dir) == log.read(0).size());
+  char c = 0;
+  assert(::pread(ranges[0].fd, &c, 1, 0) == 1 && c == 'p');
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  char dir[64];
+  snprintf(dir, sizeof dir, "/tmp/topiclog_test.%d", getpid());
+  assert(::mkdir(dir, 0755) == 0);
+  TopicLog::Options options;
+  options.dir = dir;
+  options.segmentBytes = 256;
+  testRollAndReplay(options);
+  removeAll(dir);
+  printf("all passed\n");
+}
@@ -0,0 +1,149 @@
+#include "examples/hub/TopicTrie.h"
+
+#include <assert.h>
+
+using namespace pubsub;
+
+TopicTrie::TopicTrie(size_t numLoops)
+  : numLoops_(numLoops),
+    root_(new Node)
+{
+}
+
+TopicTrie::~TopicTrie()
+{
+}
+
+std::vector<string> TopicTrie::split(const string& topic)
+{
+  std::vector<string> levels;
+  size_t start = 0;
+  size_t slash = 0;
+  while ((slash = topic.find('/', start)) != string::npos)
+  {
+    levels.push_back(topic.substr(start, slash - start));
+    start = slash + 1;
+  }
+  levels.push_back(topic.substr(start));
+  return levels;
+}
+
+bool TopicTrie::isFilter(const string& topic)
+{
+  for (const string& level : split(topic))
+  {
+    if (level == "*" || level == "#")
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TopicTrie::isValidFilter(const string& filter)
+{
+  std::vector<string> levels = split(filter);
+  for (size_t i = 0; i + 1 < levels.size(); ++i)
+  {
+    if (levels[i] == "#")
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TopicTrie::add(const string& filter, size_t loop)
+{
+  assert(loop < numLoops_);
+  Node* node = root_.get();
+  for (const string& level : split(filter))
+  {
+    std::unique_ptr<Node>& child = node->children[level];
+    if (!child)
+    {
+      child.reset(new Node);
+    }
+    node = child.get();
+  }
+  if (node->audiences.empty())
+  {
+    node->filter = filter;
+    node->audiences.resize(numLoops_);
+  }
+  ++node->audiences[loop];
+  ++node->subscribers;
+}
+
+void TopicTrie::remove(const string& filter, size_t loop)
+{
+  remove(root_.get(), split(filter), 0, loop);
+}
+
+bool TopicTrie::remove(Node* node, const std::vector<string>& levels, size_t i, size_t loop)
+{
+  if (i == levels.size())
+  {
+    assert(node->subscribers > 0 && node->audiences[loop] > 0);
+    --node->audiences[loop];
+    --node->subscribers;
+  }
+  else
+  {
+    std::map<string, std::unique_ptr<Node>>::iterator it = node->children.find(levels[i]);
+    assert(it != node->children.end());
+    if (remove(it->second.get(), levels, i + 1, loop))
+    {
+      node->children.erase(it);
+    }
+  }
+  return node->subscribers == 0 && node->children.empty();
+}
+
+void TopicTrie::match(const string& topic, std::vector<std::vector<string>>* filtersOfLoops) const
+{
+  assert(filtersOfLoops->size() == numLoops_);
+  match(*root_, split(topic), 0, filtersOfLoops);
+}
+
+void TopicTrie::match(const Node& node,
+                      const std::vector<string>& levels,
+                      size_t i,
+                      std::vector<std::vector<string>>* filtersOfLoops) const
+{
+  // "#" takes the rest, none or more
+  std::map<string, std::unique_ptr<Node>>::const_iterator it = node.children.find("#");
+  if (it != node.children.end())
+  {
+    collect(*it->second, filtersOfLoops);
+  }
+  if (i == levels.size())
+  {
+    collect(node, filtersOfLoops);
+    return;
+  }
+  it = node.children.find(levels[i]);
+  if (it != node.children.end())
+  {
+    match(*it->second, levels, i + 1, filtersOfLoops);
+  }
+  it = node.children.find("*");
+  if (it != node.children.end())
+  {
+    match(*it->second, levels, i + 1, filtersOfLoops);
+  }
+}
+
+void TopicTrie::collect(const Node& node, std::vector<std::vector<string>>* filtersOfLoops)
+{
+  if (node.subscribers > 0)
+  {
+    for (size_t loop = 0; loop < node.audiences.size(); ++loop)
+    {
+      if (node.audiences[loop] > 0)
+      {
+        (*filtersOfLoops)[loop].push_back(node.filter);
+      }
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef MUDUO_EXAMPLES_HUB_TOPICTRIE_H
+#define MUDUO_EXAMPLES_HUB_TOPICTRIE_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace pubsub
+{
+using muduo::string;
+
+// Subscriptions of topic filters, MQTT style, by the loops of subscribers.
+//
+// A topic is levels separated by '/'.  In a filter, a level of "*" matches
+// any one level, and "#" as the last level matches any number of levels,
+// none included, so "a/#" matches "a", "a/b" and "a/b/c".  Matching a topic
+// walks the trie along its levels, so it costs by the levels of the topic
+// and the wildcards on the way, not by the number of filters.
+//
+// Not thread safe.
+class TopicTrie : muduo::noncopyable
+{
+ public:
+  explicit TopicTrie(size_t numLoops);
+  ~TopicTrie();
+
+  // has a level of "*" or "#"
+  static bool isFilter(const string& topic);
+  // "#" is the last level only
+  static bool isValidFilter(const string& filter);
+
+  bool empty() const { return root_->children.empty() && root_->subscribers == 0; }
+
+  // a subscriber of the filter in the loop
+  void add(const string& filter, size_t loop);
+  void remove(const string& filter, size_t loop);
+
+  // appends the filters matching topic to (*filtersOfLoops)[loop] of the
+  // loops of their subscribers, which has one vector per loop
+  void match(const string& topic, std::vector<std::vector<string>>* filtersOfLoops) const;
+
+ private:
+  struct Node
+  {
+    std::map<string, std::unique_ptr<Node>> children;
+    string filter;  // of the subscribers, if any
+    std::vector<int> audiences;  // by loop
+    int subscribers = 0;
+  };
+
+  static std::vector<string> split(const string& topic);
+  // true if node is left with nothing
+  bool remove(Node* node, const std::vector<string>& levels, size_t i, size_t loop);
+  void match(const Node& node,
+             const std::vector<string>& levels,
+             size_t i,
+             std::vector<std::vector<string>>* filtersOfLoops) const;
+  static void collect(const Node& node, std::vector<std::vector<string>>* filtersOfLoops);
+
+  const size_t numLoops_;
+  std::unique_ptr<Node> root_;
+};
+
+}  // namespace pubsub
+
+#endif  // MUDUO_EXAMPLES_HUB_TOPICTRIE_H
@@ -0,0 +1,125 @@
+#undef NDEBUG
+#include "examples/hub/TopicTrie.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace pubsub;
+
+typedef std::vector<std::vector<string>> FiltersOfLoops;
+
+FiltersOfLoops match(const TopicTrie& trie, const string& topic, size_t numLoops)
+{
+  FiltersOfLoops filtersOfLoops(numLoops);
+  trie.match(topic, &filtersOfLoops);
+  for (std::vector<string>& filters : filtersOfLoops)
+  {
+    std::sort(filters.begin(), filters.end());
+  }
+  return filtersOfLoops;
+}
+
+std::vector<string> match(const TopicTrie& trie, const string& topic)
+{
+  return match(trie, topic, 1)[0];
+}
+
+typedef std::vector<string> Filters;
+
+void testFilters()
+{
+  assert(!TopicTrie::isFilter("a/b/c"));
+  assert(!TopicTrie::isFilter("a*/b#"));
+  assert(TopicTrie::isFilter("*"));
+  assert(TopicTrie::isFilter("a/*/c"));
+  assert(TopicTrie::isFilter("a/#"));
+
+  assert(TopicTrie::isValidFilter("#"));
+  assert(TopicTrie::isValidFilter("*/*/#"));
+  assert(!TopicTrie::isValidFilter("#/a"));
+  assert(!TopicTrie::isValidFilter("a/#/c"));
+}
+
+void testWildcards()
+{
+  TopicTrie trie(1);
+  assert(trie.empty());
+  const char* filters[] = { "*/b/c", "a/*/c", "a/b/*", "#", "a/#", "a/b/c/#", "*" };
+  for (const char* filter : filters)
+  {
+    trie.add(filter, 0);
+  }
+  assert(!trie.empty());
+
+  // "#" matches no level as well
+  assert(match(trie, "a/b/c") ==
+         Filters({ "#", "*/b/c", "a/#", "a/*/c", "a/b/*", "a/b/c/#" }));
+  // "*" is exactly one level
+  assert(match(trie, "a/b") == Filters({ "#", "a/#" }));
+  assert(match(trie, "a") == Filters({ "#", "*", "a/#" }));
+  assert(match(trie, "x/b/c") == Filters({ "#", "*/b/c" }));
+  assert(match(trie, "a/x/c") == Filters({ "#", "a/#", "a/*/c" }));
+  assert(match(trie, "a/b/c/d/e") == Filters({ "#", "a/#", "a/b/c/#" }));
+  // empty levels are levels
+  assert(match(trie, "a//c") == Filters({ "#", "a/#", "a/*/c" }));
+  assert(match(trie, "/b/c") == Filters({ "#", "*/b/c" }));
+}
+
+void testOverlapping()
+{
+  TopicTrie trie(3);
+  trie.add("s/*/t", 0);
+  trie.add("s/*/t", 0);
+  trie.add("s/*/t", 2);
+  trie.add("s/#", 1);
+  trie.add("s/x/*", 2);
+
+  // once per loop, however many subscribers it has
+  FiltersOfLoops filtersOfLoops = match(trie, "s/x/t", 3);
+  assert(filtersOfLoops[0] == Filters({ "s/*/t" }));
+  assert(filtersOfLoops[1] == Filters({ "s/#" }));
+  assert(filtersOfLoops[2] == Filters({ "s/*/t", "s/x/*" }));
+
+  // the loop keeps the filter until its last subscriber goes
+  trie.remove("s/*/t", 0);
+  assert(match(trie, "s/x/t", 3)[0] == Filters({ "s/*/t" }));
+  trie.remove("s/*/t", 0);
+  filtersOfLoops = match(trie, "s/x/t", 3);
+  assert(filtersOfLoops[0].empty());
+  assert(filtersOfLoops[2] == Filters({ "s/*/t", "s/x/*" }));
+}
+
+void testPruning()
+{
+  TopicTrie trie(2);
+  trie.add("a/b/c/d", 0);
+  trie.add("a/b", 1);
+  trie.add("a/*/c/#", 0);
+
+  // a node on the way of another filter stays
+  trie.remove("a/b/c/d", 0);
+  assert(match(trie, "a/b/c/d", 2) == FiltersOfLoops({ Filters({ "a/*/c/#" }), Filters() }));
+  assert(match(trie, "a/b", 2) == FiltersOfLoops({ Filters(), Filters({ "a/b" }) }));
+  trie.remove("a/b", 1);
+  assert(!trie.empty());
+  trie.remove("a/*/c/#", 0);
+  assert(trie.empty());
+  assert(match(trie, "a/b/c/d", 2) == FiltersOfLoops(2));
+
+  // and it is all new again
+  trie.add("a/b/c/d", 1);
+  assert(match(trie, "a/b/c/d", 2) == FiltersOfLoops({ Filters(), Filters({ "a/b/c/d" }) }));
+  trie.remove("a/b/c/d", 1);
+  assert(trie.empty());
+}
+
+int main()
+{
+  testFilters();
+  testWildcards();
+  testOverlapping();
+  testPruning();
+  printf("all passed\n");
+}
@@ -51,3 +51,24 @@ ParseResult pubsub::parseMessage(Buffer* buf,
   return result;
 }
 
+
+int64_t pubsub::splitOffset(string* topic)
+{
+  size_t space = topic->rfind(' ');
+  if (space == string::npos || space + 1 == topic->size())
+  {
+    return -1;
+  }
+  int64_t offset = 0;
+  for (size_t i = space + 1; i < topic->size(); ++i)
+  {
+    const char c = (*topic)[i];
+    if (c < '0' || c > '9' || offset > (INT64_MAX - 9) / 10)
+    {
+      return -1;
+    }
+    offset = offset * 10 + (c - '0');
+  }
+  topic->resize(space);
+  return offset;
+}
@@ -21,6 +21,10 @@ ParseResult parseMessage(muduo::net::Buffer* buf,
                          string* cmd,
                          string* topic,
                          string* content);
+
+// A topic line of "sub" from subscribers, or of "pub" from a hub with a log,
+// may end with an offset, "topic offset".  Takes it off the topic, -1 if none.
+int64_t splitOffset(string* topic);
 }  // namespace pubsub
 
 #endif  // MUDUO_EXAMPLES_HUB_CODEC_H
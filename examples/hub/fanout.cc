@@ -0,0 +1,278 @@
+#include "examples/hub/pubsub.h"
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/ProcessInfo.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+using namespace pubsub;
+
+// One publisher and many subscribers of one topic.  The publisher sends a
+// message once the previous one reached every subscriber, so the time of a
+// message is how long the hub takes to fan it out.
+
+// of the subscribers of a loop, touched in the loop only
+struct LoopStats
+{
+  int subscribers = 0;
+  int warmed = 0;
+  std::vector<int> received;          // by seq
+  std::vector<int64_t> latencySum;    // us
+  std::vector<int64_t> lastArrival;   // us since epoch
+};
+
+EventLoop* g_loop = NULL;
+string g_topic;
+int g_numSubscribers = 0;
+int g_messages = 0;
+string g_padding;
+std::unique_ptr<PubSubClient> g_publisher;
+// by loop
+std::map<EventLoop*, std::vector<std::unique_ptr<PubSubClient>>> g_subscribers;
+std::map<EventLoop*, LoopStats> g_stats;
+std::unique_ptr<std::atomic<int>[]> g_loopsDone;  // by seq
+std::atomic<int> g_loopsWarmed(0);
+std::vector<int64_t> g_sentAt;
+int g_seq = 0;
+Timestamp g_begin;
+TimerId g_warmupTimer;
+std::atomic<bool> g_done(false);
+std::atomic<int> g_connected(0);  // subscribers and the publisher
+
+void report()
+{
+  const double seconds = timeDifference(Timestamp::now(), g_begin);
+  std::vector<int64_t> fanout(g_messages);
+  int64_t latencySum = 0;
+  for (int seq = 0; seq < g_messages; ++seq)
+  {
+    int64_t last = 0;
+    for (const auto& it : g_stats)
+    {
+      last = std::max(last, it.second.lastArrival[seq]);
+      latencySum += it.second.latencySum[seq];
+    }
+    fanout[seq] = last - g_sentAt[seq];
+  }
+  std::sort(fanout.begin(), fanout.end());
+  const double deliveries = 1.0 * g_numSubscribers * g_messages;
+  printf("%d subscribers, %d messages in %.3f s, %.0f deliveries/s\n",
+         g_numSubscribers, g_messages, seconds, deliveries / seconds);
+  printf("delivery latency us: mean %.1f\n", static_cast<double>(latencySum) / deliveries);
+  printf("fan-out time us: min %lld p50 %lld p99 %lld max %lld\n",
+         static_cast<long long>(fanout.front()),
+         static_cast<long long>(fanout[fanout.size() / 2]),
+         static_cast<long long>(fanout[fanout.size() * 99 / 100]),
+         static_cast<long long>(fanout.back()));
+}
+
+// in g_loop
+void publishNext()
+{
+  if (g_seq == g_messages)
+  {
+    g_done = true;
+    report();
+    // quits when all are disconnected, so that none is destructed in the middle
+    g_publisher->stop();
+    for (const auto& it : g_subscribers)
+    {
+      for (const auto& subscriber : it.second)
+      {
+        subscriber->stop();
+      }
+    }
+    return;
+  }
+  Timestamp now = Timestamp::now();
+  g_sentAt[g_seq] = now.microSecondsSinceEpoch();
+  char buf[64];
+  snprintf(buf, sizeof buf, "%d %lld ", g_seq++, static_cast<long long>(now.microSecondsSinceEpoch()));
+  g_publisher->publish(g_topic, buf + g_padding);
+}
+
+void warmup()
+{
+  if (g_loopsWarmed.load() == static_cast<int>(g_stats.size()))
+  {
+    LOG_WARN << "all " << g_numSubscribers << " subscribers are receiving";
+    g_loop->cancel(g_warmupTimer);
+    g_begin = Timestamp::now();
+    publishNext();
+  }
+  else
+  {
+    g_publisher->publish(g_topic, "-1 0");
+  }
+}
+
+// in the loop of the subscriber
+void onPublish(LoopStats* stats, bool* warmed,
+               const string&, const string& content, Timestamp receiveTime)
+{
+  char* end = NULL;
+  long seq = strtol(content.c_str(), &end, 10);
+  if (seq < 0 || seq >= g_messages)
+  {
+    if (!*warmed)
+    {
+      *warmed = true;
+      if (++stats->warmed == stats->subscribers)
+      {
+        ++g_loopsWarmed;
+      }
+    }
+    return;
+  }
+  const int64_t sent = strtoll(end, NULL, 10);
+  const int64_t arrival = receiveTime.microSecondsSinceEpoch();
+  stats->latencySum[seq] += arrival - sent;
+  stats->lastArrival[seq] = arrival;
+  if (++stats->received[seq] == stats->subscribers
+      && ++g_loopsDone[seq] == static_cast<int>(g_stats.size()))
+  {
+    g_loop->queueInLoop(publishNext);
+  }
+}
+
+void disconnected(const char* who)
+{
+  if (!g_done)
+  {
+    LOG_FATAL << who << " is disconnected";
+  }
+  else if (--g_connected == 0)
+  {
+    g_loop->queueInLoop(std::bind(&EventLoop::quit, g_loop));
+  }
+}
+
+void subscriberConnection(LoopStats* stats, bool* warmed, PubSubClient* client)
+{
+  if (client->connected())
+  {
+    ++g_connected;
+    client->subscribe(g_topic, std::bind(onPublish, stats, warmed, _1, _2, _3));
+  }
+  else
+  {
+    disconnected("a subscriber");
+  }
+}
+
+void publisherConnection(PubSubClient* client)
+{
+  if (client->connected())
+  {
+    ++g_connected;
+    g_warmupTimer = g_loop->runEvery(0.1, warmup);
+  }
+  else
+  {
+    disconnected("the publisher");
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    printf("Usage: %s hub_ip[,hub_ip...]:port subscribers [messages] [threads] [size]\n"
+           "Subscribers connect to the hub_ips in turn, more of them take more\n"
+           "local ports.\n", argv[0]);
+    return 0;
+  }
+
+  string hostport = argv[1];
+  size_t colon = hostport.rfind(':');
+  if (colon == string::npos)
+  {
+    printf("Bad hub address %s\n", argv[1]);
+    return 1;
+  }
+  uint16_t port = static_cast<uint16_t>(atoi(hostport.c_str()+colon+1));
+  std::vector<InetAddress> hubAddrs;
+  for (size_t start = 0; start < colon; )
+  {
+    size_t comma = std::min(hostport.find(',', start), colon);
+    hubAddrs.push_back(InetAddress(hostport.substr(start, comma - start), port));
+    start = comma + 1;
+  }
+  g_numSubscribers = atoi(argv[2]);
+  g_messages = argc > 3 ? atoi(argv[3]) : 100;
+  int threads = argc > 4 ? atoi(argv[4]) : 1;
+  int size = argc > 5 ? atoi(argv[5]) : 64;
+  if (g_numSubscribers <= 0 || g_messages <= 0 || threads < 0)
+  {
+    printf("Bad arguments\n");
+    return 1;
+  }
+  g_topic = "fanout-" + ProcessInfo::pidString();
+  g_padding.assign(std::max(size - 24, 0), 'x');
+  g_sentAt.resize(g_messages);
+  g_loopsDone.reset(new std::atomic<int>[g_messages]);
+  for (int i = 0; i < g_messages; ++i)
+  {
+    g_loopsDone[i] = 0;
+  }
+
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  EventLoopThreadPool pool(&loop, "fanout");
+  pool.setThreadNum(threads);
+  pool.start();
+
+  std::vector<EventLoop*> loops;
+  for (int i = 0; i < g_numSubscribers; ++i)
+  {
+    loops.push_back(pool.getNextLoop());
+    LoopStats& stats = g_stats[loops.back()];
+    ++stats.subscribers;
+  }
+  for (auto& it : g_stats)
+  {
+    it.second.received.resize(g_messages);
+    it.second.latencySum.resize(g_messages);
+    it.second.lastArrival.resize(g_messages);
+  }
+
+  std::unique_ptr<bool[]> warmed(new bool[g_numSubscribers]());
+  for (int i = 0; i < g_numSubscribers; ++i)
+  {
+    std::unique_ptr<PubSubClient> subscriber(
+        new PubSubClient(loops[i], hubAddrs[i % hubAddrs.size()], "sub-" + std::to_string(i)));
+    subscriber->setConnectionCallback(
+        std::bind(subscriberConnection, &g_stats[loops[i]], &warmed[i], _1));
+    subscriber->start();
+    g_subscribers[loops[i]].push_back(std::move(subscriber));
+  }
+  LOG_WARN << g_numSubscribers << " subscribers of " << g_topic << " in "
+           << g_stats.size() << " loops";
+
+  g_publisher.reset(new PubSubClient(&loop, hubAddrs[0], "publisher"));
+  g_publisher->setConnectionCallback(publisherConnection);
+  g_publisher->start();
+  loop.loop();
+  // in their loops, after the disconnections are done
+  g_publisher.reset();
+  CountDownLatch destructed(static_cast<int>(g_subscribers.size()));
+  for (auto& it : g_subscribers)
+  {
+    std::vector<std::unique_ptr<PubSubClient>>* subscribers = &it.second;
+    it.first->runInLoop([subscribers, &destructed]
+        {
+          subscribers->clear();
+          destructed.countDown();
+        });
+  }
+  destructed.wait();
+}
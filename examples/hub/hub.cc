@@ -1,12 +1,19 @@
 #include "examples/hub/codec.h"
+#include "examples/hub/TopicLog.h"
+#include "examples/hub/TopicTrie.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/TcpServer.h"
 
 #include <map>
 #include <set>
+#include <errno.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -15,63 +22,154 @@ namespace pubsub
 {
 
 typedef std::set<string> ConnectionSubscription;
+// a message encoded once, shared by the loops sending it
+typedef std::shared_ptr<const string> MessagePtr;
 
+// in the loop of its shard
+//
+// The log is opened on the first publish, or by a subscriber if the topic
+// has one on disk, and closed again once the topic is idle.
 class Topic : public muduo::copyable
 {
  public:
-  Topic(const string& topic)
-    : topic_(topic)
+  Topic(const string& topic, size_t numLoops, const TopicLog::Options* logOptions)
+    : topic_(topic),
+      audiences_(numLoops),
+      logOptions_(logOptions),
+      onDisk_(kUnknown)
   {
   }
 
-  void add(const TcpConnectionPtr& conn)
+  // a subscriber in the loop, returns the last message, if any
+  MessagePtr add(size_t loop, Timestamp now)
   {
-    audiences_.insert(conn);
-    if (lastPubTime_.valid())
+    openLog(false, now);
+    ++audiences_[loop];
+    return message_;
+  }
+
+  void remove(size_t loop)
+  {
+    assert(audiences_[loop] > 0);
+    --audiences_[loop];
+  }
+
+  // NULL if it can't be logged, its offset goes to the next one then
+  MessagePtr publish(const string& content, Timestamp time)
+  {
+    lastPubTime_ = time;
+    if (TopicLog* log = openLog(true, time))
     {
-      conn->send(makeMessage());
+      MessagePtr message = std::make_shared<string>(
+          "pub " + topic_ + " " + std::to_string(log->endOffset()) + "\r\n" + content + "\r\n");
+      if (!log->append(*message, time))
+      {
+        return MessagePtr();
+      }
+      message_ = message;
     }
+    else
+    {
+      message_ = std::make_shared<string>("pub " + topic_ + "\r\n" + content + "\r\n");
+    }
+    return message_;
   }
 
-  void remove(const TcpConnectionPtr& conn)
+  // number of subscribers in the loop
+  int audiences(size_t loop) const { return audiences_[loop]; }
+
+  // messages from offset to now, none without a log
+  std::vector<TopicLog::Range> read(int64_t offset, Timestamp now)
   {
-    audiences_.erase(conn);
+    TopicLog* log = openLog(false, now);
+    return log ? log->read(offset) : std::vector<TopicLog::Range>();
   }
 
-  void publish(const string& content, Timestamp time)
+  // closes the log if unused for idleSeconds, ranges being sent keep
+  // their segment files open
+  void retain(Timestamp now)
   {
-    content_ = content;
-    lastPubTime_ = time;
-    string message = makeMessage();
-    for (std::set<TcpConnectionPtr>::iterator it = audiences_.begin();
-         it != audiences_.end();
-         ++it)
+    if (log_)
     {
-      (*it)->send(message);
+      log_->retain(now);
+      if (logOptions_->idleSeconds > 0
+          && timeDifference(now, lastLogUse_) > logOptions_->idleSeconds)
+      {
+        log_.reset();
+      }
     }
   }
 
  private:
+  enum OnDisk { kUnknown, kNo, kYes };
 
-  string makeMessage()
+  // NULL without a log, creates one only if create
+  TopicLog* openLog(bool create, Timestamp now)
   {
-    return "pub " + topic_ + "\r\n" + content_ + "\r\n";
+    if (!log_ && !logOptions_->dir.empty())
+    {
+      // only this topic makes its directory, so look once
+      if (onDisk_ == kUnknown)
+      {
+        onDisk_ = TopicLog::exists(topic_, *logOptions_) ? kYes : kNo;
+      }
+      if (create || onDisk_ == kYes)
+      {
+        log_ = std::make_shared<TopicLog>(topic_, *logOptions_);
+        onDisk_ = kYes;
+        string last = log_->lastMessage();
+        if (!message_ && !last.empty())
+        {
+          message_ = std::make_shared<string>(last);
+        }
+      }
+    }
+    lastLogUse_ = now;
+    return get_pointer(log_);
   }
 
   string topic_;
-  string content_;
+  MessagePtr message_;
   Timestamp lastPubTime_;
-  std::set<TcpConnectionPtr> audiences_;
+  std::vector<int> audiences_;
+  const TopicLog::Options* logOptions_;
+  OnDisk onDisk_;
+  std::shared_ptr<TopicLog> log_;
+  Timestamp lastLogUse_;
 };
 
+// Topics are sharded across the I/O loops by name.  The loop of a topic
+// keeps its last message and the number of subscribers in each loop; every
+// loop keeps its own subscribers by topic.  A message is encoded once in the
+// loop of its topic, then each loop with subscribers sends it to them.
+//
+// A subscription of a filter with wildcards goes to the TopicTrie of every
+// loop, the loop of a topic matches it against the trie on each message.
+// Only messages to come go to those subscribers, no last one or replay.
+//
+// With a log, messages of a topic are numbered and kept on disk, they go to
+// subscribers as "pub topic offset".  "sub topic offset" replays the log
+// from the offset with sendfile(2) before the messages to come.
 class PubSubServer : noncopyable
 {
  public:
   PubSubServer(muduo::net::EventLoop* loop,
-               const muduo::net::InetAddress& listenAddr)
+               const muduo::net::InetAddress& listenAddr,
+               int numThreads,
+               const TopicLog::Options& logOptions)
     : loop_(loop),
-      server_(loop, listenAddr, "PubSubServer")
+      server_(loop, listenAddr, "PubSubServer"),
+      logOptions_(logOptions),
+      nextShard_(0)
   {
+    server_.setThreadNum(numThreads);
+    const size_t numLoops = static_cast<size_t>(std::max(numThreads, 1));
+    for (size_t i = 0; i < numLoops; ++i)
+    {
+      shards_.emplace_back(new Shard(i, numLoops));
+    }
+    server_.setThreadInitCallback(
+        std::bind(&PubSubServer::initLoop, this, _1));
     server_.setConnectionCallback(
         std::bind(&PubSubServer::onConnection, this, _1));
     server_.setMessageCallback(
@@ -81,10 +179,47 @@ class PubSubServer : noncopyable
 
   void start()
   {
+    // the loops are all initialized when it returns
     server_.start();
   }
 
  private:
+  struct Shard : noncopyable
+  {
+    Shard(size_t i, size_t numLoops)
+      : index(i),
+        loop(NULL),
+        filters(numLoops)
+    {
+    }
+
+    const size_t index;
+    EventLoop* loop;
+    // of the shard
+    std::map<string, Topic> topics;
+    // of all filters, by loops of their subscribers
+    TopicTrie filters;
+    // connections of the loop, by topic or filter
+    std::map<string, std::set<TcpConnectionPtr>> audiences;
+    std::map<string, std::set<TcpConnectionPtr>> filterAudiences;
+  };
+
+  void initLoop(EventLoop* loop)
+  {
+    MutexLockGuard lock(mutex_);
+    t_shard = shards_[nextShard_++].get();
+    t_shard->loop = loop;
+    if (!logOptions_.dir.empty())
+    {
+      loop->runEvery(1.0, std::bind(&PubSubServer::retainLogs, this));
+    }
+  }
+
+  Shard& shardOf(const string& topic)
+  {
+    return *shards_[std::hash<string>()(topic) % shards_.size()];
+  }
+
   void onConnection(const TcpConnectionPtr& conn)
   {
     if (conn->connected())
@@ -123,8 +258,10 @@ class PubSubServer : noncopyable
         }
         else if (cmd == "sub")
         {
-          LOG_INFO << conn->name() << " subscribes " << topic;
-          doSubscribe(conn, topic);
+          int64_t offset = splitOffset(&topic);
+          LOG_INFO << conn->name() << " subscribes " << topic
+                   << (offset >= 0 ? " from " + std::to_string(offset) : string());
+          doSubscribe(conn, topic, offset);
         }
         else if (cmd == "unsub")
         {
@@ -149,25 +286,89 @@ class PubSubServer : noncopyable
     doPublish("internal", "utc_time", now.toFormattedString(), now);
   }
 
+  void retainLogs()
+  {
+    Timestamp now = Timestamp::now();
+    for (auto& it : t_shard->topics)
+    {
+      it.second.retain(now);
+    }
+  }
+
+  // in the loop of conn, offset is -1 for the last message
   void doSubscribe(const TcpConnectionPtr& conn,
-                   const string& topic)
+                   const string& topic,
+                   int64_t offset)
   {
     ConnectionSubscription* connSub
       = boost::any_cast<ConnectionSubscription>(conn->getMutableContext());
 
-    connSub->insert(topic);
-    getTopic(topic).add(conn);
+    if (TopicTrie::isFilter(topic))
+    {
+      if (!TopicTrie::isValidFilter(topic))
+      {
+        LOG_WARN << conn->name() << " subscribes bad filter " << topic;
+      }
+      else if (connSub->insert(topic).second)
+      {
+        std::set<TcpConnectionPtr>& audiences = t_shard->filterAudiences[topic];
+        audiences.insert(conn);
+        // the loop subscribes the filter for all of its connections
+        if (audiences.size() == 1)
+        {
+          for (const auto& shard : shards_)
+          {
+            shard->loop->runInLoop(
+                std::bind(&PubSubServer::addFilterInShard, this, topic, t_shard->index));
+          }
+        }
+      }
+    }
+    else if (connSub->insert(topic).second)
+    {
+      shardOf(topic).loop->runInLoop(
+          std::bind(&PubSubServer::subscribeInShard, this, conn, topic, t_shard->index, offset));
+    }
   }
 
   void doUnsubscribe(const TcpConnectionPtr& conn,
                      const string& topic)
   {
     LOG_INFO << conn->name() << " unsubscribes " << topic;
-    getTopic(topic).remove(conn);
-    // topic could be the one to be destroyed, so don't use it after erasing.
     ConnectionSubscription* connSub
       = boost::any_cast<ConnectionSubscription>(conn->getMutableContext());
-    connSub->erase(topic);
+    // topic could be the one to be destroyed, so don't use it after erasing.
+    const string t = topic;
+    if (connSub->erase(t) == 0)
+    {
+      return;
+    }
+    if (TopicTrie::isFilter(t))
+    {
+      std::set<TcpConnectionPtr>& audiences = t_shard->filterAudiences[t];
+      audiences.erase(conn);
+      if (audiences.empty())
+      {
+        t_shard->filterAudiences.erase(t);
+        for (const auto& shard : shards_)
+        {
+          shard->loop->runInLoop(
+              std::bind(&PubSubServer::removeFilterInShard, this, t, t_shard->index));
+        }
+      }
+      return;
+    }
+    std::map<string, std::set<TcpConnectionPtr>>::iterator it = t_shard->audiences.find(t);
+    if (it != t_shard->audiences.end())
+    {
+      it->second.erase(conn);
+      if (it->second.empty())
+      {
+        t_shard->audiences.erase(it);
+      }
+    }
+    shardOf(t).loop->runInLoop(
+        std::bind(&PubSubServer::unsubscribeInShard, this, t, t_shard->index));
   }
 
   void doPublish(const string& source,
@@ -175,43 +376,208 @@ class PubSubServer : noncopyable
                  const string& content,
                  Timestamp time)
   {
-    getTopic(topic).publish(content, time);
+    if (TopicTrie::isFilter(topic))
+    {
+      LOG_WARN << source << " publishes to filter " << topic;
+      return;
+    }
+    shardOf(topic).loop->runInLoop(
+        std::bind(&PubSubServer::publishInShard, this, topic, content, time));
+  }
+
+  // in the loop of the topic
+  void subscribeInShard(const TcpConnectionPtr& conn,
+                        const string& topic,
+                        size_t loop,
+                        int64_t offset)
+  {
+    Topic& t = getTopic(topic);
+    Timestamp now = Timestamp::now();
+    MessagePtr last = t.add(loop, now);
+    std::vector<TopicLog::Range> history;
+    if (offset >= 0 && !logOptions_.dir.empty())
+    {
+      history = t.read(offset, now);
+      last.reset();
+    }
+    // after the messages of the topic sent to the loop so far
+    shards_[loop]->loop->runInLoop(
+        std::bind(&PubSubServer::addAudience, this, conn, topic, last, history));
+  }
+
+  void unsubscribeInShard(const string& topic, size_t loop)
+  {
+    std::map<string, Topic>::iterator it = t_shard->topics.find(topic);
+    if (it != t_shard->topics.end())
+    {
+      it->second.remove(loop);
+    }
+  }
+
+  void addFilterInShard(const string& filter, size_t loop)
+  {
+    t_shard->filters.add(filter, loop);
+  }
+
+  void removeFilterInShard(const string& filter, size_t loop)
+  {
+    t_shard->filters.remove(filter, loop);
+  }
+
+  void publishInShard(const string& topic, const string& content, Timestamp time)
+  {
+    Topic& t = getTopic(topic);
+    MessagePtr message = t.publish(content, time);
+    if (!message)
+    {
+      // not sent either, so offsets stay in step with the log
+      return;
+    }
+    std::vector<std::vector<string>> filtersOfLoops(shards_.size());
+    if (!t_shard->filters.empty())
+    {
+      t_shard->filters.match(topic, &filtersOfLoops);
+    }
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+      if (t.audiences(i) > 0 || !filtersOfLoops[i].empty())
+      {
+        shards_[i]->loop->runInLoop(
+            std::bind(&PubSubServer::deliver, this, topic, message, filtersOfLoops[i]));
+      }
+    }
+  }
+
+  // in the loop of conn
+  void addAudience(const TcpConnectionPtr& conn,
+                   const string& topic,
+                   const MessagePtr& last,
+                   const std::vector<TopicLog::Range>& history)
+  {
+    // unsubscribed meanwhile, the count of the shard is taken back already
+    if (!conn->connected()
+        || boost::any_cast<const ConnectionSubscription&>(conn->getContext()).count(topic) == 0)
+    {
+      return;
+    }
+    t_shard->audiences[topic].insert(conn);
+    if (last)
+    {
+      conn->send(last);
+    }
+    // messages published from now on are queued behind the files
+    for (const TopicLog::Range& range : history)
+    {
+      conn->sendFile(range.fd, range.begin, range.count, range.guard);
+    }
+  }
+
+  // once to each connection of the topic or the filters
+  void deliver(const string& topic, const MessagePtr& message, const std::vector<string>& filters)
+  {
+    const std::set<TcpConnectionPtr>* audiences = NULL;
+    std::map<string, std::set<TcpConnectionPtr>>::const_iterator it = t_shard->audiences.find(topic);
+    if (it != t_shard->audiences.end())
+    {
+      audiences = &it->second;
+      for (const TcpConnectionPtr& conn : *audiences)
+      {
+        conn->send(message);
+      }
+    }
+
+    std::set<TcpConnection*> sent;
+    for (const string& filter : filters)
+    {
+      it = t_shard->filterAudiences.find(filter);
+      if (it == t_shard->filterAudiences.end())
+      {
+        continue;
+      }
+      for (const TcpConnectionPtr& conn : it->second)
+      {
+        if ((audiences && audiences->count(conn))
+            || (filters.size() > 1 && !sent.insert(get_pointer(conn)).second))
+        {
+          continue;
+        }
+        conn->send(message);
+      }
+    }
   }
 
   Topic& getTopic(const string& topic)
   {
-    std::map<string, Topic>::iterator it = topics_.find(topic);
-    if (it == topics_.end())
+    std::map<string, Topic>& topics = t_shard->topics;
+    std::map<string, Topic>::iterator it = topics.find(topic);
+    if (it == topics.end())
     {
-      it = topics_.insert(make_pair(topic, Topic(topic))).first;
+      it = topics.insert(make_pair(topic, Topic(topic, shards_.size(), &logOptions_))).first;
     }
     return it->second;
   }
 
   EventLoop* loop_;
   TcpServer server_;
-  std::map<string, Topic> topics_;
+  const TopicLog::Options logOptions_;
+  MutexLock mutex_;
+  size_t nextShard_ GUARDED_BY(mutex_);
+  // one per I/O loop, its loop is set before start() returns
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // of the loop of this thread
+  static __thread Shard* t_shard;
 };
 
+__thread PubSubServer::Shard* PubSubServer::t_shard = NULL;
+
 }  // namespace pubsub
 
 int main(int argc, char* argv[])
 {
-  if (argc > 1)
+  pubsub::TopicLog::Options logOptions;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:s:b:r:i:")) != -1)
   {
-    uint16_t port = static_cast<uint16_t>(atoi(argv[1]));
-    EventLoop loop;
-    if (argc > 2)
+    switch (opt)
+    {
+      case 'd':
+        logOptions.dir = optarg;
+        break;
+      case 's':
+        logOptions.segmentBytes = static_cast<size_t>(atoi(optarg)) * 1024 * 1024;
+        break;
+      case 'b':
+        logOptions.retentionBytes = static_cast<int64_t>(atoi(optarg)) * 1024 * 1024;
+        break;
+      case 'r':
+        logOptions.retentionSeconds = atoi(optarg);
+        break;
+      case 'i':
+        logOptions.idleSeconds = atoi(optarg);
+        break;
+      default:
+        return 1;
+    }
+  }
+
+  if (optind < argc && logOptions.segmentBytes > 0 && logOptions.segmentBytes <= 1024 * 1024 * 1024)
+  {
+    if (!logOptions.dir.empty() && ::mkdir(logOptions.dir.c_str(), 0755) < 0 && errno != EEXIST)
     {
-      //int inspectPort = atoi(argv[2]);
+      perror(logOptions.dir.c_str());
+      return 1;
     }
-    pubsub::PubSubServer server(&loop, InetAddress(port));
+    uint16_t port = static_cast<uint16_t>(atoi(argv[optind]));
+    int numThreads = optind + 1 < argc ? atoi(argv[optind + 1]) : 0;
+    EventLoop loop;
+    pubsub::PubSubServer server(&loop, InetAddress(port), numThreads, logOptions);
     server.start();
     loop.loop();
   }
   else
   {
-    printf("Usage: %s pubsub_port [inspect_port]\n", argv[0]);
+    printf("Usage: %s [-d log_dir [-s segment_MiB] [-b retention_MiB] [-r retention_seconds]\n"
+           "       [-i idle_seconds]]\n"
+           "       pubsub_port [threads]\n", argv[0]);
   }
 }
-
@@ -34,17 +34,47 @@ bool PubSubClient::connected() const
 
 bool PubSubClient::subscribe(const string& topic, const SubscribeCallback& cb)
 {
-  string message = "sub " + topic + "\r\n";
+  return subscribe(topic, -1, cb);
+}
+
+bool PubSubClient::subscribe(const string& topic, int64_t offset, const SubscribeCallback& cb)
+{
   subscribeCallback_ = cb;
-  return send(message);
+  {
+    MutexLockGuard lock(mutex_);
+    if (!subscriptions_.insert(std::make_pair(topic, offset)).second)
+    {
+      // subscribed again after reconnecting
+      return connected();
+    }
+  }
+  return send(subscribeMessage(topic, offset));
 }
 
 void PubSubClient::unsubscribe(const string& topic)
 {
+  {
+    MutexLockGuard lock(mutex_);
+    subscriptions_.erase(topic);
+  }
   string message = "unsub " + topic + "\r\n";
   send(message);
 }
 
+int64_t PubSubClient::nextOffset(const string& topic) const
+{
+  MutexLockGuard lock(mutex_);
+  std::map<string, int64_t>::const_iterator it = subscriptions_.find(topic);
+  return it != subscriptions_.end() ? it->second : -1;
+}
+
+string PubSubClient::subscribeMessage(const string& topic, int64_t offset)
+{
+  return offset >= 0
+    ? "sub " + topic + " " + std::to_string(offset) + "\r\n"
+    : "sub " + topic + "\r\n";
+}
+
 
 bool PubSubClient::publish(const string& topic, const string& content)
 {
@@ -57,7 +87,11 @@ void PubSubClient::onConnection(const TcpConnectionPtr& conn)
   if (conn->connected())
   {
     conn_ = conn;
-    // FIXME: re-sub
+    MutexLockGuard lock(mutex_);
+    for (const auto& it : subscriptions_)
+    {
+      conn->send(subscribeMessage(it.first, it.second));
+    }
   }
   else
   {
@@ -84,6 +118,16 @@ void PubSubClient::onMessage(const TcpConnectionPtr& conn,
     {
       if (cmd == "pub" && subscribeCallback_)
       {
+        int64_t offset = splitOffset(&topic);
+        if (offset >= 0)
+        {
+          MutexLockGuard lock(mutex_);
+          std::map<string, int64_t>::iterator it = subscriptions_.find(topic);
+          if (it != subscriptions_.end())
+          {
+            it->second = offset + 1;
+          }
+        }
         subscribeCallback_(topic, content, receiveTime);
       }
     }
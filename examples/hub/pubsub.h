@@ -1,8 +1,11 @@
 #ifndef MUDUO_EXAMPLES_HUB_PUBSUB_H
 #define MUDUO_EXAMPLES_HUB_PUBSUB_H
 
+#include "muduo/base/Mutex.h"
 #include "muduo/net/TcpClient.h"
 
+#include <map>
+
 namespace pubsub
 {
 using muduo::string;
@@ -22,25 +25,36 @@ class PubSubClient : muduo::noncopyable
   void start();
   void stop();
   bool connected() const;
+  // reconnects, and subscribes again from where it was with a hub of a log
+  void enableRetry() { client_.enableRetry(); }
 
   void setConnectionCallback(const ConnectionCallback& cb)
   { connectionCallback_ = cb; }
 
   bool subscribe(const string& topic, const SubscribeCallback& cb);
+  // from the message at offset, for a hub with a log
+  bool subscribe(const string& topic, int64_t offset, const SubscribeCallback& cb);
   void unsubscribe(const string& topic);
   bool publish(const string& topic, const string& content);
 
+  // of the message after the last one received, -1 if unknown
+  int64_t nextOffset(const string& topic) const;
+
  private:
   void onConnection(const muduo::net::TcpConnectionPtr& conn);
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
                  muduo::net::Buffer* buf,
                  muduo::Timestamp receiveTime);
   bool send(const string& message);
+  static string subscribeMessage(const string& topic, int64_t offset);
 
   muduo::net::TcpClient client_;
   muduo::net::TcpConnectionPtr conn_;
   ConnectionCallback connectionCallback_;
   SubscribeCallback subscribeCallback_;
+  mutable muduo::MutexLock mutex_;
+  // topics to next offsets
+  std::map<string, int64_t> subscriptions_ GUARDED_BY(mutex_);
 };
 }  // namespace pubsub
 
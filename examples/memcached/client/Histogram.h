@@ -0,0 +1,113 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_CLIENT_HISTOGRAM_H
+#define MUDUO_EXAMPLES_MEMCACHED_CLIENT_HISTOGRAM_H
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+
+// Counts of values in log-linear buckets, in the style of HdrHistogram.
+//
+// Values below kSubBuckets have a bucket each, larger ones have 64 buckets
+// per power of 2, which keeps the error of a percentile below 1/64.  The
+// memory is fixed, recording is O(1), and histograms of threads merge.
+class Histogram
+{
+ public:
+  Histogram()
+    : counts_(kNumBuckets),
+      count_(0),
+      sum_(0),
+      min_(INT64_MAX),
+      max_(0)
+  {
+  }
+
+  void record(int64_t value)
+  {
+    value = std::max<int64_t>(value, 0);
+    ++counts_[bucketOf(static_cast<uint64_t>(value))];
+    ++count_;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const Histogram& rhs)
+  {
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+      counts_[i] += rhs.counts_[i];
+    }
+    count_ += rhs.count_;
+    sum_ += rhs.sum_;
+    min_ = std::min(min_, rhs.min_);
+    max_ = std::max(max_, rhs.max_);
+  }
+
+  int64_t count() const { return count_; }
+  int64_t min() const { return count_ ? min_ : 0; }
+  int64_t max() const { return max_; }
+  double mean() const { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0; }
+
+  // the highest value of the bucket of the percentile, 0 < percent <= 100
+  int64_t percentile(double percent) const
+  {
+    if (count_ == 0)
+    {
+      return 0;
+    }
+    // the nearest rank
+    int64_t rank = static_cast<int64_t>(percent / 100 * static_cast<double>(count_) + 0.5);
+    rank = std::min(std::max<int64_t>(rank, 1), count_);
+    int64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+      seen += counts_[i];
+      if (seen >= rank)
+      {
+        return std::min(highestOf(i), max_);
+      }
+    }
+    return max_;
+  }
+
+ private:
+  static const int kSubBucketBits = 7;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kHalf = kSubBuckets / 2;
+  static const int kNumBuckets = kSubBuckets + (64 - kSubBucketBits) * kHalf;
+
+  static int bucketOf(uint64_t value)
+  {
+    if (value < kSubBuckets)
+    {
+      return static_cast<int>(value);
+    }
+    // the top kSubBucketBits bits of value
+    const int shift = 63 - __builtin_clzll(value) - (kSubBucketBits - 1);
+    const int sub = static_cast<int>(value >> shift);
+    assert(kHalf <= sub && sub < kSubBuckets);
+    return kSubBuckets + (shift - 1) * kHalf + (sub - kHalf);
+  }
+
+  static int64_t highestOf(int bucket)
+  {
+    if (bucket < kSubBuckets)
+    {
+      return bucket;
+    }
+    const int shift = (bucket - kSubBuckets) / kHalf + 1;
+    const int64_t sub = (bucket - kSubBuckets) % kHalf + kHalf;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<int64_t> counts_;
+  int64_t count_;
+  int64_t sum_;
+  int64_t min_;
+  int64_t max_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_CLIENT_HISTOGRAM_H
@@ -1,3 +1,5 @@
+#include "examples/memcached/client/Histogram.h"
+
 #include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
@@ -5,157 +7,421 @@
 #include "muduo/net/TcpClient.h"
 
 #include <boost/program_options.hpp>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <random>
 
+#include <math.h>
 #include <stdio.h>
 
 namespace po = boost::program_options;
 using namespace muduo;
 using namespace muduo::net;
 
-class Client : noncopyable
+struct Options
+{
+  int clients;
+  int keys;
+  double zipf;      // 0 for uniform
+  double setRatio;
+  int valueSize;
+  int valueMax;     // sizes uniform in [valueSize, valueMax] if larger
+  double rate;      // requests per second of all clients, 0 for closed loop
+  int depth;        // requests in flight per client in closed loop
+  bool populate;
+};
+
+// Ranks of keys in a Zipfian distribution, the algorithm of Gray et al.,
+// "Quickly Generating Billion-Record Synthetic Databases", as in YCSB.
+class ZipfGenerator : noncopyable
 {
  public:
-  enum Operation
+  ZipfGenerator(int64_t n, double theta)
+    : n_(n),
+      theta_(theta),
+      zetan_(zeta(n, theta)),
+      alpha_(1.0 / (1.0 - theta)),
+      eta_((1.0 - pow(2.0 / static_cast<double>(n), 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan_))
   {
-    kGet,
-    kSet,
-  };
+    assert(n > 0);
+    assert(0 <= theta && theta < 1);
+  }
+
+  // 0 is the hottest
+  template<typename Rng>
+  int64_t operator()(Rng& rng) const
+  {
+    const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    const double uz = u * zetan_;
+    if (uz < 1.0)
+    {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta_))
+    {
+      return std::min<int64_t>(1, n_ - 1);
+    }
+    int64_t rank = static_cast<int64_t>(static_cast<double>(n_) * pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, n_ - 1);
+  }
+
+ private:
+  static double zeta(int64_t n, double theta)
+  {
+    double sum = 0;
+    for (int64_t i = 1; i <= n; ++i)
+    {
+      sum += 1.0 / pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  const int64_t n_;
+  const double theta_;
+  const double zetan_;
+  const double alpha_;
+  const double eta_;
+};
 
+// A connection sending gets and sets of the ASCII protocol.
+//
+// In open loop, the loop calls tick() often, which sends the requests due
+// by then at the rate of the client.  Latency counts from when a request
+// was due, not when it went out, so a stalled server is charged for the
+// requests it held back (no coordinated omission).  In closed loop, a
+// response makes room for the next request, latency counts from sending.
+//
+// Requests due in [measureFrom, end) are recorded, none are sent after end.
+class Client : noncopyable
+{
+ public:
   Client(const string& name,
          EventLoop* loop,
          const InetAddress& serverAddr,
-         Operation op,
-         int requests,
-         int keys,
-         int valuelen,
-         CountDownLatch* connected,
+         const Options& options,
+         const ZipfGenerator* zipf,
+         int index,
+         CountDownLatch* ready,
          CountDownLatch* finished)
     : name_(name),
       client_(loop, serverAddr, name),
-      op_(op),
-      sent_(0),
-      acked_(0),
-      requests_(requests),
-      keys_(keys),
-      valuelen_(valuelen),
-      value_(valuelen_, 'a'),
-      connected_(connected),
+      options_(options),
+      zipf_(zipf),
+      index_(index),
+      rng_(index),
+      interval_(options.rate > 0 ? options.clients * 1e6 / options.rate : 0),
+      running_(false),
+      hits_(0),
+      misses_(0),
+      errors_(0),
+      populating_(false),
+      ready_(ready),
       finished_(finished)
   {
-    value_ += "\r\n";
     client_.setConnectionCallback(std::bind(&Client::onConnection, this, _1));
     client_.setMessageCallback(std::bind(&Client::onMessage, this, _1, _2, _3));
     client_.connect();
   }
 
-  void send()
+  EventLoop* getLoop() { return client_.getLoop(); }
+
+  // in loop
+  void start(Timestamp begin, Timestamp measureFrom, Timestamp end)
   {
+    getLoop()->assertInLoopThread();
+    measureFrom_ = measureFrom;
+    end_ = end;
+    running_ = true;
+    if (interval_ > 0)
+    {
+      // clients of a loop do not send at once
+      nextDue_ = addTime(begin, interval_ * index_ / options_.clients / 1e6);
+    }
+    else
+    {
+      Buffer buf;
+      for (int i = 0; i < options_.depth; ++i)
+      {
+        fill(&buf, Timestamp::now());
+      }
+      conn_->send(&buf);
+    }
+  }
+
+  // open loop only, in loop
+  void tick(Timestamp now)
+  {
+    if (!running_)
+    {
+      return;
+    }
     Buffer buf;
-    fill(&buf);
-    conn_->send(&buf);
+    while (nextDue_ <= now && nextDue_ < end_)
+    {
+      fill(&buf, nextDue_);
+      nextDue_ = addTime(nextDue_, interval_ / 1e6);
+    }
+    if (buf.readableBytes() > 0 && conn_)
+    {
+      conn_->send(&buf);
+    }
+    stopIfDone(now);
   }
 
+  // after finished
+  const Histogram& histogram() const { return histogram_; }
+  int64_t hits() const { return hits_; }
+  int64_t misses() const { return misses_; }
+  int64_t errors() const { return errors_; }
+
  private:
+  struct Pending
+  {
+    Timestamp due;
+    bool get;
+  };
 
   void onConnection(const TcpConnectionPtr& conn)
   {
     if (conn->connected())
     {
+      conn->setTcpNoDelay(true);
       conn_ = conn;
-      connected_->countDown();
+      if (options_.populate)
+      {
+        populate();
+      }
+      else
+      {
+        ready_->countDown();
+      }
     }
     else
     {
       conn_.reset();
-      client_.getLoop()->queueInLoop(std::bind(&CountDownLatch::countDown, finished_));
+      running_ = false;
+      getLoop()->queueInLoop(std::bind(&CountDownLatch::countDown, finished_));
     }
   }
 
+  // sets our share of keys, then a version to know they are done
+  void populate()
+  {
+    populating_ = true;
+    Buffer buf;
+    char req[256];
+    for (int key = index_; key < options_.keys; key += options_.clients)
+    {
+      const int valuelen = valueSize();
+      snprintf(req, sizeof req, "set key%d 0 0 %d noreply\r\n", key, valuelen);
+      buf.append(req);
+      appendValue(&buf, valuelen);
+    }
+    buf.append("version\r\n");
+    conn_->send(&buf);
+  }
+
   void onMessage(const TcpConnectionPtr& conn,
                  Buffer* buffer,
                  Timestamp receiveTime)
   {
-    if (op_ == kSet)
+    const char* crlf = NULL;
+    while (populating_ && (crlf = buffer->findCRLF()) != NULL)
     {
-      while (buffer->readableBytes() > 0)
+      StringPiece line(buffer->peek(), static_cast<int>(crlf - buffer->peek()));
+      if (line.starts_with("VERSION"))
+      {
+        populating_ = false;
+        ready_->countDown();
+      }
+      else
       {
-        const char* crlf = buffer->findCRLF();
-        if (crlf)
-        {
-          buffer->retrieveUntil(crlf+2);
-          ++acked_;
-          if (sent_ < requests_)
-          {
-            send();
-          }
-        }
-        else
-        {
-          break;
-        }
+        LOG_ERROR << name_ << " populate " << line.as_string();
       }
+      buffer->retrieveUntil(crlf + 2);
     }
-    else
+    if (populating_)
+    {
+      return;
+    }
+
+    Buffer more;
+    while (!pending_.empty())
     {
-      while (buffer->readableBytes() > 0)
+      const Pending request = pending_.front();
+      int result = request.get ? parseGet(buffer) : parseSet(buffer);
+      if (result < 0)
+      {
+        break;
+      }
+      pending_.pop_front();
+      if (request.due >= measureFrom_)
+      {
+        histogram_.record(receiveTime.microSecondsSinceEpoch() - request.due.microSecondsSinceEpoch());
+        if (result == kHit)
+          ++hits_;
+        else if (result == kMiss)
+          ++misses_;
+        else if (result == kError)
+          ++errors_;
+      }
+      if (interval_ == 0 && running_ && receiveTime < end_)
       {
-        const char* end = static_cast<const char*>(memmem(buffer->peek(),
-                                                          buffer->readableBytes(),
-                                                          "END\r\n", 5));
-        if (end)
-        {
-          buffer->retrieveUntil(end+5);
-          ++acked_;
-          if (sent_ < requests_)
-          {
-            send();
-          }
-        }
-        else
-        {
-          break;
-        }
+        fill(&more, receiveTime);
       }
     }
-    if (acked_ == requests_)
+    if (more.readableBytes() > 0)
     {
+      conn->send(&more);
+    }
+    stopIfDone(receiveTime);
+  }
+
+  void stopIfDone(Timestamp now)
+  {
+    if (running_ && now >= end_ && pending_.empty())
+    {
+      running_ = false;
       conn_->shutdown();
     }
   }
 
-  void fill(Buffer* buf)
+  enum Result
+  {
+    kIncomplete = -1,
+    kHit,
+    kMiss,
+    kStored,
+    kError,
+  };
+
+  // VALUE <key> <flags> <bytes>\r\n<data>\r\nEND\r\n, or END\r\n
+  int parseGet(Buffer* buf)
+  {
+    const char* crlf = buf->findCRLF();
+    if (!crlf)
+    {
+      return kIncomplete;
+    }
+    StringPiece line(buf->peek(), static_cast<int>(crlf - buf->peek()));
+    if (line == "END")
+    {
+      buf->retrieveUntil(crlf + 2);
+      return kMiss;
+    }
+    if (!line.starts_with("VALUE "))
+    {
+      buf->retrieveUntil(crlf + 2);
+      return kError;
+    }
+    const char* sp = static_cast<const char*>(memrchr(line.data(), ' ', line.size()));
+    const size_t bytes = static_cast<size_t>(atoi(sp + 1));
+    const size_t total = line.size() + 2 + bytes + 2 + 5;
+    if (buf->readableBytes() < total)
+    {
+      return kIncomplete;
+    }
+    buf->retrieve(total);
+    return kHit;
+  }
+
+  // STORED\r\n and the others of one line
+  int parseSet(Buffer* buf)
   {
+    const char* crlf = buf->findCRLF();
+    if (!crlf)
+    {
+      return kIncomplete;
+    }
+    bool stored = StringPiece(buf->peek(), static_cast<int>(crlf - buf->peek())) == "STORED";
+    buf->retrieveUntil(crlf + 2);
+    return stored ? kStored : kError;
+  }
+
+  void fill(Buffer* buf, Timestamp due)
+  {
+    const int key = static_cast<int>((*zipf_)(rng_));
+    const bool get = std::uniform_real_distribution<double>(0, 1)(rng_) >= options_.setRatio;
     char req[256];
-    if (op_ == kSet)
+    if (get)
     {
-      snprintf(req, sizeof req, "set %s%d 42 0 %d\r\n", name_.c_str(), sent_ % keys_, valuelen_);
-      ++sent_;
+      snprintf(req, sizeof req, "get key%d\r\n", key);
       buf->append(req);
-      buf->append(value_);
     }
     else
     {
-      snprintf(req, sizeof req, "get %s%d\r\n", name_.c_str(), sent_ % keys_);
-      ++sent_;
+      const int valuelen = valueSize();
+      snprintf(req, sizeof req, "set key%d 42 0 %d\r\n", key, valuelen);
       buf->append(req);
+      appendValue(buf, valuelen);
     }
+    Pending pending = { due, get };
+    pending_.push_back(pending);
   }
 
-  string name_;
+  int valueSize()
+  {
+    if (options_.valueMax <= options_.valueSize)
+    {
+      return options_.valueSize;
+    }
+    return std::uniform_int_distribution<int>(options_.valueSize, options_.valueMax)(rng_);
+  }
+
+  void appendValue(Buffer* buf, int valuelen)
+  {
+    buf->ensureWritableBytes(valuelen + 2);
+    memset(buf->beginWrite(), 'a', valuelen);
+    buf->hasWritten(valuelen);
+    buf->append("\r\n");
+  }
+
+  const string name_;
   TcpClient client_;
   TcpConnectionPtr conn_;
-  const Operation op_;
-  int sent_;
-  int acked_;
-  const int requests_;
-  const int keys_;
-  const int valuelen_;
-  string value_;
-  CountDownLatch* const connected_;
+  const Options& options_;
+  const ZipfGenerator* const zipf_;
+  const int index_;
+  std::mt19937_64 rng_;
+  const double interval_;  // in microseconds, 0 for closed loop
+  Timestamp nextDue_;
+  Timestamp measureFrom_;
+  Timestamp end_;
+  bool running_;
+  std::deque<Pending> pending_;
+  Histogram histogram_;
+  int64_t hits_;
+  int64_t misses_;
+  int64_t errors_;
+  bool populating_;
+  CountDownLatch* const ready_;
   CountDownLatch* const finished_;
 };
 
+void tickClients(const std::vector<Client*>* clients)
+{
+  Timestamp now = Timestamp::now();
+  for (Client* client : *clients)
+  {
+    client->tick(now);
+  }
+}
+
+void startClients(const std::vector<Client*>* clients,
+                  Timestamp begin, Timestamp measureFrom, Timestamp end,
+                  double tickInterval, TimerId* timer)
+{
+  for (Client* client : *clients)
+  {
+    client->start(begin, measureFrom, end);
+  }
+  if (tickInterval > 0 && !clients->empty())
+  {
+    *timer = clients->front()->getLoop()->runEvery(tickInterval, std::bind(tickClients, clients));
+  }
+}
+
 int main(int argc, char* argv[])
 {
   Logger::setLogLevel(Logger::WARN);
@@ -163,10 +429,18 @@ int main(int argc, char* argv[])
   uint16_t tcpport = 11211;
   string hostIp = "127.0.0.1";
   int threads = 4;
-  int clients = 100;
-  int requests = 100000;
-  int keys = 10000;
-  bool set = false;
+  double duration = 10;
+  double warmup = 1;
+  double tickMs = 0.1;
+  Options options;
+  options.clients = 100;
+  options.keys = 10000;
+  options.zipf = 0.99;
+  options.setRatio = 0;
+  options.valueSize = 100;
+  options.valueMax = 0;
+  options.rate = 0;
+  options.depth = 1;
 
   po::options_description desc("Allowed options");
   desc.add_options()
@@ -174,10 +448,19 @@ int main(int argc, char* argv[])
       ("port,p", po::value<uint16_t>(&tcpport), "TCP port")
       ("ip,i", po::value<string>(&hostIp), "Host IP")
       ("threads,t", po::value<int>(&threads), "Number of worker threads")
-      ("clients,c", po::value<int>(&clients), "Number of concurrent clients")
-      ("requests,r", po::value<int>(&requests), "Number of requests per clients")
-      ("keys,k", po::value<int>(&keys), "Number of keys per clients")
-      ("set,s", "Get or Set")
+      ("clients,c", po::value<int>(&options.clients), "Number of concurrent clients")
+      ("keys,k", po::value<int>(&options.keys), "Number of keys of all clients")
+      ("zipf,z", po::value<double>(&options.zipf), "Zipfian constant of keys in [0, 1), 0 for uniform")
+      ("set-ratio", po::value<double>(&options.setRatio), "Ratio of sets in requests")
+      ("set,s", "Sets only")
+      ("value-size,v", po::value<int>(&options.valueSize), "Value size")
+      ("value-max", po::value<int>(&options.valueMax), "Value sizes uniform in [value-size, value-max]")
+      ("rate,r", po::value<double>(&options.rate), "Requests per second of all clients, 0 for closed loop")
+      ("depth,d", po::value<int>(&options.depth), "Requests in flight per client in closed loop")
+      ("duration,D", po::value<double>(&duration), "Seconds to measure")
+      ("warmup,w", po::value<double>(&warmup), "Seconds to run before measuring")
+      ("tick", po::value<double>(&tickMs), "Milliseconds between sends in open loop")
+      ("populate", "Set all keys before running")
       ;
 
   po::variables_map vm;
@@ -189,7 +472,17 @@ int main(int argc, char* argv[])
     std::cout << desc << "\n";
     return 0;
   }
-  set = vm.count("set");
+  if (vm.count("set"))
+  {
+    options.setRatio = 1;
+  }
+  options.populate = vm.count("populate") > 0;
+  if (options.clients <= 0 || options.keys <= 0 || options.depth <= 0
+      || options.zipf < 0 || options.zipf >= 1)
+  {
+    std::cout << desc << "\n";
+    return 1;
+  }
 
   InetAddress serverAddr(hostIp, tcpport);
   LOG_WARN << "Connecting " << serverAddr.toIpPort();
@@ -197,43 +490,94 @@ int main(int argc, char* argv[])
   EventLoop loop;
   EventLoopThreadPool pool(&loop, "bench-memcache");
 
-  int valuelen = 100;
-  Client::Operation op = set ? Client::kSet : Client::kGet;
-
-  double memoryMiB = 1.0 * clients * keys * (32+80+valuelen+8) / 1024 / 1024;
+  double memoryMiB = 1.0 * options.keys * (32+80+std::max(options.valueSize, options.valueMax)+8) / 1024 / 1024;
   LOG_WARN << "estimated memcached-debug memory usage " << int(memoryMiB) << " MiB";
 
   pool.setThreadNum(threads);
   pool.start();
 
+  ZipfGenerator zipf(options.keys, options.zipf);
   char buf[32];
-  CountDownLatch connected(clients);
-  CountDownLatch finished(clients);
+  CountDownLatch ready(options.clients);
+  CountDownLatch finished(options.clients);
   std::vector<std::unique_ptr<Client>> holder;
-  for (int i = 0; i < clients; ++i)
+  std::map<EventLoop*, std::vector<Client*>> clientsOfLoop;
+  for (int i = 0; i < options.clients; ++i)
   {
     snprintf(buf, sizeof buf, "%d-", i+1);
+    EventLoop* ioLoop = pool.getNextLoop();
     holder.emplace_back(new Client(buf,
-                                pool.getNextLoop(),
-                                serverAddr,
-                                op,
-                                requests,
-                                keys,
-                                valuelen,
-                                &connected,
-                                &finished));
-  }
-  connected.wait();
-  LOG_WARN << clients << " clients all connected";
-  Timestamp start = Timestamp::now();
-  for (int i = 0; i < clients; ++i)
-  {
-    holder[i]->send();
+                                   ioLoop,
+                                   serverAddr,
+                                   options,
+                                   &zipf,
+                                   i,
+                                   &ready,
+                                   &finished));
+    clientsOfLoop[ioLoop].push_back(holder.back().get());
+  }
+  ready.wait();
+  LOG_WARN << options.clients << " clients all connected"
+           << (options.populate ? ", keys populated" : "");
+
+  const Timestamp begin = addTime(Timestamp::now(), 0.01);
+  const Timestamp measureFrom = addTime(begin, warmup);
+  const Timestamp end = addTime(measureFrom, duration);
+  const double tickInterval = options.rate > 0 ? tickMs / 1000 : 0;
+  // one timer per loop in open loop, filled by the loop
+  std::map<EventLoop*, TimerId> timers;
+  for (auto& it : clientsOfLoop)
+  {
+    timers[it.first];
+  }
+  for (auto& it : clientsOfLoop)
+  {
+    it.first->runInLoop(std::bind(startClients, &it.second, begin, measureFrom, end,
+                                  tickInterval, &timers[it.first]));
   }
   finished.wait();
-  Timestamp end = Timestamp::now();
   LOG_WARN << "All finished";
-  double seconds = timeDifference(end, start);
-  LOG_WARN << seconds << " sec";
-  LOG_WARN << 1.0 * clients * requests / seconds << " QPS";
+
+  if (tickInterval > 0)
+  {
+    // no tick on clients gone
+    CountDownLatch cancelled(static_cast<int>(timers.size()));
+    for (auto& it : timers)
+    {
+      it.first->cancel(it.second);
+      it.first->queueInLoop(std::bind(&CountDownLatch::countDown, &cancelled));
+    }
+    cancelled.wait();
+  }
+
+  Histogram latency;
+  int64_t hits = 0, misses = 0, errors = 0;
+  for (const auto& client : holder)
+  {
+    latency.merge(client->histogram());
+    hits += client->hits();
+    misses += client->misses();
+    errors += client->errors();
+  }
+
+  printf("%s loop, %d clients, %d keys, zipf %.2f, set ratio %.2f, value %d bytes\n",
+         options.rate > 0 ? "open" : "closed", options.clients, options.keys,
+         options.zipf, options.setRatio, options.valueSize);
+  printf("%.0f requests/s", static_cast<double>(latency.count()) / duration);
+  if (options.rate > 0)
+  {
+    printf(" of %.0f", options.rate);
+  }
+  printf(", gets hit %lld miss %lld, errors %lld\n",
+         static_cast<long long>(hits), static_cast<long long>(misses),
+         static_cast<long long>(errors));
+  printf("latency us: min %lld mean %.1f p50 %lld p90 %lld p99 %lld p999 %lld p9999 %lld max %lld\n",
+         static_cast<long long>(latency.min()),
+         latency.mean(),
+         static_cast<long long>(latency.percentile(50)),
+         static_cast<long long>(latency.percentile(90)),
+         static_cast<long long>(latency.percentile(99)),
+         static_cast<long long>(latency.percentile(99.9)),
+         static_cast<long long>(latency.percentile(99.99)),
+         static_cast<long long>(latency.max()));
 }
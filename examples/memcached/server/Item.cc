@@ -1,9 +1,10 @@
 #include "examples/memcached/server/Item.h"
+#include "examples/memcached/server/SlabAllocator.h"
 
 #include "muduo/base/LogStream.h"
 #include "muduo/net/Buffer.h"
 
-#include <boost/functional/hash/hash.hpp>
+#include <new>
 
 #include <string.h> // memcpy
 #include <stdio.h>
@@ -11,7 +12,69 @@
 using namespace muduo;
 using namespace muduo::net;
 
-Item::Item(StringPiece keyArg,
+ItemPtr Item::makeItem(SlabAllocator* slabs,
+                       int cls,
+                       StringPiece keyArg,
+                       uint32_t flagsArg,
+                       int exptimeArg,
+                       int valuelen,
+                       uint64_t casArg)
+{
+  void* chunk = NULL;
+  if (slabs)
+  {
+    assert(slabs->chunkSize(cls) >= totalSize(keyArg.size(), valuelen));
+    chunk = slabs->allocate(cls);
+  }
+  else
+  {
+    assert(cls == -1);
+    chunk = ::malloc(totalSize(keyArg.size(), valuelen));
+  }
+  if (!chunk)
+  {
+    return ItemPtr();
+  }
+  return ItemPtr(new (chunk) Item(slabs, cls, keyArg, flagsArg, exptimeArg, valuelen, casArg));
+}
+
+size_t Item::hashKey(StringPiece key)
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  const size_t len = key.size();
+  uint64_t h = 0x8445d61a4e774912ULL ^ (len * m);
+
+  const char* p = key.data();
+  const char* end = p + (len & ~static_cast<size_t>(7));
+  for (; p != end; p += 8)
+  {
+    uint64_t k;
+    memcpy(&k, p, sizeof k);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  if (len & 7)
+  {
+    // the tail, little-endian as the reference implementation
+    uint64_t k = 0;
+    memcpy(&k, p, len & 7);
+    h ^= k;
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return static_cast<size_t>(h);
+}
+
+Item::Item(SlabAllocator* slabs,
+           int cls,
+           StringPiece keyArg,
            uint32_t flagsArg,
            int exptimeArg,
            int valuelen,
@@ -21,19 +84,39 @@ Item::Item(StringPiece keyArg,
     rel_exptime_(exptimeArg),
     valuelen_(valuelen),
     receivedBytes_(0),
+    refCount_(0),
     cas_(casArg),
-    hash_(boost::hash_range(keyArg.begin(), keyArg.end())),
-    data_(static_cast<char*>(::malloc(totalLen())))
+    hash_(hashKey(keyArg)),
+    slabs_(slabs),
+    slabClass_(static_cast<int8_t>(cls)),
+    accessed_(false),
+    clockIndex_(0)
 {
   assert(valuelen_ >= 2);
   assert(receivedBytes_ < totalLen());
   append(keyArg.data(), keylen_);
 }
 
-void Item::append(const char* data, size_t len)
+void Item::destroy() const
+{
+  SlabAllocator* slabs = slabs_;
+  int cls = slabClass_;
+  void* chunk = const_cast<Item*>(this);
+  this->~Item();
+  if (slabs)
+  {
+    slabs->deallocate(chunk, cls);
+  }
+  else
+  {
+    ::free(chunk);
+  }
+}
+
+void Item::append(const char* buf, size_t len)
 {
   assert(len <= neededBytes());
-  memcpy(data_ + receivedBytes_, data, len);
+  memcpy(data() + receivedBytes_, buf, len);
   receivedBytes_ += static_cast<int>(len);
   assert(receivedBytes_ <= totalLen());
 }
@@ -41,7 +124,7 @@ void Item::append(const char* data, size_t len)
 void Item::output(Buffer* out, bool needCas) const
 {
   out->append("VALUE ");
-  out->append(data_, keylen_);
+  out->append(data(), keylen_);
   LogStream buf;
   buf << ' ' << flags_ << ' ' << valuelen_-2;
   if (needCas)
@@ -52,12 +135,3 @@ void Item::output(Buffer* out, bool needCas) const
   out->append(buf.buffer().data(), buf.buffer().length());
   out->append(value(), valuelen_);
 }
-
-void Item::resetKey(StringPiece k)
-{
-  assert(k.size() <= 250);
-  keylen_ = k.size();
-  receivedBytes_ = 0;
-  append(k.data(), k.size());
-  hash_ = boost::hash_range(k.begin(), k.end());
-}
@@ -5,7 +5,9 @@
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 
-#include <memory>
+#include <boost/intrusive_ptr.hpp>
+
+#include <atomic>
 
 namespace muduo
 {
@@ -16,10 +18,16 @@ class Buffer;
 }
 
 class Item;
-typedef std::shared_ptr<Item> ItemPtr;  // TODO: use unique_ptr
-typedef std::shared_ptr<const Item> ConstItemPtr;  // TODO: use unique_ptr
+class SlabAllocator;
+// the count is in Item, there is no control block of shared_ptr
+typedef boost::intrusive_ptr<Item> ItemPtr;
+typedef boost::intrusive_ptr<const Item> ConstItemPtr;
+
+void intrusive_ptr_add_ref(const Item* item);
+void intrusive_ptr_release(const Item* item);
 
-// Item is immutable once added into hash table
+// Item is immutable once added into hash table, but for the bookkeeping of
+// eviction.  Key and value follow the Item in the same block of memory.
 class Item : muduo::noncopyable
 {
  public:
@@ -34,30 +42,36 @@ class Item : muduo::noncopyable
     kCas,
   };
 
+  // exptimeArg is in seconds since the start of server, 0 for never
   static ItemPtr makeItem(muduo::StringPiece keyArg,
                           uint32_t flagsArg,
                           int exptimeArg,
                           int valuelen,
                           uint64_t casArg)
   {
-    return std::make_shared<Item>(keyArg, flagsArg, exptimeArg, valuelen, casArg);
-    //return ItemPtr(new Item(keyArg, flagsArg, exptimeArg, valuelen, casArg));
+    return makeItem(NULL, -1, keyArg, flagsArg, exptimeArg, valuelen, casArg);
   }
 
-  Item(muduo::StringPiece keyArg,
-       uint32_t flagsArg,
-       int exptimeArg,
-       int valuelen,
-       uint64_t casArg);
+  // in a chunk of slab class cls, NULL if the class is out of memory
+  static ItemPtr makeItem(SlabAllocator* slabs,
+                          int cls,
+                          muduo::StringPiece keyArg,
+                          uint32_t flagsArg,
+                          int exptimeArg,
+                          int valuelen,
+                          uint64_t casArg);
 
-  ~Item()
+  static size_t totalSize(size_t keylen, size_t valuelen)
   {
-    ::free(data_);
+    return sizeof(Item) + keylen + valuelen;
   }
 
+  // MurmurHash64A, the bits are good from top to bottom
+  static size_t hashKey(muduo::StringPiece key);
+
   muduo::StringPiece key() const
   {
-    return muduo::StringPiece(data_, keylen_);
+    return muduo::StringPiece(data(), keylen_);
   }
 
   uint32_t flags() const
@@ -70,9 +84,14 @@ class Item : muduo::noncopyable
     return rel_exptime_;
   }
 
+  bool isExpired(int now) const
+  {
+    return rel_exptime_ != 0 && rel_exptime_ <= now;
+  }
+
   const char* value() const
   {
-    return data_+keylen_;
+    return data()+keylen_;
   }
 
   size_t valueLength() const
@@ -100,30 +119,94 @@ class Item : muduo::noncopyable
     return totalLen() - receivedBytes_;
   }
 
-  void append(const char* data, size_t len);
+  void append(const char* buf, size_t len);
 
   bool endsWithCRLF() const
   {
     return receivedBytes_ == totalLen()
-        && data_[totalLen()-2] == '\r'
-        && data_[totalLen()-1] == '\n';
+        && data()[totalLen()-2] == '\r'
+        && data()[totalLen()-1] == '\n';
   }
 
   void output(muduo::net::Buffer* out, bool needCas = false) const;
 
-  void resetKey(muduo::StringPiece k);
+  int slabClass() const
+  {
+    return slabClass_;
+  }
+
+  // CLOCK of MemcacheServer, gets set the bit without locking
+  void touch() const
+  {
+    if (!accessed_.load(std::memory_order_relaxed))
+    {
+      accessed_.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  bool testAndClearAccessed() const
+  {
+    return accessed_.exchange(false, std::memory_order_relaxed);
+  }
+
+  bool unique() const
+  {
+    return refCount_.load(std::memory_order_acquire) == 1;
+  }
+
+  size_t clockIndex() const
+  {
+    return clockIndex_;
+  }
+
+  void setClockIndex(size_t index) const
+  {
+    clockIndex_ = static_cast<uint32_t>(index);
+  }
 
  private:
+  friend void intrusive_ptr_add_ref(const Item* item);
+  friend void intrusive_ptr_release(const Item* item);
+
+  Item(SlabAllocator* slabs,
+       int cls,
+       muduo::StringPiece keyArg,
+       uint32_t flagsArg,
+       int exptimeArg,
+       int valuelen,
+       uint64_t casArg);
+
+  void destroy() const;
+
   int totalLen() const { return keylen_ + valuelen_; }
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+  const char* data() const { return reinterpret_cast<const char*>(this + 1); }
 
   int            keylen_;
   const uint32_t flags_;
   const int      rel_exptime_;
   const int      valuelen_;
   int            receivedBytes_;  // FIXME: remove this member
+  mutable std::atomic<int> refCount_;
   uint64_t       cas_;
   size_t         hash_;
-  char*          data_;
+  SlabAllocator* const slabs_;  // NULL for malloc()
+  const int8_t   slabClass_;
+  mutable std::atomic<bool> accessed_;
+  mutable uint32_t clockIndex_;  // guarded by the CLOCK of slabClass_
 };
 
+inline void intrusive_ptr_add_ref(const Item* item)
+{
+  item->refCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void intrusive_ptr_release(const Item* item)
+{
+  if (item->refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    item->destroy();
+  }
+}
+
 #endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEM_H
@@ -0,0 +1,213 @@
+#include "examples/memcached/server/ItemIndex.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const size_t ItemIndex::kGroupSize;
+const int8_t ItemIndex::kEmpty;
+const int8_t ItemIndex::kDeleted;
+
+ItemIndex::ItemIndex()
+  : ctrl_(NULL),
+    slots_(NULL),
+    capacity_(0),
+    size_(0),
+    deleted_(0)
+{
+}
+
+ItemIndex::~ItemIndex()
+{
+  for (size_t i = 0; i < capacity_; ++i)
+  {
+    if (isFull(ctrl_[i]))
+    {
+      intrusive_ptr_release(slots_[i]);
+    }
+  }
+  ::free(ctrl_);
+  ::free(slots_);
+}
+
+uint32_t ItemIndex::match(const int8_t* group, int8_t tag)
+{
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+#else
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kGroupSize; ++i)
+  {
+    if (group[i] == tag)
+      mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+uint32_t ItemIndex::matchEmpty(const int8_t* group)
+{
+  return match(group, kEmpty);
+}
+
+uint32_t ItemIndex::matchEmptyOrDeleted(const int8_t* group)
+{
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+  // both are less than -1, full ones are not negative
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+#else
+  uint32_t mask = 0;
+  for (size_t i = 0; i < kGroupSize; ++i)
+  {
+    if (group[i] < -1)
+      mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+const Item* ItemIndex::find(muduo::StringPiece key, size_t hash) const
+{
+  if (capacity_ == 0)
+  {
+    return NULL;
+  }
+  const int8_t tag = tagOf(hash);
+  const size_t mask = numGroups() - 1;
+  size_t g = groupOf(hash);
+  // triangular probing visits every group once
+  for (size_t probe = 1; probe <= numGroups(); ++probe)
+  {
+    const int8_t* group = ctrl_ + g * kGroupSize;
+    for (uint32_t m = match(group, tag); m != 0; m &= m - 1)
+    {
+      const Item* item = slots_[g * kGroupSize + __builtin_ctz(m)];
+      if (item->hash() == hash && item->key() == key)
+      {
+        return item;
+      }
+    }
+    if (matchEmpty(group))
+    {
+      return NULL;
+    }
+    g = (g + probe) & mask;
+  }
+  return NULL;
+}
+
+size_t ItemIndex::findSlot(const Item* item) const
+{
+  const int8_t tag = tagOf(item->hash());
+  const size_t mask = numGroups() - 1;
+  size_t g = groupOf(item->hash());
+  for (size_t probe = 1; probe <= numGroups(); ++probe)
+  {
+    for (uint32_t m = match(ctrl_ + g * kGroupSize, tag); m != 0; m &= m - 1)
+    {
+      size_t i = g * kGroupSize + __builtin_ctz(m);
+      if (slots_[i] == item)
+      {
+        return i;
+      }
+    }
+    g = (g + probe) & mask;
+  }
+  assert(false && "item is not in the index");
+  return capacity_;
+}
+
+void ItemIndex::insert(const Item* item)
+{
+  assert(find(item->key(), item->hash()) == NULL);
+  // at most 7/8 full, counting the deleted
+  if ((size_ + deleted_ + 1) * 8 > capacity_ * 7)
+  {
+    // grow if live items take more than half of it, or purge the deleted
+    rehash((size_ + 1) * 2 > capacity_ ? std::max(capacity_ * 2, kGroupSize) : capacity_);
+  }
+
+  const size_t mask = numGroups() - 1;
+  size_t g = groupOf(item->hash());
+  uint32_t m = 0;
+  for (size_t probe = 1; (m = matchEmptyOrDeleted(ctrl_ + g * kGroupSize)) == 0; ++probe)
+  {
+    g = (g + probe) & mask;
+  }
+  size_t i = g * kGroupSize + __builtin_ctz(m);
+  if (ctrl_[i] == kDeleted)
+  {
+    --deleted_;
+  }
+  ctrl_[i] = tagOf(item->hash());
+  slots_[i] = item;
+  intrusive_ptr_add_ref(item);
+  ++size_;
+}
+
+void ItemIndex::erase(const Item* item)
+{
+  eraseAt(findSlot(item));
+}
+
+void ItemIndex::eraseAt(size_t i)
+{
+  assert(i < capacity_ && isFull(ctrl_[i]));
+  // a lookup passes a group only if it has no empty slot, so the slot
+  // can be empty again only if its group has one already
+  if (matchEmpty(ctrl_ + i / kGroupSize * kGroupSize))
+  {
+    ctrl_[i] = kEmpty;
+  }
+  else
+  {
+    ctrl_[i] = kDeleted;
+    ++deleted_;
+  }
+  --size_;
+  const Item* item = slots_[i];
+  slots_[i] = NULL;
+  intrusive_ptr_release(item);
+}
+
+void ItemIndex::rehash(size_t newCapacity)
+{
+  assert(newCapacity >= kGroupSize && (newCapacity & (newCapacity - 1)) == 0);
+  int8_t* oldCtrl = ctrl_;
+  const Item** oldSlots = slots_;
+  const size_t oldCapacity = capacity_;
+
+  ctrl_ = static_cast<int8_t*>(::malloc(newCapacity));
+  slots_ = static_cast<const Item**>(::malloc(newCapacity * sizeof(Item*)));
+  memset(ctrl_, kEmpty, newCapacity);
+  capacity_ = newCapacity;
+  deleted_ = 0;
+
+  const size_t mask = numGroups() - 1;
+  for (size_t j = 0; j < oldCapacity; ++j)
+  {
+    if (!isFull(oldCtrl[j]))
+    {
+      continue;
+    }
+    const Item* item = oldSlots[j];
+    size_t g = groupOf(item->hash());
+    uint32_t m = 0;
+    for (size_t probe = 1; (m = matchEmpty(ctrl_ + g * kGroupSize)) == 0; ++probe)
+    {
+      g = (g + probe) & mask;
+    }
+    size_t i = g * kGroupSize + __builtin_ctz(m);
+    ctrl_[i] = oldCtrl[j];
+    slots_[i] = item;
+  }
+  ::free(oldCtrl);
+  ::free(oldSlots);
+}
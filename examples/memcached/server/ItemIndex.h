@@ -0,0 +1,92 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMINDEX_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMINDEX_H
+
+#include "examples/memcached/server/Item.h"
+
+// Items by key, an open-addressing hash table in the style of Swiss tables.
+//
+// A control byte per slot holds 7 bits of the hash of the item in it, or
+// marks the slot empty or deleted.  A probe compares the control bytes of a
+// group of 16 slots at once, with SSE2 when available, and looks at an Item
+// only when its 7 bits match.  Slots are bare pointers, the table holds a
+// reference of each item in it.
+//
+// The low bits of Item::hash() pick the group and the tag, so the caller
+// shall use the high bits for sharding.
+//
+// Not thread safe.
+class ItemIndex : muduo::noncopyable
+{
+ public:
+  ItemIndex();
+  ~ItemIndex();
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  // hash must be Item::hashKey(key)
+  const Item* find(muduo::StringPiece key, size_t hash) const;
+
+  // no item of the same key shall be in it
+  void insert(const Item* item);
+
+  // item shall be in it
+  void erase(const Item* item);
+
+  template<typename Func>
+  void forEach(Func func) const
+  {
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+      if (isFull(ctrl_[i]))
+      {
+        func(slots_[i]);
+      }
+    }
+  }
+
+  // erases the items for which pred returns true
+  template<typename Pred>
+  size_t eraseIf(Pred pred)
+  {
+    size_t erased = 0;
+    for (size_t i = 0; i < capacity_; ++i)
+    {
+      if (isFull(ctrl_[i]) && pred(slots_[i]))
+      {
+        eraseAt(i);
+        ++erased;
+      }
+    }
+    return erased;
+  }
+
+ private:
+  static const size_t kGroupSize = 16;
+  static const int8_t kEmpty = -128;
+  static const int8_t kDeleted = -2;
+
+  static bool isFull(int8_t ctrl) { return ctrl >= 0; }
+  static int8_t tagOf(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+  size_t numGroups() const { return capacity_ / kGroupSize; }
+  // the first group to probe
+  size_t groupOf(size_t hash) const { return (hash >> 7) & (numGroups() - 1); }
+
+  // bit i set for a match of the i-th control byte in the group
+  static uint32_t match(const int8_t* group, int8_t tag);
+  static uint32_t matchEmpty(const int8_t* group);
+  static uint32_t matchEmptyOrDeleted(const int8_t* group);
+
+  size_t findSlot(const Item* item) const;
+  void eraseAt(size_t i);
+  void rehash(size_t newCapacity);
+
+  int8_t* ctrl_;
+  const Item** slots_;
+  size_t capacity_;  // 0 or a power of 2 no less than kGroupSize
+  size_t size_;
+  size_t deleted_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_ITEMINDEX_H
@@ -0,0 +1,199 @@
+#undef NDEBUG
+#include "examples/memcached/server/ItemIndex.h"
+#include "examples/memcached/server/SlabAllocator.h"
+
+#include "muduo/base/Logging.h"
+
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+
+ItemPtr makeItem(const string& key)
+{
+  return Item::makeItem(key, 0, 0, 2, 1);
+}
+
+// keys whose hashes agree with hash0 on the bits of mask
+std::vector<ItemPtr> itemsWithBits(size_t mask, size_t hash0, size_t n)
+{
+  std::vector<ItemPtr> items;
+  char key[32];
+  for (int i = 0; items.size() < n; ++i)
+  {
+    snprintf(key, sizeof key, "key%d", i);
+    if ((Item::hashKey(key) & mask) == (hash0 & mask))
+    {
+      items.push_back(makeItem(key));
+    }
+  }
+  return items;
+}
+
+const Item* find(const ItemIndex& index, const ItemPtr& item)
+{
+  return index.find(item->key(), item->hash());
+}
+
+void testGrowth()
+{
+  ItemIndex index;
+  assert(index.size() == 0 && index.capacity() == 0);
+  assert(index.find("nothing", Item::hashKey("nothing")) == NULL);
+
+  const int kItems = 10000;
+  std::vector<ItemPtr> items;
+  char key[32];
+  for (int i = 0; i < kItems; ++i)
+  {
+    snprintf(key, sizeof key, "growth%d", i);
+    items.push_back(makeItem(key));
+    index.insert(get_pointer(items.back()));
+    // a power of 2, at most 7/8 full
+    assert((index.capacity() & (index.capacity() - 1)) == 0);
+    assert(index.size() * 8 <= index.capacity() * 7);
+  }
+  assert(index.size() == static_cast<size_t>(kItems));
+  for (const ItemPtr& item : items)
+  {
+    assert(find(index, item) == get_pointer(item));
+  }
+
+  size_t visited = 0;
+  index.forEach([&visited](const Item*) { ++visited; });
+  assert(visited == index.size());
+
+  // the index holds a reference of its own
+  const Item* first = get_pointer(items[0]);
+  ItemPtr other = makeItem("growth0");
+  assert(find(index, other) == first);
+  items.clear();
+  assert(find(index, other) == first);
+}
+
+void testTagCollisions()
+{
+  // the same 7 bits of tag, and in the single group of 16 slots
+  const size_t kTag = 0x7F;
+  std::vector<ItemPtr> items = itemsWithBits(kTag, 0x2A, 15);
+  ItemIndex index;
+  for (size_t i = 0; i < 14; ++i)
+  {
+    index.insert(get_pointer(items[i]));
+  }
+  assert(index.capacity() == 16);
+  for (size_t i = 0; i < 14; ++i)
+  {
+    assert(find(index, items[i]) == get_pointer(items[i]));
+  }
+  // the tag matches, the key does not
+  assert(find(index, items[14]) == NULL);
+
+  index.erase(get_pointer(items[7]));
+  assert(find(index, items[7]) == NULL);
+  assert(find(index, items[8]) == get_pointer(items[8]));
+}
+
+void testTombstones()
+{
+  // of 2 groups, 16 fill the first and one overflows to the second
+  const size_t kGroupBit = size_t(1) << 7;
+  std::vector<ItemPtr> first = itemsWithBits(kGroupBit, 0, 17);
+  std::vector<ItemPtr> second = itemsWithBits(kGroupBit, kGroupBit, 12);
+  ItemIndex index;
+  for (const ItemPtr& item : first)
+  {
+    index.insert(get_pointer(item));
+  }
+  for (size_t i = 0; i < 10; ++i)
+  {
+    index.insert(get_pointer(second[i]));
+  }
+  assert(index.capacity() == 32 && index.size() == 27);
+
+  // the first group stays without an empty slot, so a lookup goes on
+  // past the deleted ones to the second
+  for (size_t i = 0; i < 13; ++i)
+  {
+    index.erase(get_pointer(first[i]));
+  }
+  for (size_t i = 0; i < first.size(); ++i)
+  {
+    assert(find(index, first[i]) == (i < 13 ? NULL : get_pointer(first[i])));
+  }
+
+  // 14 live and 13 deleted, the second insert purges the deleted
+  // without growing, as the live ones take no more than half
+  index.insert(get_pointer(second[10]));
+  index.insert(get_pointer(second[11]));
+  assert(index.capacity() == 32 && index.size() == 16);
+  for (size_t i = 13; i < first.size(); ++i)
+  {
+    assert(find(index, first[i]) == get_pointer(first[i]));
+  }
+  for (const ItemPtr& item : second)
+  {
+    assert(find(index, item) == get_pointer(item));
+  }
+
+  // and fills up to 7/8 again
+  for (size_t i = 0; i < 10; ++i)
+  {
+    index.insert(get_pointer(first[i]));
+  }
+  assert(index.capacity() == 32 && index.size() == 26);
+
+  size_t erased = index.eraseIf([&second](const Item* item) { return item == get_pointer(second[3]); });
+  assert(erased == 1 && index.size() == 25);
+  assert(find(index, second[3]) == NULL);
+}
+
+void testSlabAllocator()
+{
+  SlabAllocator slabs(SlabAllocator::kPageSize);
+  assert(slabs.slabClass(1) == 0);
+  assert(slabs.chunkSize(0) == SlabAllocator::kMinChunkSize);
+  for (int cls = 1; cls < slabs.numClasses(); ++cls)
+  {
+    assert(slabs.chunkSize(cls) > slabs.chunkSize(cls - 1));
+    assert(slabs.slabClass(slabs.chunkSize(cls - 1) + 1) == cls);
+  }
+  assert(slabs.slabClass(SlabAllocator::kMaxChunkSize) == slabs.numClasses() - 1);
+  assert(slabs.slabClass(SlabAllocator::kMaxChunkSize + 1) == -1);
+
+  // one page up to the limit
+  std::vector<void*> chunks;
+  while (void* chunk = slabs.allocate(0))
+  {
+    chunks.push_back(chunk);
+  }
+  assert(chunks.size() == SlabAllocator::kPageSize / slabs.chunkSize(0));
+  assert(slabs.allocatedBytes() == chunks.size() * slabs.chunkSize(0));
+
+  // a chunk freed goes to the next one
+  slabs.deallocate(chunks.back(), 0);
+  assert(slabs.allocate(0) == chunks.back());
+  assert(slabs.allocate(0) == NULL);
+
+  // every class gets a page past the limit
+  void* other = slabs.allocate(1);
+  assert(other != NULL);
+  assert(slabs.allocatedBytes() > slabs.limit());
+  slabs.deallocate(other, 1);
+  for (void* chunk : chunks)
+  {
+    slabs.deallocate(chunk, 0);
+  }
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  testGrowth();
+  testTagCollisions();
+  testTombstones();
+  testSlabAllocator();
+  printf("all passed\n");
+}
@@ -1,39 +1,278 @@
 #include "examples/memcached/server/MemcacheServer.h"
+#include "examples/memcached/server/Snapshot.h"
+#include "examples/memcached/server/UdpServer.h"
 
 #include "muduo/base/Atomic.h"
 #include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThreadPool.h"
+
+#include <algorithm>
+
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
 muduo::AtomicInt64 g_cas;
 
+namespace
+{
+// the crawler visits all shards in about 6.4 seconds
+const double kCrawlInterval = 0.1;
+const int kShardsPerCrawl = 64;
+// a set gives up after evicting so many items of its class
+const int kMaxEvictionsPerItem = 16;
+const time_t kMaxRelativeExptime = 60*60*24*30;
+}
+
 MemcacheServer::Options::Options()
+  : tcpport(0),
+    udpport(0),
+    gperfport(0),
+    threads(0),
+    memoryLimitMB(0),
+    snapshotInterval(0)
 {
-  memZero(this, sizeof(*this));
 }
 
 struct MemcacheServer::Stats
 {
+  AtomicInt64 evictions;
+  AtomicInt64 expired;
+  AtomicInt64 outOfMemory;
+  AtomicInt64 hotKeyCopies;
+  AtomicInt64 snapshots;
+  AtomicInt64 snapshotItems;
 };
 
+// CLOCK, a cheap approximation of LRU: a get only sets the accessed bit of
+// the item, eviction sweeps the items of a slab class, clearing the bits set,
+// and takes the first item whose bit was clear.
+struct MemcacheServer::Clock
+{
+  Clock()
+    : hand(0)
+  {
+  }
+
+  void insert(const Item* item)
+  {
+    MutexLockGuard lock(mutex);
+    item->setClockIndex(items.size());
+    items.push_back(item);
+  }
+
+  void erase(const Item* item)
+  {
+    MutexLockGuard lock(mutex);
+    size_t i = item->clockIndex();
+    assert(items[i] == item);
+    items[i] = items.back();
+    items[i]->setClockIndex(i);
+    items.pop_back();
+  }
+
+  ConstItemPtr pickVictim(int now)
+  {
+    MutexLockGuard lock(mutex);
+    // at most two rounds, all bits are clear after the first
+    for (size_t i = 0; i < 2 * items.size(); ++i)
+    {
+      if (hand >= items.size())
+      {
+        hand = 0;
+      }
+      const Item* item = items[hand++];
+      if (item->isExpired(now) || !item->testAndClearAccessed())
+      {
+        // alive, it is in an index which erases it from here first
+        return ConstItemPtr(item);
+      }
+    }
+    return ConstItemPtr();
+  }
+
+  MutexLock mutex;
+  // the items of an index, which holds them
+  std::vector<const Item*> items GUARDED_BY(mutex);
+  size_t hand GUARDED_BY(mutex);
+};
+
+// Per I/O loop, gets of hot keys without the lock of their shards.
+//
+// A count-min sketch counts the gets that take the lock, its counters halve
+// every kWindow of them.  A key counted kThreshold times is hot: its item is
+// copied into a small direct-mapped cache of the loop.  A get of the copy
+// writes no shared cache line, it reads the version of the shard, and the
+// copy is good only if the version is unchanged since.
+struct MemcacheServer::HotKeys
+{
+  static const int kRows = 4;
+  static const int kColumns = 4096;
+  static const uint16_t kThreshold = 128;
+  static const int kWindow = 64 * 1024;
+  static const size_t kCacheSize = 256;
+  // larger items are not copied
+  static const size_t kMaxCopySize = 4096;
+
+  struct Entry
+  {
+    ConstItemPtr copy;
+    // for touch(), which keeps it from eviction
+    ConstItemPtr item;
+    uint64_t version;
+  };
+
+  HotKeys()
+    : gets(0),
+      cache(kCacheSize)
+  {
+    memZero(counters, sizeof counters);
+  }
+
+  static size_t slotOf(size_t hash)
+  {
+    return (hash >> 24) & (kCacheSize - 1);
+  }
+
+  ConstItemPtr find(StringPiece key, size_t hash, uint64_t version)
+  {
+    Entry& entry = cache[slotOf(hash)];
+    if (entry.copy && entry.copy->hash() == hash && entry.copy->key() == key)
+    {
+      if (entry.version == version)
+      {
+        entry.item->touch();
+        return entry.copy;
+      }
+      entry.copy.reset();
+      entry.item.reset();
+    }
+    return ConstItemPtr();
+  }
+
+  // returns true if hot
+  bool count(size_t hash)
+  {
+    if (++gets == kWindow)
+    {
+      gets = 0;
+      for (auto& row : counters)
+      {
+        for (uint16_t& counter : row)
+        {
+          counter = static_cast<uint16_t>(counter >> 1);
+        }
+      }
+    }
+    uint16_t estimate = UINT16_MAX;
+    for (int row = 0; row < kRows; ++row)
+    {
+      uint16_t& counter = counters[row][(hash >> (row * 16)) & (kColumns - 1)];
+      if (counter < UINT16_MAX)
+      {
+        ++counter;
+      }
+      estimate = std::min(estimate, counter);
+    }
+    return estimate >= kThreshold;
+  }
+
+  bool insert(const ConstItemPtr& item, uint64_t version)
+  {
+    if (Item::totalSize(item->key().size(), item->valueLength()) > kMaxCopySize)
+    {
+      return false;
+    }
+    ItemPtr copy(Item::makeItem(item->key(),
+                                item->flags(),
+                                item->rel_exptime(),
+                                static_cast<int>(item->valueLength()),
+                                item->cas()));
+    copy->append(item->value(), item->valueLength());
+    Entry& entry = cache[slotOf(item->hash())];
+    entry.copy = copy;
+    entry.item = item;
+    entry.version = version;
+    return true;
+  }
+
+  int gets;
+  uint16_t counters[kRows][kColumns];
+  std::vector<Entry> cache;
+};
+
+__thread MemcacheServer::HotKeys* MemcacheServer::t_hotKeys = NULL;
+
 MemcacheServer::MemcacheServer(muduo::net::EventLoop* loop, const Options& options)
   : loop_(loop),
     options_(options),
     startTime_(::time(NULL)-1),
+    nextShardToCrawl_(0),
+    snapshotThread_("snapshot"),
+    snapshotting_(false),
     server_(loop, InetAddress(options.tcpport), "muduo-memcached"),
     stats_(new Stats)
 {
+  if (options_.memoryLimitMB > 0)
+  {
+    slabs_.reset(new SlabAllocator(static_cast<size_t>(options_.memoryLimitMB) * 1024 * 1024));
+    for (int i = 0; i < slabs_->numClasses(); ++i)
+    {
+      clocks_.emplace_back(new Clock);
+    }
+  }
   server_.setConnectionCallback(
       std::bind(&MemcacheServer::onConnection, this, _1));
+  server_.setThreadInitCallback(
+      std::bind(&MemcacheServer::initLoop, this, _1));
 }
 
-MemcacheServer::~MemcacheServer() = default;
+MemcacheServer::~MemcacheServer()
+{
+  // a snapshot being saved finishes, then the last one, as loops still run
+  snapshotThread_.stop();
+  if (!options_.snapshotPath.empty())
+  {
+    saveSnapshot();
+  }
+  // the base loop, if it was an I/O loop
+  t_hotKeys = NULL;
+}
+
+void MemcacheServer::initLoop(EventLoop* loop)
+{
+  assert(t_hotKeys == NULL);
+  std::unique_ptr<HotKeys> hotKeys(new HotKeys);
+  t_hotKeys = hotKeys.get();
+  MutexLockGuard lock(mutex_);
+  hotKeys_.push_back(std::move(hotKeys));
+}
 
 void MemcacheServer::start()
 {
+  if (!options_.snapshotPath.empty())
+  {
+    loadSnapshot(std::max(options_.threads, 1));
+    snapshotThread_.start(1);
+    if (options_.snapshotInterval > 0)
+    {
+      loop_->runEvery(options_.snapshotInterval,
+                      std::bind(&MemcacheServer::requestSnapshot, this));
+    }
+  }
+  loop_->runEvery(kCrawlInterval, std::bind(&MemcacheServer::crawlExpired, this));
   server_.start();
+  if (options_.udpport != 0)
+  {
+    for (EventLoop* loop : server_.threadPool()->getAllLoops())
+    {
+      udpServers_.emplace_back(new UdpServer(this, loop, InetAddress(options_.udpport)));
+    }
+    LOG_INFO << "UDP port " << options_.udpport << " on " << udpServers_.size() << " loops";
+  }
 }
 
 void MemcacheServer::stop()
@@ -41,22 +280,208 @@ void MemcacheServer::stop()
   loop_->runAfter(3.0, std::bind(&EventLoop::quit, loop_));
 }
 
+void MemcacheServer::requestSnapshot()
+{
+  // one at a time
+  if (!snapshotting_.exchange(true))
+  {
+    snapshotThread_.run([this]
+    {
+      saveSnapshot();
+      snapshotting_ = false;
+    });
+  }
+}
+
+bool MemcacheServer::saveSnapshot()
+{
+  assert(!options_.snapshotPath.empty());
+  const Timestamp start(Timestamp::now());
+  SnapshotWriter writer(options_.snapshotPath);
+  std::vector<ConstItemPtr> items;
+  for (Shard& shard : shards_)
+  {
+    {
+      MutexLockGuard lock(shard.mutex);
+      shard.items.forEach([&items](const Item* item)
+      {
+        items.push_back(ConstItemPtr(item));
+      });
+    }
+    // items are immutable, a store meanwhile replaces rather than changes
+    const int now = currentTime();
+    for (const ConstItemPtr& item : items)
+    {
+      if (!item->isExpired(now))
+      {
+        const int64_t exptime = item->rel_exptime() == 0 ? 0 : startTime_ + item->rel_exptime();
+        writer.add(item->key(), item->flags(), exptime,
+                   StringPiece(item->value(), static_cast<int>(item->valueLength() - 2)));
+      }
+    }
+    items.clear();
+  }
+  if (!writer.finish())
+  {
+    return false;
+  }
+  stats_->snapshots.increment();
+  stats_->snapshotItems.getAndSet(writer.items());
+  LOG_INFO << "saved " << writer.items() << " items of " << writer.bytes() << " bytes to "
+           << options_.snapshotPath << " in " << timeDifference(Timestamp::now(), start) << " s";
+  return true;
+}
+
+bool MemcacheServer::loadSnapshot(int threads)
+{
+  assert(!options_.snapshotPath.empty());
+  const Timestamp start(Timestamp::now());
+  SnapshotReader reader(options_.snapshotPath);
+  if (!reader.valid())
+  {
+    return false;
+  }
+
+  AtomicInt64 loaded;
+  AtomicInt64 corrupt;
+  std::vector<std::unique_ptr<Thread>> loaders;
+  for (int i = 0; i < threads; ++i)
+  {
+    loaders.emplace_back(new Thread(std::bind(&MemcacheServer::loadBlocks, this, &reader,
+                                              i, threads, &loaded, &corrupt),
+                                    "snapshot-load"));
+    loaders.back()->start();
+  }
+  for (auto& loader : loaders)
+  {
+    loader->join();
+  }
+  LOG_INFO << "loaded " << loaded.get() << " items of " << reader.fileSize() << " bytes from "
+           << options_.snapshotPath << " in " << timeDifference(Timestamp::now(), start)
+           << " s with " << threads << " threads";
+  if (corrupt.get() > 0)
+  {
+    LOG_ERROR << corrupt.get() << " of " << reader.numBlocks() << " blocks are corrupt";
+  }
+  return corrupt.get() == 0;
+}
+
+void MemcacheServer::loadBlocks(const SnapshotReader* reader,
+                                size_t first,
+                                size_t step,
+                                AtomicInt64* loaded,
+                                AtomicInt64* corrupt)
+{
+  const time_t now = ::time(NULL);
+  int64_t items = 0;
+  for (size_t block = first; block < reader->numBlocks(); block += step)
+  {
+    bool good = reader->forEachRecord(block, [this, now, &items](const SnapshotReader::Record& record)
+    {
+      if (record.exptime != 0 && record.exptime <= now)
+      {
+        return;
+      }
+      ItemPtr item(newItem(record.key,
+                           record.flags,
+                           toRelativeExptime(record.exptime),
+                           record.value.size() + 2,
+                           0));
+      if (!item)
+      {
+        return;
+      }
+      item->append(record.value.data(), record.value.size());
+      item->append("\r\n", 2);
+      bool exists = false;
+      storeItem(item, Item::kSet, &exists);
+      ++items;
+    });
+    if (!good)
+    {
+      corrupt->increment();
+    }
+  }
+  loaded->add(items);
+}
+
+int MemcacheServer::toRelativeExptime(time_t exptime) const
+{
+  if (exptime == 0)
+  {
+    return 0;
+  }
+  else if (exptime < 0)
+  {
+    // expired already
+    return 1;
+  }
+  else if (exptime > kMaxRelativeExptime)
+  {
+    // unix time
+    return static_cast<int>(std::max<time_t>(exptime - startTime_, 1));
+  }
+  else
+  {
+    return currentTime() + static_cast<int>(exptime);
+  }
+}
+
+ItemPtr MemcacheServer::newItem(StringPiece key,
+                                uint32_t flags,
+                                int relExptime,
+                                int valuelen,
+                                uint64_t cas)
+{
+  if (!slabs_)
+  {
+    return Item::makeItem(key, flags, relExptime, valuelen, cas);
+  }
+
+  int cls = slabs_->slabClass(Item::totalSize(key.size(), valuelen));
+  if (cls < 0)
+  {
+    return ItemPtr();
+  }
+  ItemPtr item(Item::makeItem(slabs_.get(), cls, key, flags, relExptime, valuelen, cas));
+  for (int i = 0; !item && i < kMaxEvictionsPerItem && evict(cls); ++i)
+  {
+    item = Item::makeItem(slabs_.get(), cls, key, flags, relExptime, valuelen, cas);
+  }
+  if (!item)
+  {
+    stats_->outOfMemory.increment();
+  }
+  return item;
+}
+
 bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy policy, bool* exists)
 {
   assert(item->neededBytes() == 0);
-  MutexLock& mutex = shards_[item->hash() % kShards].mutex;
-  ItemMap& items = shards_[item->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  ItemMap::const_iterator it = items.find(item);
-  *exists = it != items.end();
+  if (policy == Item::kAppend || policy == Item::kPrepend)
+  {
+    return appendItem(item, policy == Item::kAppend, exists);
+  }
+
+  Shard& shard = shardOf(item->hash());
+  ItemIndex& items = shard.items;
+  MutexLockGuard lock(shard.mutex);
+  const Item* old = items.find(item->key(), item->hash());
+  if (old && old->isExpired(currentTime()))
+  {
+    stats_->expired.increment();
+    eraseLocked(shard, old);
+    old = NULL;
+  }
+  *exists = old != NULL;
   if (policy == Item::kSet)
   {
     item->setCas(g_cas.incrementAndGet());
     if (*exists)
     {
-      items.erase(it);
+      eraseLocked(shard, old);
     }
-    items.insert(item);
+    insertLocked(shard, item.get());
   }
   else
   {
@@ -69,7 +494,7 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
       else
       {
         item->setCas(g_cas.incrementAndGet());
-        items.insert(item);
+        insertLocked(shard, item.get());
       }
     }
     else if (policy == Item::kReplace)
@@ -77,39 +502,8 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
       if (*exists)
       {
         item->setCas(g_cas.incrementAndGet());
-        items.erase(it);
-        items.insert(item);
-      }
-      else
-      {
-        return false;
-      }
-    }
-    else if (policy == Item::kAppend || policy == Item::kPrepend)
-    {
-      if (*exists)
-      {
-        const ConstItemPtr& oldItem = *it;
-        int newLen = static_cast<int>(item->valueLength() + oldItem->valueLength() - 2);
-        ItemPtr newItem(Item::makeItem(item->key(),
-                                       oldItem->flags(),
-                                       oldItem->rel_exptime(),
-                                       newLen,
-                                       g_cas.incrementAndGet()));
-        if (policy == Item::kAppend)
-        {
-          newItem->append(oldItem->value(), oldItem->valueLength() - 2);
-          newItem->append(item->value(), item->valueLength());
-        }
-        else
-        {
-          newItem->append(item->value(), item->valueLength() - 2);
-          newItem->append(oldItem->value(), oldItem->valueLength());
-        }
-        assert(newItem->neededBytes() == 0);
-        assert(newItem->endsWithCRLF());
-        items.erase(it);
-        items.insert(newItem);
+        eraseLocked(shard, old);
+        insertLocked(shard, item.get());
       }
       else
       {
@@ -118,11 +512,11 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
     }
     else if (policy == Item::kCas)
     {
-      if (*exists && (*it)->cas() == item->cas())
+      if (*exists && old->cas() == item->cas())
       {
         item->setCas(g_cas.incrementAndGet());
-        items.erase(it);
-        items.insert(item);
+        eraseLocked(shard, old);
+        insertLocked(shard, item.get());
       }
       else
       {
@@ -137,21 +531,204 @@ bool MemcacheServer::storeItem(const ItemPtr& item, const Item::UpdatePolicy pol
   return true;
 }
 
-ConstItemPtr MemcacheServer::getItem(const ConstItemPtr& key) const
+bool MemcacheServer::appendItem(const ItemPtr& item, bool append, bool* exists)
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
-  const ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  ItemMap::const_iterator it = items.find(key);
-  return it != items.end() ? *it : ConstItemPtr();
+  // not a copy of HotKeys, it is compared with the one in the index below
+  uint64_t version = 0;
+  ConstItemPtr oldItem = findItem(item->key(), item->hash(), &version);
+  *exists = static_cast<bool>(oldItem);
+  if (!oldItem)
+  {
+    return false;
+  }
+
+  // without the lock of the shard, evicting locks others
+  int newLen = static_cast<int>(item->valueLength() + oldItem->valueLength() - 2);
+  ItemPtr newItem(this->newItem(item->key(),
+                                oldItem->flags(),
+                                oldItem->rel_exptime(),
+                                newLen,
+                                0));
+  if (!newItem)
+  {
+    return false;
+  }
+  if (append)
+  {
+    newItem->append(oldItem->value(), oldItem->valueLength() - 2);
+    newItem->append(item->value(), item->valueLength());
+  }
+  else
+  {
+    newItem->append(item->value(), item->valueLength() - 2);
+    newItem->append(oldItem->value(), oldItem->valueLength());
+  }
+  assert(newItem->neededBytes() == 0);
+  assert(newItem->endsWithCRLF());
+
+  Shard& shard = shardOf(item->hash());
+  MutexLockGuard lock(shard.mutex);
+  if (shard.items.find(item->key(), item->hash()) != oldItem.get())
+  {
+    // changed meanwhile
+    return false;
+  }
+  newItem->setCas(g_cas.incrementAndGet());
+  eraseLocked(shard, oldItem.get());
+  insertLocked(shard, newItem.get());
+  return true;
+}
+
+ConstItemPtr MemcacheServer::getItem(StringPiece key)
+{
+  const size_t hash = Item::hashKey(key);
+  HotKeys* hotKeys = t_hotKeys;
+  if (hotKeys)
+  {
+    const Shard& shard = shardOf(hash);
+    ConstItemPtr copy = hotKeys->find(key, hash, shard.version.load(std::memory_order_acquire));
+    // an expired one goes with the lock
+    if (copy && !copy->isExpired(currentTime()))
+    {
+      return copy;
+    }
+  }
+
+  uint64_t version = 0;
+  ConstItemPtr item = findItem(key, hash, &version);
+  if (hotKeys && item && hotKeys->count(hash) && hotKeys->insert(item, version))
+  {
+    stats_->hotKeyCopies.increment();
+  }
+  return item;
+}
+
+ConstItemPtr MemcacheServer::findItem(StringPiece key, size_t hash, uint64_t* version)
+{
+  Shard& shard = shardOf(hash);
+  MutexLockGuard lock(shard.mutex);
+  const Item* item = shard.items.find(key, hash);
+  if (!item)
+  {
+    return ConstItemPtr();
+  }
+  if (item->isExpired(currentTime()))
+  {
+    stats_->expired.increment();
+    eraseLocked(shard, item);
+    return ConstItemPtr();
+  }
+  item->touch();
+  *version = shard.version.load(std::memory_order_relaxed);
+  return ConstItemPtr(item);
+}
+
+bool MemcacheServer::deleteItem(StringPiece key)
+{
+  const size_t hash = Item::hashKey(key);
+  Shard& shard = shardOf(hash);
+  MutexLockGuard lock(shard.mutex);
+  const Item* item = shard.items.find(key, hash);
+  if (!item)
+  {
+    return false;
+  }
+  bool expired = item->isExpired(currentTime());
+  eraseLocked(shard, item);
+  return !expired;
+}
+
+void MemcacheServer::insertLocked(Shard& shard, const Item* item)
+{
+  shard.items.insert(item);
+  shard.version.fetch_add(1, std::memory_order_release);
+  if (slabs_)
+  {
+    clocks_[item->slabClass()]->insert(item);
+  }
+}
+
+void MemcacheServer::eraseLocked(Shard& shard, const Item* item)
+{
+  if (slabs_)
+  {
+    clocks_[item->slabClass()]->erase(item);
+  }
+  shard.items.erase(item);
+  shard.version.fetch_add(1, std::memory_order_release);
+}
+
+bool MemcacheServer::evict(int cls)
+{
+  ConstItemPtr victim = clocks_[cls]->pickVictim(currentTime());
+  if (!victim)
+  {
+    return false;
+  }
+  Shard& shard = shardOf(victim->hash());
+  MutexLockGuard lock(shard.mutex);
+  // it may have been replaced or deleted meanwhile
+  if (shard.items.find(victim->key(), victim->hash()) == victim.get())
+  {
+    if (victim->isExpired(currentTime()))
+    {
+      stats_->expired.increment();
+    }
+    else
+    {
+      stats_->evictions.increment();
+    }
+    eraseLocked(shard, victim.get());
+  }
+  // the memory goes back to slabs_ when the last reference goes,
+  // which may be a get in flight
+  return true;
+}
+
+void MemcacheServer::crawlExpired()
+{
+  loop_->assertInLoopThread();
+  const int now = currentTime();
+  for (int i = 0; i < kShardsPerCrawl; ++i)
+  {
+    Shard& shard = shards_[nextShardToCrawl_];
+    nextShardToCrawl_ = (nextShardToCrawl_ + 1) % kShards;
+    MutexLockGuard lock(shard.mutex);
+    size_t expired = shard.items.eraseIf([this, now](const Item* item)
+    {
+      if (!item->isExpired(now))
+      {
+        return false;
+      }
+      if (slabs_)
+      {
+        clocks_[item->slabClass()]->erase(item);
+      }
+      return true;
+    });
+    if (expired > 0)
+    {
+      shard.version.fetch_add(1, std::memory_order_release);
+    }
+    stats_->expired.add(static_cast<int64_t>(expired));
+  }
 }
 
-bool MemcacheServer::deleteItem(const ConstItemPtr& key)
+void MemcacheServer::appendStats(Buffer* out) const
 {
-  MutexLock& mutex = shards_[key->hash() % kShards].mutex;
-  ItemMap& items = shards_[key->hash() % kShards].items;
-  MutexLockGuard lock(mutex);
-  return items.erase(key) == 1;
+  LogStream stream;
+  stream << "STAT pid " << ::getpid() << "\r\n"
+         << "STAT uptime " << currentTime() << "\r\n"
+         << "STAT time " << ::time(NULL) << "\r\n"
+         << "STAT limit_maxbytes " << (slabs_ ? slabs_->limit() : 0) << "\r\n"
+         << "STAT total_malloced " << (slabs_ ? slabs_->allocatedBytes() : 0) << "\r\n"
+         << "STAT evictions " << stats_->evictions.get() << "\r\n"
+         << "STAT expired " << stats_->expired.get() << "\r\n"
+         << "STAT out_of_memory " << stats_->outOfMemory.get() << "\r\n"
+         << "STAT hot_key_copies " << stats_->hotKeyCopies.get() << "\r\n"
+         << "STAT snapshots " << stats_->snapshots.get() << "\r\n"
+         << "STAT snapshot_items " << stats_->snapshotItems.get() << "\r\n";
+  out->append(stream.buffer().data(), stream.buffer().length());
 }
 
 void MemcacheServer::onConnection(const TcpConnectionPtr& conn)
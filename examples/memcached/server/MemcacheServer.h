@@ -2,15 +2,20 @@
 #define MUDUO_EXAMPLES_MEMCACHED_SERVER_MEMCACHESERVER_H
 
 #include "examples/memcached/server/Item.h"
+#include "examples/memcached/server/ItemIndex.h"
 #include "examples/memcached/server/Session.h"
+#include "examples/memcached/server/SlabAllocator.h"
 
 #include "muduo/base/Mutex.h"
+#include "muduo/base/ThreadPool.h"
 #include "muduo/net/TcpServer.h"
 #include "examples/wordcount/hash.h"
 
 #include <array>
 #include <unordered_map>
-#include <unordered_set>
+
+class SnapshotReader;
+class UdpServer;
 
 class MemcacheServer : muduo::noncopyable
 {
@@ -19,69 +24,121 @@ class MemcacheServer : muduo::noncopyable
   {
     Options();
     uint16_t tcpport;
-    uint16_t udpport;
+    uint16_t udpport;  // 0 for no UDP
     uint16_t gperfport;
     int threads;
+    int memoryLimitMB;  // 0 for no limit
+    string snapshotPath;  // empty for no snapshot
+    int snapshotInterval;  // in seconds, 0 for at destruction only
   };
 
   MemcacheServer(muduo::net::EventLoop* loop, const Options&);
   ~MemcacheServer();
 
   void setThreadNum(int threads) { server_.setThreadNum(threads); }
+  // loads the snapshot, if any, before listening
   void start();
   void stop();
 
-  time_t startTime() const { return startTime_; }
+  // Blocking, of items in the index then, without stopping gets and
+  // stores, which lock shards one at a time.
+  bool saveSnapshot();
+  // items of the snapshot file, loaded with threads
+  bool loadSnapshot(int threads);
 
+  time_t startTime() const { return startTime_; }
+  // seconds since startTime()
+  int currentTime() const { return static_cast<int>(::time(NULL) - startTime_); }
+  // exptime of the protocol, relative or absolute, to currentTime() based
+  int toRelativeExptime(time_t exptime) const;
+
+  // with -m, evicts items to make room, NULL if that failed
+  ItemPtr newItem(muduo::StringPiece key,
+                  uint32_t flags,
+                  int relExptime,
+                  int valuelen,
+                  uint64_t cas);
   bool storeItem(const ItemPtr& item, Item::UpdatePolicy policy, bool* exists);
-  ConstItemPtr getItem(const ConstItemPtr& key) const;
-  bool deleteItem(const ConstItemPtr& key);
+  // in an I/O loop, the item may be a copy of the loop for a hot key
+  ConstItemPtr getItem(muduo::StringPiece key);
+  bool deleteItem(muduo::StringPiece key);
+
+  void appendStats(muduo::net::Buffer* out) const;
 
  private:
   void onConnection(const muduo::net::TcpConnectionPtr& conn);
+  void initLoop(muduo::net::EventLoop* loop);
 
   struct Stats;
+  struct Clock;
+  struct HotKeys;
 
   muduo::net::EventLoop* loop_;  // not own
   Options options_;
   const time_t startTime_;
+  // before items, which go back to it
+  std::unique_ptr<SlabAllocator> slabs_;
+  // one per slab class, items of the class in the order of insertion
+  std::vector<std::unique_ptr<Clock>> clocks_;
 
   mutable muduo::MutexLock mutex_;
   std::unordered_map<string, SessionPtr> sessions_ GUARDED_BY(mutex_);
+  // one per I/O loop, destructs after server_, which joins the loops
+  std::vector<std::unique_ptr<HotKeys>> hotKeys_ GUARDED_BY(mutex_);
+  // of the loop of this thread
+  static __thread HotKeys* t_hotKeys;
 
-  // a complicated solution to save memory
-  struct Hash
-  {
-    size_t operator()(const ConstItemPtr& x) const
-    {
-      return x->hash();
-    }
-  };
-
-  struct Equal
+  struct Shard
   {
-    bool operator()(const ConstItemPtr& x, const ConstItemPtr& y) const
+    Shard()
+      : version(0)
     {
-      return x->key() == y->key();
     }
-  };
-
-  typedef std::unordered_set<ConstItemPtr, Hash, Equal> ItemMap;
 
-  struct MapWithLock
-  {
-    ItemMap items;
+    ItemIndex items;
     mutable muduo::MutexLock mutex;
+    // bumped with the lock on every change of items
+    std::atomic<uint64_t> version;
   };
 
-  const static int kShards = 4096;
-
-  std::array<MapWithLock, kShards> shards_;
+  // the index uses low bits of the hash
+  Shard& shardOf(size_t hash)
+  {
+    return shards_[hash >> (sizeof(size_t) * 8 - kShardBits)];
+  }
+
+  // with the mutex of the shard, which is locked before the Clock
+  void insertLocked(Shard& shard, const Item* item);
+  void eraseLocked(Shard& shard, const Item* item);
+
+  // the item in the index, and the version of its shard
+  ConstItemPtr findItem(muduo::StringPiece key, size_t hash, uint64_t* version);
+
+  bool appendItem(const ItemPtr& item, bool append, bool* exists);
+  void requestSnapshot();
+  void loadBlocks(const SnapshotReader* reader,
+                  size_t first,
+                  size_t step,
+                  muduo::AtomicInt64* loaded,
+                  muduo::AtomicInt64* corrupt);
+  bool evict(int cls);
+  void crawlExpired();
+
+  const static int kShardBits = 12;
+  const static int kShards = 1 << kShardBits;
+
+  std::array<Shard, kShards> shards_;
+  int nextShardToCrawl_;  // in loop_
+  // of one thread, for saveSnapshot()
+  muduo::ThreadPool snapshotThread_;
+  std::atomic<bool> snapshotting_;
 
   // NOT guarded by mutex_, but here because server_ has to destructs before
   // sessions_
   muduo::net::TcpServer server_;
-  std::unique_ptr<Stats> stats_ PT_GUARDED_BY(mutex_);
+  std::unique_ptr<Stats> stats_;
+  // one per I/O loop, destructs before server_, which runs the loops
+  std::vector<std::unique_ptr<UdpServer>> udpServers_;
 };
 
 #endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_MEMCACHESERVER_H
@@ -8,13 +8,134 @@
 using namespace muduo;
 using namespace muduo::net;
 
-static bool isBinaryProtocol(uint8_t firstByte)
+namespace
 {
-  return firstByte == 0x80;
+
+// the binary protocol of memcached
+const uint8_t kRequestMagic = 0x80;
+const uint8_t kResponseMagic = 0x81;
+const size_t kBinaryHeaderSize = 24;
+
+enum Opcode
+{
+  kGet = 0x00,
+  kSet = 0x01,
+  kAdd = 0x02,
+  kReplace = 0x03,
+  kDelete = 0x04,
+  kQuit = 0x07,
+  kGetQ = 0x09,
+  kNoop = 0x0a,
+  kVersion = 0x0b,
+  kGetK = 0x0c,
+  kGetKQ = 0x0d,
+  kAppend = 0x0e,
+  kPrepend = 0x0f,
+  kStat = 0x10,
+  kSetQ = 0x11,
+  kAddQ = 0x12,
+  kReplaceQ = 0x13,
+  kDeleteQ = 0x14,
+  kQuitQ = 0x17,
+  kAppendQ = 0x19,
+  kPrependQ = 0x1a,
+};
+
+enum Status
+{
+  kNoError = 0x00,
+  kKeyNotFound = 0x01,
+  kKeyExists = 0x02,
+  kValueTooLarge = 0x03,
+  kInvalidArguments = 0x04,
+  kItemNotStored = 0x05,
+  kUnknownCommand = 0x81,
+  kOutOfMemory = 0x82,
+};
+
+bool isBinaryProtocol(uint8_t firstByte)
+{
+  return firstByte == kRequestMagic;
+}
+
+bool isQuiet(uint8_t opcode)
+{
+  switch (opcode)
+  {
+    case kGetQ:
+    case kGetKQ:
+    case kSetQ:
+    case kAddQ:
+    case kReplaceQ:
+    case kDeleteQ:
+    case kQuitQ:
+    case kAppendQ:
+    case kPrependQ:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint16_t readUint16(const char* p)
+{
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  return static_cast<uint16_t>(u[0] << 8 | u[1]);
+}
+
+uint32_t readUint32(const char* p)
+{
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  return static_cast<uint32_t>(u[0]) << 24 | static_cast<uint32_t>(u[1]) << 16
+      | static_cast<uint32_t>(u[2]) << 8 | u[3];
+}
+
+uint64_t readUint64(const char* p)
+{
+  return static_cast<uint64_t>(readUint32(p)) << 32 | readUint32(p + 4);
+}
+
+char* writeUint16(char* p, uint16_t x)
+{
+  p[0] = static_cast<char>(x >> 8);
+  p[1] = static_cast<char>(x);
+  return p + 2;
 }
 
+char* writeUint32(char* p, uint32_t x)
+{
+  return writeUint16(writeUint16(p, static_cast<uint16_t>(x >> 16)), static_cast<uint16_t>(x));
+}
+
+char* writeUint64(char* p, uint64_t x)
+{
+  return writeUint32(writeUint32(p, static_cast<uint32_t>(x >> 32)), static_cast<uint32_t>(x));
+}
+
+char* formatUint(char* p, uint64_t x)
+{
+  char digits[24];
+  char* d = digits;
+  do
+  {
+    *d++ = static_cast<char>('0' + x % 10);
+    x /= 10;
+  } while (x != 0);
+  while (d != digits)
+  {
+    *p++ = *--d;
+  }
+  return p;
+}
+
+}  // namespace
+
 const int kLongestKeySize = 250;
-string Session::kLongestKey(kLongestKeySize, 'x');
+const int kLargestValueSize = 1024 * 1024;
+// longer lines are get/gets of many keys, or garbage
+const size_t kLongestGetLine = 64 * 1024;
+// smaller values are copied into outputBuf_
+const size_t kSmallValueSize = 256;
 
 template <typename InputIterator, typename Token>
 bool Session::SpaceSeparator::operator()(InputIterator& next, InputIterator end, Token& tok)
@@ -76,7 +197,28 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
 
 {
   const size_t initialReadable = buf->readableBytes();
+  processInput(buf);
+  flush();
+  bytesRead_ += initialReadable - buf->readableBytes();
+}
+
+void Session::processDatagram(muduo::net::Buffer* buf)
+{
+  assert(!conn_);
+  assert(state_ == kNewCommand);
+  protocol_ = kAuto;
+  processInput(buf);
+  if (state_ != kNewCommand || buf->readableBytes() > 0)
+  {
+    LOG_DEBUG << "incomplete request in datagram";
+    resetRequest();
+    state_ = kNewCommand;
+    buf->retrieveAll();
+  }
+}
 
+void Session::processInput(muduo::net::Buffer* buf)
+{
   while (buf->readableBytes() > 0)
   {
     if (state_ == kNewCommand)
@@ -90,7 +232,36 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
       assert(protocol_ == kAscii || protocol_ == kBinary);
       if (protocol_ == kBinary)
       {
-        // FIXME
+        if (buf->readableBytes() < kBinaryHeaderSize)
+        {
+          break;
+        }
+        const char* header = buf->peek();
+        if (!isBinaryProtocol(static_cast<uint8_t>(header[0])))
+        {
+          LOG_ERROR << "bad magic " << static_cast<int>(static_cast<uint8_t>(header[0]));
+          buf->retrieveAll();
+          if (conn_)
+          {
+            conn_->forceClose();
+          }
+          break;
+        }
+        const uint32_t bodylen = readUint32(header + 8);
+        if (bodylen > kLargestValueSize + kLongestKeySize + 64)
+        {
+          binaryResponse(header, kValueTooLarge, "", "", "Too large.");
+          buf->retrieve(kBinaryHeaderSize);
+          bytesToDiscard_ = bodylen;
+          state_ = kDiscardValue;
+          continue;
+        }
+        if (buf->readableBytes() < kBinaryHeaderSize + bodylen)
+        {
+          break;
+        }
+        processBinaryRequest(header);
+        buf->retrieve(kBinaryHeaderSize + bodylen);
       }
       else  // ASCII protocol
       {
@@ -107,11 +278,16 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
         }
         else
         {
-          if (buf->readableBytes() > 1024)
+          StringPiece partial(buf->peek(), static_cast<int>(buf->readableBytes()));
+          const bool isGet = partial.starts_with("get ") || partial.starts_with("gets ");
+          if (buf->readableBytes() > (isGet ? kLongestGetLine : 1024))
           {
-            // FIXME: check for 'get' and 'gets'
-            conn_->shutdown();
-            // buf->retrieveAll() ???
+            flush();
+            if (conn_)
+            {
+              conn_->shutdown();
+            }
+            buf->retrieveAll();
           }
           break;
         }
@@ -130,7 +306,6 @@ void Session::onMessage(const muduo::net::TcpConnectionPtr& conn,
       assert(false);
     }
   }
-  bytesRead_ += initialReadable - buf->readableBytes();
 }
 
 void Session::receiveValue(muduo::net::Buffer* buf)
@@ -140,7 +315,7 @@ void Session::receiveValue(muduo::net::Buffer* buf)
   // if (protocol_ == kBinary)
 
   const size_t avail = std::min(buf->readableBytes(), currItem_->neededBytes());
-  assert(currItem_.unique());
+  assert(currItem_->unique());
   currItem_->append(buf->peek(), avail);
   buf->retrieve(avail);
   if (currItem_->neededBytes() == 0)
@@ -207,6 +382,20 @@ bool Session::processRequest(StringPiece request)
   assert(bytesToDiscard_ == 0);
   ++requestsProcessed_;
 
+  // no tokenizer for the most common, and possibly longest, requests
+  if (request.starts_with("get "))
+  {
+    request.remove_prefix(4);
+    doGet(request, false);
+    return true;
+  }
+  else if (request.starts_with("gets "))
+  {
+    request.remove_prefix(5);
+    doGet(request, true);
+    return true;
+  }
+
   // check 'noreply' at end of request line
   if (request.size() >= 8)
   {
@@ -236,41 +425,20 @@ bool Session::processRequest(StringPiece request)
   }
   else if (command_ == "get" || command_ == "gets")
   {
-    bool cas = command_ == "gets";
-
-    // FIXME: send multiple chunks with write complete callback.
-    while (beg != tok.end())
-    {
-      StringPiece key = *beg;
-      bool good = key.size() <= kLongestKeySize;
-      if (!good)
-      {
-        reply("CLIENT_ERROR bad command line format\r\n");
-        return true;
-      }
-
-      needle_->resetKey(key);
-      ConstItemPtr item = owner_->getItem(needle_);
-      ++beg;
-      if (item)
-      {
-        item->output(&outputBuf_, cas);
-      }
-    }
-    outputBuf_.append("END\r\n");
-
-    if (conn_->outputBuffer()->writableBytes() > 65536 + outputBuf_.readableBytes())
-    {
-      LOG_DEBUG << "shrink output buffer from " << conn_->outputBuffer()->internalCapacity();
-      conn_->outputBuffer()->shrink(65536 + outputBuf_.readableBytes());
-    }
-
-    conn_->send(&outputBuf_);
+    // without keys
+    reply("ERROR\r\n");
   }
   else if (command_ == "delete")
   {
     doDelete(beg, tok.end());
   }
+  else if (command_ == "stats")
+  {
+    Buffer stats;
+    owner_->appendStats(&stats);
+    stats.append("END\r\n");
+    appendOutput(stats.peek(), stats.readableBytes());
+  }
   else if (command_ == "version")
   {
 #ifdef HAVE_TCMALLOC
@@ -289,11 +457,16 @@ bool Session::processRequest(StringPiece request)
 #endif
   else if (command_ == "quit")
   {
-    conn_->shutdown();
+    if (conn_)
+    {
+      flush();
+      conn_->shutdown();
+    }
   }
-  else if (command_ == "shutdown")
+  else if (command_ == "shutdown" && conn_)
   {
     // "ERROR: shutdown not enabled"
+    flush();
     conn_->shutdown();
     owner_->stop();
   }
@@ -318,10 +491,144 @@ void Session::reply(muduo::StringPiece msg)
 {
   if (!noreply_)
   {
-    conn_->send(msg.data(), msg.size());
+    appendOutput(msg.data(), msg.size());
   }
 }
 
+void Session::doGet(StringPiece keys, bool cas)
+{
+  const size_t numPieces = pieces_.size();
+  const size_t numHeld = heldItems_.size();
+  const size_t outputLen = outputBuf_.readableBytes();
+  // appendOutput() may extend it
+  const size_t lastPieceLen = pieces_.empty() ? 0 : pieces_.back().len;
+  const size_t outputBytes = outputBytes_;
+
+  const char* p = keys.begin();
+  const char* end = keys.end();
+  while (p != end)
+  {
+    if (*p == ' ')
+    {
+      ++p;
+      continue;
+    }
+    const char* sp = static_cast<const char*>(memchr(p, ' ', end - p));
+    const char* keyEnd = sp ? sp : end;
+    StringPiece key(p, static_cast<int>(keyEnd - p));
+    p = keyEnd;
+    if (key.size() > kLongestKeySize)
+    {
+      // none of the values
+      pieces_.resize(numPieces);
+      if (!pieces_.empty())
+      {
+        pieces_.back().len = lastPieceLen;
+      }
+      heldItems_.resize(numHeld);
+      outputBytes_ = outputBytes;
+      outputBuf_.unwrite(outputBuf_.readableBytes() - outputLen);
+      reply("CLIENT_ERROR bad command line format\r\n");
+      return;
+    }
+
+    ConstItemPtr item = owner_->getItem(key);
+    if (item)
+    {
+      // VALUE <key> <flags> <bytes> [<cas unique>]\r\n
+      char header[kLongestKeySize + 64];
+      char* h = header;
+      memcpy(h, "VALUE ", 6);
+      h += 6;
+      memcpy(h, key.data(), key.size());
+      h += key.size();
+      *h++ = ' ';
+      h = formatUint(h, item->flags());
+      *h++ = ' ';
+      h = formatUint(h, item->valueLength() - 2);
+      if (cas)
+      {
+        *h++ = ' ';
+        h = formatUint(h, item->cas());
+      }
+      *h++ = '\r';
+      *h++ = '\n';
+      appendOutput(header, h - header);
+      // with the trailing CRLF
+      appendValue(item, item->value(), item->valueLength());
+    }
+  }
+  appendOutput("END\r\n", 5);
+}
+
+void Session::appendOutput(const char* data, size_t len)
+{
+  if (!pieces_.empty()
+      && pieces_.back().data == NULL
+      && pieces_.back().offset + pieces_.back().len == outputBuf_.readableBytes())
+  {
+    pieces_.back().len += len;
+  }
+  else
+  {
+    Piece piece = { NULL, outputBuf_.readableBytes(), len };
+    pieces_.push_back(piece);
+  }
+  outputBuf_.append(data, len);
+  outputBytes_ += len;
+}
+
+void Session::appendValue(const ConstItemPtr& item, const char* data, size_t len)
+{
+  if (len < kSmallValueSize)
+  {
+    appendOutput(data, len);
+    return;
+  }
+  Piece piece = { data, 0, len };
+  pieces_.push_back(piece);
+  outputBytes_ += len;
+  heldItems_.push_back(item);
+}
+
+void Session::flush()
+{
+  if (pieces_.empty() || !conn_)
+  {
+    return;
+  }
+  iov_.clear();
+  gatherOutput(&iov_);
+
+  if (conn_->outputBuffer()->writableBytes() > 65536 + outputBytes_)
+  {
+    LOG_DEBUG << "shrink output buffer from " << conn_->outputBuffer()->internalCapacity();
+    conn_->outputBuffer()->shrink(65536 + outputBytes_);
+  }
+
+  // copies what is not written, the items can go
+  conn_->sendv(iov_.data(), static_cast<int>(iov_.size()));
+  clearOutput();
+}
+
+void Session::gatherOutput(std::vector<struct iovec>* iov) const
+{
+  for (const Piece& piece : pieces_)
+  {
+    const char* data = piece.data ? piece.data : outputBuf_.peek() + piece.offset;
+    struct iovec vec = { const_cast<char*>(data), piece.len };
+    iov->push_back(vec);
+  }
+}
+
+void Session::clearOutput()
+{
+  pieces_.clear();
+  outputBytes_ = 0;
+  heldItems_.clear();
+  outputBuf_.retrieveAll();
+}
+
 bool Session::doUpdate(Session::Tokenizer::iterator& beg, Session::Tokenizer::iterator end)
 {
   if (command_ == "set")
@@ -352,20 +659,6 @@ bool Session::doUpdate(Session::Tokenizer::iterator& beg, Session::Tokenizer::it
   Reader r(beg, end);
   good = good && r.read(&flags) && r.read(&exptime) && r.read(&bytes);
 
-  int rel_exptime = static_cast<int>(exptime);
-  if (exptime > 60*60*24*30)
-  {
-    rel_exptime = static_cast<int>(exptime - owner_->startTime());
-    if (rel_exptime < 1)
-    {
-      rel_exptime = 1;
-    }
-  }
-  else
-  {
-    // rel_exptime = exptime + currentTime;
-  }
-
   if (good && policy_ == Item::kCas)
   {
     good = r.read(&cas);
@@ -379,18 +672,22 @@ bool Session::doUpdate(Session::Tokenizer::iterator& beg, Session::Tokenizer::it
   if (bytes > 1024*1024)
   {
     reply("SERVER_ERROR object too large for cache\r\n");
-    needle_->resetKey(key);
-    owner_->deleteItem(needle_);
-    bytesToDiscard_ = bytes + 2;
-    state_ = kDiscardValue;
-    return false;
   }
   else
   {
-    currItem_ = Item::makeItem(key, flags, rel_exptime, bytes + 2, cas);
-    state_ = kReceiveValue;
-    return false;
+    currItem_ = owner_->newItem(key, flags, owner_->toRelativeExptime(exptime), bytes + 2, cas);
+    if (currItem_)
+    {
+      state_ = kReceiveValue;
+      return false;
+    }
+    reply("SERVER_ERROR out of memory storing object\r\n");
   }
+  // the old value is gone, as in memcached
+  owner_->deleteItem(key);
+  bytesToDiscard_ = bytes + 2;
+  state_ = kDiscardValue;
+  return false;
 }
 
 void Session::doDelete(Session::Tokenizer::iterator& beg, Session::Tokenizer::iterator end)
@@ -410,8 +707,7 @@ void Session::doDelete(Session::Tokenizer::iterator& beg, Session::Tokenizer::it
   }
   else
   {
-    needle_->resetKey(key);
-    if (owner_->deleteItem(needle_))
+    if (owner_->deleteItem(key))
     {
       reply("DELETED\r\n");
     }
@@ -421,3 +717,260 @@ void Session::doDelete(Session::Tokenizer::iterator& beg, Session::Tokenizer::it
     }
   }
 }
+
+void Session::processBinaryRequest(const char* header)
+{
+  ++requestsProcessed_;
+  const uint8_t opcode = static_cast<uint8_t>(header[1]);
+  const uint16_t keylen = readUint16(header + 2);
+  const uint8_t extlen = static_cast<uint8_t>(header[4]);
+  const uint32_t bodylen = readUint32(header + 8);
+  if (implicit_cast<size_t>(keylen) + extlen > bodylen || keylen > kLongestKeySize)
+  {
+    binaryResponse(header, kInvalidArguments, "", "", "Invalid arguments");
+    return;
+  }
+
+  const char* body = header + kBinaryHeaderSize;
+  StringPiece extras(body, extlen);
+  StringPiece key(body + extlen, keylen);
+  StringPiece value(body + extlen + keylen, static_cast<int>(bodylen - extlen - keylen));
+  switch (opcode)
+  {
+    case kGet:
+    case kGetQ:
+    case kGetK:
+    case kGetKQ:
+      doBinaryGet(header, key);
+      break;
+    case kSet:
+    case kSetQ:
+    case kAdd:
+    case kAddQ:
+    case kReplace:
+    case kReplaceQ:
+    case kAppend:
+    case kAppendQ:
+    case kPrepend:
+    case kPrependQ:
+      doBinaryUpdate(header, key, extras, value);
+      break;
+    case kDelete:
+    case kDeleteQ:
+      if (key.empty() || !extras.empty())
+      {
+        binaryResponse(header, kInvalidArguments, "", "", "Invalid arguments");
+      }
+      else if (owner_->deleteItem(key))
+      {
+        binaryResponse(header, kNoError, "", "", "");
+      }
+      else
+      {
+        binaryResponse(header, kKeyNotFound, "", "", "Not found");
+      }
+      break;
+    case kNoop:
+      binaryResponse(header, kNoError, "", "", "");
+      break;
+    case kVersion:
+      binaryResponse(header, kNoError, "", "", "0.01 muduo");
+      break;
+    case kStat:
+      doBinaryStats(header);
+      break;
+    case kQuit:
+    case kQuitQ:
+      binaryResponse(header, kNoError, "", "", "");
+      if (conn_)
+      {
+        flush();
+        conn_->shutdown();
+      }
+      break;
+    default:
+      LOG_INFO << "Unknown binary command: " << static_cast<int>(opcode);
+      binaryResponse(header, kUnknownCommand, "", "", "Unknown command");
+      break;
+  }
+}
+
+void Session::doBinaryGet(const char* header, StringPiece key)
+{
+  const uint8_t opcode = static_cast<uint8_t>(header[1]);
+  const bool withKey = opcode == kGetK || opcode == kGetKQ;
+  if (key.empty())
+  {
+    binaryResponse(header, kInvalidArguments, "", "", "Invalid arguments");
+    return;
+  }
+
+  ConstItemPtr item = owner_->getItem(key);
+  if (item)
+  {
+    // without the trailing CRLF
+    const size_t valuelen = item->valueLength() - 2;
+    const size_t keylen = withKey ? key.size() : 0;
+    char flags[4];
+    writeUint32(flags, item->flags());
+    binaryHeader(header, kNoError, sizeof flags, keylen,
+                 sizeof flags + keylen + valuelen, item->cas());
+    appendOutput(flags, sizeof flags);
+    appendOutput(key.data(), keylen);
+    appendValue(item, item->value(), valuelen);
+  }
+  else if (!isQuiet(opcode))
+  {
+    // misses of GetQ and GetKQ are not told
+    binaryResponse(header, kKeyNotFound, "", withKey ? key : StringPiece(), "Not found");
+  }
+}
+
+void Session::doBinaryUpdate(const char* header, StringPiece key,
+                             StringPiece extras, StringPiece value)
+{
+  const uint8_t opcode = static_cast<uint8_t>(header[1]);
+  const uint64_t cas = readUint64(header + 16);
+  Item::UpdatePolicy policy = Item::kInvalid;
+  switch (opcode)
+  {
+    case kSet:
+    case kSetQ:
+      policy = cas ? Item::kCas : Item::kSet;
+      break;
+    case kAdd:
+    case kAddQ:
+      policy = Item::kAdd;
+      break;
+    case kReplace:
+    case kReplaceQ:
+      policy = cas ? Item::kCas : Item::kReplace;
+      break;
+    case kAppend:
+    case kAppendQ:
+      policy = Item::kAppend;
+      break;
+    case kPrepend:
+    case kPrependQ:
+      policy = Item::kPrepend;
+      break;
+    default:
+      assert(false);
+  }
+
+  // flags and exptime, but for append and prepend
+  const bool withExtras = policy != Item::kAppend && policy != Item::kPrepend;
+  if (key.empty() || extras.size() != (withExtras ? 8 : 0))
+  {
+    binaryResponse(header, kInvalidArguments, "", "", "Invalid arguments");
+    return;
+  }
+  if (value.size() > kLargestValueSize)
+  {
+    owner_->deleteItem(key);
+    binaryResponse(header, kValueTooLarge, "", "", "Too large.");
+    return;
+  }
+
+  const uint32_t flags = withExtras ? readUint32(extras.data()) : 0;
+  const time_t exptime = withExtras ? readUint32(extras.data() + 4) : 0;
+  // values end with CRLF, as of the ASCII protocol
+  ItemPtr item = owner_->newItem(key, flags, owner_->toRelativeExptime(exptime),
+                                 value.size() + 2, cas);
+  if (!item)
+  {
+    // the old value is gone, as in memcached
+    owner_->deleteItem(key);
+    binaryResponse(header, kOutOfMemory, "", "", "Out of memory");
+    return;
+  }
+  item->append(value.data(), value.size());
+  item->append("\r\n", 2);
+
+  bool exists = false;
+  if (owner_->storeItem(item, policy, &exists))
+  {
+    // append and prepend store a new item of their own
+    binaryResponse(header, kNoError, "", "", "", withExtras ? item->cas() : 0);
+  }
+  else if (policy == Item::kCas)
+  {
+    binaryResponse(header, exists ? kKeyExists : kKeyNotFound, "", "",
+                   exists ? "Data exists for key." : "Not found");
+  }
+  else if (policy == Item::kAdd)
+  {
+    binaryResponse(header, kKeyExists, "", "", "Data exists for key.");
+  }
+  else if (policy == Item::kReplace)
+  {
+    binaryResponse(header, kKeyNotFound, "", "", "Not found");
+  }
+  else
+  {
+    binaryResponse(header, kItemNotStored, "", "", "Not stored.");
+  }
+}
+
+void Session::doBinaryStats(const char* header)
+{
+  // one response per "STAT name value" line, and an empty one to end
+  Buffer stats;
+  owner_->appendStats(&stats);
+  const char* crlf = NULL;
+  while ((crlf = stats.findCRLF()) != NULL)
+  {
+    StringPiece line(stats.peek(), static_cast<int>(crlf - stats.peek()));
+    if (line.starts_with("STAT "))
+    {
+      line.remove_prefix(5);
+      const char* sp = static_cast<const char*>(memchr(line.data(), ' ', line.size()));
+      if (sp)
+      {
+        StringPiece name(line.data(), static_cast<int>(sp - line.data()));
+        StringPiece value(sp + 1, static_cast<int>(line.end() - sp - 1));
+        binaryResponse(header, kNoError, "", name, value);
+      }
+    }
+    stats.retrieveUntil(crlf + 2);
+  }
+  binaryResponse(header, kNoError, "", "", "");
+}
+
+void Session::binaryHeader(const char* header,
+                           uint16_t status,
+                           size_t extlen,
+                           size_t keylen,
+                           size_t bodylen,
+                           uint64_t cas)
+{
+  char response[kBinaryHeaderSize];
+  response[0] = static_cast<char>(kResponseMagic);
+  response[1] = header[1];
+  writeUint16(response + 2, static_cast<uint16_t>(keylen));
+  response[4] = static_cast<char>(extlen);
+  response[5] = 0;  // data type
+  writeUint16(response + 6, status);
+  writeUint32(response + 8, static_cast<uint32_t>(bodylen));
+  memcpy(response + 12, header + 12, 4);  // opaque
+  writeUint64(response + 16, cas);
+  appendOutput(response, sizeof response);
+}
+
+void Session::binaryResponse(const char* header,
+                             uint16_t status,
+                             StringPiece extras,
+                             StringPiece key,
+                             StringPiece value,
+                             uint64_t cas)
+{
+  if (status == kNoError && isQuiet(static_cast<uint8_t>(header[1])))
+  {
+    return;
+  }
+  binaryHeader(header, status, extras.size(), key.size(),
+               extras.size() + key.size() + value.size(), cas);
+  appendOutput(extras.data(), extras.size());
+  appendOutput(key.data(), key.size());
+  appendOutput(value.data(), value.size());
+}
@@ -9,6 +9,10 @@
 
 #include <boost/tokenizer.hpp>
 
+#include <vector>
+
+#include <sys/uio.h>
+
 using muduo::string;
 
 class MemcacheServer;
@@ -21,11 +25,11 @@ class Session : public std::enable_shared_from_this<Session>,
     : owner_(owner),
       conn_(conn),
       state_(kNewCommand),
-      protocol_(kAscii), // FIXME
+      protocol_(kAuto),
       noreply_(false),
       policy_(Item::kInvalid),
       bytesToDiscard_(0),
-      needle_(Item::makeItem(kLongestKey, 0, 0, 2, 0)),
+      outputBytes_(0),
       bytesRead_(0),
       requestsProcessed_(0)
   {
@@ -37,13 +41,38 @@ class Session : public std::enable_shared_from_this<Session>,
         std::bind(&Session::onMessage, this, _1, _2, _3));
   }
 
+  // without connection, for requests in datagrams
+  explicit Session(MemcacheServer* owner)
+    : owner_(owner),
+      state_(kNewCommand),
+      protocol_(kAuto),
+      noreply_(false),
+      policy_(Item::kInvalid),
+      bytesToDiscard_(0),
+      outputBytes_(0),
+      bytesRead_(0),
+      requestsProcessed_(0)
+  {
+  }
+
   ~Session()
   {
-    LOG_INFO << "requests processed: " << requestsProcessed_
-             << " input buffer size: " << conn_->inputBuffer()->internalCapacity()
-             << " output buffer size: " << conn_->outputBuffer()->internalCapacity();
+    if (conn_)
+    {
+      LOG_INFO << "requests processed: " << requestsProcessed_
+               << " input buffer size: " << conn_->inputBuffer()->internalCapacity()
+               << " output buffer size: " << conn_->outputBuffer()->internalCapacity();
+    }
   }
 
+  // Without connection only, processes buf as a whole, a request does not
+  // go across datagrams.  The output stays until clearOutput().
+  void processDatagram(muduo::net::Buffer* buf);
+  size_t outputBytes() const { return outputBytes_; }
+  // valid until the next call of any other member function
+  void gatherOutput(std::vector<struct iovec>* iov) const;
+  void clearOutput();
+
  private:
   enum State
   {
@@ -62,6 +91,7 @@ class Session : public std::enable_shared_from_this<Session>,
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
                  muduo::net::Buffer* buf,
                  muduo::Timestamp);
+  void processInput(muduo::net::Buffer* buf);
   void onWriteComplete(const muduo::net::TcpConnectionPtr& conn);
   void receiveValue(muduo::net::Buffer* buf);
   void discardValue(muduo::net::Buffer* buf);
@@ -72,6 +102,36 @@ class Session : public std::enable_shared_from_this<Session>,
   bool processRequest(muduo::StringPiece request);
   void resetRequest();
   void reply(muduo::StringPiece msg);
+  // keys separated by spaces
+  void doGet(muduo::StringPiece keys, bool cas);
+
+  // header and body of one request in buf
+  void processBinaryRequest(const char* header);
+  void doBinaryGet(const char* header, muduo::StringPiece key);
+  void doBinaryUpdate(const char* header, muduo::StringPiece key,
+                      muduo::StringPiece extras, muduo::StringPiece value);
+  void doBinaryStats(const char* header);
+  // to the request of header
+  void binaryHeader(const char* header,
+                    uint16_t status,
+                    size_t extlen,
+                    size_t keylen,
+                    size_t bodylen,
+                    uint64_t cas);
+  // none for success of quiet commands
+  void binaryResponse(const char* header,
+                      uint16_t status,
+                      muduo::StringPiece extras,
+                      muduo::StringPiece key,
+                      muduo::StringPiece value,
+                      uint64_t cas = 0);
+
+  // Responses of one onMessage() go out in one writev(), large values
+  // are sent from the items, which are held until then.  flush() does
+  // nothing without connection.
+  void appendOutput(const char* data, size_t len);
+  void appendValue(const ConstItemPtr& item, const char* data, size_t len);
+  void flush();
 
   struct SpaceSeparator
   {
@@ -88,7 +148,7 @@ class Session : public std::enable_shared_from_this<Session>,
   void doDelete(Tokenizer::iterator& beg, Tokenizer::iterator end);
 
   MemcacheServer* owner_;
-  muduo::net::TcpConnectionPtr conn_;
+  muduo::net::TcpConnectionPtr conn_;  // NULL for datagrams
   State state_;
   Protocol protocol_;
 
@@ -98,15 +158,23 @@ class Session : public std::enable_shared_from_this<Session>,
   Item::UpdatePolicy policy_;
   ItemPtr currItem_;
   size_t bytesToDiscard_;
-  // cached
-  ItemPtr needle_;
+
+  // output of requests processed so far
+  struct Piece
+  {
+    const char* data;  // NULL for outputBuf_
+    size_t offset;     // in outputBuf_
+    size_t len;
+  };
   muduo::net::Buffer outputBuf_;
+  std::vector<Piece> pieces_;
+  size_t outputBytes_;
+  std::vector<ConstItemPtr> heldItems_;
+  std::vector<struct iovec> iov_;
 
   // per session stats
   size_t bytesRead_;
   size_t requestsProcessed_;
-
-  static string kLongestKey;
 };
 
 typedef std::shared_ptr<Session> SessionPtr;
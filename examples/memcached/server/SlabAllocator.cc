@@ -0,0 +1,131 @@
+#include "examples/memcached/server/SlabAllocator.h"
+
+#include "muduo/base/Logging.h"
+
+#include <algorithm>
+
+#include <stdlib.h>
+
+using namespace muduo;
+
+const size_t SlabAllocator::kPageSize;
+const size_t SlabAllocator::kMinChunkSize;
+const size_t SlabAllocator::kMaxChunkSize;
+
+struct SlabAllocator::SlabClass
+{
+  explicit SlabClass(size_t size)
+    : chunkSize(size),
+      pageSize(std::max(size, kPageSize) / size * size),
+      numPages(0),
+      freeList(NULL)
+  {
+  }
+
+  const size_t chunkSize;
+  const size_t pageSize;
+  MutexLock mutex;
+  int numPages GUARDED_BY(mutex);
+  // linked through the first word of free chunks
+  void* freeList GUARDED_BY(mutex);
+};
+
+SlabAllocator::SlabAllocator(size_t limitBytes, double factor)
+  : limit_(limitBytes),
+    allocated_(0)
+{
+  assert(factor > 1.0);
+  size_t size = kMinChunkSize;
+  while (size <= kPageSize / 2)
+  {
+    classes_.emplace_back(new SlabClass(size));
+    size_t next = static_cast<size_t>(static_cast<double>(size) * factor);
+    // 8-byte aligned
+    size = std::max(size + 8, (next + 7) & ~static_cast<size_t>(7));
+  }
+  classes_.emplace_back(new SlabClass(kMaxChunkSize));
+  LOG_INFO << "SlabAllocator " << classes_.size() << " classes, limit " << limit_;
+}
+
+SlabAllocator::~SlabAllocator()
+{
+  for (char* page : pages_)
+  {
+    ::free(page);
+  }
+}
+
+int SlabAllocator::slabClass(size_t bytes) const
+{
+  // few classes, binary search is not worth it
+  for (size_t i = 0; i < classes_.size(); ++i)
+  {
+    if (bytes <= classes_[i]->chunkSize)
+    {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+size_t SlabAllocator::chunkSize(int cls) const
+{
+  return classes_[cls]->chunkSize;
+}
+
+void* SlabAllocator::allocate(int cls)
+{
+  SlabClass* sc = classes_[cls].get();
+  MutexLockGuard lock(sc->mutex);
+  if (!sc->freeList && !newPage(sc))
+  {
+    return NULL;
+  }
+  void* chunk = sc->freeList;
+  sc->freeList = *static_cast<void**>(chunk);
+  return chunk;
+}
+
+void SlabAllocator::deallocate(void* chunk, int cls)
+{
+  SlabClass* sc = classes_[cls].get();
+  MutexLockGuard lock(sc->mutex);
+  *static_cast<void**>(chunk) = sc->freeList;
+  sc->freeList = chunk;
+}
+
+size_t SlabAllocator::allocatedBytes() const
+{
+  MutexLockGuard lock(mutex_);
+  return allocated_;
+}
+
+bool SlabAllocator::newPage(SlabClass* sc)
+{
+  char* page = NULL;
+  {
+    MutexLockGuard lock(mutex_);
+    // the first page of a class goes past the limit, as in memcached,
+    // otherwise a class could have neither memory nor items to evict
+    if (limit_ > 0 && allocated_ + sc->pageSize > limit_ && sc->numPages > 0)
+    {
+      return false;
+    }
+    page = static_cast<char*>(::malloc(sc->pageSize));
+    if (!page)
+    {
+      return false;
+    }
+    pages_.push_back(page);
+    allocated_ += sc->pageSize;
+  }
+  ++sc->numPages;
+
+  for (size_t offset = 0; offset + sc->chunkSize <= sc->pageSize; offset += sc->chunkSize)
+  {
+    void* chunk = page + offset;
+    *static_cast<void**>(chunk) = sc->freeList;
+    sc->freeList = chunk;
+  }
+  return true;
+}
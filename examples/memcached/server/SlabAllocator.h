@@ -0,0 +1,54 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
+
+#include "muduo/base/Mutex.h"
+
+#include <memory>
+#include <vector>
+
+// Memory of items, as in memcached: pages are cut into chunks of one size,
+// one size per slab class, sizes growing by a factor from class to class.
+//
+// Pages are allocated on demand until the limit, and stay with their class.
+// Past the limit, a class gets chunks only from items freed, so the caller
+// evicts items of that class to make room.  Every class gets one page even
+// past the limit.
+class SlabAllocator : muduo::noncopyable
+{
+ public:
+  static const size_t kPageSize = 1024 * 1024;
+  static const size_t kMinChunkSize = 96;
+  // values of 1MiB, keys of 250 bytes
+  static const size_t kMaxChunkSize = kPageSize + 512;
+
+  explicit SlabAllocator(size_t limitBytes, double factor = 1.25);
+  ~SlabAllocator();
+
+  int numClasses() const { return static_cast<int>(classes_.size()); }
+
+  // -1 if larger than kMaxChunkSize
+  int slabClass(size_t bytes) const;
+
+  size_t chunkSize(int cls) const;
+
+  // NULL if the class has no free chunk and the limit is reached
+  void* allocate(int cls);
+  void deallocate(void* chunk, int cls);
+
+  size_t limit() const { return limit_; }
+  size_t allocatedBytes() const;
+
+ private:
+  struct SlabClass;
+
+  bool newPage(SlabClass* sc);
+
+  const size_t limit_;
+  std::vector<std::unique_ptr<SlabClass>> classes_;
+
+  mutable muduo::MutexLock mutex_;
+  std::vector<char*> pages_ GUARDED_BY(mutex_);
+  size_t allocated_ GUARDED_BY(mutex_);
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_SLABALLOCATOR_H
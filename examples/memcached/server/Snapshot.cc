@@ -0,0 +1,165 @@
+#include "examples/memcached/server/Snapshot.h"
+
+#include "muduo/base/Logging.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+
+SnapshotWriter::SnapshotWriter(const string& path)
+  : path_(path),
+    tmpPath_(path + ".tmp"),
+    blockItems_(0),
+    items_(0),
+    bytes_(0)
+{
+  // AppendFile appends
+  ::unlink(tmpPath_.c_str());
+  file_.reset(new FileUtil::AppendFile(tmpPath_));
+  file_->append(snapshot::kHeader, snapshot::kHeaderSize);
+  bytes_ += snapshot::kHeaderSize;
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+  if (file_)
+  {
+    file_.reset();
+    ::unlink(tmpPath_.c_str());
+  }
+}
+
+void SnapshotWriter::add(StringPiece key, uint32_t flags, int64_t exptime, StringPiece value)
+{
+  assert(key.size() <= 255);
+  char header[snapshot::kRecordHeaderSize];
+  const uint32_t valuelen = static_cast<uint32_t>(value.size());
+  header[0] = static_cast<char>(key.size());
+  memcpy(header + 1, &flags, sizeof flags);
+  memcpy(header + 5, &valuelen, sizeof valuelen);
+  memcpy(header + 9, &exptime, sizeof exptime);
+  block_.append(header, sizeof header);
+  block_.append(key.data(), key.size());
+  block_.append(value.data(), value.size());
+  ++blockItems_;
+  ++items_;
+  if (block_.readableBytes() >= kBlockSize)
+  {
+    writeBlock();
+  }
+}
+
+void SnapshotWriter::writeBlock()
+{
+  uint32_t header[4] = { snapshot::kBlockMagic,
+                         blockItems_,
+                         static_cast<uint32_t>(block_.readableBytes()),
+                         crc32c::value(block_.peek(), block_.readableBytes()) };
+  file_->append(reinterpret_cast<const char*>(header), sizeof header);
+  file_->append(block_.peek(), block_.readableBytes());
+  bytes_ += static_cast<int64_t>(sizeof header + block_.readableBytes());
+  block_.retrieveAll();
+  blockItems_ = 0;
+}
+
+bool SnapshotWriter::finish()
+{
+  assert(file_);
+  if (blockItems_ > 0)
+  {
+    writeBlock();
+  }
+  // the end
+  writeBlock();
+  file_->flush();
+  const bool written = file_->writtenBytes() == bytes_;
+  file_.reset();
+  if (!written)
+  {
+    LOG_ERROR << "SnapshotWriter wrote " << bytes_ << " bytes of " << tmpPath_ << " partly";
+    ::unlink(tmpPath_.c_str());
+    return false;
+  }
+
+  int fd = ::open(tmpPath_.c_str(), O_RDONLY | O_CLOEXEC);
+  const bool synced = fd >= 0 && ::fsync(fd) == 0;
+  if (fd >= 0)
+  {
+    ::close(fd);
+  }
+  if (!synced || ::rename(tmpPath_.c_str(), path_.c_str()) != 0)
+  {
+    LOG_SYSERR << "SnapshotWriter " << tmpPath_;
+    ::unlink(tmpPath_.c_str());
+    return false;
+  }
+  return true;
+}
+
+SnapshotReader::SnapshotReader(const string& path)
+  : data_(NULL),
+    size_(0),
+    valid_(false)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(snapshot::kHeaderSize))
+  {
+    size_ = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      data_ = static_cast<const char*>(addr);
+      // blocks are read by threads at once
+      ::madvise(addr, size_, MADV_WILLNEED);
+    }
+  }
+  ::close(fd);
+  if (!data_ || memcmp(data_, snapshot::kHeader, snapshot::kHeaderSize) != 0)
+  {
+    LOG_ERROR << "SnapshotReader " << path << " is not a snapshot";
+    return;
+  }
+
+  size_t offset = snapshot::kHeaderSize;
+  while (offset + snapshot::kBlockHeaderSize <= size_)
+  {
+    uint32_t header[4];
+    memcpy(header, data_ + offset, sizeof header);
+    if (header[0] != snapshot::kBlockMagic)
+    {
+      break;
+    }
+    if (header[1] == 0 && header[2] == 0)
+    {
+      valid_ = offset + snapshot::kBlockHeaderSize == size_;
+      break;
+    }
+    if (header[2] > size_ - offset - snapshot::kBlockHeaderSize)
+    {
+      break;
+    }
+    blocks_.push_back(data_ + offset);
+    offset += snapshot::kBlockHeaderSize + header[2];
+  }
+  if (!valid_)
+  {
+    LOG_ERROR << "SnapshotReader " << path << " is truncated or corrupt at " << offset;
+  }
+}
+
+SnapshotReader::~SnapshotReader()
+{
+  if (data_)
+  {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
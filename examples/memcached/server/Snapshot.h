@@ -0,0 +1,149 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_SNAPSHOT_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_SNAPSHOT_H
+
+#include "muduo/base/Crc32c.h"
+#include "muduo/base/FileUtil.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/Buffer.h"
+
+#include <memory>
+#include <vector>
+
+#include <string.h>
+
+// Items in a file, for warm restarts.  Blocks of items have checksums of
+// their own, so they load in parallel.  Integers are in the byte order of
+// the host.
+//
+//   header  "MCSNAP01"                  8 bytes
+//   block   magic "MCBK", items, bytes,  4 x uint32
+//           crc32c of the records
+//           records                     bytes
+//   ...
+//   end     a block of no items
+//
+//   record  keylen uint8, flags uint32, valuelen uint32,
+//           exptime int64 in unix time or 0, key, value without CRLF
+namespace snapshot
+{
+
+const char kHeader[] = "MCSNAP01";
+const size_t kHeaderSize = 8;
+const uint32_t kBlockMagic = 0x4B42434D;  // "MCBK"
+const size_t kBlockHeaderSize = 16;
+const size_t kRecordHeaderSize = 17;
+
+}  // namespace snapshot
+
+// Writes path.tmp, renamed to path by finish().
+class SnapshotWriter : muduo::noncopyable
+{
+ public:
+  explicit SnapshotWriter(const muduo::string& path);
+  // removes path.tmp if not finished
+  ~SnapshotWriter();
+
+  void add(muduo::StringPiece key, uint32_t flags, int64_t exptime, muduo::StringPiece value);
+
+  // syncs and renames, false on errors
+  bool finish();
+
+  int64_t items() const { return items_; }
+  int64_t bytes() const { return file_ ? file_->writtenBytes() : bytes_; }
+
+ private:
+  static const size_t kBlockSize = 1024 * 1024;
+
+  void writeBlock();
+
+  const muduo::string path_;
+  const muduo::string tmpPath_;
+  std::unique_ptr<muduo::FileUtil::AppendFile> file_;
+  muduo::net::Buffer block_;
+  uint32_t blockItems_;
+  int64_t items_;
+  int64_t bytes_;  // expected in file_
+};
+
+// Memory maps a snapshot, and finds its blocks.
+class SnapshotReader : muduo::noncopyable
+{
+ public:
+  struct Record
+  {
+    muduo::StringPiece key;
+    uint32_t flags;
+    int64_t exptime;
+    muduo::StringPiece value;
+  };
+
+  explicit SnapshotReader(const muduo::string& path);
+  ~SnapshotReader();
+
+  // the file is there, and its blocks end well
+  bool valid() const { return valid_; }
+  size_t numBlocks() const { return blocks_.size(); }
+  size_t fileSize() const { return size_; }
+
+  // calls func for each record of a block whose checksum matches,
+  // returns false for a corrupt block, of which none is passed
+  template<typename Func>
+  bool forEachRecord(size_t block, Func func) const
+  {
+    const char* p = blocks_[block];
+    uint32_t header[4];
+    memcpy(header, p, sizeof header);
+    const uint32_t items = header[1];
+    const uint32_t bytes = header[2];
+    p += snapshot::kBlockHeaderSize;
+    if (muduo::crc32c::value(p, bytes) != header[3])
+    {
+      return false;
+    }
+
+    // checked before any is passed
+    const char* end = p + bytes;
+    const char* q = p;
+    for (uint32_t i = 0; i < items; ++i)
+    {
+      if (q + snapshot::kRecordHeaderSize > end)
+        return false;
+      uint32_t valuelen = 0;
+      memcpy(&valuelen, q + 5, sizeof valuelen);
+      const size_t len = snapshot::kRecordHeaderSize + static_cast<uint8_t>(q[0]) + valuelen;
+      if (len > static_cast<size_t>(end - q))
+        return false;
+      q += len;
+    }
+    if (q != end)
+    {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < items; ++i)
+    {
+      Record record;
+      const uint8_t keylen = static_cast<uint8_t>(p[0]);
+      uint32_t valuelen = 0;
+      memcpy(&record.flags, p + 1, sizeof record.flags);
+      memcpy(&valuelen, p + 5, sizeof valuelen);
+      memcpy(&record.exptime, p + 9, sizeof record.exptime);
+      p += snapshot::kRecordHeaderSize;
+      record.key = muduo::StringPiece(p, keylen);
+      p += keylen;
+      record.value = muduo::StringPiece(p, static_cast<int>(valuelen));
+      p += valuelen;
+      func(record);
+    }
+    return true;
+  }
+
+ private:
+  const char* data_;
+  size_t size_;
+  std::vector<const char*> blocks_;
+  bool valid_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_SNAPSHOT_H
@@ -0,0 +1,234 @@
+#include "examples/memcached/server/UdpServer.h"
+#include "examples/memcached/server/MemcacheServer.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <limits.h>  // IOV_MAX
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+int createNonblockingUdp(sa_family_t family)
+{
+  int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+  if (sockfd < 0)
+  {
+    LOG_SYSFATAL << "::socket";
+  }
+  return sockfd;
+}
+
+uint16_t readUint16(const char* p)
+{
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  return static_cast<uint16_t>(u[0] << 8 | u[1]);
+}
+
+void writeUint16(char* p, size_t x)
+{
+  p[0] = static_cast<char>(x >> 8);
+  p[1] = static_cast<char>(x);
+}
+
+}  // namespace
+
+UdpServer::UdpServer(MemcacheServer* owner,
+                     EventLoop* loop,
+                     const InetAddress& listenAddr)
+  : loop_(loop),
+    socket_(createNonblockingUdp(listenAddr.family())),
+    channel_(loop, socket_.fd()),
+    session_(owner),
+    recvBuf_(kBatchSize * kMaxRequestSize),
+    recvIov_(kBatchSize),
+    peers_(kBatchSize),
+    recvMsgs_(kBatchSize),
+    outputIndex_(0),
+    outputOffset_(0)
+{
+  socket_.setReuseAddr(true);
+  socket_.setReusePort(true);
+  socket_.bindAddress(listenAddr);
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    recvIov_[i].iov_base = &recvBuf_[i * kMaxRequestSize];
+    recvIov_[i].iov_len = kMaxRequestSize;
+    memZero(&recvMsgs_[i], sizeof recvMsgs_[i]);
+    recvMsgs_[i].msg_hdr.msg_name = &peers_[i];
+    recvMsgs_[i].msg_hdr.msg_iov = &recvIov_[i];
+    recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+  }
+  channel_.setReadCallback(std::bind(&UdpServer::handleRead, this, _1));
+  loop_->runInLoop(std::bind(&UdpServer::startInLoop, this));
+}
+
+UdpServer::~UdpServer()
+{
+  CountDownLatch latch(1);
+  loop_->runInLoop(std::bind(&UdpServer::stopInLoop, this, &latch));
+  latch.wait();
+}
+
+void UdpServer::startInLoop()
+{
+  loop_->assertInLoopThread();
+  channel_.enableReading();
+}
+
+void UdpServer::stopInLoop(CountDownLatch* latch)
+{
+  loop_->assertInLoopThread();
+  channel_.disableAll();
+  channel_.remove();
+  latch->countDown();
+}
+
+void UdpServer::handleRead(Timestamp)
+{
+  loop_->assertInLoopThread();
+  for (int i = 0; i < kBatchSize; ++i)
+  {
+    recvMsgs_[i].msg_hdr.msg_namelen = sizeof peers_[i];
+    recvMsgs_[i].msg_hdr.msg_flags = 0;
+  }
+  int n = ::recvmmsg(socket_.fd(), recvMsgs_.data(), kBatchSize, 0, NULL);
+  if (n < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "UdpServer::handleRead";
+    }
+    return;
+  }
+
+  assert(responses_.empty());
+  for (int i = 0; i < n; ++i)
+  {
+    const struct msghdr& hdr = recvMsgs_[i].msg_hdr;
+    const char* frame = static_cast<const char*>(recvIov_[i].iov_base);
+    const size_t len = recvMsgs_[i].msg_len;
+    // requests of more than one datagram are not supported, as in memcached
+    if (len <= kFrameHeaderSize || (hdr.msg_flags & MSG_TRUNC) || readUint16(frame + 4) != 1)
+    {
+      LOG_DEBUG << "bad datagram of " << len << " bytes";
+      continue;
+    }
+
+    const size_t outputBytes = session_.outputBytes();
+    request_.append(frame + kFrameHeaderSize, len - kFrameHeaderSize);
+    session_.processDatagram(&request_);
+    Response response;
+    memcpy(&response.peer, &peers_[i], sizeof response.peer);
+    response.peerLen = hdr.msg_namelen;
+    response.requestId = readUint16(frame);
+    response.bytes = session_.outputBytes() - outputBytes;
+    responses_.push_back(response);
+  }
+  sendResponses();
+}
+
+void UdpServer::takeOutput(size_t bytes)
+{
+  while (bytes > 0)
+  {
+    assert(outputIndex_ < output_.size());
+    const struct iovec& vec = output_[outputIndex_];
+    const size_t len = std::min(bytes, vec.iov_len - outputOffset_);
+    struct iovec slice = { static_cast<char*>(vec.iov_base) + outputOffset_, len };
+    sendIov_.push_back(slice);
+    bytes -= len;
+    outputOffset_ += len;
+    if (outputOffset_ == vec.iov_len)
+    {
+      ++outputIndex_;
+      outputOffset_ = 0;
+    }
+  }
+}
+
+void UdpServer::sendResponses()
+{
+  const size_t kPayloadSize = kMaxDatagramSize - kFrameHeaderSize;
+  output_.clear();
+  session_.gatherOutput(&output_);
+  outputIndex_ = 0;
+  outputOffset_ = 0;
+
+  // frames_ does not move once filled
+  size_t numDatagrams = 0;
+  for (const Response& response : responses_)
+  {
+    numDatagrams += (response.bytes + kPayloadSize - 1) / kPayloadSize;
+  }
+  frames_.resize(numDatagrams * kFrameHeaderSize);
+  sendIov_.clear();
+  sendMsgs_.clear();
+  // the first iovec of each message, as sendIov_ may move until done
+  std::vector<size_t> firstIov;
+
+  for (const Response& response : responses_)
+  {
+    const size_t total = (response.bytes + kPayloadSize - 1) / kPayloadSize;
+    if (total > 0xFFFF)
+    {
+      LOG_WARN << "response of " << response.bytes << " bytes is too large for UDP";
+      const size_t numIov = sendIov_.size();
+      takeOutput(response.bytes);
+      sendIov_.resize(numIov);
+      continue;
+    }
+    for (size_t seq = 0; seq < total; ++seq)
+    {
+      char* frame = &frames_[sendMsgs_.size() * kFrameHeaderSize];
+      writeUint16(frame, response.requestId);
+      writeUint16(frame + 2, seq);
+      writeUint16(frame + 4, total);
+      writeUint16(frame + 6, 0);
+
+      firstIov.push_back(sendIov_.size());
+      struct iovec header = { frame, kFrameHeaderSize };
+      sendIov_.push_back(header);
+      takeOutput(std::min(kPayloadSize, response.bytes - seq * kPayloadSize));
+
+      struct mmsghdr msg;
+      memZero(&msg, sizeof msg);
+      msg.msg_hdr.msg_name = const_cast<struct sockaddr_in6*>(&response.peer);
+      msg.msg_hdr.msg_namelen = response.peerLen;
+      msg.msg_hdr.msg_iovlen = sendIov_.size() - firstIov.back();
+      sendMsgs_.push_back(msg);
+    }
+  }
+  for (size_t i = 0; i < sendMsgs_.size(); ++i)
+  {
+    sendMsgs_[i].msg_hdr.msg_iov = &sendIov_[firstIov[i]];
+  }
+
+  // datagrams that do not fit in the socket buffer are dropped, UDP is lossy
+  size_t sent = 0;
+  while (sent < sendMsgs_.size())
+  {
+    const size_t vlen = std::min(sendMsgs_.size() - sent, implicit_cast<size_t>(IOV_MAX));
+    int n = ::sendmmsg(socket_.fd(), &sendMsgs_[sent], static_cast<unsigned>(vlen), 0);
+    if (n < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        LOG_SYSERR << "UdpServer::sendResponses";
+      }
+      LOG_DEBUG << "dropped " << sendMsgs_.size() - sent << " datagrams";
+      break;
+    }
+    sent += n;
+  }
+
+  responses_.clear();
+  session_.clearOutput();
+}
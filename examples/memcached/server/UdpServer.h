@@ -0,0 +1,85 @@
+#ifndef MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPSERVER_H
+#define MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPSERVER_H
+
+#include "examples/memcached/server/Session.h"
+
+#include "muduo/net/Channel.h"
+#include "muduo/net/Socket.h"
+
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace muduo
+{
+class CountDownLatch;
+}
+
+// The UDP frontend of memcached, one per I/O loop.  Sockets of all loops
+// bind the same port with SO_REUSEPORT, so the kernel spreads clients over
+// the loops.
+//
+// A datagram starts with a frame header of 8 bytes: request id, sequence
+// number, total number of datagrams and a reserved field, 16-bit each in
+// network byte order.  A request takes one datagram, its response is split
+// into datagrams of at most kMaxDatagramSize bytes, header included.
+//
+// A read takes up to kBatchSize datagrams with one recvmmsg(2), and the
+// responses to all of them go out with sendmmsg(2).  Values are sent from
+// the items, as in TCP sessions.
+class UdpServer : muduo::noncopyable
+{
+ public:
+  static const size_t kMaxDatagramSize = 1400;
+  static const size_t kFrameHeaderSize = 8;
+
+  UdpServer(MemcacheServer* owner,
+            muduo::net::EventLoop* loop,
+            const muduo::net::InetAddress& listenAddr);
+  // waits for the loop to forget the socket
+  ~UdpServer();
+
+ private:
+  static const int kBatchSize = 32;
+  // larger requests are dropped
+  static const size_t kMaxRequestSize = 2048;
+
+  struct Response
+  {
+    struct sockaddr_in6 peer;
+    socklen_t peerLen;
+    uint16_t requestId;
+    size_t bytes;
+  };
+
+  void startInLoop();
+  void stopInLoop(muduo::CountDownLatch* latch);
+  void handleRead(muduo::Timestamp);
+  // from output_[next] on, slices of no more than bytes into sendIov_
+  void takeOutput(size_t bytes);
+  void sendResponses();
+
+  muduo::net::EventLoop* loop_;
+  muduo::net::Socket socket_;
+  muduo::net::Channel channel_;
+  Session session_;
+  muduo::net::Buffer request_;
+
+  // for recvmmsg()
+  std::vector<char> recvBuf_;
+  std::vector<struct iovec> recvIov_;
+  std::vector<struct sockaddr_in6> peers_;
+  std::vector<struct mmsghdr> recvMsgs_;
+
+  // for sendmmsg()
+  std::vector<Response> responses_;
+  std::vector<struct iovec> output_;  // from session_
+  size_t outputIndex_;
+  size_t outputOffset_;
+  std::vector<char> frames_;
+  std::vector<struct iovec> sendIov_;
+  std::vector<struct mmsghdr> sendMsgs_;
+};
+
+#endif  // MUDUO_EXAMPLES_MEMCACHED_SERVER_UDPSERVER_H
@@ -1,4 +1,5 @@
 #include "examples/memcached/server/MemcacheServer.h"
+#include "muduo/base/ProcessInfo.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/inspect/ProcessInspector.h"
 
@@ -8,8 +9,16 @@
 #include <gperftools/malloc_extension.h>
 #endif
 
+using namespace muduo;
 using namespace muduo::net;
 
+long rssKiB()
+{
+  string status = ProcessInfo::procStatus();
+  size_t pos = status.find("VmRSS:");
+  return pos == string::npos ? 0 : atol(status.c_str() + pos + 6);
+}
+
 int main(int argc, char* argv[])
 {
 #ifdef HAVE_TCMALLOC
@@ -20,7 +29,9 @@ int main(int argc, char* argv[])
   int valuelen = argc > 3 ? atoi(argv[3]) : 100;
   EventLoop loop;
   MemcacheServer::Options options;
+  options.memoryLimitMB = argc > 4 ? atoi(argv[4]) : 0;
   MemcacheServer server(&loop, options);
+  const long initialRss = rssKiB();
 
   printf("sizeof(Item) = %zd\npid = %d\nitems = %d\nkeylen = %d\nvaluelen = %d\n",
          sizeof(Item), getpid(), items, keylen, valuelen);
@@ -30,7 +41,7 @@ int main(int argc, char* argv[])
   {
     snprintf(key, sizeof key, "%0*d", keylen, i);
     value.assign(valuelen, "0123456789"[i % 10]);
-    ItemPtr item(Item::makeItem(key, 0, 0, valuelen+2, 1));
+    ItemPtr item(server.newItem(key, 0, 0, valuelen+2, 1));
     item->append(value.data(), value.size());
     item->append("\r\n", 2);
     assert(item->endsWithCRLF());
@@ -39,10 +50,25 @@ int main(int argc, char* argv[])
     assert(stored); (void) stored;
     assert(!exists);
   }
+  Timestamp start(Timestamp::now());
+  int found = 0;
+  for (int i = 0; i < items; ++i)
+  {
+    snprintf(key, sizeof key, "%0*d", keylen, i);
+    if (server.getItem(key))
+      ++found;
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%d of %d found, %.1f ns per getItem\n", found, items, seconds * 1e9 / items);
+
   Inspector::ArgList arg;
   printf("==========\n%s\n",
          ProcessInspector::overview(HttpRequest::kGet, arg).c_str());
-  // TODO: print bytes per item, overhead percent
+  printf("%.1f bytes per item, %d of which are key and value\n",
+         static_cast<double>(rssKiB() - initialRss) * 1024 / items, keylen + valuelen + 2);
+  Buffer stats;
+  server.appendStats(&stats);
+  printf("==========\n%s", stats.retrieveAllAsString().c_str());
   fflush(stdout);
 #ifdef HAVE_TCMALLOC
   char buf[8192];
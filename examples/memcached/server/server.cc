@@ -19,9 +19,15 @@ bool parseCommandLine(int argc, char* argv[], MemcacheServer::Options* options)
   desc.add_options()
       ("help,h", "Help")
       ("port,p", po::value<uint16_t>(&options->tcpport), "TCP port")
-      ("udpport,U", po::value<uint16_t>(&options->udpport), "UDP port")
+      ("udpport,U", po::value<uint16_t>(&options->udpport), "UDP port, 0 for no UDP")
       ("gperf,g", po::value<uint16_t>(&options->gperfport), "port for gperftools")
       ("threads,t", po::value<int>(&options->threads), "Number of worker threads")
+      ("memory-limit,m", po::value<int>(&options->memoryLimitMB),
+       "Item memory in megabytes, evicting past it, 0 for no limit")
+      ("snapshot,f", po::value<muduo::string>(&options->snapshotPath),
+       "Snapshot file of items, loaded at start, saved at shutdown")
+      ("snapshot-interval", po::value<int>(&options->snapshotInterval),
+       "Seconds between snapshots, 0 for at shutdown only")
       ;
 
   po::variables_map vm;
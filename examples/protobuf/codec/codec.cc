@@ -10,10 +10,10 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/net/Endian.h"
+#include "muduo/net/protobuf/ProtobufArena.h"
+#include "muduo/net/protobuf/ProtobufPrototypeCache.h"
 #include "muduo/net/protorpc/google-inl.h"
 
-#include <google/protobuf/descriptor.h>
-
 #include <zlib.h>  // adler32
 
 using namespace muduo;
@@ -127,10 +127,29 @@ void ProtobufCodec::onMessage(const TcpConnectionPtr& conn,
     else if (buf->readableBytes() >= implicit_cast<size_t>(len + kHeaderLen))
     {
       ErrorCode errorCode = kNoError;
-      MessagePtr message = parse(buf->peek()+kHeaderLen, len, &errorCode);
-      if (errorCode == kNoError && message)
+      if (useArena_)
+      {
+        ProtobufArena& arena = ProtobufArena::threadInstance();
+        ProtobufArena::Scope scope(arena);
+        google::protobuf::Message* message =
+          parse(buf->peek()+kHeaderLen, len, arena.arena(), &errorCode);
+        if (message)
+        {
+          // does not own the message, no control block is allocated
+          messageCallback_(conn, MessagePtr(MessagePtr(), message), receiveTime);
+        }
+      }
+      else
+      {
+        MessagePtr message = parse(buf->peek()+kHeaderLen, len, &errorCode);
+        if (message)
+        {
+          messageCallback_(conn, message, receiveTime);
+        }
+      }
+
+      if (errorCode == kNoError)
       {
-        messageCallback_(conn, message, receiveTime);
         buf->retrieve(kHeaderLen+len);
       }
       else
@@ -148,24 +167,20 @@ void ProtobufCodec::onMessage(const TcpConnectionPtr& conn,
 
 google::protobuf::Message* ProtobufCodec::createMessage(const std::string& typeName)
 {
-  google::protobuf::Message* message = NULL;
-  const google::protobuf::Descriptor* descriptor =
-    google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(typeName);
-  if (descriptor)
-  {
-    const google::protobuf::Message* prototype =
-      google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor);
-    if (prototype)
-    {
-      message = prototype->New();
-    }
-  }
-  return message;
+  const google::protobuf::Message* prototype = ProtobufPrototypeCache::find(typeName);
+  return prototype ? prototype->New() : NULL;
 }
 
 MessagePtr ProtobufCodec::parse(const char* buf, int len, ErrorCode* error)
 {
-  MessagePtr message;
+  return MessagePtr(parse(buf, len, NULL, error));
+}
+
+google::protobuf::Message* ProtobufCodec::parse(const char* buf, int len,
+                                                google::protobuf::Arena* arena,
+                                                ErrorCode* error)
+{
+  google::protobuf::Message* message = NULL;
 
   // check sum
   int32_t expectedCheckSum = asInt32(buf + len - kHeaderLen);
@@ -179,11 +194,12 @@ MessagePtr ProtobufCodec::parse(const char* buf, int len, ErrorCode* error)
     int32_t nameLen = asInt32(buf);
     if (nameLen >= 2 && nameLen <= len - 2*kHeaderLen)
     {
-      std::string typeName(buf + kHeaderLen, buf + kHeaderLen + nameLen - 1);
+      StringPiece typeName(buf + kHeaderLen, nameLen - 1);
       // create message object
-      message.reset(createMessage(typeName));
-      if (message)
+      const google::protobuf::Message* prototype = ProtobufPrototypeCache::find(typeName);
+      if (prototype)
       {
+        message = prototype->New(arena);
         // parse from buffer
         const char* data = buf + kHeaderLen + nameLen;
         int32_t dataLen = len - nameLen - 2*kHeaderLen;
@@ -194,6 +210,11 @@ MessagePtr ProtobufCodec::parse(const char* buf, int len, ErrorCode* error)
         else
         {
           *error = kParseError;
+          if (!arena)
+          {
+            delete message;
+          }
+          message = NULL;
         }
       }
       else
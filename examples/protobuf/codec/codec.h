@@ -14,6 +14,14 @@
 
 #include <google/protobuf/message.h>
 
+namespace google
+{
+namespace protobuf
+{
+class Arena;
+}
+}
+
 // struct ProtobufTransportFormat __attribute__ ((__packed__))
 // {
 //   int32_t  len;
@@ -53,16 +61,22 @@ class ProtobufCodec : muduo::noncopyable
 
   explicit ProtobufCodec(const ProtobufMessageCallback& messageCb)
     : messageCallback_(messageCb),
-      errorCallback_(defaultErrorCallback)
+      errorCallback_(defaultErrorCallback),
+      useArena_(false)
   {
   }
 
   ProtobufCodec(const ProtobufMessageCallback& messageCb, const ErrorCallback& errorCb)
     : messageCallback_(messageCb),
-      errorCallback_(errorCb)
+      errorCallback_(errorCb),
+      useArena_(false)
   {
   }
 
+  // Parses messages into the per-thread muduo::net::ProtobufArena, which is
+  // reset when the callback returns, the MessagePtr must not be kept.
+  void setUseArena(bool on) { useArena_ = on; }
+
   void onMessage(const muduo::net::TcpConnectionPtr& conn,
                  muduo::net::Buffer* buf,
                  muduo::Timestamp receiveTime);
@@ -80,6 +94,10 @@ class ProtobufCodec : muduo::noncopyable
   static void fillEmptyBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
   static google::protobuf::Message* createMessage(const std::string& type_name);
   static MessagePtr parse(const char* buf, int len, ErrorCode* errorCode);
+  // allocates the message on arena if not NULL, returns NULL on error.
+  static google::protobuf::Message* parse(const char* buf, int len,
+                                          google::protobuf::Arena* arena,
+                                          ErrorCode* errorCode);
 
  private:
   static void defaultErrorCallback(const muduo::net::TcpConnectionPtr&,
@@ -89,6 +107,7 @@ class ProtobufCodec : muduo::noncopyable
 
   ProtobufMessageCallback messageCallback_;
   ErrorCallback errorCallback_;
+  bool useArena_;
 
   const static int kHeaderLen = sizeof(int32_t);
   const static int kMinMessageLen = 2*kHeaderLen + 2; // nameLen + typeName + checkSum
@@ -1,7 +1,11 @@
 #include "examples/protobuf/codec/codec.h"
 #include "muduo/net/Endian.h"
+#include "muduo/net/protobuf/ProtobufArena.h"
+#include "muduo/net/protobuf/ProtobufPrototypeCache.h"
 #include "examples/protobuf/codec/query.pb.h"
 
+#include <google/protobuf/arena.h>
+
 #include <stdio.h>
 #include <zlib.h>  // adler32
 
@@ -242,6 +246,72 @@ void testOnMessage()
   }
 }
 
+void testPrototypeCache()
+{
+  const google::protobuf::Message* prototype = ProtobufPrototypeCache::find("muduo.Query");
+  assert(prototype == &muduo::Query::default_instance());
+  assert(ProtobufPrototypeCache::find("muduo.Query") == prototype);
+  assert(ProtobufPrototypeCache::find("muduo.Answer") == &muduo::Answer::default_instance());
+  assert(ProtobufPrototypeCache::find("muduo.NoSuchMessage") == NULL);
+  assert(ProtobufPrototypeCache::find(StringPiece("muduo.QueryX", 11)) == prototype);
+  (void) prototype;
+}
+
+int g_arenaCount = 0;
+
+void onArenaMessage(const muduo::net::TcpConnectionPtr&,
+                    const MessagePtr& message,
+                    muduo::Timestamp)
+{
+  assert(message->GetArena() == ProtobufArena::threadInstance().arena());
+  assert(message.use_count() == 0);
+  std::shared_ptr<muduo::Query> query = down_pointer_cast<muduo::Query>(message);
+  assert(query->questioner() == "Chen Shuo");
+  g_arenaCount++;
+}
+
+void testArena()
+{
+  muduo::Query query;
+  query.set_id(1);
+  query.set_questioner("Chen Shuo");
+  query.add_question("Running?");
+
+  Buffer buf;
+  ProtobufCodec::fillEmptyBuffer(&buf, query);
+  const int32_t len = buf.readInt32();
+
+  ProtobufArena& arena = ProtobufArena::threadInstance();
+  {
+    ProtobufArena::Scope scope(arena);
+    ProtobufCodec::ErrorCode errorCode = ProtobufCodec::kNoError;
+    google::protobuf::Message* message =
+      ProtobufCodec::parse(buf.peek(), len, arena.arena(), &errorCode);
+    assert(errorCode == ProtobufCodec::kNoError);
+    assert(message->GetArena() == arena.arena());
+    assert(message->DebugString() == query.DebugString());
+    assert(arena.spaceUsed() > 0);
+    (void) message;
+  }
+  assert(arena.spaceUsed() == 0);
+
+  buf.retrieveAll();
+  Buffer input;
+  for (int i = 0; i < 100; ++i)
+  {
+    ProtobufCodec::fillEmptyBuffer(&buf, query);
+    input.append(buf.peek(), buf.readableBytes());
+    buf.retrieveAll();
+  }
+  ProtobufCodec codec(onArenaMessage);
+  codec.setUseArena(true);
+  muduo::net::TcpConnectionPtr conn;
+  codec.onMessage(conn, &input, muduo::Timestamp());
+  assert(g_arenaCount == 100);
+  assert(input.readableBytes() == 0);
+  assert(arena.spaceUsed() == 0);
+}
+
 int main()
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
@@ -256,6 +326,9 @@ int main()
   puts("");
   testOnMessage();
   puts("");
+  testPrototypeCache();
+  testArena();
+  puts("");
 
   puts("All pass!!!");
 
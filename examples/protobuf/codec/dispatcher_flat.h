@@ -0,0 +1,214 @@
+// Copyright 2011, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_EXAMPLES_PROTOBUF_CODEC_DISPATCHER_FLAT_H
+#define MUDUO_EXAMPLES_PROTOBUF_CODEC_DISPATCHER_FLAT_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/Callbacks.h"
+
+#include <google/protobuf/message.h>
+
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+
+typedef std::shared_ptr<google::protobuf::Message> MessagePtr;
+
+// Same interface as ProtobufDispatcher, but looks callbacks up in a flat
+// table instead of a std::map, and calls them without a virtual function
+// or a checked cast.
+//
+// Messages are keyed by their C++ type, typeid(*message), which is much
+// cheaper than GetDescriptor() and tells the exact class, so the cast is
+// a static one.  A DynamicMessage goes to the default callback, so does a
+// message whose class is compiled into more than one shared library, as
+// each copy has its own type_info; link the .pb.cc of a message once.
+// The table is rebuilt on every registration, sized so that no two
+// types hash to the same slot, so a lookup is a multiply, a load and a
+// compare.
+class ProtobufDispatcherFlat : muduo::noncopyable
+{
+ public:
+  typedef std::function<void (const muduo::net::TcpConnectionPtr&,
+                              const MessagePtr& message,
+                              muduo::Timestamp)> ProtobufMessageCallback;
+
+  explicit ProtobufDispatcherFlat(const ProtobufMessageCallback& defaultCb)
+    : defaultCallback_(defaultCb),
+      shift_(64)
+  {
+    rebuild();
+  }
+
+  void onProtobufMessage(const muduo::net::TcpConnectionPtr& conn,
+                         const MessagePtr& message,
+                         muduo::Timestamp receiveTime) const
+  {
+    const std::type_info* type = &typeid(*message);
+    const Entry& entry = table_[hash(type, shift_)];
+    if (entry.type == type)
+    {
+      entry.invoke(entry.callback, conn, message, receiveTime);
+    }
+    else
+    {
+      defaultCallback_(conn, message, receiveTime);
+    }
+  }
+
+  template<typename T>
+  void registerMessageCallback(
+      const std::function<void (const muduo::net::TcpConnectionPtr&,
+                                const std::shared_ptr<T>&,
+                                muduo::Timestamp)>& callback)
+  {
+    static_assert(std::is_base_of<google::protobuf::Message, T>::value,
+                  "T must be derived from gpb::Message.");
+    typedef std::function<void (const muduo::net::TcpConnectionPtr&,
+                                const std::shared_ptr<T>&,
+                                muduo::Timestamp)> Function;
+    std::shared_ptr<Function> owned(new Function(callback));
+    add(&typeid(T), &invokeFunction<T>, std::shared_ptr<const void>(owned));
+  }
+
+  /// The callback is known at compile time and is inlined into the table
+  /// entry, eg. registerMessageCallback<Query, &onQuery>().
+  template<typename T,
+           void (*callback)(const muduo::net::TcpConnectionPtr&,
+                            const std::shared_ptr<T>&,
+                            muduo::Timestamp)>
+  void registerMessageCallback()
+  {
+    static_assert(std::is_base_of<google::protobuf::Message, T>::value,
+                  "T must be derived from gpb::Message.");
+    add(&typeid(T), &invokeStatic<T, callback>, std::shared_ptr<const void>());
+  }
+
+  size_t tableSize() const { return table_.size(); }
+
+ private:
+  typedef void (*Invoker)(const void* callback,
+                          const muduo::net::TcpConnectionPtr&,
+                          const MessagePtr&,
+                          muduo::Timestamp);
+
+  struct Entry
+  {
+    const std::type_info* type;  // NULL for an empty slot
+    Invoker invoke;
+    const void* callback;
+  };
+
+  struct Registration
+  {
+    const std::type_info* type;
+    Invoker invoke;
+    std::shared_ptr<const void> callback;
+  };
+
+  template<typename T>
+  static void invokeFunction(const void* callback,
+                             const muduo::net::TcpConnectionPtr& conn,
+                             const MessagePtr& message,
+                             muduo::Timestamp receiveTime)
+  {
+    typedef std::function<void (const muduo::net::TcpConnectionPtr&,
+                                const std::shared_ptr<T>&,
+                                muduo::Timestamp)> Function;
+    (*static_cast<const Function*>(callback))(
+        conn, std::static_pointer_cast<T>(message), receiveTime);
+  }
+
+  template<typename T,
+           void (*callback)(const muduo::net::TcpConnectionPtr&,
+                            const std::shared_ptr<T>&,
+                            muduo::Timestamp)>
+  static void invokeStatic(const void*,
+                           const muduo::net::TcpConnectionPtr& conn,
+                           const MessagePtr& message,
+                           muduo::Timestamp receiveTime)
+  {
+    callback(conn, std::static_pointer_cast<T>(message), receiveTime);
+  }
+
+  static size_t hash(const std::type_info* type, int shift)
+  {
+    // Fibonacci hashing, the high bits are the best mixed
+    uint64_t h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(type))
+               * 0x9E3779B97F4A7C15ULL;
+    // shift is 64 for the single-slot table of no registration
+    return shift < 64 ? static_cast<size_t>(h >> shift) : 0;
+  }
+
+  void add(const std::type_info* type,
+           Invoker invoke,
+           const std::shared_ptr<const void>& callback)
+  {
+    Registration r = { type, invoke, callback };
+    bool replaced = false;
+    for (Registration& old : registrations_)
+    {
+      if (*old.type == *type)
+      {
+        old = r;
+        replaced = true;
+      }
+    }
+    if (!replaced)
+    {
+      registrations_.push_back(r);
+    }
+    rebuild();
+  }
+
+  // smallest power of 2, at least twice the registrations, without collisions
+  void rebuild()
+  {
+    int bits = 0;
+    while ((size_t(1) << bits) < 2 * registrations_.size())
+    {
+      ++bits;
+    }
+    for (;; ++bits)
+    {
+      assert(bits < 32);
+      const int shift = 64 - bits;
+      std::vector<Entry> table(size_t(1) << bits, Entry());
+      bool collided = false;
+      for (const Registration& r : registrations_)
+      {
+        Entry& entry = table[hash(r.type, shift)];
+        if (entry.type != NULL)
+        {
+          collided = true;
+          break;
+        }
+        entry.type = r.type;
+        entry.invoke = r.invoke;
+        entry.callback = r.callback.get();
+      }
+      if (!collided)
+      {
+        table_.swap(table);
+        shift_ = shift;
+        return;
+      }
+    }
+  }
+
+  std::vector<Entry> table_;
+  std::vector<Registration> registrations_;  // owns the callbacks
+  ProtobufMessageCallback defaultCallback_;
+  int shift_;
+};
+
+#endif  // MUDUO_EXAMPLES_PROTOBUF_CODEC_DISPATCHER_FLAT_H
@@ -1,9 +1,14 @@
+#undef NDEBUG
 #include "examples/protobuf/codec/dispatcher.h"
+#include "examples/protobuf/codec/dispatcher_flat.h"
 
 #include "examples/protobuf/codec/query.pb.h"
 
 #include <iostream>
 
+#include <stdio.h>
+#include <string.h>
+
 using std::cout;
 using std::endl;
 
@@ -42,7 +47,105 @@ void onUnknownMessageType(const muduo::net::TcpConnectionPtr&,
   cout << "onUnknownMessageType: " << message->GetTypeName() << endl;
 }
 
-int main()
+int g_queries = 0;
+int g_answers = 0;
+int g_unknowns = 0;
+
+void countQuery(const muduo::net::TcpConnectionPtr&,
+                const QueryPtr&,
+                muduo::Timestamp)
+{
+  ++g_queries;
+}
+
+void countAnswer(const muduo::net::TcpConnectionPtr&,
+                 const AnswerPtr&,
+                 muduo::Timestamp)
+{
+  ++g_answers;
+}
+
+void countUnknown(const muduo::net::TcpConnectionPtr&,
+                  const MessagePtr&,
+                  muduo::Timestamp)
+{
+  ++g_unknowns;
+}
+
+void test_flat()
+{
+  ProtobufDispatcherFlat dispatcher(countUnknown);
+  muduo::net::TcpConnectionPtr conn;
+  muduo::Timestamp t;
+  MessagePtr query(new muduo::Query);
+  MessagePtr answer(new muduo::Answer);
+  MessagePtr empty(new muduo::Empty);
+
+  // nothing registered
+  dispatcher.onProtobufMessage(conn, query, t);
+  assert(g_unknowns == 1);
+
+  dispatcher.registerMessageCallback<muduo::Query>(countQuery);
+  dispatcher.registerMessageCallback<muduo::Answer, &countAnswer>();
+  dispatcher.onProtobufMessage(conn, query, t);
+  dispatcher.onProtobufMessage(conn, answer, t);
+  dispatcher.onProtobufMessage(conn, empty, t);
+  assert(g_queries == 1 && g_answers == 1 && g_unknowns == 2);
+
+  // replaces the old callback
+  dispatcher.registerMessageCallback<muduo::Query>(
+      [](const muduo::net::TcpConnectionPtr&, const QueryPtr& q, muduo::Timestamp)
+      {
+        assert(q->GetDescriptor() == muduo::Query::descriptor()); (void) q;
+        g_queries += 10;
+      });
+  dispatcher.onProtobufMessage(conn, query, t);
+  assert(g_queries == 11);
+  printf("flat table of %zd slots\n", dispatcher.tableSize());
+}
+
+template<typename Dispatcher>
+double benchmark(const Dispatcher& dispatcher, const std::vector<MessagePtr>& messages, int n)
+{
+  muduo::net::TcpConnectionPtr conn;
+  muduo::Timestamp start(muduo::Timestamp::now());
+  for (int i = 0; i < n; ++i)
+  {
+    dispatcher.onProtobufMessage(conn, messages[i % messages.size()], start);
+  }
+  return timeDifference(muduo::Timestamp::now(), start);
+}
+
+void benchmark_dispatchers()
+{
+  const int kN = 10 * 1000 * 1000;
+  std::vector<MessagePtr> messages;
+  messages.push_back(MessagePtr(new muduo::Query));
+  messages.push_back(MessagePtr(new muduo::Answer));
+  messages.push_back(MessagePtr(new muduo::Query));
+  messages.push_back(MessagePtr(new muduo::Empty));
+
+  ProtobufDispatcher map(countUnknown);
+  map.registerMessageCallback<muduo::Query>(countQuery);
+  map.registerMessageCallback<muduo::Answer>(countAnswer);
+
+  ProtobufDispatcherFlat flat(countUnknown);
+  flat.registerMessageCallback<muduo::Query>(countQuery);
+  flat.registerMessageCallback<muduo::Answer>(countAnswer);
+
+  ProtobufDispatcherFlat flatStatic(countUnknown);
+  flatStatic.registerMessageCallback<muduo::Query, &countQuery>();
+  flatStatic.registerMessageCallback<muduo::Answer, &countAnswer>();
+
+  double m = benchmark(map, messages, kN);
+  double f = benchmark(flat, messages, kN);
+  double s = benchmark(flatStatic, messages, kN);
+  printf("std::map      %.1f ns per message\n", m * 1e9 / kN);
+  printf("flat          %.1f ns per message\n", f * 1e9 / kN);
+  printf("flat, static  %.1f ns per message\n", s * 1e9 / kN);
+}
+
+int main(int argc, char* argv[])
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
   test_down_pointer_cast();
@@ -61,6 +164,12 @@ int main()
   dispatcher.onProtobufMessage(conn, answer, t);
   dispatcher.onProtobufMessage(conn, empty, t);
 
+  test_flat();
+  if (argc > 1 && strcmp(argv[1], "-b") == 0)
+  {
+    benchmark_dispatchers();
+  }
+
   google::protobuf::ShutdownProtobufLibrary();
 }
 
@@ -2,6 +2,7 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
+#include "muduo/net/protorpc/RpcExecutor.h"
 #include "muduo/net/protorpc/RpcServer.h"
 
 #include <unistd.h>
@@ -29,7 +30,7 @@ class SudokuServiceImpl : public SudokuService
 
 }  // namespace sudoku
 
-int main()
+int main(int argc, char* argv[])
 {
   LOG_INFO << "pid = " << getpid();
   EventLoop loop;
@@ -37,6 +38,21 @@ int main()
   sudoku::SudokuServiceImpl impl;
   RpcServer server(&loop, listenAddr);
   server.registerService(&impl);
+  // solving is CPU bound, keep it off the IO thread
+  int numSolvers = argc > 1 ? atoi(argv[1]) : 4;
+  if (numSolvers > 0)
+  {
+    RpcExecutor* solvers = server.addExecutor("solver", numSolvers, 10000);
+    server.setServiceExecutor(sudoku::SudokuService::descriptor()->full_name(), "solver");
+    loop.runEvery(10.0, [solvers]
+      {
+        RpcExecutor::Stats stats = solvers->stats();
+        LOG_INFO << "solver calls " << stats.calls << " rejected " << stats.rejected
+                 << " in flight " << stats.inFlight << " queue time avg "
+                 << (stats.calls ? stats.totalQueueTime / stats.calls : 0)
+                 << "us max " << stats.maxQueueTime << "us";
+      });
+  }
   server.start();
   loop.loop();
   google::protobuf::ShutdownProtobufLibrary();
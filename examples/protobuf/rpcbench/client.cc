@@ -9,6 +9,9 @@
 #include "muduo/net/TcpConnection.h"
 #include "muduo/net/protorpc/RpcChannel.h"
 
+#include <algorithm>
+
+#include <inttypes.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -23,16 +26,25 @@ class RpcClient : noncopyable
 
   RpcClient(EventLoop* loop,
             const InetAddress& serverAddr,
+            int pipeline,
+            double batchDelay,
             CountDownLatch* allConnected,
             CountDownLatch* allFinished)
-    : // loop_(loop),
+    : loop_(loop),
       client_(loop, serverAddr, "RpcClient"),
       channel_(new RpcChannel),
       stub_(get_pointer(channel_)),
+      pipeline_(pipeline),
       allConnected_(allConnected),
       allFinished_(allFinished),
+      sent_(0),
       count_(0)
   {
+    latencies_.reserve(kRequests);
+    if (batchDelay >= 0)
+    {
+      channel_->enableBatching(batchDelay);
+    }
     client_.setConnectionCallback(
         std::bind(&RpcClient::onConnection, this, _1));
     client_.setMessageCallback(
@@ -45,12 +57,22 @@ class RpcClient : noncopyable
     client_.connect();
   }
 
-  void sendRequest()
+  // keeps pipeline calls in flight on the channel
+  void start()
   {
-    echo::EchoRequest request;
-    request.set_payload("001010");
-    echo::EchoResponse* response = new echo::EchoResponse;
-    stub_.Echo(NULL, &request, response, NewCallback(this, &RpcClient::replied, response));
+    loop_->runInLoop([this]
+      {
+        for (int i = 0; i < pipeline_ && sent_ < kRequests; ++i)
+        {
+          sendRequest();
+        }
+      });
+  }
+
+  // microseconds, valid after finished
+  const std::vector<int64_t>& latencies() const
+  {
+    return latencies_;
   }
 
  private:
@@ -65,29 +87,44 @@ class RpcClient : noncopyable
     }
   }
 
-  void replied(echo::EchoResponse* resp)
+  void sendRequest()
+  {
+    ++sent_;
+    echo::EchoRequest request;
+    request.set_payload("001010");
+    echo::EchoResponse* response = new echo::EchoResponse;
+    stub_.Echo(NULL, &request, response,
+               NewCallback(this, &RpcClient::replied, response, Timestamp::now()));
+  }
+
+  void replied(echo::EchoResponse* resp, Timestamp sendTime)
   {
     // LOG_INFO << "replied:\n" << resp->DebugString();
     // loop_->quit();
+    latencies_.push_back(Timestamp::now().microSecondsSinceEpoch()
+                         - sendTime.microSecondsSinceEpoch());
     ++count_;
-    if (count_ < kRequests)
+    if (sent_ < kRequests)
     {
       sendRequest();
     }
-    else
+    else if (count_ == kRequests)
     {
       LOG_INFO << "RpcClient " << this << " finished";
       allFinished_->countDown();
     }
   }
 
-  // EventLoop* loop_;
+  EventLoop* loop_;
   TcpClient client_;
   RpcChannelPtr channel_;
   echo::EchoService::Stub stub_;
+  const int pipeline_;
   CountDownLatch* allConnected_;
   CountDownLatch* allFinished_;
+  int sent_;
   int count_;
+  std::vector<int64_t> latencies_;
 };
 
 int main(int argc, char* argv[])
@@ -109,6 +146,22 @@ int main(int argc, char* argv[])
       nThreads = atoi(argv[3]);
     }
 
+    int pipeline = 1;
+
+    if (argc > 4)
+    {
+      pipeline = atoi(argv[4]);
+    }
+
+    // -1 writes every call, 0 coalesces calls of one loop iteration,
+    // N coalesces calls within N microseconds
+    double batchDelay = -1;
+
+    if (argc > 5)
+    {
+      batchDelay = atoi(argv[5]) / 1e6;
+    }
+
     CountDownLatch allConnected(nClients);
     CountDownLatch allFinished(nClients);
 
@@ -121,7 +174,7 @@ int main(int argc, char* argv[])
     std::vector<std::unique_ptr<RpcClient>> clients;
     for (int i = 0; i < nClients; ++i)
     {
-      clients.emplace_back(new RpcClient(pool.getNextLoop(), serverAddr, &allConnected, &allFinished));
+      clients.emplace_back(new RpcClient(pool.getNextLoop(), serverAddr, pipeline, batchDelay, &allConnected, &allFinished));
       clients.back()->connect();
     }
     allConnected.wait();
@@ -129,7 +182,7 @@ int main(int argc, char* argv[])
     LOG_INFO << "all connected";
     for (int i = 0; i < nClients; ++i)
     {
-      clients[i]->sendRequest();
+      clients[i]->start();
     }
     allFinished.wait();
     Timestamp end(Timestamp::now());
@@ -138,11 +191,21 @@ int main(int argc, char* argv[])
     printf("%f seconds\n", seconds);
     printf("%.1f calls per second\n", nClients * kRequests / seconds);
 
+    std::vector<int64_t> latencies;
+    for (const auto& client : clients)
+    {
+      latencies.insert(latencies.end(), client->latencies().begin(), client->latencies().end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const size_t n = latencies.size();
+    printf("latency us: p50 %" PRId64 " p99 %" PRId64 " p999 %" PRId64 " max %" PRId64 "\n",
+           latencies[n / 2], latencies[n * 99 / 100], latencies[n * 999 / 1000], latencies[n - 1]);
+
     exit(0);
   }
   else
   {
-    printf("Usage: %s host_ip numClients [numThreads]\n", argv[0]);
+    printf("Usage: %s host_ip numClients [numThreads [callsInFlightPerClient [batchDelayUs]]]\n", argv[0]);
   }
 }
 
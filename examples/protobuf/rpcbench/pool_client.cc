@@ -0,0 +1,144 @@
+#include "examples/protobuf/rpcbench/echo.pb.h"
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/protorpc/RpcChannelPool.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// Spreads echo calls over several servers with RpcChannelPool.
+class PoolClient : noncopyable
+{
+ public:
+  PoolClient(EventLoop* loop, RpcChannelPool* pool,
+             int numCalls, int pipeline, CountDownLatch* finished)
+    : loop_(loop),
+      stub_(pool),
+      numCalls_(numCalls),
+      pipeline_(pipeline),
+      finished_(finished),
+      sent_(0),
+      done_(0),
+      failed_(0)
+  {
+  }
+
+  // calls are sent and done in the loop thread
+  void start()
+  {
+    loop_->runInLoop([this]
+      {
+        for (int i = 0; i < pipeline_ && sent_ < numCalls_; ++i)
+        {
+          sendRequest();
+        }
+      });
+  }
+
+  // valid after finished
+  int failed() const
+  {
+    return failed_;
+  }
+
+ private:
+  void sendRequest()
+  {
+    ++sent_;
+    echo::EchoRequest request;
+    request.set_payload("001010");
+    RpcController* controller = new RpcController;
+    echo::EchoResponse* response = new echo::EchoResponse;
+    stub_.Echo(controller, &request, response,
+               NewCallback(this, &PoolClient::replied, controller, response));
+  }
+
+  void replied(RpcController* controller, echo::EchoResponse* response)
+  {
+    if (controller->Failed())
+    {
+      ++failed_;
+    }
+    delete controller;
+    if (sent_ < numCalls_)
+    {
+      sendRequest();
+    }
+    if (++done_ == numCalls_)
+    {
+      finished_->countDown();
+    }
+  }
+
+  EventLoop* loop_;
+  echo::EchoService::Stub stub_;
+  const int numCalls_;
+  const int pipeline_;
+  CountDownLatch* finished_;
+  int sent_;
+  int done_;
+  int failed_;
+};
+
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    printf("Usage: %s rr|least|p2c numCalls host:port [host:port ...]\n", argv[0]);
+    return 0;
+  }
+  LOG_INFO << "pid = " << getpid();
+
+  std::vector<InetAddress> backends;
+  for (int i = 3; i < argc; ++i)
+  {
+    string hostport(argv[i]);
+    size_t colon = hostport.find(':');
+    if (colon == string::npos)
+    {
+      printf("bad address %s\n", argv[i]);
+      return 1;
+    }
+    uint16_t port = static_cast<uint16_t>(atoi(hostport.c_str() + colon + 1));
+    backends.push_back(InetAddress(hostport.substr(0, colon), port));
+  }
+
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+  RpcChannelPool pool(loop, backends, "PoolClient");
+  string policy(argv[1]);
+  pool.setPolicy(policy == "rr" ? RpcChannelPool::kRoundRobin :
+                 policy == "least" ? RpcChannelPool::kLeastOutstanding :
+                 RpcChannelPool::kPowerOfTwoChoices);
+  pool.setTimeout(1.0);
+  pool.connect();
+  // let the connections come up
+  sleep(1);
+
+  const int numCalls = atoi(argv[2]);
+  CountDownLatch finished(1);
+  PoolClient client(loop, &pool, numCalls, 100, &finished);
+  Timestamp start(Timestamp::now());
+  client.start();
+  finished.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("%f seconds, %.1f calls per second, %d failed\n",
+         seconds, numCalls / seconds, client.failed());
+  for (const RpcChannelPool::BackendStats& stats : pool.stats())
+  {
+    printf("%s %s%s calls %" PRId64 " errors %" PRId64 "\n",
+           stats.address.toIpPort().c_str(),
+           stats.connected ? "up" : "down",
+           stats.ejected ? " ejected" : "",
+           stats.calls, stats.errors);
+  }
+  pool.disconnect();
+  sleep(1);
+}
@@ -38,6 +38,13 @@ int main(int argc, char* argv[])
   echo::EchoServiceImpl impl;
   RpcServer server(&loop, listenAddr);
   server.setThreadNum(nThreads);
+  // -1 writes every response, 0 coalesces responses of one loop iteration,
+  // N coalesces responses within N microseconds
+  int batchDelayUs = argc > 3 ? atoi(argv[3]) : -1;
+  if (batchDelayUs >= 0)
+  {
+    server.enableBatching(batchDelayUs / 1e6);
+  }
   server.registerService(&impl);
   server.start();
   loop.loop();
@@ -0,0 +1,101 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/base/Crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace muduo
+{
+namespace crc32c
+{
+namespace detail
+{
+
+struct Table
+{
+  Table()
+  {
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j)
+      {
+        crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+      }
+      entries[i] = crc;
+    }
+  }
+
+  uint32_t entries[256];
+};
+
+uint32_t extendSoftware(uint32_t crc, const unsigned char* p, size_t len)
+{
+  static const Table table;
+  for (size_t i = 0; i < len; ++i)
+  {
+    crc = table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t extendHardware(uint32_t crc, const unsigned char* p, size_t len)
+{
+  uint64_t crc64 = crc;
+  for (; len >= 8; p += 8, len -= 8)
+  {
+    uint64_t word;
+    memcpy(&word, p, sizeof word);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  uint32_t crc32 = static_cast<uint32_t>(crc64);
+  for (; len > 0; ++p, --len)
+  {
+    crc32 = _mm_crc32_u8(crc32, *p);
+  }
+  return crc32;
+}
+
+bool hasSse42()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+#endif
+
+}  // namespace detail
+
+bool isHardwareAccelerated()
+{
+#if defined(__x86_64__)
+  static const bool hardware = detail::hasSse42();
+  return hardware;
+#else
+  return false;
+#endif
+}
+
+uint32_t extend(uint32_t crc, const void* data, size_t len)
+{
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  crc = ~crc;
+#if defined(__x86_64__)
+  if (isHardwareAccelerated())
+  {
+    return ~detail::extendHardware(crc, p, len);
+  }
+#endif
+  return ~detail::extendSoftware(crc, p, len);
+}
+
+}  // namespace crc32c
+}  // namespace muduo
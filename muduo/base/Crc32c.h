@@ -0,0 +1,37 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#ifndef MUDUO_BASE_CRC32C_H
+#define MUDUO_BASE_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace muduo
+{
+namespace crc32c
+{
+
+///
+/// CRC-32C (Castagnoli), as used by iSCSI, ext4 and SCTP.
+///
+/// Uses the SSE4.2 crc32 instruction when the CPU has it,
+/// checked at runtime, otherwise a lookup table.
+///
+
+// Returns the crc32c of concat(A, data[0,len)) where crc is the crc32c of A.
+uint32_t extend(uint32_t crc, const void* data, size_t len);
+
+inline uint32_t value(const void* data, size_t len)
+{
+  return extend(0, data, len);
+}
+
+bool isHardwareAccelerated();
+
+}  // namespace crc32c
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_CRC32C_H
@@ -0,0 +1,71 @@
+#include "muduo/base/Crc32c.h"
+#include "muduo/base/Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+using namespace muduo;
+
+void check(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    printf("FAILED: %s\n", what);
+    abort();
+  }
+}
+
+void testKnownValues()
+{
+  // RFC 3720 section B.4
+  char buf[32];
+  memset(buf, 0, sizeof buf);
+  check(crc32c::value(buf, sizeof buf) == 0x8A9136AA, "zeros");
+  memset(buf, 0xFF, sizeof buf);
+  check(crc32c::value(buf, sizeof buf) == 0x62A8AB43, "ones");
+  for (int i = 0; i < 32; ++i)
+  {
+    buf[i] = static_cast<char>(i);
+  }
+  check(crc32c::value(buf, sizeof buf) == 0x46DD794E, "incrementing");
+  check(crc32c::value("123456789", 9) == 0xE3069283, "123456789");
+  check(crc32c::value("", 0) == 0, "empty");
+}
+
+void testExtend()
+{
+  std::string data;
+  for (int i = 0; i < 1000; ++i)
+  {
+    data += static_cast<char>(i * 31);
+  }
+  const uint32_t whole = crc32c::value(data.data(), data.size());
+  for (size_t split = 0; split <= data.size(); split += 7)
+  {
+    uint32_t crc = crc32c::value(data.data(), split);
+    crc = crc32c::extend(crc, data.data() + split, data.size() - split);
+    check(crc == whole, "extend");
+  }
+}
+
+void bench()
+{
+  std::string data(64 * 1024 * 1024, 'x');
+  Timestamp start(Timestamp::now());
+  uint32_t crc = crc32c::value(data.data(), data.size());
+  double seconds = timeDifference(Timestamp::now(), start);
+  printf("crc32c %s: %08x %.1f MiB/s\n",
+         crc32c::isHardwareAccelerated() ? "hardware" : "software",
+         crc, 64 / seconds);
+}
+
+int main()
+{
+  testKnownValues();
+  testExtend();
+  bench();
+  puts("All pass!!!");
+}
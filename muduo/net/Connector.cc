@@ -106,12 +106,19 @@ void Connector::connect()
     case ENOTSOCK:
       LOG_SYSERR << "connect error in Connector::startInLoop " << savedErrno;
       sockets::close(sockfd);  //不能重连
+      if (connectErrorCallback_)
+      {
+        connectErrorCallback_();
+      }
       break;
 
     default:
       LOG_SYSERR << "Unexpected error in Connector::startInLoop " << savedErrno;
       sockets::close(sockfd);
-      // connectErrorCallback_();
+      if (connectErrorCallback_)
+      {
+        connectErrorCallback_();
+      }
       break;
   }
 }
@@ -216,6 +223,11 @@ void Connector::retry(int sockfd)
 {
   sockets::close(sockfd);
   setState(kDisconnected);
+  // not for stop(), the callback may stop it as well
+  if (connect_ && connectErrorCallback_)
+  {
+    connectErrorCallback_();
+  }
   if (connect_)
   {
     LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
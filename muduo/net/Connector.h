@@ -32,6 +32,7 @@ class Connector : noncopyable,
 {
  public:
   typedef std::function<void (int sockfd)> NewConnectionCallback;
+  typedef std::function<void ()> ConnectErrorCallback;
 
   Connector(EventLoop* loop, const InetAddress& serverAddr);
   ~Connector();
@@ -39,6 +40,11 @@ class Connector : noncopyable,
   void setNewConnectionCallback(const NewConnectionCallback& cb)
   { newConnectionCallback_ = cb; }
 
+  /// Called in loop thread on each failed attempt, before retrying.
+  /// Calling stop() from it gives up.
+  void setConnectErrorCallback(const ConnectErrorCallback& cb)
+  { connectErrorCallback_ = cb; }
+
   void start();  // can be called in any thread
   void restart();  // must be called in loop thread
   void stop();  // can be called in any thread
@@ -67,6 +73,7 @@ class Connector : noncopyable,
   States state_;  // FIXME: use atomic variable
   std::unique_ptr<Channel> channel_;  //Connector 对应的通道
   NewConnectionCallback newConnectionCallback_;   //连接成功回调函数
+  ConnectErrorCallback connectErrorCallback_;   //连接失败回调函数
   int retryDelayMs_;   //重连延迟时间
 };
 
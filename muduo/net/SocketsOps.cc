@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>  // snprintf
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/uio.h>  // readv
 #include <unistd.h>
@@ -188,6 +189,22 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
 {
   return ::write(sockfd, buf, count);
 }
+
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int fileFd, int64_t* offset, size_t count)
+{
+  off_t off = static_cast<off_t>(*offset);
+  ssize_t n = ::sendfile(sockfd, fileFd, &off, count);
+  if (n > 0)
+  {
+    *offset = off;
+  }
+  return n;
+}
 //关闭文件描述符
 void sockets::close(int sockfd)
 {
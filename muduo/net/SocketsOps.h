@@ -37,6 +37,9 @@ int  accept(int sockfd, struct sockaddr_in6* addr);
 ssize_t read(int sockfd, void *buf, size_t count);
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt);
 ssize_t write(int sockfd, const void *buf, size_t count);
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);
+// zero-copy transfer from a regular file, advances *offset.
+ssize_t sendfile(int sockfd, int fileFd, int64_t* offset, size_t count);
 void close(int sockfd);
 void shutdownWrite(int sockfd);
 
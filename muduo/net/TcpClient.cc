@@ -132,6 +132,11 @@ void TcpClient::stop()
   connector_->stop();
 }
 
+void TcpClient::setConnectErrorCallback(std::function<void ()> cb)
+{
+  connector_->setConnectErrorCallback(cb);
+}
+
 void TcpClient::newConnection(int sockfd)
 {
   loop_->assertInLoopThread();
@@ -64,6 +64,11 @@ class TcpClient : noncopyable
   void setWriteCompleteCallback(WriteCompleteCallback cb)
   { writeCompleteCallback_ = std::move(cb); }
 
+  /// Set callback for each failed connect attempt, in loop thread.
+  /// Call stop() in it to stop retrying.
+  /// Not thread safe.
+  void setConnectErrorCallback(std::function<void ()> cb);
+
  private:
   /// Not thread safe, but in loop
   void newConnection(int sockfd);
@@ -16,6 +16,8 @@
 #include "muduo/net/SocketsOps.h"
 
 #include <errno.h>
+#include <limits.h>  // IOV_MAX
+#include <sys/uio.h>
 
 using namespace muduo;
 using namespace muduo::net;
@@ -112,7 +114,6 @@ void TcpConnection::send(const StringPiece& message)
   }
 }
 
-// FIXME efficiency!!!
 void TcpConnection::send(Buffer* buf)
 {
   if (state_ == kConnected)
@@ -124,13 +125,104 @@ void TcpConnection::send(Buffer* buf)
     }
     else
     {
-      void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
+      // take over the data instead of copying it
+      std::shared_ptr<Buffer> message(new Buffer(0));
+      message->swap(*buf);
       loop_->runInLoop(
-          std::bind(fp,
+          std::bind(&TcpConnection::sendBufferInLoop,
                     this,     // FIXME
-                    buf->retrieveAllAsString()));
-                    //std::forward<string>(message)));
+                    message));
+    }
+  }
+}
+
+void TcpConnection::send(const std::shared_ptr<const string>& message)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendSharedInLoop(message);
+    }
+    else
+    {
+      loop_->runInLoop(
+          std::bind(&TcpConnection::sendSharedInLoop,
+                    this,     // FIXME
+                    message));
+    }
+  }
+}
+
+void TcpConnection::sendFile(int fileFd, int64_t offset, size_t count,
+                             const std::shared_ptr<void>& guard)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendFileInLoop(fileFd, offset, count, guard);
+    }
+    else
+    {
+      loop_->runInLoop(
+          std::bind(&TcpConnection::sendFileInLoop,
+                    this,     // FIXME
+                    fileFd, offset, count, guard));
+    }
+  }
+}
+
+void TcpConnection::sendv(const struct iovec* iov, int iovcnt)
+{
+  loop_->assertInLoopThread();
+  if (state_ != kConnected)
+  {
+    return;
+  }
+  size_t len = 0;
+  for (int i = 0; i < iovcnt; ++i)
+  {
+    len += iov[i].iov_len;
+  }
+
+  ssize_t nwrote = 0;
+  bool faultError = false;
+  if (pendingFiles_.empty() && !channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  {
+    nwrote = sockets::writev(channel_->fd(), iov, std::min(iovcnt, IOV_MAX));
+    if (nwrote >= 0)
+    {
+      if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+    }
+    else
+    {
+      nwrote = 0;
+      if (errno != EWOULDBLOCK)
+      {
+        LOG_SYSERR << "TcpConnection::sendv";
+        if (errno == EPIPE || errno == ECONNRESET)
+        {
+          faultError = true;
+        }
+      }
+    }
+  }
+
+  // the rest, in order, after what was written
+  size_t skip = implicit_cast<size_t>(nwrote);
+  for (int i = 0; i < iovcnt && !faultError; ++i)
+  {
+    if (skip >= iov[i].iov_len)
+    {
+      skip -= iov[i].iov_len;
+      continue;
     }
+    sendInLoop(static_cast<const char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+    skip = 0;
   }
 }
 
@@ -139,6 +231,16 @@ void TcpConnection::sendInLoop(const StringPiece& message)
   sendInLoop(message.data(), message.size());
 }
 
+void TcpConnection::sendSharedInLoop(const std::shared_ptr<const string>& message)
+{
+  sendInLoop(message->data(), message->size());
+}
+
+void TcpConnection::sendBufferInLoop(const std::shared_ptr<Buffer>& message)
+{
+  sendInLoop(message->peek(), message->readableBytes());
+}
+
 void TcpConnection::sendInLoop(const void* data, size_t len)
 {
   loop_->assertInLoopThread();
@@ -150,6 +252,13 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     LOG_WARN << "disconnected, give up writing";
     return;
   }
+  // keep the order, data goes after the file being sent
+  if (!pendingFiles_.empty())
+  {
+    checkHighWaterMark(len);
+    pendingFiles_.back().trailer.append(data, len);
+    return;
+  }
   // if no thing in output queue, try writing directly
   //是否关注可写事件
   //通道 没有关注可写事件  并且   发送缓冲区没有数据,直接write
@@ -182,15 +291,8 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
   //没有错误,并且还有未写完的数据(说明内核发送缓冲区满,要将未写完的数据添加到 output buffer 中)
   if (!faultError && remaining > 0)
   {
-    size_t oldLen = outputBuffer_.readableBytes();
-
     //如果超过highwaterMark_ ( 高水位标),回调 highWaterMarkCallback
-    if (oldLen + remaining >= highWaterMark_
-        && oldLen < highWaterMark_
-        && highWaterMarkCallback_)
-    {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-    }
+    checkHighWaterMark(remaining);
     outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
     if (!channel_->isWriting())
     {
@@ -198,6 +300,106 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     }
   }
 }
+void TcpConnection::sendFileInLoop(int fileFd, int64_t offset, size_t count,
+                                   const std::shared_ptr<void>& guard)
+{
+  loop_->assertInLoopThread();
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return;
+  }
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+  {
+    assert(pendingFiles_.empty());
+    ssize_t nwrote = sockets::sendfile(channel_->fd(), fileFd, &offset, count);
+    if (nwrote > 0 || (nwrote == 0 && count == 0))
+    {
+      count -= nwrote;
+      if (count == 0)
+      {
+        if (writeCompleteCallback_)
+        {
+          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        return;
+      }
+    }
+    else if (nwrote == 0 || errno != EWOULDBLOCK)
+    {
+      // the peer would take what follows for the rest of the file
+      if (nwrote == 0)
+        LOG_ERROR << "TcpConnection::sendFileInLoop file shorter than " << count << " bytes";
+      else
+        LOG_SYSERR << "TcpConnection::sendFileInLoop";
+      forceClose();
+      return;
+    }
+  }
+
+  checkHighWaterMark(count);
+  PendingFile file;
+  file.fd = fileFd;
+  file.offset = offset;
+  file.remaining = count;
+  file.guard = guard;
+  pendingFiles_.push_back(file);
+  if (!channel_->isWriting())
+  {
+    channel_->enableWriting();
+  }
+}
+
+size_t TcpConnection::queuedBytes() const
+{
+  size_t bytes = outputBuffer_.readableBytes();
+  for (const PendingFile& file : pendingFiles_)
+  {
+    bytes += file.remaining + file.trailer.readableBytes();
+  }
+  return bytes;
+}
+
+void TcpConnection::checkHighWaterMark(size_t added)
+{
+  size_t oldLen = queuedBytes();
+  if (oldLen + added >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + added));
+  }
+}
+
+void TcpConnection::writePendingFile()
+{
+  assert(outputBuffer_.readableBytes() == 0);
+  PendingFile& file = pendingFiles_.front();
+  ssize_t n = sockets::sendfile(channel_->fd(), file.fd, &file.offset, file.remaining);
+  if (n > 0)
+  {
+    file.remaining -= n;
+  }
+  else if (n == 0 || errno != EWOULDBLOCK)
+  {
+    // file truncated or not sendfile-able, the peer would take the
+    // trailer for the rest of it.  The file stays queued, so nothing
+    // else is written before the connection is closed.
+    if (n == 0)
+      LOG_ERROR << "TcpConnection::writePendingFile file shorter by " << file.remaining << " bytes";
+    else
+      LOG_SYSERR << "TcpConnection::writePendingFile";
+    forceClose();
+    return;
+  }
+
+  if (file.remaining == 0)
+  {
+    outputBuffer_.swap(file.trailer);
+    pendingFiles_.pop_front();
+  }
+}
+
 /*
     应用程序想关闭连接,但是有可能处于发送数据的过程中, output buffer 中有数据还没发完, 不能
     直接调用close()   
@@ -405,13 +607,24 @@ void TcpConnection::handleWrite()
   //如果处于 POLLOUT 事件
   if (channel_->isWriting())
   {
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());
+    ssize_t n = 1;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+      n = sockets::write(channel_->fd(),
+                         outputBuffer_.peek(),
+                         outputBuffer_.readableBytes());
+      if (n > 0)
+      {
+        outputBuffer_.retrieve(n);
+      }
+    }
+    if (n > 0 && outputBuffer_.readableBytes() == 0 && !pendingFiles_.empty())
+    {
+      writePendingFile();
+    }
     if (n > 0)
     {
-      outputBuffer_.retrieve(n);
-      if (outputBuffer_.readableBytes() == 0) //发送缓冲区已经清空
+      if (outputBuffer_.readableBytes() == 0 && pendingFiles_.empty()) //发送缓冲区已经清空
       { 
         channel_->disableWriting();   //停止关注(POLLOUT)事件,一面出现 busy loop 
         if (writeCompleteCallback_)  //回调writeCompleteCallback_
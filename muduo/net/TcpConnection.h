@@ -18,10 +18,13 @@
 #include "muduo/net/Buffer.h"
 #include "muduo/net/InetAddress.h"
 
+#include <deque>
 #include <memory>
 
 #include <boost/any.hpp>
 
+struct iovec;
+
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
 
@@ -67,6 +70,19 @@ class TcpConnection : noncopyable,
   void send(const StringPiece& message);
   // void send(Buffer&& message); // C++11
   void send(Buffer* message);  // this one will swap data
+  // message is shared rather than copied when called from other threads,
+  // eg. one encoded frame broadcast to many connections.
+  void send(const std::shared_ptr<const string>& message);
+  // Sends count bytes of fileFd starting at offset with sendfile(2),
+  // the content is not copied through outputBuffer_.
+  // guard keeps fileFd open until the transfer is done,
+  // data sent afterwards is queued behind the file.
+  void sendFile(int fileFd, int64_t offset, size_t count,
+                const std::shared_ptr<void>& guard);
+  // Gathers the pieces with writev(2), what the kernel does not take is
+  // copied into outputBuffer_, so the pieces need not outlive the call.
+  // In the loop thread only.
+  void sendv(const struct iovec* iov, int iovcnt);
   void shutdown(); // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
   void forceClose();
@@ -95,6 +111,9 @@ class TcpConnection : noncopyable,
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }
 
+  const WriteCompleteCallback& writeCompleteCallback() const
+  { return writeCompleteCallback_; }
+
   void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
   { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
@@ -116,6 +135,15 @@ class TcpConnection : noncopyable,
 
  private:
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
+  // a file being sent by sendFile(), it goes after outputBuffer_
+  struct PendingFile
+  {
+    int fd;
+    int64_t offset;
+    size_t remaining;
+    std::shared_ptr<void> guard;
+    Buffer trailer;  // data sent after this file
+  };
   void handleRead(Timestamp receiveTime);
   void handleWrite();
   void handleClose();
@@ -124,6 +152,16 @@ class TcpConnection : noncopyable,
   // void sendInLoop(string&& message);
   void sendInLoop(const StringPiece& message);
   void sendInLoop(const void* message, size_t len);
+  void sendSharedInLoop(const std::shared_ptr<const string>& message);
+  void sendBufferInLoop(const std::shared_ptr<Buffer>& message);
+  void sendFileInLoop(int fileFd, int64_t offset, size_t count,
+                      const std::shared_ptr<void>& guard);
+  void writePendingFile();
+  // outputBuffer_ plus pending files and their trailers
+  size_t queuedBytes() const;
+  // calls highWaterMarkCallback_ if added bytes cross highWaterMark_,
+  // before they are queued
+  void checkHighWaterMark(size_t added);
   void shutdownInLoop();
   // void shutdownAndForceCloseInLoop(double seconds);
   void forceCloseInLoop();
@@ -165,6 +203,7 @@ class TcpConnection : noncopyable,
   size_t highWaterMark_; // 高水位标,高水位达到多少调用 high 函数
   Buffer inputBuffer_;   //应用层接受缓冲区
   Buffer outputBuffer_; // 应用层发送缓冲区                             FIXME: use list<Buffer> as output buffer.
+  std::deque<PendingFile> pendingFiles_;
   boost::any context_;   //绑定一个未知类型的上下文对象   
   /*
         可变类型解决方案  
@@ -11,34 +11,123 @@ namespace net
 {
 
 // input is zlib compressed data, output uncompressed data
-// FIXME: finish this
 class ZlibInputStream : noncopyable
 {
  public:
   explicit ZlibInputStream(Buffer* output)
     : output_(output),
-      zerror_(Z_OK)
+      zerror_(Z_OK),
+      bufferSize_(1024)
   {
     memZero(&zstream_, sizeof zstream_);
     zerror_ = inflateInit(&zstream_);
   }
 
+  // windowBits as in inflateInit2, eg. -MAX_WBITS for raw deflate data.
+  ZlibInputStream(Buffer* output, int windowBits)
+    : output_(output),
+      zerror_(Z_OK),
+      bufferSize_(1024)
+  {
+    memZero(&zstream_, sizeof zstream_);
+    zerror_ = inflateInit2(&zstream_, windowBits);
+  }
+
   ~ZlibInputStream()
   {
     finish();
   }
 
-  bool write(StringPiece buf);
-  bool write(Buffer* input);
-  bool finish();
-    // inflateEnd(&zstream_);
+  // Return last error message or NULL if no error.
+  const char* zlibErrorMessage() const { return zstream_.msg; }
+
+  int zlibErrorCode() const { return zerror_; }
+  int64_t inputBytes() const { return zstream_.total_in; }
+  int64_t outputBytes() const { return zstream_.total_out; }
+
+  // decompress all of buf, returns false on corrupted data.
+  bool write(StringPiece buf)
+  {
+    if (zerror_ != Z_OK)
+      return false;
+
+    void* in = const_cast<char*>(buf.data());
+    zstream_.next_in = static_cast<Bytef*>(in);
+    zstream_.avail_in = buf.size();
+    decompressAll();
+    zstream_.next_in = NULL;
+    zstream_.avail_in = 0;
+    return zerror_ == Z_OK || zerror_ == Z_STREAM_END;
+  }
+
+  // decompresses buf until output holds more than maxOutputBytes,
+  // the rest of buf is dropped then, returns false on corrupted data.
+  bool write(StringPiece buf, size_t maxOutputBytes)
+  {
+    if (zerror_ != Z_OK)
+      return false;
+
+    void* in = const_cast<char*>(buf.data());
+    zstream_.next_in = static_cast<Bytef*>(in);
+    zstream_.avail_in = buf.size();
+    decompressAll(maxOutputBytes);
+    zstream_.next_in = NULL;
+    zstream_.avail_in = 0;
+    return zerror_ == Z_OK || zerror_ == Z_STREAM_END;
+  }
+
+  bool write(Buffer* input)
+  {
+    bool ok = write(StringPiece(input->peek(), static_cast<int>(input->readableBytes())));
+    input->retrieveAll();
+    return ok;
+  }
+
+  bool finish()
+  {
+    bool ok = zerror_ == Z_OK || zerror_ == Z_STREAM_END;
+    if (zstream_.state != NULL)
+    {
+      ok = inflateEnd(&zstream_) == Z_OK && ok;
+      if (ok)
+        zerror_ = Z_STREAM_END;
+    }
+    return ok;
+  }
 
  private:
-  int decompress(int flush);
+  void decompressAll(size_t maxOutputBytes = static_cast<size_t>(-1))
+  {
+    do
+    {
+      zerror_ = decompress(Z_NO_FLUSH);
+    } while (zerror_ == Z_OK && (zstream_.avail_in > 0 || zstream_.avail_out == 0)
+             && output_->readableBytes() <= maxOutputBytes);
+    if (zerror_ == Z_BUF_ERROR && zstream_.avail_in == 0)
+    {
+      // no progress possible, all input consumed
+      zerror_ = Z_OK;
+    }
+  }
+
+  int decompress(int flush)
+  {
+    output_->ensureWritableBytes(bufferSize_);
+    zstream_.next_out = reinterpret_cast<Bytef*>(output_->beginWrite());
+    zstream_.avail_out = static_cast<int>(output_->writableBytes());
+    int error = ::inflate(&zstream_, flush);
+    output_->hasWritten(output_->writableBytes() - zstream_.avail_out);
+    if (output_->writableBytes() == 0 && bufferSize_ < 65536)
+    {
+      bufferSize_ *= 2;
+    }
+    return error;
+  }
 
   Buffer* output_;
   z_stream zstream_;
   int zerror_;
+  int bufferSize_;
 };
 
 // input is uncompressed data, output zlib compressed data
@@ -54,6 +143,19 @@ class ZlibOutputStream : noncopyable
     zerror_ = deflateInit(&zstream_, Z_DEFAULT_COMPRESSION);
   }
 
+  // windowBits as in deflateInit2, eg. MAX_WBITS + 16 for gzip wrapper,
+  // -MAX_WBITS for raw deflate data.
+  ZlibOutputStream(Buffer* output, int level, int windowBits)
+    : output_(output),
+      zerror_(Z_OK),
+      bufferSize_(1024)
+  {
+    memZero(&zstream_, sizeof zstream_);
+    zerror_ = deflateInit2(&zstream_, level, Z_DEFLATED,
+                           windowBits,
+                           8, Z_DEFAULT_STRATEGY);
+  }
+
   ~ZlibOutputStream()
   {
     finish();
@@ -105,6 +207,25 @@ class ZlibOutputStream : noncopyable
     return zerror_ == Z_OK;
   }
 
+  // output everything written so far, aligned to a byte boundary,
+  // so that the peer can decompress it before finish().
+  bool flush()
+  {
+    if (zerror_ != Z_OK)
+      return false;
+
+    do
+    {
+      zerror_ = compress(Z_SYNC_FLUSH);
+    } while (zerror_ == Z_OK && zstream_.avail_out == 0);
+    if (zerror_ == Z_BUF_ERROR)
+    {
+      // no progress possible, nothing left to flush
+      zerror_ = Z_OK;
+    }
+    return zerror_ == Z_OK;
+  }
+
   bool finish()
   {
     if (zerror_ != Z_OK)
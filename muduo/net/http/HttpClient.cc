@@ -0,0 +1,521 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpClient.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/http/HttpContext.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct HttpClient::Call : noncopyable
+{
+  Call()
+    : host(NULL),
+      conn(NULL),
+      idempotent(true),
+      head(false),
+      retries(0),
+      done(false)
+  {
+  }
+
+  string request;  // serialized
+  ResponseCallback cb;
+  TimerId timer;
+  Host* host;
+  Connection* conn;  // NULL if not sent yet
+  bool idempotent;
+  bool head;
+  int retries;
+  bool done;
+};
+
+struct HttpClient::Host : noncopyable
+{
+  explicit Host(const InetAddress& serverAddr)
+    : addr(serverAddr)
+  {
+  }
+
+  const InetAddress addr;
+  std::vector<ConnectionPtr> connections;
+  std::deque<CallPtr> pending;
+};
+
+// one keep-alive connection, responses come back in request order.
+class HttpClient::Connection : noncopyable
+{
+ public:
+  Connection(HttpClient* owner, Host* host, EventLoop* loop, const string& name)
+    : owner_(owner),
+      host_(host),
+      client_(loop, host->addr, name),
+      closing_(false),
+      closed_(false)
+  {
+    client_.setConnectionCallback(
+        std::bind(&Connection::onConnection, this, _1));
+    client_.setMessageCallback(
+        std::bind(&Connection::onMessage, this, _1, _2, _3));
+    client_.setConnectErrorCallback(
+        std::bind(&Connection::onConnectError, this));
+  }
+
+  Host* host() const { return host_; }
+
+  void connect() { client_.connect(); }
+
+  bool connecting() const { return !conn_ && !closed_; }
+
+  bool usable() const { return conn_ && !closing_; }
+
+  const std::deque<CallPtr>& inflight() const { return inflight_; }
+
+  // all in-flight requests are idempotent, safe to pipeline behind them
+  bool pipelinable() const
+  {
+    for (const CallPtr& call : inflight_)
+    {
+      if (!call->idempotent)
+        return false;
+    }
+    return true;
+  }
+
+  void send(const CallPtr& call)
+  {
+    assert(usable());
+    call->conn = this;
+    inflight_.push_back(call);
+    conn_->send(call->request);
+  }
+
+  void close()
+  {
+    closing_ = true;
+    if (conn_)
+    {
+      conn_->forceClose();
+    }
+  }
+
+  std::deque<CallPtr> takeInflight()
+  {
+    std::deque<CallPtr> calls;
+    calls.swap(inflight_);
+    return calls;
+  }
+
+  // called by ~HttpClient, no more callbacks after this
+  void detach()
+  {
+    if (conn_)
+    {
+      conn_->setConnectionCallback(defaultConnectionCallback);
+      conn_->setMessageCallback(defaultMessageCallback);
+      conn_.reset();
+    }
+    client_.stop();
+  }
+
+ private:
+  void onConnection(const TcpConnectionPtr& conn)
+  {
+    if (conn->connected())
+    {
+      conn_ = conn;
+      conn_->setTcpNoDelay(true);
+      owner_->onConnected(this);
+    }
+    else
+    {
+      closed_ = true;
+      conn_.reset();
+      // body delimited by connection close
+      if (!inflight_.empty() && !context_.idle() && context_.onConnectionClosed())
+      {
+        deliverFront();
+      }
+      owner_->onClosed(this);
+    }
+  }
+
+  // in the Connector, before its retry
+  void onConnectError()
+  {
+    client_.stop();
+    closed_ = true;
+    owner_->onConnectFailed(this);
+  }
+
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+  {
+    while (!inflight_.empty() && !closing_)
+    {
+      if (!context_.parseResponse(buf, receiveTime, inflight_.front()->head))
+      {
+        LOG_ERROR << "HttpClient bad response from " << conn->peerAddress().toIpPort();
+        CallPtr call = inflight_.front();
+        inflight_.pop_front();
+        call->conn = NULL;
+        close();
+        owner_->finish(call, HttpClientResponse(HttpClientResponse::kBadResponse));
+        return;
+      }
+      if (!context_.gotAll())
+      {
+        return;
+      }
+      if (context_.closeAfterResponse())
+      {
+        // the rest will be retried on a new connection
+        closing_ = true;
+        conn->shutdown();
+      }
+      deliverFront();
+    }
+
+    if (buf->readableBytes() > 0 && !closing_)
+    {
+      LOG_ERROR << "HttpClient unexpected data from " << conn->peerAddress().toIpPort();
+      buf->retrieveAll();
+      close();
+    }
+  }
+
+  void deliverFront()
+  {
+    CallPtr call = inflight_.front();
+    inflight_.pop_front();
+    call->conn = NULL;
+    HttpClientResponse response;
+    response.swap(context_.response());
+    context_.reset();
+    owner_->onResponse(this, call, response);
+  }
+
+  HttpClient* owner_;
+  Host* host_;
+  TcpClient client_;
+  TcpConnectionPtr conn_;
+  HttpResponseContext context_;
+  std::deque<CallPtr> inflight_;
+  bool closing_;
+  bool closed_;
+};
+
+namespace
+{
+
+const char* methodName(HttpRequest::Method method)
+{
+  switch (method)
+  {
+    case HttpRequest::kPost:
+      return "POST";
+    case HttpRequest::kHead:
+      return "HEAD";
+    case HttpRequest::kPut:
+      return "PUT";
+    case HttpRequest::kDelete:
+      return "DELETE";
+    default:
+      return "GET";
+  }
+}
+
+string serialize(const HttpRequest& req, const InetAddress& server)
+{
+  string result;
+  result.reserve(256 + req.body().size());
+  result += methodName(req.method());
+  result += ' ';
+  result += req.path().empty() ? "/" : req.path();
+  result += req.query();
+  result += " HTTP/1.1\r\n";
+  bool hasHost = false;
+  bool hasLength = false;
+  for (const auto& header : req.headers())
+  {
+    hasHost = hasHost || header.first == "Host";
+    hasLength = hasLength || header.first == "Content-Length";
+    result += header.first;
+    result += ": ";
+    result += header.second;
+    result += "\r\n";
+  }
+  if (!hasHost)
+  {
+    result += "Host: ";
+    result += server.toIpPort();
+    result += "\r\n";
+  }
+  if (!hasLength && (!req.body().empty()
+                     || req.method() == HttpRequest::kPost
+                     || req.method() == HttpRequest::kPut))
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", req.body().size());
+    result += buf;
+  }
+  result += "\r\n";
+  result += req.body();
+  return result;
+}
+
+void destroyConnection(const std::shared_ptr<void>&)
+{
+}
+
+}  // namespace
+
+HttpClient::HttpClient(EventLoop* loop, const string& name)
+  : loop_(CHECK_NOTNULL(loop)),
+    name_(name),
+    maxConnectionsPerHost_(4),
+    maxPipelineDepth_(1),
+    timeout_(30.0),
+    nextConnId_(1)
+{
+}
+
+HttpClient::~HttpClient()
+{
+  loop_->assertInLoopThread();
+  for (auto& entry : hosts_)
+  {
+    Host* host = entry.second.get();
+    for (const CallPtr& call : host->pending)
+    {
+      loop_->cancel(call->timer);
+    }
+    for (const ConnectionPtr& conn : host->connections)
+    {
+      for (const CallPtr& call : conn->inflight())
+      {
+        loop_->cancel(call->timer);
+      }
+      conn->detach();
+    }
+  }
+}
+
+void HttpClient::request(const InetAddress& server,
+                         const HttpRequest& req,
+                         const ResponseCallback& cb)
+{
+  CallPtr call(new Call);
+  call->request = serialize(req, server);
+  call->cb = cb;
+  HttpRequest::Method method = req.method();
+  call->idempotent = method != HttpRequest::kPost;
+  call->head = method == HttpRequest::kHead;
+  loop_->runInLoop(
+      std::bind(&HttpClient::requestInLoop, this, server, call));
+}
+
+void HttpClient::get(const InetAddress& server,
+                     const string& path,
+                     const ResponseCallback& cb)
+{
+  HttpRequest req;
+  req.setMethod(HttpRequest::kGet);
+  size_t question = path.find('?');
+  req.setPath(path.data(), path.data() + std::min(question, path.size()));
+  if (question != string::npos)
+  {
+    req.setQuery(path.data() + question, path.data() + path.size());
+  }
+  request(server, req, cb);
+}
+
+size_t HttpClient::numConnections(const InetAddress& server) const
+{
+  loop_->assertInLoopThread();
+  HostMap::const_iterator it = hosts_.find(server.toIpPort());
+  return it != hosts_.end() ? it->second->connections.size() : 0;
+}
+
+void HttpClient::requestInLoop(const InetAddress& server, const CallPtr& call)
+{
+  loop_->assertInLoopThread();
+  std::unique_ptr<Host>& host = hosts_[server.toIpPort()];
+  if (!host)
+  {
+    host.reset(new Host(server));
+  }
+  call->host = host.get();
+  call->timer = loop_->runAfter(
+      timeout_,
+      std::bind(&HttpClient::onTimeout, this, std::weak_ptr<Call>(call)));
+  host->pending.push_back(call);
+  dispatch(host.get());
+}
+
+HttpClient::Connection* HttpClient::pickConnection(Host* host, const Call& call)
+{
+  Connection* best = NULL;
+  for (const ConnectionPtr& conn : host->connections)
+  {
+    if (!conn->usable())
+      continue;
+    size_t inflight = conn->inflight().size();
+    bool ok = inflight == 0
+        || (call.idempotent
+            && inflight < static_cast<size_t>(maxPipelineDepth_)
+            && conn->pipelinable());
+    if (ok && (best == NULL || inflight < best->inflight().size()))
+    {
+      best = get_pointer(conn);
+    }
+  }
+  return best;
+}
+
+void HttpClient::dispatch(Host* host)
+{
+  while (!host->pending.empty())
+  {
+    Connection* conn = pickConnection(host, *host->pending.front());
+    if (conn == NULL)
+      break;
+    CallPtr call = host->pending.front();
+    host->pending.pop_front();
+    conn->send(call);
+  }
+
+  // open new connections unless enough are on the way
+  size_t connecting = 0;
+  for (const ConnectionPtr& conn : host->connections)
+  {
+    if (conn->connecting())
+      ++connecting;
+  }
+  while (!host->pending.empty()
+         && host->connections.size() < static_cast<size_t>(maxConnectionsPerHost_)
+         && connecting * maxPipelineDepth_ < host->pending.size())
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "-%s#%d", host->addr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    ConnectionPtr conn(new Connection(this, host, loop_, name_ + buf));
+    host->connections.push_back(conn);
+    ++connecting;
+    conn->connect();
+  }
+}
+
+void HttpClient::onConnected(Connection* conn)
+{
+  dispatch(conn->host());
+}
+
+void HttpClient::onClosed(Connection* conn)
+{
+  Host* host = conn->host();
+  std::deque<CallPtr> calls = conn->takeInflight();
+  // retry in original order, ahead of newer requests
+  for (auto it = calls.rbegin(); it != calls.rend(); ++it)
+  {
+    const CallPtr& call = *it;
+    call->conn = NULL;
+    if (call->done)
+      continue;
+    if (call->idempotent && call->retries == 0)
+    {
+      ++call->retries;
+      host->pending.push_front(call);
+    }
+    else
+    {
+      finish(call, HttpClientResponse(HttpClientResponse::kConnectionClosed));
+    }
+  }
+  removeConnection(conn);
+  dispatch(host);
+}
+
+void HttpClient::onConnectFailed(Connection* conn)
+{
+  Host* host = conn->host();
+  assert(conn->inflight().empty());
+  removeConnection(conn);
+  for (const ConnectionPtr& other : host->connections)
+  {
+    if (other->usable() || other->connecting())
+      return;
+  }
+  std::deque<CallPtr> calls;
+  calls.swap(host->pending);
+  for (const CallPtr& call : calls)
+  {
+    finish(call, HttpClientResponse(HttpClientResponse::kConnectFailed));
+  }
+}
+
+void HttpClient::removeConnection(Connection* conn)
+{
+  std::vector<ConnectionPtr>& connections = conn->host()->connections;
+  for (size_t i = 0; i < connections.size(); ++i)
+  {
+    if (get_pointer(connections[i]) == conn)
+    {
+      // TcpClient is still on the stack, destroy it later
+      loop_->queueInLoop(std::bind(&destroyConnection, connections[i]));
+      connections.erase(connections.begin() + i);
+      break;
+    }
+  }
+}
+
+void HttpClient::onResponse(Connection* conn, const CallPtr& call, const HttpClientResponse& response)
+{
+  finish(call, response);
+  dispatch(conn->host());
+}
+
+void HttpClient::onTimeout(const std::weak_ptr<Call>& weakCall)
+{
+  CallPtr call(weakCall.lock());
+  if (!call || call->done)
+    return;
+
+  Connection* conn = call->conn;
+  if (conn == NULL)
+  {
+    std::deque<CallPtr>& pending = call->host->pending;
+    pending.erase(std::remove(pending.begin(), pending.end(), call), pending.end());
+  }
+  finish(call, HttpClientResponse(HttpClientResponse::kTimeout));
+  if (conn)
+  {
+    // responses are in order, this connection can not be used any more
+    conn->close();
+  }
+}
+
+void HttpClient::finish(const CallPtr& call, const HttpClientResponse& response)
+{
+  if (call->done)
+    return;
+  call->done = true;
+  loop_->cancel(call->timer);
+  if (call->cb)
+  {
+    call->cb(response);
+  }
+}
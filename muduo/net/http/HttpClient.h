@@ -0,0 +1,112 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPCLIENT_H
+#define MUDUO_NET_HTTP_HTTPCLIENT_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TimerId.h"
+#include "muduo/net/http/HttpClientResponse.h"
+#include "muduo/net/http/HttpRequest.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+/// Asynchronous HTTP/1.1 client.
+///
+/// Keeps a pool of keep-alive connections per server, each built on a
+/// TcpClient. Idempotent requests are pipelined on a connection up to
+/// setMaxPipelineDepth(), and retried once if the connection is closed
+/// before the response arrives. Every request has a timeout driven by
+/// the TimerQueue of the loop. A connection is not retried if it can't
+/// be made, the requests waiting for it fail with kConnectFailed unless
+/// another connection to the server is up or on the way.
+///
+/// request() is thread safe, callbacks run in the loop thread.
+/// Must be destroyed in the loop thread.
+class HttpClient : noncopyable
+{
+ public:
+  typedef std::function<void (const HttpClientResponse&)> ResponseCallback;
+
+  HttpClient(EventLoop* loop, const string& name);
+  ~HttpClient();
+
+  EventLoop* getLoop() const { return loop_; }
+
+  /// Not thread safe, set before first request.
+  void setMaxConnectionsPerHost(int n)
+  { maxConnectionsPerHost_ = n; }
+
+  /// 1 disables pipelining.
+  void setMaxPipelineDepth(int n)
+  { maxPipelineDepth_ = n; }
+
+  /// Seconds from request() to the end of the response.
+  void setTimeout(double seconds)
+  { timeout_ = seconds; }
+
+  /// Sends req to server, cb is called with the response or an error.
+  /// Host header is set to server if req does not have one.
+  void request(const InetAddress& server,
+               const HttpRequest& req,
+               const ResponseCallback& cb);
+
+  void get(const InetAddress& server,
+           const string& path,
+           const ResponseCallback& cb);
+
+  /// Number of connections to server, for testing.
+  size_t numConnections(const InetAddress& server) const;
+
+ private:
+  class Connection;
+  struct Call;
+  struct Host;
+  typedef std::shared_ptr<Connection> ConnectionPtr;
+  typedef std::shared_ptr<Call> CallPtr;
+  typedef std::map<string, std::unique_ptr<Host>> HostMap;
+
+  void requestInLoop(const InetAddress& server, const CallPtr& call);
+  void dispatch(Host* host);
+  Connection* pickConnection(Host* host, const Call& call);
+  void onConnected(Connection* conn);
+  void onClosed(Connection* conn);
+  void onConnectFailed(Connection* conn);
+  void onResponse(Connection* conn, const CallPtr& call, const HttpClientResponse& response);
+  void onTimeout(const std::weak_ptr<Call>& weakCall);
+  void finish(const CallPtr& call, const HttpClientResponse& response);
+  void removeConnection(Connection* conn);
+
+  EventLoop* loop_;
+  const string name_;
+  int maxConnectionsPerHost_;
+  int maxPipelineDepth_;
+  double timeout_;
+  int nextConnId_;
+  // always in loop thread
+  HostMap hosts_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPCLIENT_H
@@ -0,0 +1,178 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPCLIENTRESPONSE_H
+#define MUDUO_NET_HTTP_HTTPCLIENTRESPONSE_H
+
+#include "muduo/base/copyable.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <map>
+
+#include <strings.h>
+
+namespace muduo
+{
+namespace net
+{
+
+/// A HTTP response received by HttpClient.
+class HttpClientResponse : public muduo::copyable
+{
+ public:
+  enum Error
+  {
+    kNoError,
+    kTimeout,
+    kConnectionClosed,
+    kBadResponse,
+    kConnectFailed,
+  };
+
+  // header field names are case-insensitive
+  struct CaseInsensitiveLess
+  {
+    bool operator()(const string& lhs, const string& rhs) const
+    { return ::strcasecmp(lhs.c_str(), rhs.c_str()) < 0; }
+  };
+  typedef std::map<string, string, CaseInsensitiveLess> Headers;
+
+  HttpClientResponse()
+    : error_(kNoError),
+      statusCode_(0),
+      minorVersion_(1)
+  {
+  }
+
+  explicit HttpClientResponse(Error error)
+    : error_(error),
+      statusCode_(0),
+      minorVersion_(1)
+  {
+  }
+
+  bool ok() const
+  { return error_ == kNoError; }
+
+  Error error() const
+  { return error_; }
+
+  const char* errorString() const
+  {
+    switch (error_)
+    {
+      case kNoError:
+        return "no error";
+      case kTimeout:
+        return "timeout";
+      case kConnectionClosed:
+        return "connection closed";
+      case kBadResponse:
+        return "bad response";
+      case kConnectFailed:
+        return "connect failed";
+      default:
+        return "unknown error";
+    }
+  }
+
+  void setStatus(int code, const char* start, const char* end)
+  {
+    statusCode_ = code;
+    statusMessage_.assign(start, end);
+  }
+
+  int statusCode() const
+  { return statusCode_; }
+
+  const string& statusMessage() const
+  { return statusMessage_; }
+
+  void setMinorVersion(int v)
+  { minorVersion_ = v; }
+
+  // 0 for HTTP/1.0, 1 for HTTP/1.1
+  int minorVersion() const
+  { return minorVersion_; }
+
+  void setReceiveTime(Timestamp t)
+  { receiveTime_ = t; }
+
+  Timestamp receiveTime() const
+  { return receiveTime_; }
+
+  // same as HttpRequest::addHeader, repeated fields are joined with ", "
+  void addHeader(const char* start, const char* colon, const char* end)
+  {
+    string field(start, colon);
+    ++colon;
+    while (colon < end && isspace(*colon))
+    {
+      ++colon;
+    }
+    string value(colon, end);
+    while (!value.empty() && isspace(value[value.size()-1]))
+    {
+      value.resize(value.size()-1);
+    }
+    string& existing = headers_[field];
+    if (!existing.empty())
+    {
+      existing += ", ";
+    }
+    existing += value;
+  }
+
+  string getHeader(const string& field) const
+  {
+    string result;
+    Headers::const_iterator it = headers_.find(field);
+    if (it != headers_.end())
+    {
+      result = it->second;
+    }
+    return result;
+  }
+
+  const Headers& headers() const
+  { return headers_; }
+
+  void appendBody(const char* data, size_t len)
+  { body_.append(data, len); }
+
+  const string& body() const
+  { return body_; }
+
+  void swap(HttpClientResponse& that)
+  {
+    std::swap(error_, that.error_);
+    std::swap(statusCode_, that.statusCode_);
+    std::swap(minorVersion_, that.minorVersion_);
+    statusMessage_.swap(that.statusMessage_);
+    receiveTime_.swap(that.receiveTime_);
+    headers_.swap(that.headers_);
+    body_.swap(that.body_);
+  }
+
+ private:
+  Error error_;
+  int statusCode_;
+  int minorVersion_;
+  string statusMessage_;
+  Timestamp receiveTime_;
+  Headers headers_;
+  string body_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPCLIENTRESPONSE_H
@@ -0,0 +1,344 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpCompressor.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// q value of one element of Accept-Encoding, eg. "gzip;q=0.5"
+double qvalue(const char* begin, const char* end)
+{
+  const char* semicolon = std::find(begin, end, ';');
+  for (const char* p = semicolon; p + 2 < end; ++p)
+  {
+    if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+    {
+      return strtod(p + 2, NULL);
+    }
+  }
+  return 1.0;
+}
+
+bool tokenIs(const char* begin, const char* end, const char* token)
+{
+  while (begin < end && *begin == ' ')
+    ++begin;
+  const char* tokenEnd = std::find(begin, end, ';');
+  while (tokenEnd > begin && tokenEnd[-1] == ' ')
+    --tokenEnd;
+  size_t len = strlen(token);
+  return static_cast<size_t>(tokenEnd - begin) == len
+      && ::strncasecmp(begin, token, len) == 0;
+}
+
+}  // namespace
+
+HttpCompressor::Encoding HttpCompressor::negotiate(const string& acceptEncoding)
+{
+  double gzip = 0.0;
+  double deflate = 0.0;
+  double any = -1.0;
+  const char* p = acceptEncoding.c_str();
+  const char* end = p + acceptEncoding.size();
+  while (p < end)
+  {
+    const char* comma = std::find(p, end, ',');
+    if (tokenIs(p, comma, "gzip") || tokenIs(p, comma, "x-gzip"))
+    {
+      gzip = qvalue(p, comma);
+    }
+    else if (tokenIs(p, comma, "deflate"))
+    {
+      deflate = qvalue(p, comma);
+    }
+    else if (tokenIs(p, comma, "*"))
+    {
+      any = qvalue(p, comma);
+    }
+    p = comma == end ? end : comma + 1;
+  }
+  if (any > 0.0 && gzip == 0.0 && acceptEncoding.find("gzip") == string::npos)
+  {
+    gzip = any;
+  }
+
+  if (gzip > 0.0 && gzip >= deflate)
+    return kGzip;
+  else if (deflate > 0.0)
+    return kDeflate;
+  return kIdentity;
+}
+
+const char* HttpCompressor::encodingName(Encoding encoding)
+{
+  switch (encoding)
+  {
+    case kGzip:
+      return "gzip";
+    case kDeflate:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+HttpCompressor::HttpCompressor(Buffer* output, Encoding encoding, bool chunked, int level)
+  : output_(output),
+    chunked_(chunked),
+    stream_(chunked ? &compressed_ : output, level,
+            encoding == kGzip ? MAX_WBITS + 16 : MAX_WBITS)
+{
+  assert(encoding != kIdentity);
+}
+
+void HttpCompressor::appendChunk()
+{
+  if (chunked_ && compressed_.readableBytes() > 0)
+  {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%zx\r\n", compressed_.readableBytes());
+    output_->append(buf);
+    output_->append(compressed_.peek(), compressed_.readableBytes());
+    output_->append("\r\n", 2);
+    compressed_.retrieveAll();
+  }
+}
+
+bool HttpCompressor::write(StringPiece data)
+{
+  bool ok = stream_.write(data);
+  // keep chunks reasonably sized without forcing a flush
+  if (compressed_.readableBytes() >= 64*1024)
+  {
+    appendChunk();
+  }
+  return ok;
+}
+
+bool HttpCompressor::flush()
+{
+  bool ok = stream_.flush();
+  appendChunk();
+  return ok;
+}
+
+bool HttpCompressor::finish()
+{
+  bool ok = stream_.finish();
+  appendChunk();
+  if (chunked_)
+  {
+    output_->append("0\r\n\r\n");
+  }
+  return ok;
+}
+
+HttpCompressionFilter::HttpCompressionFilter()
+  : minSize_(1024),
+    level_(Z_DEFAULT_COMPRESSION),
+    maxFileSize_(2*1024*1024),
+    maxCacheBytes_(16*1024*1024),
+    cachedBytes_(0)
+{
+  contentTypes_.push_back("text/");
+  contentTypes_.push_back("application/json");
+  contentTypes_.push_back("application/javascript");
+  contentTypes_.push_back("application/xml");
+  contentTypes_.push_back("image/svg+xml");
+}
+
+size_t HttpCompressionFilter::cachedBytes() const
+{
+  MutexLockGuard lock(mutex_);
+  return cachedBytes_;
+}
+
+bool HttpCompressionFilter::compressible(const HttpResponse& resp) const
+{
+  if (resp.statusCode() != HttpResponse::k200Ok
+      || !resp.getHeader("Content-Encoding").empty())
+  {
+    return false;
+  }
+  if (resp.hasBodyFile())
+  {
+    // read from disk once, for the cache, which must be able to hold it
+    if (resp.bodyFileLength() < minSize_
+        || resp.bodyFileLength() > std::min(maxFileSize_, maxEntryBytes())
+        || resp.getHeader("ETag").empty())
+    {
+      return false;
+    }
+  }
+  else if (resp.body().size() < minSize_)
+  {
+    return false;
+  }
+  const string& type = resp.getHeader("Content-Type");
+  for (const string& prefix : contentTypes_)
+  {
+    if (type.compare(0, prefix.size(), prefix) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HttpCompressionFilter::compress(const HttpResponse& resp,
+                                     HttpCompressor::Encoding encoding,
+                                     string* compressed) const
+{
+  Buffer output;
+  HttpCompressor compressor(&output, encoding, false, level_);
+  bool ok = true;
+  size_t bodySize = 0;
+  if (resp.hasBodyFile())
+  {
+    bodySize = resp.bodyFileLength();
+    char buf[64*1024];
+    off_t offset = static_cast<off_t>(resp.bodyFileOffset());
+    size_t remaining = bodySize;
+    while (ok && remaining > 0)
+    {
+      ssize_t n = ::pread(resp.bodyFileFd(), buf, std::min(remaining, sizeof buf), offset);
+      if (n > 0)
+      {
+        ok = compressor.write(StringPiece(buf, static_cast<int>(n)));
+        offset += n;
+        remaining -= static_cast<size_t>(n);
+      }
+      else if (n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      else
+      {
+        // file shrunk or unreadable, send it as is
+        if (n < 0)
+        {
+          LOG_SYSERR << "HttpCompressionFilter::compress";
+        }
+        ok = false;
+      }
+    }
+  }
+  else
+  {
+    bodySize = resp.body().size();
+    ok = compressor.write(resp.body());
+  }
+  ok = compressor.finish() && ok;
+  if (!ok || output.readableBytes() >= bodySize)
+  {
+    return false;
+  }
+  *compressed = output.retrieveAllAsString();
+  return true;
+}
+
+HttpCompressionFilter::BodyPtr HttpCompressionFilter::findCached(const string& key)
+{
+  MutexLockGuard lock(mutex_);
+  auto it = cache_.find(key);
+  if (it != cache_.end())
+  {
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+  }
+  return BodyPtr();
+}
+
+void HttpCompressionFilter::addCached(const string& key, const BodyPtr& body)
+{
+  if (body->size() > maxEntryBytes())
+  {
+    return;
+  }
+  MutexLockGuard lock(mutex_);
+  if (cache_.find(key) != cache_.end())
+  {
+    return;
+  }
+  lru_.push_front(Entry(key, body));
+  cache_[key] = lru_.begin();
+  cachedBytes_ += body->size();
+  while (cachedBytes_ > maxCacheBytes_)
+  {
+    cachedBytes_ -= lru_.back().second->size();
+    cache_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+void HttpCompressionFilter::filter(const HttpRequest& req, HttpResponse* resp)
+{
+  if (!compressible(*resp))
+  {
+    return;
+  }
+  resp->addHeader("Vary", "Accept-Encoding");
+  HttpCompressor::Encoding encoding =
+    HttpCompressor::negotiate(req.getHeader("Accept-Encoding"));
+  if (encoding == HttpCompressor::kIdentity)
+  {
+    return;
+  }
+
+  // compressed variants of the same entity share a weak validator
+  string etag = resp->getHeader("ETag");
+  string key;
+  BodyPtr compressed;
+  if (!etag.empty() && maxCacheBytes_ > 0)
+  {
+    key = req.path();
+    key += '\0';
+    key += etag;
+    key += '\0';
+    key += HttpCompressor::encodingName(encoding);
+    compressed = findCached(key);
+  }
+
+  if (!compressed)
+  {
+    std::shared_ptr<string> body(new string);
+    if (!compress(*resp, encoding, body.get()))
+    {
+      return;
+    }
+    compressed = body;
+    if (!key.empty())
+    {
+      addCached(key, compressed);
+    }
+  }
+
+  resp->setBody(compressed);
+  resp->addHeader("Content-Encoding", HttpCompressor::encodingName(encoding));
+  if (!etag.empty() && etag.compare(0, 2, "W/") != 0)
+  {
+    resp->addHeader("ETag", "W/" + etag);
+  }
+}
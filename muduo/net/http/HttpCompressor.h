@@ -0,0 +1,136 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
+#define MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/ZlibStream.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpRequest;
+class HttpResponse;
+
+/// Content-Encoding of a HTTP body, streaming.
+///
+/// Compressed data is appended to output as it is produced, if chunked,
+/// each flushed piece is framed as a HTTP/1.1 chunk.
+/// HttpServer has no chunked responses, this is for code writing its own
+/// to a TcpConnection; HttpCompressionFilter uses it to compress whole bodies.
+class HttpCompressor : noncopyable
+{
+ public:
+  enum Encoding
+  {
+    kIdentity, kGzip, kDeflate,
+  };
+
+  /// Picks the best encoding from an Accept-Encoding header, gzip preferred.
+  static Encoding negotiate(const string& acceptEncoding);
+  static const char* encodingName(Encoding encoding);
+
+  HttpCompressor(Buffer* output, Encoding encoding, bool chunked,
+                 int level = Z_DEFAULT_COMPRESSION);
+
+  bool write(StringPiece data);
+  /// Outputs everything written so far, the peer can decode it right away.
+  bool flush();
+  /// Ends the stream, and writes the last chunk if chunked.
+  bool finish();
+
+  int64_t inputBytes() const { return stream_.inputBytes(); }
+  int64_t outputBytes() const { return stream_.outputBytes(); }
+
+ private:
+  void appendChunk();
+
+  Buffer* output_;
+  const bool chunked_;
+  Buffer compressed_;  // chunk being built, if chunked_
+  ZlibOutputStream stream_;
+};
+
+/// Transparent response compression driven by Accept-Encoding,
+/// install it with HttpServer::setResponseFilter().
+///
+/// Responses which carry an ETag are considered static, their compressed
+/// variants are kept in a LRU cache and reused, shared by the responses
+/// rather than copied.  File bodies, such as those of StaticFileHandler,
+/// are compressed if they have an ETag and the cache can hold them, read
+/// from the file on the first request, then served from the cache.
+/// It is thread safe.
+class HttpCompressionFilter : noncopyable
+{
+ public:
+  HttpCompressionFilter();
+
+  /// Not thread safe, set before serving.
+  /// Bodies smaller than this are sent as is, default 1KiB.
+  void setMinSize(size_t bytes)
+  { minSize_ = bytes; }
+
+  void setLevel(int level)
+  { level_ = level; }
+
+  /// File bodies larger than this, or than an entry of the cache
+  /// (1/8 of its size), are sent as is, default 2MiB.
+  void setMaxFileSize(size_t bytes)
+  { maxFileSize_ = bytes; }
+
+  /// Total bytes of cached compressed variants, 0 to disable.
+  void setCacheSize(size_t bytes)
+  { maxCacheBytes_ = bytes; }
+
+  /// Content-Type prefixes worth compressing, eg. "text/".
+  void addContentType(const string& prefix)
+  { contentTypes_.push_back(prefix); }
+
+  void filter(const HttpRequest& req, HttpResponse* resp);
+
+  size_t cachedBytes() const;
+
+ private:
+  typedef std::shared_ptr<const string> BodyPtr;
+  typedef std::pair<string, BodyPtr> Entry;  // key, compressed body
+  typedef std::list<Entry> EntryList;
+
+  bool compressible(const HttpResponse& resp) const;
+  bool compress(const HttpResponse& resp, HttpCompressor::Encoding encoding,
+                string* compressed) const;
+  size_t maxEntryBytes() const { return maxCacheBytes_ / 8; }
+  // NULL if not cached
+  BodyPtr findCached(const string& key);
+  void addCached(const string& key, const BodyPtr& body);
+
+  size_t minSize_;
+  int level_;
+  size_t maxFileSize_;
+  size_t maxCacheBytes_;
+  std::vector<string> contentTypes_;
+
+  mutable MutexLock mutex_;
+  EntryList lru_ GUARDED_BY(mutex_);
+  std::unordered_map<string, EntryList::iterator> cache_ GUARDED_BY(mutex_);
+  size_t cachedBytes_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPCOMPRESSOR_H
@@ -10,9 +10,59 @@
 #include "muduo/net/Buffer.h"
 #include "muduo/net/http/HttpContext.h"
 
+#include <stdlib.h>
+#include <strings.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+enum HeaderLineResult
+{
+  kNeedMore,
+  kHeaderLine,
+  kEndOfHeaders,
+};
+
+// parses one header line of a request or response into message
+template<typename Message>
+HeaderLineResult parseHeaderLine(Buffer* buf, Message* message)
+{
+  const char* crlf = buf->findCRLF();
+  if (crlf == NULL)
+  {
+    return kNeedMore;
+  }
+  HeaderLineResult result = kEndOfHeaders;
+  const char* colon = std::find(buf->peek(), crlf, ':');  //查找 冒号 所在位置
+  if (colon != crlf)
+  {
+    message->addHeader(buf->peek(), colon, crlf);
+    result = kHeaderLine;
+  }
+  // empty line, end of header
+  // FIXME:
+  buf->retrieveUntil(crlf + 2);  //将header 从buf 中取回, 包括\r\n
+  return result;
+}
+
+bool containsToken(const string& value, const char* token)
+{
+  size_t len = strlen(token);
+  for (size_t i = 0; i + len <= value.size(); ++i)
+  {
+    if (::strncasecmp(value.c_str() + i, token, len) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
 bool HttpContext::processRequestLine(const char* begin, const char* end)
 {
   bool succeed = false;
@@ -89,32 +139,218 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
       }
     }
     else if (state_ == kExpectHeaders)  //解析header 
+    {
+      HeaderLineResult result = parseHeaderLine(buf, &request_);
+      if (result == kEndOfHeaders)
+      {
+        state_ = kGotAll;  // httpContext 将状态改为 kGotAll
+        hasMore = false;
+      }
+      else if (result == kNeedMore)
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectBody)  //当前还不支持请求中 带 body
+    {
+      // FIXME:
+    }
+  }
+  return ok;
+}
+
+bool HttpResponseContext::processStatusLine(const char* begin, const char* end)
+{
+  // HTTP/1.1 200 OK
+  if (end - begin < 12 || !std::equal(begin, begin+7, "HTTP/1.") || begin[8] != ' ')
+  {
+    return false;
+  }
+  if (begin[7] != '0' && begin[7] != '1')
+  {
+    return false;
+  }
+  response_.setMinorVersion(begin[7] - '0');
+
+  const char* start = begin + 9;
+  int code = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (!isdigit(start[i]))
+    {
+      return false;
+    }
+    code = code * 10 + (start[i] - '0');
+  }
+  start += 3;
+  if (start < end && *start == ' ')
+  {
+    ++start;
+  }
+  response_.setStatus(code, start, end);
+  return true;
+}
+
+bool HttpResponseContext::startBody()
+{
+  int code = response_.statusCode();
+  if (headRequest_ || code / 100 == 1 || code == 204 || code == 304)
+  {
+    state_ = kGotAll;
+    return true;
+  }
+
+  if (containsToken(response_.getHeader("Transfer-Encoding"), "chunked"))
+  {
+    state_ = kExpectChunkSize;
+    return true;
+  }
+
+  const string& length = response_.getHeader("Content-Length");
+  if (!length.empty())
+  {
+    char* end = NULL;
+    unsigned long long n = strtoull(length.c_str(), &end, 10);
+    if (end == length.c_str() || *end != '\0')
+    {
+      return false;
+    }
+    bodyRemaining_ = static_cast<size_t>(n);
+    state_ = bodyRemaining_ > 0 ? kExpectBody : kGotAll;
+    return true;
+  }
+
+  state_ = kExpectBodyUntilClose;
+  return true;
+}
+
+bool HttpResponseContext::closeAfterResponse() const
+{
+  const string& connection = response_.getHeader("Connection");
+  return containsToken(connection, "close")
+      || (response_.minorVersion() == 0 && !containsToken(connection, "keep-alive"));
+}
+
+// return false if any error
+bool HttpResponseContext::parseResponse(Buffer* buf, Timestamp receiveTime, bool headRequest)
+{
+  bool ok = true;
+  bool hasMore = true;
+  if (state_ == kExpectStatusLine)
+  {
+    headRequest_ = headRequest;
+  }
+
+  while (ok && hasMore)
+  {
+    if (state_ == kExpectStatusLine)
     {
       const char* crlf = buf->findCRLF();
       if (crlf)
       {
-        const char* colon = std::find(buf->peek(), crlf, ':');  //查找 冒号 所在位置
-        if (colon != crlf)
+        ok = processStatusLine(buf->peek(), crlf);
+        if (ok)
         {
-          request_.addHeader(buf->peek(), colon, crlf);
+          response_.setReceiveTime(receiveTime);
+          buf->retrieveUntil(crlf + 2);
+          state_ = kExpectHeaders;
+        }
+      }
+      else
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectHeaders)
+    {
+      HeaderLineResult result = parseHeaderLine(buf, &response_);
+      if (result == kEndOfHeaders)
+      {
+        if (response_.statusCode() / 100 == 1)
+        {
+          // interim response, eg. 100 Continue, wait for the final one
+          HttpClientResponse dummy;
+          response_.swap(dummy);
+          state_ = kExpectStatusLine;
         }
         else
         {
-          // empty line, end of header
-          // FIXME:
-          state_ = kGotAll;  // httpContext 将状态改为 kGotAll
-          hasMore = false;
+          ok = startBody();
         }
-        buf->retrieveUntil(crlf + 2);  //将header 从buf 中取回, 包括\r\n
+      }
+      else if (result == kNeedMore)
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectBody || (state_ == kExpectChunkData && bodyRemaining_ > 0))
+    {
+      size_t n = std::min(buf->readableBytes(), bodyRemaining_);
+      response_.appendBody(buf->peek(), n);
+      buf->retrieve(n);
+      bodyRemaining_ -= n;
+      if (bodyRemaining_ == 0 && state_ == kExpectBody)
+      {
+        state_ = kGotAll;
+      }
+      else if (bodyRemaining_ > 0)
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectChunkData)
+    {
+      // CRLF after chunk data
+      if (buf->readableBytes() >= 2)
+      {
+        ok = buf->peek()[0] == '\r' && buf->peek()[1] == '\n';
+        buf->retrieve(2);
+        state_ = kExpectChunkSize;
       }
       else
       {
         hasMore = false;
       }
     }
-    else if (state_ == kExpectBody)  //当前还不支持请求中 带 body
+    else if (state_ == kExpectChunkSize)
     {
-      // FIXME:
+      const char* crlf = buf->findCRLF();
+      if (crlf)
+      {
+        char* end = NULL;
+        unsigned long size = strtoul(buf->peek(), &end, 16);
+        ok = end != buf->peek() && (end == crlf || *end == ';' || *end == ' ');
+        buf->retrieveUntil(crlf + 2);
+        bodyRemaining_ = size;
+        state_ = size > 0 ? kExpectChunkData : kExpectChunkTrailer;
+      }
+      else
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectChunkTrailer)
+    {
+      HeaderLineResult result = parseHeaderLine(buf, &response_);
+      if (result == kEndOfHeaders)
+      {
+        state_ = kGotAll;
+      }
+      else if (result == kNeedMore)
+      {
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectBodyUntilClose)
+    {
+      response_.appendBody(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
+      hasMore = false;
+    }
+    else
+    {
+      assert(state_ == kGotAll);
+      hasMore = false;
     }
   }
   return ok;
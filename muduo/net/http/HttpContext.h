@@ -13,6 +13,7 @@
 
 #include "muduo/base/copyable.h"
 
+#include "muduo/net/http/HttpClientResponse.h"
 #include "muduo/net/http/HttpRequest.h"
 
 namespace muduo
@@ -73,6 +74,82 @@ class HttpContext : public muduo::copyable
   HttpRequest request_;   //http 请求
 };
 
+// http 响应解析类, for HttpClient
+// shares header parsing with HttpContext, also parses the body.
+class HttpResponseContext : public muduo::copyable
+{
+ public:
+  enum HttpResponseParseState
+  {
+    kExpectStatusLine,
+    kExpectHeaders,
+    kExpectBody,           // Content-Length
+    kExpectChunkSize,      // Transfer-Encoding: chunked
+    kExpectChunkData,
+    kExpectChunkTrailer,
+    kExpectBodyUntilClose, // neither, body ends when connection closes
+    kGotAll,
+  };
+
+  HttpResponseContext()
+    : state_(kExpectStatusLine),
+      bodyRemaining_(0),
+      headRequest_(false)
+  {
+  }
+
+  // default copy-ctor, dtor and assignment are fine
+
+  // return false if any error
+  // responses to HEAD have no body even with Content-Length.
+  bool parseResponse(Buffer* buf, Timestamp receiveTime, bool headRequest);
+
+  // call this when peer closes the connection,
+  // return true if the response is complete.
+  bool onConnectionClosed()
+  {
+    if (state_ == kExpectBodyUntilClose)
+    {
+      state_ = kGotAll;
+    }
+    return gotAll();
+  }
+
+  bool gotAll() const
+  { return state_ == kGotAll; }
+
+  // nothing received since last reset()
+  bool idle() const
+  { return state_ == kExpectStatusLine; }
+
+  // peer will close the connection after this response
+  bool closeAfterResponse() const;
+
+  void reset()
+  {
+    state_ = kExpectStatusLine;
+    bodyRemaining_ = 0;
+    headRequest_ = false;
+    HttpClientResponse dummy;
+    response_.swap(dummy);
+  }
+
+  const HttpClientResponse& response() const
+  { return response_; }
+
+  HttpClientResponse& response()
+  { return response_; }
+
+ private:
+  bool processStatusLine(const char* begin, const char* end);
+  bool startBody();
+
+  HttpResponseParseState state_;
+  size_t bodyRemaining_;
+  bool headRequest_;
+  HttpClientResponse response_;
+};
+
 }  // namespace net
 }  // namespace muduo
 
@@ -84,6 +84,9 @@ class HttpRequest : public muduo::copyable
     return method_ != kInvalid;
   }
 
+  void setMethod(Method m)
+  { method_ = m; }
+
   Method method() const
   { return method_; }
 
@@ -170,6 +173,15 @@ class HttpRequest : public muduo::copyable
 
   const std::map<string, string>& headers() const
   { return headers_; }
+
+  void setHeader(const string& field, const string& value)
+  { headers_[field] = value; }
+
+  void setBody(const string& body)
+  { body_ = body; }
+
+  const string& body() const
+  { return body_; }
 //  交换数据成员
   void swap(HttpRequest& that)
   {
@@ -179,6 +191,7 @@ class HttpRequest : public muduo::copyable
     query_.swap(that.query_);
     receiveTime_.swap(that.receiveTime_);
     headers_.swap(that.headers_);
+    body_.swap(that.body_);
   }
 
  private:
@@ -188,6 +201,7 @@ class HttpRequest : public muduo::copyable
   string query_;                    
   Timestamp receiveTime_;    //请求时间 
   std::map<string, string> headers_;   //header 列表
+  string body_;
 };
 
 }  // namespace net
@@ -16,6 +16,12 @@ using namespace muduo;
 using namespace muduo::net;
 //http 响应类封装
 void HttpResponse::appendToBuffer(Buffer* output) const
+{
+  appendHeadersToBuffer(output);
+  output->append(body());  // file body is sent by HttpServer after this
+}
+
+void HttpResponse::appendHeadersToBuffer(Buffer* output) const
 {
   char buf[32];
   //添加相应头
@@ -33,7 +39,8 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   else
   {
     //实体的长度
-    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
+    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n",
+             hasBodyFile() ? fileLength_ : body().size());
     output->append(buf);
     output->append("Connection: Keep-Alive\r\n");
   }
@@ -47,5 +54,4 @@ void HttpResponse::appendToBuffer(Buffer* output) const
   }
 // 头部和 实体 部分应该有一个空行
   output->append("\r\n");   //header  与 body 之间的空行
-  output->append(body_);
 }
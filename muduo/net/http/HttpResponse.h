@@ -15,6 +15,7 @@
 #include "muduo/base/Types.h"
 
 #include <map>
+#include <memory>
 
 namespace muduo
 {
@@ -29,16 +30,28 @@ class HttpResponse : public muduo::copyable
   {
     kUnknown,
     k200Ok = 200,   // 成功
+    k206PartialContent = 206,
     k301MovedPermanently = 301,  // 301 重定向,请求的页面永久性移植至另一个地址
+    k304NotModified = 304,
     k400BadRequest = 400,   //错误的请求,语法格式有错,服务器无法处理此请求
+    k403Forbidden = 403,
     k404NotFound = 404,   //  请求的网页不存在
+    k405MethodNotAllowed = 405,
+    k416RangeNotSatisfiable = 416,
+    k500InternalServerError = 500,
   };
 
   explicit HttpResponse(bool close)
     : statusCode_(kUnknown),
-      closeConnection_(close)
+      closeConnection_(close),
+      fileFd_(-1),
+      fileOffset_(0),
+      fileLength_(0)
   {
   }
+
+  HttpStatusCode statusCode() const
+  { return statusCode_; }
  // 设置状态吗
   void setStatusCode(HttpStatusCode code)
   { statusCode_ = code; }
@@ -62,12 +75,73 @@ class HttpResponse : public muduo::copyable
   void addHeader(const string& key, const string& value)
   { headers_[key] = value; }
 
+  string getHeader(const string& key) const
+  {
+    string result;
+    std::map<string, string>::const_iterator it = headers_.find(key);
+    if (it != headers_.end())
+    {
+      result = it->second;
+    }
+    return result;
+  }
+
+  /// Replaces a file body as well.
   void setBody(const string& body)
-  { body_ = body; }
+  {
+    body_ = body;
+    sharedBody_.reset();
+    fileFd_ = -1;
+    fileOffset_ = 0;
+    fileLength_ = 0;
+    fileGuard_.reset();
+  }
+
+  /// Same as above, body is shared rather than copied,
+  /// eg. one kept in a cache.
+  void setBody(const std::shared_ptr<const string>& body)
+  {
+    setBody(string());
+    sharedBody_ = body;
+  }
+
+  const string& body() const
+  { return sharedBody_ ? *sharedBody_ : body_; }
+
+  /// Body is fileLength bytes of fd from fileOffset, sent with sendfile(2)
+  /// after the headers. guard keeps fd open until it is sent.
+  void setBodyFile(int fd, int64_t fileOffset, size_t fileLength,
+                   const std::shared_ptr<void>& guard)
+  {
+    body_.clear();
+    sharedBody_.reset();
+    fileFd_ = fd;
+    fileOffset_ = fileOffset;
+    fileLength_ = fileLength;
+    fileGuard_ = guard;
+  }
+
+  bool hasBodyFile() const
+  { return fileFd_ >= 0; }
+
+  int bodyFileFd() const
+  { return fileFd_; }
+
+  int64_t bodyFileOffset() const
+  { return fileOffset_; }
+
+  size_t bodyFileLength() const
+  { return fileLength_; }
+
+  const std::shared_ptr<void>& bodyFileGuard() const
+  { return fileGuard_; }
 
 //将 HttpResponse添加到buffer ,以便于发送给客户端
   void appendToBuffer(Buffer* output) const;
 
+  // status line and headers only, for HEAD requests
+  void appendHeadersToBuffer(Buffer* output) const;
+
  private:
   std::map<string, string> headers_;  //header 列表
   HttpStatusCode statusCode_;        //状态响应码
@@ -75,6 +149,11 @@ class HttpResponse : public muduo::copyable
   string statusMessage_;     //状态响应码对应的文本信息
   bool closeConnection_;    //是否关闭连接
   string body_;   //实体
+  std::shared_ptr<const string> sharedBody_;  // instead of body_ if set
+  int fileFd_;
+  int64_t fileOffset_;
+  size_t fileLength_;
+  std::shared_ptr<void> fileGuard_;
 };
 
 }  // namespace net
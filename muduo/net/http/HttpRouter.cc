@@ -0,0 +1,398 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/HttpRouter.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// build-time trie node, compiled into FlatNode
+struct HttpRouter::Node : noncopyable
+{
+  Node()
+  {
+    std::fill(handlers, handlers + kNumMethods, -1);
+  }
+
+  string prefix;
+  string name;  // for parameter and wildcard nodes
+  std::vector<std::unique_ptr<Node>> children;
+  std::unique_ptr<Node> param;
+  std::unique_ptr<Node> wildcard;
+  int handlers[kNumMethods];
+};
+
+namespace
+{
+
+// HttpRouter::Node is private, so these helpers take it as a template argument.
+template<typename Node>
+bool setHandler(Node* node, HttpRequest::Method method, int handler)
+{
+  if (node->handlers[method] >= 0)
+  {
+    return false;
+  }
+  node->handlers[method] = handler;
+  return true;
+}
+
+// a ':' or '*' which starts a path segment
+const char* findParameter(const char* p, const char* end)
+{
+  for (const char* q = p; q < end; ++q)
+  {
+    if ((*q == ':' || *q == '*') && q > p && q[-1] == '/')
+      return q;
+  }
+  return end;
+}
+
+template<typename Node>
+bool insert(Node* node, const char* p, const char* end,
+            HttpRequest::Method method, int handler);
+
+template<typename Node>
+bool insertStatic(Node* node, const char* p, const char* staticEnd, const char* end,
+                  HttpRequest::Method method, int handler)
+{
+  size_t len = staticEnd - p;
+  for (auto& child : node->children)
+  {
+    if (child->prefix[0] != *p)
+      continue;
+
+    size_t common = 0;
+    while (common < len && common < child->prefix.size() && child->prefix[common] == p[common])
+    {
+      ++common;
+    }
+    if (common < child->prefix.size())
+    {
+      // split child at common
+      std::unique_ptr<Node> tail(new Node);
+      tail->prefix = child->prefix.substr(common);
+      tail->children.swap(child->children);
+      tail->param.swap(child->param);
+      tail->wildcard.swap(child->wildcard);
+      std::copy(child->handlers, child->handlers + HttpRequest::kDelete + 1, tail->handlers);
+      std::fill(child->handlers, child->handlers + HttpRequest::kDelete + 1, -1);
+      child->prefix.resize(common);
+      child->children.push_back(std::move(tail));
+    }
+    if (common == len)
+    {
+      return insert(child.get(), staticEnd, end, method, handler);
+    }
+    return insertStatic(child.get(), p + common, staticEnd, end, method, handler);
+  }
+
+  std::unique_ptr<Node> child(new Node);
+  child->prefix.assign(p, staticEnd);
+  Node* raw = child.get();
+  node->children.push_back(std::move(child));
+  return insert(raw, staticEnd, end, method, handler);
+}
+
+template<typename Node>
+bool insert(Node* node, const char* p, const char* end,
+            HttpRequest::Method method, int handler)
+{
+  if (p == end)
+  {
+    return setHandler(node, method, handler);
+  }
+
+  if (*p == ':')
+  {
+    const char* slash = std::find(p, end, '/');
+    string name(p + 1, slash);
+    if (name.empty())
+      return false;
+    if (!node->param)
+    {
+      node->param.reset(new Node);
+      node->param->name = name;
+    }
+    else if (node->param->name != name)
+    {
+      return false;
+    }
+    return insert(node->param.get(), slash, end, method, handler);
+  }
+  else if (*p == '*')
+  {
+    string name(p + 1, end);
+    if (name.empty() || name.find('/') != string::npos)
+      return false;
+    if (!node->wildcard)
+    {
+      node->wildcard.reset(new Node);
+      node->wildcard->name = name;
+    }
+    else if (node->wildcard->name != name)
+    {
+      return false;
+    }
+    return setHandler(node->wildcard.get(), method, handler);
+  }
+
+  return insertStatic(node, p, findParameter(p, end), end, method, handler);
+}
+
+}  // namespace
+
+HttpRouter::HttpRouter()
+  : root_(new Node)
+{
+  compile();
+}
+
+HttpRouter::~HttpRouter()
+{
+}
+
+bool HttpRouter::add(HttpRequest::Method method, const string& pattern, const Handler& handler)
+{
+  if (method == HttpRequest::kInvalid || pattern.empty() || pattern[0] != '/')
+  {
+    LOG_ERROR << "HttpRouter::add - invalid route " << pattern;
+    return false;
+  }
+  int index = static_cast<int>(handlers_.size());
+  if (!insert(root_.get(), pattern.data(), pattern.data() + pattern.size(), method, index))
+  {
+    LOG_ERROR << "HttpRouter::add - invalid or conflicting route " << pattern;
+    return false;
+  }
+  handlers_.push_back(handler);
+  // recompile every time, cheap enough for a few thousand routes
+  compile();
+  return true;
+}
+
+void HttpRouter::compile()
+{
+  nodes_.clear();
+  pool_.clear();
+  nodes_.resize(1);
+  nodes_[0] = FlatNode();
+  flatten(root_.get(), 0);
+}
+
+void HttpRouter::flatten(const Node* node, int index)
+{
+  FlatNode flat;
+  flat.prefixOffset = static_cast<int>(pool_.size());
+  flat.prefixLength = static_cast<int>(node->prefix.size());
+  pool_ += node->prefix;
+  flat.nameOffset = static_cast<int>(pool_.size());
+  flat.nameLength = static_cast<int>(node->name.size());
+  pool_ += node->name;
+  std::copy(node->handlers, node->handlers + kNumMethods, flat.handlers);
+
+  std::vector<const Node*> children;
+  for (const auto& child : node->children)
+  {
+    children.push_back(child.get());
+  }
+  std::sort(children.begin(), children.end(),
+            [](const Node* lhs, const Node* rhs)
+            {
+              return static_cast<unsigned char>(lhs->prefix[0])
+                   < static_cast<unsigned char>(rhs->prefix[0]);
+            });
+  flat.firstChild = static_cast<int>(nodes_.size());
+  flat.numChildren = static_cast<int>(children.size());
+  nodes_.resize(nodes_.size() + children.size());
+  for (int i = 0; i < flat.numChildren; ++i)
+  {
+    flatten(children[i], flat.firstChild + i);
+  }
+
+  flat.paramChild = -1;
+  if (node->param)
+  {
+    flat.paramChild = static_cast<int>(nodes_.size());
+    nodes_.resize(nodes_.size() + 1);
+    flatten(node->param.get(), flat.paramChild);
+  }
+  flat.wildcardChild = -1;
+  if (node->wildcard)
+  {
+    flat.wildcardChild = static_cast<int>(nodes_.size());
+    nodes_.resize(nodes_.size() + 1);
+    flatten(node->wildcard.get(), flat.wildcardChild);
+  }
+  nodes_[index] = flat;
+}
+
+bool HttpRouter::matchNode(int index, const char* path, const char* end,
+                           HttpRequest::Method method, HttpRouteParams* params,
+                           int* handler, int* pathMatched) const
+{
+  const FlatNode& node = nodes_[index];
+  if (path == end)
+  {
+    if (node.handlers[method] >= 0)
+    {
+      *handler = node.handlers[method];
+      return true;
+    }
+    if (*pathMatched < 0 && hasHandlers(index))
+    {
+      *pathMatched = index;
+    }
+  }
+  else
+  {
+    const unsigned char c = static_cast<unsigned char>(*path);
+    for (int i = node.firstChild; i < node.firstChild + node.numChildren; ++i)
+    {
+      const FlatNode& child = nodes_[i];
+      const char* prefix = pool_.data() + child.prefixOffset;
+      const unsigned char first = static_cast<unsigned char>(prefix[0]);
+      if (first == c)
+      {
+        if (end - path >= child.prefixLength
+            && memcmp(path, prefix, child.prefixLength) == 0
+            && matchNode(i, path + child.prefixLength, end, method, params, handler, pathMatched))
+        {
+          return true;
+        }
+        break;
+      }
+      else if (first > c)
+      {
+        break;
+      }
+    }
+
+    if (node.paramChild >= 0)
+    {
+      const char* segmentEnd = static_cast<const char*>(memchr(path, '/', end - path));
+      if (segmentEnd == NULL)
+      {
+        segmentEnd = end;
+      }
+      const FlatNode& param = nodes_[node.paramChild];
+      if (segmentEnd > path
+          && params->push(StringPiece(pool_.data() + param.nameOffset, param.nameLength),
+                          StringPiece(path, static_cast<int>(segmentEnd - path))))
+      {
+        if (matchNode(node.paramChild, segmentEnd, end, method, params, handler, pathMatched))
+        {
+          return true;
+        }
+        params->pop();
+      }
+    }
+  }
+
+  if (node.wildcardChild >= 0)
+  {
+    const FlatNode& wildcard = nodes_[node.wildcardChild];
+    if (wildcard.handlers[method] >= 0)
+    {
+      if (params->push(StringPiece(pool_.data() + wildcard.nameOffset, wildcard.nameLength),
+                       StringPiece(path, static_cast<int>(end - path))))
+      {
+        *handler = wildcard.handlers[method];
+        return true;
+      }
+    }
+    else if (*pathMatched < 0)
+    {
+      *pathMatched = node.wildcardChild;
+    }
+  }
+  return false;
+}
+
+bool HttpRouter::hasHandlers(int index) const
+{
+  for (int m = HttpRequest::kGet; m < kNumMethods; ++m)
+  {
+    if (nodes_[index].handlers[m] >= 0)
+      return true;
+  }
+  return false;
+}
+
+string HttpRouter::allowedMethods(int index) const
+{
+  string result;
+  for (int m = HttpRequest::kGet; m < kNumMethods; ++m)
+  {
+    if (nodes_[index].handlers[m] >= 0)
+    {
+      HttpRequest req;
+      req.setMethod(static_cast<HttpRequest::Method>(m));
+      if (!result.empty())
+        result += ", ";
+      result += req.methodString();
+    }
+  }
+  return result;
+}
+
+const HttpRouter::Handler* HttpRouter::match(HttpRequest::Method method,
+                                             StringPiece path,
+                                             HttpRouteParams* params,
+                                             bool* methodAllowed) const
+{
+  int handler = -1;
+  int pathMatched = -1;
+  if (method != HttpRequest::kInvalid)
+  {
+    matchNode(0, path.begin(), path.end(), method, params, &handler, &pathMatched);
+  }
+  if (methodAllowed)
+  {
+    *methodAllowed = handler >= 0 || pathMatched < 0;
+  }
+  return handler >= 0 ? &handlers_[handler] : NULL;
+}
+
+void HttpRouter::onRequest(const HttpRequest& req, HttpResponse* resp) const
+{
+  HttpRouteParams params;
+  int handler = -1;
+  int pathMatched = -1;
+  if (req.method() != HttpRequest::kInvalid)
+  {
+    const string& path = req.path();
+    matchNode(0, path.data(), path.data() + path.size(), req.method(),
+              &params, &handler, &pathMatched);
+  }
+
+  if (handler >= 0)
+  {
+    handlers_[handler](req, params, resp);
+  }
+  else if (pathMatched >= 0)
+  {
+    resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+    resp->setStatusMessage("Method Not Allowed");
+    resp->addHeader("Allow", allowedMethods(pathMatched));
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
@@ -0,0 +1,155 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_HTTPROUTER_H
+#define MUDUO_NET_HTTP_HTTPROUTER_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/net/http/HttpRequest.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpResponse;
+
+/// Parameters captured by HttpRouter, point into the request path,
+/// valid during the handler call.
+class HttpRouteParams : noncopyable
+{
+ public:
+  static const int kMaxParams = 8;
+
+  struct Param
+  {
+    StringPiece name;
+    StringPiece value;
+  };
+
+  HttpRouteParams()
+    : size_(0)
+  {
+  }
+
+  int size() const
+  { return size_; }
+
+  const Param& operator[](int i) const
+  { return params_[i]; }
+
+  /// Empty if name was not captured.
+  StringPiece get(StringPiece name) const
+  {
+    for (int i = 0; i < size_; ++i)
+    {
+      if (params_[i].name == name)
+        return params_[i].value;
+    }
+    return StringPiece();
+  }
+
+  // internal use
+  bool push(StringPiece name, StringPiece value)
+  {
+    if (size_ == kMaxParams)
+      return false;
+    params_[size_].name = name;
+    params_[size_].value = value;
+    ++size_;
+    return true;
+  }
+
+  void pop()
+  { --size_; }
+
+ private:
+  int size_;
+  Param params_[kMaxParams];
+};
+
+/// Dispatches requests by method and path.
+///
+/// Patterns are like "/users/:id/posts/*rest", ":name" captures one
+/// path segment, "*name" captures the rest of the path.
+/// Static segments take precedence over parameters, which take
+/// precedence over wildcards.
+///
+/// Routes are compiled into a flat radix trie, matching does no allocation.
+/// add() is not thread safe, register all routes before HttpServer::start(),
+/// matching is thread safe.
+class HttpRouter : noncopyable
+{
+ public:
+  typedef std::function<void (const HttpRequest&,
+                              const HttpRouteParams&,
+                              HttpResponse*)> Handler;
+
+  HttpRouter();
+  ~HttpRouter();
+
+  /// Returns false if pattern is malformed or conflicts with another route.
+  bool add(HttpRequest::Method method, const string& pattern, const Handler& handler);
+
+  /// Returns the handler, or NULL if not found.
+  /// *methodAllowed is false if path matches but not for this method.
+  const Handler* match(HttpRequest::Method method,
+                       StringPiece path,
+                       HttpRouteParams* params,
+                       bool* methodAllowed) const;
+
+  /// Can be used as HttpServer::HttpCallback, replies 404 or 405.
+  void onRequest(const HttpRequest& req, HttpResponse* resp) const;
+
+  size_t numRoutes() const
+  { return handlers_.size(); }
+
+ private:
+  static const int kNumMethods = HttpRequest::kDelete + 1;
+  struct Node;
+
+  // compiled node, static children are contiguous and sorted by first byte
+  struct FlatNode
+  {
+    int prefixOffset;   // into pool_
+    int prefixLength;
+    int nameOffset;     // parameter name, into pool_
+    int nameLength;
+    int firstChild;
+    int numChildren;
+    int paramChild;     // -1 if none
+    int wildcardChild;  // -1 if none
+    int handlers[kNumMethods];  // into handlers_, -1 if none
+  };
+
+  void compile();
+  void flatten(const Node* node, int index);
+  bool matchNode(int index, const char* path, const char* end,
+                 HttpRequest::Method method, HttpRouteParams* params,
+                 int* handler, int* pathMatched) const;
+  bool hasHandlers(int index) const;
+  // for the Allow header of a 405
+  string allowedMethods(int index) const;
+
+  std::unique_ptr<Node> root_;
+  std::vector<Handler> handlers_;
+  std::vector<FlatNode> nodes_;
+  string pool_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPROUTER_H
@@ -61,6 +61,10 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
   {
     conn->setContext(HttpContext()); //TcpConnection 与一个HttpContext 绑定
   }
+  if (connectionCallback_)
+  {
+    connectionCallback_(conn);
+  }
 }
 
 void HttpServer::onMessage(const TcpConnectionPtr& conn,
@@ -70,15 +74,34 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
   //先取出 http 的上下文
   HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
-//解析请求
-  if (!context->parseRequest(buf, receiveTime))
+  // pipelined requests may arrive in one read
+  while (buf->readableBytes() > 0)
   {
-    conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-    conn->shutdown();
-  }
+//解析请求
+    if (!context->parseRequest(buf, receiveTime))
+    {
+      conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
+      conn->shutdown();
+      break;
+    }
 
-  if (context->gotAll())
-  {
+    if (!context->gotAll())
+    {
+      break;
+    }
+    if (upgradeCallback_ && !context->request().getHeader("Upgrade").empty())
+    {
+      // the callback may replace the context
+      HttpRequest req;
+      req.swap(context->request());
+      context->reset();
+      if (upgradeCallback_(conn, req, receiveTime))
+      {
+        break;
+      }
+      onRequest(conn, req);
+      continue;
+    }
     onRequest(conn, context->request());
     context->reset();  //本次请求处理完毕, 重置 httpContext ,适用于长连接
   }
@@ -91,9 +114,27 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
   HttpResponse response(close);
   httpCallback_(req, &response);
+  if (responseFilter_)
+  {
+    responseFilter_(req, &response);
+  }
   Buffer buf;
-  response.appendToBuffer(&buf);
+  if (req.method() == HttpRequest::kHead)
+  {
+    response.appendHeadersToBuffer(&buf);
+  }
+  else
+  {
+    response.appendToBuffer(&buf);
+  }
   conn->send(&buf);
+  if (response.hasBodyFile() && req.method() != HttpRequest::kHead)
+  {
+    conn->sendFile(response.bodyFileFd(),
+                   response.bodyFileOffset(),
+                   response.bodyFileLength(),
+                   response.bodyFileGuard());
+  }
   if (response.closeConnection())
   {
     conn->shutdown();
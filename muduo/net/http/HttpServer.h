@@ -31,6 +31,9 @@ class HttpServer : noncopyable
  public:
   typedef std::function<void (const HttpRequest&,
                               HttpResponse*)> HttpCallback;
+  typedef std::function<bool (const TcpConnectionPtr&,
+                              const HttpRequest&,
+                              Timestamp)> UpgradeCallback;
 
   HttpServer(EventLoop* loop,
              const InetAddress& listenAddr,
@@ -45,6 +48,29 @@ class HttpServer : noncopyable
     httpCallback_ = cb;
   }
 
+  /// Called after HttpCallback to post-process every response,
+  /// e.g. HttpCompressionFilter. Not thread safe, set before start().
+  void setResponseFilter(const HttpCallback& cb)
+  {
+    responseFilter_ = cb;
+  }
+
+  /// Called for requests with an "Upgrade" header, eg. WebSocketServer.
+  /// Returns true if it takes over the connection, HttpServer then stops
+  /// parsing, unparsed input is left in conn->inputBuffer().
+  /// Not thread safe, set before start().
+  void setUpgradeCallback(const UpgradeCallback& cb)
+  {
+    upgradeCallback_ = cb;
+  }
+
+  /// Called when a connection is up or down, after HttpServer's own handling.
+  /// Not thread safe, set before start().
+  void setConnectionCallback(const ConnectionCallback& cb)
+  {
+    connectionCallback_ = cb;
+  }
+
   void setThreadNum(int numThreads)
   {
     server_.setThreadNum(numThreads);
@@ -63,6 +89,9 @@ class HttpServer : noncopyable
   TcpServer server_; 
 
   //当接收到一个 http 请求, 回调 onMessage , onMessage 回调 onRequest , onRequest 回调 httpCallback
+  HttpCallback responseFilter_;
+  UpgradeCallback upgradeCallback_;
+  ConnectionCallback connectionCallback_;
   HttpCallback httpCallback_;  //在处理http 请求(即调用onRequest) 的过程中回调此函数,对请求进行具体处理
 };
 
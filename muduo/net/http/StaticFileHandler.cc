@@ -0,0 +1,485 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/StaticFileHandler.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct StaticFileHandler::File : noncopyable
+{
+  File()
+    : fd(-1),
+      size(0),
+      mtime(0),
+      inode(0)
+  {
+  }
+
+  ~File()
+  {
+    if (fd >= 0)
+    {
+      ::close(fd);
+    }
+  }
+
+  string path;
+  int fd;  // -1 if content is in memory
+  int64_t size;
+  time_t mtime;
+  ino_t inode;
+  string etag;
+  string lastModified;
+  string contentType;
+  string content;
+  Timestamp validated;  // guarded by StaticFileHandler::mutex_
+};
+
+namespace
+{
+
+const char* contentTypeOf(const string& path)
+{
+  static const struct
+  {
+    const char* extension;
+    const char* type;
+  } kTypes[] = {
+    { ".html", "text/html" },
+    { ".htm", "text/html" },
+    { ".css", "text/css" },
+    { ".js", "application/javascript" },
+    { ".json", "application/json" },
+    { ".txt", "text/plain" },
+    { ".xml", "text/xml" },
+    { ".png", "image/png" },
+    { ".jpg", "image/jpeg" },
+    { ".jpeg", "image/jpeg" },
+    { ".gif", "image/gif" },
+    { ".svg", "image/svg+xml" },
+    { ".ico", "image/x-icon" },
+    { ".wasm", "application/wasm" },
+    { ".pdf", "application/pdf" },
+    { ".woff2", "font/woff2" },
+  };
+
+  size_t dot = path.rfind('.');
+  if (dot != string::npos && path.find('/', dot) == string::npos)
+  {
+    const char* extension = path.c_str() + dot;
+    for (const auto& t : kTypes)
+    {
+      if (::strcasecmp(extension, t.extension) == 0)
+      {
+        return t.type;
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+int hexValue(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// decodes %XX, returns false if path escapes document root
+bool normalizePath(const string& path, string* result)
+{
+  if (path.empty() || path[0] != '/')
+  {
+    return false;
+  }
+  result->clear();
+  for (size_t i = 0; i < path.size(); ++i)
+  {
+    char c = path[i];
+    if (c == '%')
+    {
+      if (i + 2 >= path.size())
+      {
+        return false;
+      }
+      int hi = hexValue(path[i+1]);
+      int lo = hexValue(path[i+2]);
+      if (hi < 0 || lo < 0)
+      {
+        return false;
+      }
+      c = static_cast<char>(hi * 16 + lo);
+      i += 2;
+    }
+    if (c == '\0')
+    {
+      return false;
+    }
+    result->push_back(c);
+  }
+  // reject any ".." segment
+  size_t pos = 0;
+  while ((pos = result->find("..", pos)) != string::npos)
+  {
+    bool segmentBegin = (*result)[pos-1] == '/';
+    bool segmentEnd = pos + 2 == result->size() || (*result)[pos+2] == '/';
+    if (segmentBegin && segmentEnd)
+    {
+      return false;
+    }
+    pos += 2;
+  }
+  if ((*result)[result->size()-1] == '/')
+  {
+    result->append("index.html");
+  }
+  return true;
+}
+
+// single range only, returns 0 if range should be ignored,
+// 1 if satisfiable, -1 if not satisfiable.
+int parseRange(const string& range, int64_t size, int64_t* first, int64_t* last)
+{
+  const char kPrefix[] = "bytes=";
+  if (range.compare(0, sizeof(kPrefix)-1, kPrefix) != 0
+      || range.find(',') != string::npos)
+  {
+    return 0;
+  }
+  const char* start = range.c_str() + sizeof(kPrefix) - 1;
+  const char* dash = strchr(start, '-');
+  if (dash == NULL)
+  {
+    return 0;
+  }
+  char* end = NULL;
+  if (dash == start)
+  {
+    // suffix range, last N bytes
+    int64_t suffix = strtoll(dash+1, &end, 10);
+    if (end == dash+1 || *end != '\0' || suffix < 0)
+    {
+      return 0;
+    }
+    if (suffix == 0 || size == 0)
+    {
+      return -1;
+    }
+    *first = suffix >= size ? 0 : size - suffix;
+    *last = size - 1;
+    return 1;
+  }
+
+  *first = strtoll(start, &end, 10);
+  if (end != dash || *first < 0)
+  {
+    return 0;
+  }
+  if (dash[1] == '\0')
+  {
+    *last = size - 1;
+  }
+  else
+  {
+    *last = strtoll(dash+1, &end, 10);
+    if (*end != '\0' || *last < *first)
+    {
+      return 0;
+    }
+    if (*last >= size)
+    {
+      *last = size - 1;
+    }
+  }
+  return *first < size ? 1 : -1;
+}
+
+}  // namespace
+
+StaticFileHandler::StaticFileHandler(const string& documentRoot)
+  : documentRoot_(documentRoot),
+    maxOpenFiles_(1024),
+    maxInMemoryFileSize_(16*1024),
+    revalidateInterval_(1.0)
+{
+}
+
+StaticFileHandler::~StaticFileHandler()
+{
+}
+
+size_t StaticFileHandler::cachedFiles() const
+{
+  MutexLockGuard lock(mutex_);
+  return lru_.size();
+}
+
+string StaticFileHandler::formatHttpDate(time_t t)
+{
+  struct tm tm;
+  ::gmtime_r(&t, &tm);
+  char buf[64];
+  size_t len = ::strftime(buf, sizeof buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  return string(buf, len);
+}
+
+bool StaticFileHandler::parseHttpDate(const string& date, time_t* t)
+{
+  struct tm tm;
+  memZero(&tm, sizeof tm);
+  const char* end = ::strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (end == NULL || *end != '\0')
+  {
+    return false;
+  }
+  *t = ::timegm(&tm);
+  return true;
+}
+
+StaticFileHandler::FilePtr StaticFileHandler::openFile(const string& path) const
+{
+  string fullPath = documentRoot_ + path;
+  int fd = ::open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    if (errno != ENOENT && errno != ENOTDIR)
+    {
+      LOG_SYSERR << "StaticFileHandler::openFile " << fullPath;
+    }
+    return FilePtr();
+  }
+
+  FilePtr file(new File);
+  file->path = path;
+  file->fd = fd;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+  {
+    return FilePtr();
+  }
+  file->size = st.st_size;
+  file->mtime = st.st_mtime;
+  file->inode = st.st_ino;
+  char buf[64];
+  snprintf(buf, sizeof buf, "\"%lx-%llx\"",
+           static_cast<unsigned long>(file->mtime),
+           static_cast<unsigned long long>(file->size));
+  file->etag = buf;
+  file->lastModified = formatHttpDate(file->mtime);
+  file->contentType = contentTypeOf(path);
+  file->validated = Timestamp::now();
+
+  if (file->size <= static_cast<int64_t>(maxInMemoryFileSize_))
+  {
+    file->content.resize(static_cast<size_t>(file->size));
+    size_t nread = 0;
+    while (nread < file->content.size())
+    {
+      ssize_t n = ::pread(fd, &file->content[nread], file->content.size() - nread,
+                          static_cast<off_t>(nread));
+      if (n <= 0)
+      {
+        LOG_SYSERR << "StaticFileHandler::openFile read " << fullPath;
+        return FilePtr();
+      }
+      nread += n;
+    }
+    ::close(file->fd);
+    file->fd = -1;
+  }
+  return file;
+}
+
+void StaticFileHandler::insertFile(const FilePtr& file)
+{
+  MutexLockGuard lock(mutex_);
+  auto it = files_.find(file->path);
+  if (it != files_.end())
+  {
+    lru_.erase(it->second);
+    files_.erase(it);
+  }
+  lru_.push_front(file);
+  files_[file->path] = lru_.begin();
+  while (lru_.size() > maxOpenFiles_)
+  {
+    // in-flight transfers keep their own reference
+    files_.erase(lru_.back()->path);
+    lru_.pop_back();
+  }
+}
+
+StaticFileHandler::FilePtr StaticFileHandler::getFile(const string& path)
+{
+  FilePtr file;
+  Timestamp validated;
+  {
+    MutexLockGuard lock(mutex_);
+    auto it = files_.find(path);
+    if (it != files_.end())
+    {
+      file = *it->second;
+      validated = file->validated;
+      lru_.splice(lru_.begin(), lru_, it->second);
+    }
+  }
+
+  Timestamp now(Timestamp::now());
+  if (file && timeDifference(now, validated) > revalidateInterval_)
+  {
+    struct stat st;
+    string fullPath = documentRoot_ + path;
+    if (::stat(fullPath.c_str(), &st) == 0
+        && st.st_ino == file->inode
+        && st.st_size == file->size
+        && st.st_mtime == file->mtime)
+    {
+      MutexLockGuard lock(mutex_);
+      file->validated = now;
+    }
+    else
+    {
+      file.reset();
+    }
+  }
+
+  if (!file)
+  {
+    file = openFile(path);
+    if (file)
+    {
+      insertFile(file);
+    }
+  }
+  return file;
+}
+
+bool StaticFileHandler::handle(const HttpRequest& req, HttpResponse* resp)
+{
+  string path;
+  if (!normalizePath(req.path(), &path))
+  {
+    return false;
+  }
+  FilePtr file = getFile(path);
+  if (!file)
+  {
+    return false;
+  }
+
+  if (req.method() != HttpRequest::kGet && req.method() != HttpRequest::kHead)
+  {
+    resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+    resp->setStatusMessage("Method Not Allowed");
+    resp->addHeader("Allow", "GET, HEAD");
+    return true;
+  }
+
+  resp->addHeader("Accept-Ranges", "bytes");
+  resp->addHeader("ETag", file->etag);
+  resp->addHeader("Last-Modified", file->lastModified);
+
+  // If-None-Match takes precedence over If-Modified-Since
+  const string& ifNoneMatch = req.getHeader("If-None-Match");
+  bool notModified = false;
+  if (!ifNoneMatch.empty())
+  {
+    notModified = ifNoneMatch == "*" || ifNoneMatch.find(file->etag) != string::npos;
+  }
+  else
+  {
+    time_t since = 0;
+    notModified = parseHttpDate(req.getHeader("If-Modified-Since"), &since)
+                  && file->mtime <= since;
+  }
+  if (notModified)
+  {
+    resp->setStatusCode(HttpResponse::k304NotModified);
+    resp->setStatusMessage("Not Modified");
+    return true;
+  }
+
+  resp->setContentType(file->contentType);
+  int64_t first = 0;
+  int64_t last = file->size - 1;
+  const string& range = req.getHeader("Range");
+  const string& ifRange = req.getHeader("If-Range");
+  int ranged = 0;
+  if (!range.empty() && (ifRange.empty() || ifRange == file->etag))
+  {
+    ranged = parseRange(range, file->size, &first, &last);
+  }
+  if (ranged < 0)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "bytes */%lld", static_cast<long long>(file->size));
+    resp->setStatusCode(HttpResponse::k416RangeNotSatisfiable);
+    resp->setStatusMessage("Range Not Satisfiable");
+    resp->addHeader("Content-Range", buf);
+    return true;
+  }
+  else if (ranged > 0)
+  {
+    char buf[96];
+    snprintf(buf, sizeof buf, "bytes %lld-%lld/%lld",
+             static_cast<long long>(first),
+             static_cast<long long>(last),
+             static_cast<long long>(file->size));
+    resp->setStatusCode(HttpResponse::k206PartialContent);
+    resp->setStatusMessage("Partial Content");
+    resp->addHeader("Content-Range", buf);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+  }
+
+  size_t length = static_cast<size_t>(last - first + 1);
+  if (file->fd < 0)
+  {
+    if (ranged > 0)
+    {
+      resp->setBody(file->content.substr(static_cast<size_t>(first), length));
+    }
+    else
+    {
+      resp->setBody(file->content);
+    }
+  }
+  else
+  {
+    resp->setBodyFile(file->fd, first, length, file);
+  }
+  return true;
+}
+
+void StaticFileHandler::onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+  if (!handle(req, resp))
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
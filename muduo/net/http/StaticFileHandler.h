@@ -0,0 +1,93 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_STATICFILEHANDLER_H
+#define MUDUO_NET_HTTP_STATICFILEHANDLER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <time.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpRequest;
+class HttpResponse;
+
+/// Serves files under a document root, for HttpServer.
+///
+/// Open file descriptors and stat results are kept in a LRU cache,
+/// file bodies are sent with sendfile(2) without copying through Buffer.
+/// Small files can be kept in memory instead.
+/// Supports single Range requests and conditional GET
+/// (If-None-Match, If-Modified-Since).
+/// It is thread safe, can be shared by all threads of a HttpServer.
+class StaticFileHandler : noncopyable
+{
+ public:
+  explicit StaticFileHandler(const string& documentRoot);
+  ~StaticFileHandler();
+
+  /// Not thread safe, set before serving.
+  void setMaxOpenFiles(size_t n)
+  { maxOpenFiles_ = n; }
+
+  /// Files not larger than n bytes are served from memory, 0 to disable.
+  void setMaxInMemoryFileSize(size_t n)
+  { maxInMemoryFileSize_ = n; }
+
+  /// Cached entries are stat(2)'ed again after this many seconds.
+  void setRevalidateInterval(double seconds)
+  { revalidateInterval_ = seconds; }
+
+  /// Returns false if req is not a file under document root,
+  /// resp is untouched in this case, caller may try other handlers.
+  bool handle(const HttpRequest& req, HttpResponse* resp);
+
+  /// Can be used as HttpServer::HttpCallback, replies 404 if not found.
+  void onRequest(const HttpRequest& req, HttpResponse* resp);
+
+  size_t cachedFiles() const;
+
+  static string formatHttpDate(time_t t);
+  static bool parseHttpDate(const string& date, time_t* t);
+
+ private:
+  struct File;
+  typedef std::shared_ptr<File> FilePtr;
+  typedef std::list<FilePtr> FileList;
+
+  FilePtr getFile(const string& path);
+  FilePtr openFile(const string& path) const;
+  void insertFile(const FilePtr& file);
+
+  const string documentRoot_;
+  size_t maxOpenFiles_;
+  size_t maxInMemoryFileSize_;
+  double revalidateInterval_;
+
+  mutable MutexLock mutex_;
+  // front is the most recently used
+  FileList lru_ GUARDED_BY(mutex_);
+  std::unordered_map<string, FileList::iterator> files_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_STATICFILEHANDLER_H
@@ -0,0 +1,381 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/WebSocketCodec.h"
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/ZlibStream.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+// RFC 3174, only used for the opening handshake
+void sha1(const string& message, unsigned char digest[20])
+{
+  uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+  string data(message);
+  const uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+  data += '\x80';
+  while (data.size() % 64 != 56)
+  {
+    data += '\0';
+  }
+  for (int i = 7; i >= 0; --i)
+  {
+    data += static_cast<char>(bits >> (i * 8));
+  }
+
+  for (size_t chunk = 0; chunk < data.size(); chunk += 64)
+  {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + chunk);
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i)
+    {
+      w[i] = static_cast<uint32_t>(p[4*i]) << 24 | static_cast<uint32_t>(p[4*i+1]) << 16
+           | static_cast<uint32_t>(p[4*i+2]) << 8 | static_cast<uint32_t>(p[4*i+3]);
+    }
+    for (int i = 16; i < 80; ++i)
+    {
+      uint32_t x = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+      w[i] = (x << 1) | (x >> 31);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i)
+    {
+      uint32_t f, k;
+      if (i < 20)
+      {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      }
+      else if (i < 40)
+      {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      }
+      else if (i < 60)
+      {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      }
+      else
+      {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = (b << 30) | (b >> 2);
+      b = a;
+      a = temp;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 20; ++i)
+  {
+    digest[i] = static_cast<unsigned char>(h[i/4] >> (24 - (i % 4) * 8));
+  }
+}
+
+string base64(const unsigned char* data, size_t len)
+{
+  static const char kTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  string result;
+  for (size_t i = 0; i < len; i += 3)
+  {
+    uint32_t n = static_cast<uint32_t>(data[i]) << 16;
+    if (i + 1 < len)
+      n |= static_cast<uint32_t>(data[i+1]) << 8;
+    if (i + 2 < len)
+      n |= data[i+2];
+    result += kTable[(n >> 18) & 63];
+    result += kTable[(n >> 12) & 63];
+    result += i + 1 < len ? kTable[(n >> 6) & 63] : '=';
+    result += i + 2 < len ? kTable[n & 63] : '=';
+  }
+  return result;
+}
+
+}  // namespace
+
+int WebSocketCodec::parseFrameHeader(const char* data, size_t len, FrameHeader* header)
+{
+  if (len < 2)
+  {
+    return 0;
+  }
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  if (p[0] & 0x30)
+  {
+    // RSV2 and RSV3 are not used by any extension we negotiate
+    return -1;
+  }
+  const int opcode = p[0] & 0x0F;
+  if (opcode != kContinuation && opcode != kText && opcode != kBinary
+      && opcode != kClose && opcode != kPing && opcode != kPong)
+  {
+    return -1;
+  }
+  header->fin = (p[0] & 0x80) != 0;
+  header->rsv1 = (p[0] & 0x40) != 0;
+  header->opcode = static_cast<Opcode>(opcode);
+  header->masked = (p[1] & 0x80) != 0;
+
+  uint64_t payloadLength = p[1] & 0x7F;
+  size_t headerLength = 2;
+  if (payloadLength == 126)
+  {
+    if (len < 4)
+      return 0;
+    payloadLength = static_cast<uint64_t>(p[2]) << 8 | p[3];
+    headerLength = 4;
+  }
+  else if (payloadLength == 127)
+  {
+    if (len < 10)
+      return 0;
+    payloadLength = 0;
+    for (int i = 2; i < 10; ++i)
+    {
+      payloadLength = payloadLength << 8 | p[i];
+    }
+    if (payloadLength >> 63)
+      return -1;
+    headerLength = 10;
+  }
+
+  if (header->masked)
+  {
+    if (len < headerLength + 4)
+      return 0;
+    memcpy(header->maskingKey, data + headerLength, 4);
+    headerLength += 4;
+  }
+
+  if (isControl(header->opcode) && (!header->fin || header->rsv1 || payloadLength > 125))
+  {
+    return -1;
+  }
+  header->headerLength = headerLength;
+  header->payloadLength = payloadLength;
+  return 1;
+}
+
+void WebSocketCodec::unmask(char* data, size_t len, const char maskingKey[4])
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  int key;
+  memcpy(&key, maskingKey, sizeof key);
+  const __m128i mask = _mm_set1_epi32(key);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i* p = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+  }
+#else
+  uint64_t key;
+  memcpy(&key, maskingKey, 4);
+  memcpy(reinterpret_cast<char*>(&key) + 4, maskingKey, 4);
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t x;
+    memcpy(&x, data + i, sizeof x);
+    x ^= key;
+    memcpy(data + i, &x, sizeof x);
+  }
+#endif
+  // i is a multiple of 4, so the key is still aligned
+  for (; i < len; ++i)
+  {
+    data[i] = static_cast<char>(data[i] ^ maskingKey[i & 3]);
+  }
+}
+
+void WebSocketCodec::appendFrame(Buffer* output, Opcode opcode, StringPiece payload,
+                                 bool fin, bool rsv1)
+{
+  unsigned char header[10];
+  size_t headerLength = 2;
+  header[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | (rsv1 ? 0x40 : 0) | opcode);
+  const uint64_t len = static_cast<uint64_t>(payload.size());
+  if (len < 126)
+  {
+    header[1] = static_cast<unsigned char>(len);
+  }
+  else if (len <= 0xFFFF)
+  {
+    header[1] = 126;
+    header[2] = static_cast<unsigned char>(len >> 8);
+    header[3] = static_cast<unsigned char>(len);
+    headerLength = 4;
+  }
+  else
+  {
+    header[1] = 127;
+    for (int i = 0; i < 8; ++i)
+    {
+      header[2 + i] = static_cast<unsigned char>(len >> (56 - i * 8));
+    }
+    headerLength = 10;
+  }
+  output->ensureWritableBytes(headerLength + payload.size());
+  output->append(header, headerLength);
+  output->append(payload.data(), payload.size());
+}
+
+void WebSocketCodec::appendMessage(Buffer* output, Opcode opcode, StringPiece payload,
+                                   bool compressed, size_t maxFrameSize)
+{
+  const size_t len = payload.size();
+  if (maxFrameSize == 0 || len <= maxFrameSize)
+  {
+    appendFrame(output, opcode, payload, true, compressed);
+    return;
+  }
+
+  for (size_t offset = 0; offset < len; offset += maxFrameSize)
+  {
+    const size_t n = std::min(maxFrameSize, len - offset);
+    appendFrame(output,
+                offset == 0 ? opcode : kContinuation,
+                StringPiece(payload.data() + offset, static_cast<int>(n)),
+                offset + n == len,
+                offset == 0 && compressed);
+  }
+}
+
+bool WebSocketCodec::deflate(StringPiece payload, Buffer* output)
+{
+  size_t flushed = 0;
+  {
+    ZlibOutputStream stream(output, Z_DEFAULT_COMPRESSION, -MAX_WBITS);
+    if (!stream.write(payload) || !stream.flush())
+      return false;
+    flushed = output->readableBytes();
+  }
+  // drop the final block written by ~ZlibOutputStream,
+  // and the 00 00 ff ff tail of Z_SYNC_FLUSH, see RFC 7692 section 7.2.1
+  output->unwrite(output->readableBytes() - flushed);
+  if (output->readableBytes() >= 4
+      && memcmp(output->peek() + output->readableBytes() - 4, "\x00\x00\xff\xff", 4) == 0)
+  {
+    output->unwrite(4);
+  }
+  return true;
+}
+
+int WebSocketCodec::inflate(ZlibInputStream* inflater, Buffer* output,
+                            StringPiece message, size_t maxSize)
+{
+  if (!inflater->write(message, maxSize))
+  {
+    return -1;
+  }
+  // the tail of Z_SYNC_FLUSH stripped by the sender, unless the peer
+  // ended the deflate stream
+  if (output->readableBytes() <= maxSize
+      && inflater->zlibErrorCode() != Z_STREAM_END
+      && !inflater->write(StringPiece("\x00\x00\xff\xff", 4), maxSize))
+  {
+    return -1;
+  }
+  return output->readableBytes() <= maxSize ? 1 : 0;
+}
+
+bool WebSocketCodec::isValidUtf8(StringPiece data)
+{
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+  const unsigned char* end = p + data.size();
+  while (p < end)
+  {
+    // ASCII runs, 8 bytes at a time
+    while (end - p >= 8)
+    {
+      uint64_t word;
+      memcpy(&word, p, sizeof word);
+      if (word & 0x8080808080808080ULL)
+        break;
+      p += 8;
+    }
+    if (p == end)
+      break;
+
+    const unsigned char c = *p;
+    if (c < 0x80)
+    {
+      ++p;
+      continue;
+    }
+    // second byte range of RFC 3629 section 4, the rest are 80..BF
+    int n = 0;
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+      n = 1;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      n = 2;
+      if (c == 0xE0)
+        low = 0xA0;  // overlong
+      else if (c == 0xED)
+        high = 0x9F;  // surrogates
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      n = 3;
+      if (c == 0xF0)
+        low = 0x90;  // overlong
+      else if (c == 0xF4)
+        high = 0x8F;  // above U+10FFFF
+    }
+    else
+    {
+      return false;
+    }
+    if (end - p <= n || p[1] < low || p[1] > high)
+      return false;
+    for (int i = 2; i <= n; ++i)
+    {
+      if (p[i] < 0x80 || p[i] > 0xBF)
+        return false;
+    }
+    p += n + 1;
+  }
+  return true;
+}
+
+string WebSocketCodec::acceptKey(const string& key)
+{
+  unsigned char digest[20];
+  sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+  return base64(digest, sizeof digest);
+}
@@ -0,0 +1,106 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_WEBSOCKETCODEC_H
+#define MUDUO_NET_HTTP_WEBSOCKETCODEC_H
+
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include <stdint.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class Buffer;
+class ZlibInputStream;
+
+/// WebSocket framing of RFC 6455 and permessage-deflate of RFC 7692.
+///
+/// Frames are decoded in place, the payload is unmasked inside the input
+/// Buffer and handed out as a StringPiece, so unfragmented messages are
+/// never copied.
+class WebSocketCodec
+{
+ public:
+  enum Opcode
+  {
+    kContinuation = 0x0,
+    kText = 0x1,
+    kBinary = 0x2,
+    kClose = 0x8,
+    kPing = 0x9,
+    kPong = 0xA,
+  };
+
+  enum CloseCode
+  {
+    kNormalClosure = 1000,
+    kGoingAway = 1001,
+    kProtocolError = 1002,
+    kInvalidPayload = 1007,
+    kMessageTooBig = 1009,
+  };
+
+  struct FrameHeader
+  {
+    bool fin;
+    bool rsv1;     // compressed, with permessage-deflate
+    bool masked;
+    Opcode opcode;
+    char maskingKey[4];
+    size_t headerLength;
+    uint64_t payloadLength;
+  };
+
+  /// Returns 1 if a complete header is decoded, 0 if more data is needed,
+  /// -1 if the header is malformed.
+  static int parseFrameHeader(const char* data, size_t len, FrameHeader* header);
+
+  /// XORs data with the 4-byte masking key, 16 bytes at a time with SSE2.
+  static void unmask(char* data, size_t len, const char maskingKey[4]);
+
+  /// Appends an unmasked frame, as sent by servers.
+  static void appendFrame(Buffer* output, Opcode opcode, StringPiece payload,
+                          bool fin = true, bool rsv1 = false);
+
+  /// Appends a message split into frames of at most maxFrameSize bytes,
+  /// 0 means no fragmentation.
+  static void appendMessage(Buffer* output, Opcode opcode, StringPiece payload,
+                            bool compressed, size_t maxFrameSize);
+
+  /// Compresses payload as one permessage-deflate message,
+  /// with no context takeover. Returns false on zlib error.
+  static bool deflate(StringPiece payload, Buffer* output);
+
+  /// Inflates one permessage-deflate message with inflater, whose output
+  /// is output.  Stops as soon as output holds more than maxSize bytes, so
+  /// a small message cannot inflate to gigabytes first.
+  /// Returns 1 on success, 0 if larger than maxSize, -1 if corrupted.
+  static int inflate(ZlibInputStream* inflater, Buffer* output,
+                     StringPiece message, size_t maxSize);
+
+  /// Well-formed UTF-8 of RFC 3629, no overlong forms or surrogates,
+  /// as required for text messages and close reasons.
+  static bool isValidUtf8(StringPiece data);
+
+  /// Value of Sec-WebSocket-Accept for Sec-WebSocket-Key.
+  static string acceptKey(const string& key);
+
+  static bool isControl(Opcode opcode)
+  { return (opcode & 0x8) != 0; }
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_WEBSOCKETCODEC_H
@@ -0,0 +1,475 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+
+#include "muduo/net/http/WebSocketServer.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/ZlibStream.h"
+#include "muduo/net/http/HttpServer.h"
+
+#include <algorithm>
+
+#include <string.h>
+#include <strings.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+bool tokenEquals(const char* begin, const char* end, const char* token)
+{
+  while (begin < end && isspace(*begin))
+    ++begin;
+  while (end > begin && isspace(end[-1]))
+    --end;
+  const size_t len = strlen(token);
+  return static_cast<size_t>(end - begin) == len && strncasecmp(begin, token, len) == 0;
+}
+
+// Accepts an offer like "permessage-deflate; client_max_window_bits",
+// we always compress with a full window, so offers limiting it are declined.
+bool offersDeflate(const string& extensions)
+{
+  const char* p = extensions.c_str();
+  const char* end = p + extensions.size();
+  while (p < end)
+  {
+    const char* comma = std::find(p, end, ',');
+    const char* semicolon = std::find(p, comma, ';');
+    if (tokenEquals(p, semicolon, "permessage-deflate"))
+    {
+      string params(semicolon, comma);
+      if (params.find("server_max_window_bits") == string::npos)
+      {
+        return true;
+      }
+    }
+    p = comma == end ? end : comma + 1;
+  }
+  return false;
+}
+
+StringPiece toStringPiece(const char* data, size_t len)
+{
+  return StringPiece(data, static_cast<int>(len));
+}
+
+}  // namespace
+
+WebSocketMessage::WebSocketMessage(StringPiece payload, bool binary,
+                                   bool deflate, size_t maxFrameSize)
+{
+  const WebSocketCodec::Opcode opcode = binary ? WebSocketCodec::kBinary : WebSocketCodec::kText;
+  Buffer buf;
+  WebSocketCodec::appendMessage(&buf, opcode, payload, false, maxFrameSize);
+  frame_.reset(new string(buf.retrieveAllAsString()));
+
+  Buffer deflated;
+  if (deflate
+      && WebSocketCodec::deflate(payload, &deflated)
+      && deflated.readableBytes() < static_cast<size_t>(payload.size()))
+  {
+    WebSocketCodec::appendMessage(&buf, opcode, deflated.toStringPiece(), true, maxFrameSize);
+    deflatedFrame_.reset(new string(buf.retrieveAllAsString()));
+  }
+}
+
+WebSocketConnection::WebSocketConnection(WebSocketServer* server,
+                                         const TcpConnectionPtr& conn,
+                                         const HttpRequest& request,
+                                         bool deflate)
+  : server_(server),
+    conn_(conn),
+    request_(request),
+    deflate_(deflate),
+    closeSent_(false),
+    failed_(false),
+    inMessage_(false),
+    binary_(false),
+    compressed_(false)
+{
+}
+
+WebSocketConnection::~WebSocketConnection()
+{
+}
+
+void WebSocketConnection::send(StringPiece message, bool binary)
+{
+  const WebSocketCodec::Opcode opcode = binary ? WebSocketCodec::kBinary : WebSocketCodec::kText;
+  const size_t maxFrameSize = server_->maxFrameSize_;
+  Buffer buf;
+  if (deflate_ && static_cast<size_t>(message.size()) >= server_->minDeflateSize_)
+  {
+    Buffer deflated;
+    if (WebSocketCodec::deflate(message, &deflated)
+        && deflated.readableBytes() < static_cast<size_t>(message.size()))
+    {
+      WebSocketCodec::appendMessage(&buf, opcode, deflated.toStringPiece(), true, maxFrameSize);
+      conn_->send(&buf);
+      return;
+    }
+  }
+  WebSocketCodec::appendMessage(&buf, opcode, message, false, maxFrameSize);
+  conn_->send(&buf);
+}
+
+void WebSocketConnection::send(const WebSocketMessage& message)
+{
+  if (deflate_ && message.deflatedFrame())
+  {
+    conn_->send(message.deflatedFrame());
+  }
+  else
+  {
+    conn_->send(message.frame());
+  }
+}
+
+void WebSocketConnection::ping(StringPiece payload)
+{
+  Buffer buf;
+  WebSocketCodec::appendFrame(&buf, WebSocketCodec::kPing, payload);
+  conn_->send(&buf);
+}
+
+void WebSocketConnection::close(int code, StringPiece reason)
+{
+  conn_->getLoop()->assertInLoopThread();
+  if (closeSent_)
+  {
+    return;
+  }
+  closeSent_ = true;
+  char payload[125];
+  payload[0] = static_cast<char>(code >> 8);
+  payload[1] = static_cast<char>(code);
+  size_t len = std::min(static_cast<size_t>(reason.size()), sizeof payload - 2);
+  memcpy(payload + 2, reason.data(), len);
+  Buffer buf;
+  WebSocketCodec::appendFrame(&buf, WebSocketCodec::kClose, toStringPiece(payload, len + 2));
+  conn_->send(&buf);
+}
+
+void WebSocketConnection::failConnection(int code)
+{
+  LOG_WARN << "WebSocketConnection " << conn_->name() << " failed with " << code;
+  failed_ = true;
+  close(code);
+  conn_->shutdown();
+}
+
+void WebSocketConnection::onMessage(Buffer* buf, Timestamp receiveTime)
+{
+  const size_t maxMessageSize = server_->maxMessageSize_;
+  while (!failed_ && buf->readableBytes() > 0)
+  {
+    WebSocketCodec::FrameHeader header;
+    int result = WebSocketCodec::parseFrameHeader(buf->peek(), buf->readableBytes(), &header);
+    if (result == 0)
+    {
+      break;
+    }
+    else if (result < 0 || !header.masked)
+    {
+      failConnection(WebSocketCodec::kProtocolError);
+      break;
+    }
+    if (header.payloadLength > maxMessageSize - message_.readableBytes())
+    {
+      failConnection(WebSocketCodec::kMessageTooBig);
+      break;
+    }
+
+    const size_t payloadLength = static_cast<size_t>(header.payloadLength);
+    const size_t frameLength = header.headerLength + payloadLength;
+    if (buf->readableBytes() < frameLength)
+    {
+      break;
+    }
+    // unmask in place, payload is not copied unless the message is fragmented
+    char* payload = const_cast<char*>(buf->peek()) + header.headerLength;
+    WebSocketCodec::unmask(payload, payloadLength, header.maskingKey);
+    bool more = onFrame(header, payload, receiveTime);
+    buf->retrieve(frameLength);
+    if (!more)
+    {
+      break;
+    }
+  }
+
+  if (failed_)
+  {
+    buf->retrieveAll();
+  }
+}
+
+bool WebSocketConnection::onFrame(const WebSocketCodec::FrameHeader& header,
+                                  char* payload,
+                                  Timestamp receiveTime)
+{
+  const size_t len = static_cast<size_t>(header.payloadLength);
+  switch (header.opcode)
+  {
+    case WebSocketCodec::kPing:
+    {
+      Buffer buf;
+      WebSocketCodec::appendFrame(&buf, WebSocketCodec::kPong, toStringPiece(payload, len));
+      conn_->send(&buf);
+      return true;
+    }
+    case WebSocketCodec::kPong:
+      return true;
+    case WebSocketCodec::kClose:
+    {
+      if (len == 1)
+      {
+        failConnection(WebSocketCodec::kProtocolError);
+        return false;
+      }
+      if (len > 2 && !WebSocketCodec::isValidUtf8(toStringPiece(payload + 2, len - 2)))
+      {
+        failConnection(WebSocketCodec::kInvalidPayload);
+        return false;
+      }
+      int code = WebSocketCodec::kNormalClosure;
+      if (len >= 2)
+      {
+        code = static_cast<unsigned char>(payload[0]) << 8 | static_cast<unsigned char>(payload[1]);
+      }
+      close(code);
+      failed_ = true;  // ignore anything after close
+      conn_->shutdown();
+      return false;
+    }
+    case WebSocketCodec::kText:
+    case WebSocketCodec::kBinary:
+      if (inMessage_ || (header.rsv1 && !deflate_))
+      {
+        failConnection(WebSocketCodec::kProtocolError);
+        return false;
+      }
+      binary_ = header.opcode == WebSocketCodec::kBinary;
+      compressed_ = header.rsv1;
+      if (header.fin)
+      {
+        break;
+      }
+      inMessage_ = true;
+      message_.append(payload, len);
+      return true;
+    case WebSocketCodec::kContinuation:
+      if (!inMessage_ || header.rsv1)
+      {
+        failConnection(WebSocketCodec::kProtocolError);
+        return false;
+      }
+      message_.append(payload, len);
+      if (!header.fin)
+      {
+        return true;
+      }
+      inMessage_ = false;
+      break;
+    default:
+      failConnection(WebSocketCodec::kProtocolError);
+      return false;
+  }
+
+  // a complete message, either in payload or in message_
+  StringPiece message = header.opcode == WebSocketCodec::kContinuation
+                        ? message_.toStringPiece()
+                        : toStringPiece(payload, len);
+  if (compressed_)
+  {
+    if (!inflater_)
+    {
+      inflater_.reset(new ZlibInputStream(&inflated_, -MAX_WBITS));
+    }
+    const int result = WebSocketCodec::inflate(inflater_.get(), &inflated_, message,
+                                               server_->maxMessageSize_);
+    if (result <= 0)
+    {
+      inflated_.retrieveAll();
+      failConnection(result == 0 ? WebSocketCodec::kMessageTooBig
+                                 : WebSocketCodec::kInvalidPayload);
+      return false;
+    }
+    if (inflater_->zlibErrorCode() == Z_STREAM_END)
+    {
+      // peer ended the deflate stream, start a new one for next message
+      inflater_.reset();
+    }
+    message = inflated_.toStringPiece();
+  }
+  if (!binary_ && !WebSocketCodec::isValidUtf8(message))
+  {
+    inflated_.retrieveAll();
+    failConnection(WebSocketCodec::kInvalidPayload);
+    return false;
+  }
+  deliver(message, binary_, receiveTime);
+  inflated_.retrieveAll();
+  message_.retrieveAll();
+  return true;
+}
+
+void WebSocketConnection::deliver(StringPiece message, bool binary, Timestamp receiveTime)
+{
+  if (server_->messageCallback_)
+  {
+    server_->messageCallback_(shared_from_this(), message, binary, receiveTime);
+  }
+}
+
+WebSocketServer::WebSocketServer(HttpServer* server)
+  : maxMessageSize_(16 * 1024 * 1024),
+    maxFrameSize_(0),
+    minDeflateSize_(256),
+    deflate_(true),
+    connections_(new ConnectionList)
+{
+  server->setUpgradeCallback(
+      std::bind(&WebSocketServer::onUpgrade, this, _1, _2, _3));
+  server->setConnectionCallback(
+      std::bind(&WebSocketServer::onConnection, this, _1));
+}
+
+WebSocketServer::~WebSocketServer()
+{
+}
+
+bool WebSocketServer::onUpgrade(const TcpConnectionPtr& conn,
+                                const HttpRequest& req,
+                                Timestamp receiveTime)
+{
+  if (::strcasecmp(req.getHeader("Upgrade").c_str(), "websocket") != 0)
+  {
+    return false;
+  }
+
+  const string key = req.getHeader("Sec-WebSocket-Key");
+  if (req.method() != HttpRequest::kGet || key.empty()
+      || req.getHeader("Sec-WebSocket-Version") != "13")
+  {
+    conn->send("HTTP/1.1 400 Bad Request\r\n"
+               "Sec-WebSocket-Version: 13\r\n"
+               "Connection: close\r\n\r\n");
+    conn->shutdown();
+    return true;
+  }
+
+  const bool deflate = deflate_ && offersDeflate(req.getHeader("Sec-WebSocket-Extensions"));
+  Buffer response;
+  response.append("HTTP/1.1 101 Switching Protocols\r\n"
+                  "Upgrade: websocket\r\n"
+                  "Connection: Upgrade\r\n"
+                  "Sec-WebSocket-Accept: ");
+  response.append(WebSocketCodec::acceptKey(key));
+  response.append("\r\n");
+  if (deflate)
+  {
+    response.append("Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover\r\n");
+  }
+  response.append("\r\n");
+  conn->send(&response);
+
+  WebSocketConnectionPtr ws(new WebSocketConnection(this, conn, req, deflate));
+  conn->setContext(ws);
+  conn->setMessageCallback(
+      std::bind(&WebSocketServer::onMessage, this, _1, _2, _3));
+  {
+    MutexLockGuard lock(mutex_);
+    if (!connections_.unique())
+    {
+      connections_.reset(new ConnectionList(*connections_));
+    }
+    assert(connections_.unique());
+    connections_->insert(ws);
+  }
+  LOG_DEBUG << "WebSocket " << conn->name() << " " << req.path()
+            << (deflate ? " with permessage-deflate" : "");
+  if (connectionCallback_)
+  {
+    connectionCallback_(ws);
+  }
+
+  // frames may come along with the upgrade request
+  if (conn->inputBuffer()->readableBytes() > 0)
+  {
+    ws->onMessage(conn->inputBuffer(), receiveTime);
+  }
+  return true;
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    return;
+  }
+
+  const WebSocketConnectionPtr* ws = boost::any_cast<WebSocketConnectionPtr>(&conn->getContext());
+  if (ws)
+  {
+    WebSocketConnectionPtr guard(*ws);
+    // break the cycle between TcpConnection and WebSocketConnection
+    conn->setContext(boost::any());
+    {
+      MutexLockGuard lock(mutex_);
+      if (!connections_.unique())
+      {
+        connections_.reset(new ConnectionList(*connections_));
+      }
+      assert(connections_.unique());
+      connections_->erase(guard);
+    }
+    if (connectionCallback_)
+    {
+      connectionCallback_(guard);
+    }
+  }
+}
+
+void WebSocketServer::onMessage(const TcpConnectionPtr& conn,
+                                Buffer* buf,
+                                Timestamp receiveTime)
+{
+  WebSocketConnectionPtr ws(boost::any_cast<WebSocketConnectionPtr>(conn->getContext()));
+  ws->onMessage(buf, receiveTime);
+}
+
+void WebSocketServer::broadcast(StringPiece message, bool binary)
+{
+  WebSocketMessage encoded(message, binary,
+                           deflate_ && static_cast<size_t>(message.size()) >= minDeflateSize_,
+                           maxFrameSize_);
+  ConnectionListPtr connections = getConnectionList();
+  for (ConnectionList::iterator it = connections->begin();
+      it != connections->end();
+      ++it)
+  {
+    (*it)->send(encoded);
+  }
+}
+
+size_t WebSocketServer::numConnections() const
+{
+  MutexLockGuard lock(mutex_);
+  return connections_->size();
+}
+
+WebSocketServer::ConnectionListPtr WebSocketServer::getConnectionList() const
+{
+  MutexLockGuard lock(mutex_);
+  return connections_;
+}
@@ -0,0 +1,190 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_HTTP_WEBSOCKETSERVER_H
+#define MUDUO_NET_HTTP_WEBSOCKETSERVER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/TcpConnection.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/WebSocketCodec.h"
+
+#include <set>
+
+namespace muduo
+{
+namespace net
+{
+
+class HttpServer;
+class WebSocketServer;
+class ZlibInputStream;
+
+/// A message encoded once, to be sent to many connections.
+/// With permessage-deflate, it is compressed once as well,
+/// which is possible because the server never takes over its
+/// compression context between messages.
+class WebSocketMessage : public muduo::copyable
+{
+ public:
+  WebSocketMessage(StringPiece payload, bool binary, bool deflate, size_t maxFrameSize);
+
+  const std::shared_ptr<const string>& frame() const
+  { return frame_; }
+
+  // NULL if not compressed
+  const std::shared_ptr<const string>& deflatedFrame() const
+  { return deflatedFrame_; }
+
+ private:
+  std::shared_ptr<const string> frame_;
+  std::shared_ptr<const string> deflatedFrame_;
+};
+
+/// One upgraded connection, stays valid after being closed.
+class WebSocketConnection : noncopyable,
+                            public std::enable_shared_from_this<WebSocketConnection>
+{
+ public:
+  WebSocketConnection(WebSocketServer* server,
+                      const TcpConnectionPtr& conn,
+                      const HttpRequest& request,
+                      bool deflate);
+  ~WebSocketConnection();
+
+  const TcpConnectionPtr& connection() const
+  { return conn_; }
+
+  /// The upgrade request, eg. for path() and cookies.
+  const HttpRequest& request() const
+  { return request_; }
+
+  bool connected() const
+  { return conn_->connected(); }
+
+  /// permessage-deflate negotiated.
+  bool deflate() const
+  { return deflate_; }
+
+  /// Thread safe.
+  void send(StringPiece message, bool binary = false);
+  /// Thread safe, shares the encoded frame.
+  void send(const WebSocketMessage& message);
+  void ping(StringPiece payload);
+  /// Starts the closing handshake.
+  void close(int code = WebSocketCodec::kNormalClosure, StringPiece reason = StringPiece());
+
+  void setContext(const boost::any& context)
+  { context_ = context; }
+
+  const boost::any& getContext() const
+  { return context_; }
+
+  boost::any* getMutableContext()
+  { return &context_; }
+
+ private:
+  friend class WebSocketServer;
+  void onMessage(Buffer* buf, Timestamp receiveTime);
+  bool onFrame(const WebSocketCodec::FrameHeader& header, char* payload, Timestamp receiveTime);
+  void deliver(StringPiece message, bool binary, Timestamp receiveTime);
+  void failConnection(int code);
+
+  WebSocketServer* server_;
+  TcpConnectionPtr conn_;
+  HttpRequest request_;
+  const bool deflate_;
+  bool closeSent_;
+  bool failed_;      // or close received, input is discarded
+  // current fragmented or compressed message
+  bool inMessage_;
+  bool binary_;
+  bool compressed_;
+  Buffer message_;
+  Buffer inflated_;
+  std::unique_ptr<ZlibInputStream> inflater_;
+  boost::any context_;
+};
+
+typedef std::shared_ptr<WebSocketConnection> WebSocketConnectionPtr;
+
+/// WebSocket server on top of HttpServer, see RFC 6455.
+///
+/// Takes over connections which send an "Upgrade: websocket" request,
+/// other requests are served by the HttpServer as usual.
+/// Supports permessage-deflate (RFC 7692) without server context takeover.
+class WebSocketServer : noncopyable
+{
+ public:
+  typedef std::function<void (const WebSocketConnectionPtr&)> ConnectionCallback;
+  typedef std::function<void (const WebSocketConnectionPtr&,
+                              StringPiece message,
+                              bool binary,
+                              Timestamp)> MessageCallback;
+
+  /// Installs upgrade and connection callbacks on server.
+  explicit WebSocketServer(HttpServer* server);
+  ~WebSocketServer();
+
+  /// Called when a connection is upgraded and when it is closed.
+  /// Not thread safe, set before HttpServer::start().
+  void setConnectionCallback(const ConnectionCallback& cb)
+  { connectionCallback_ = cb; }
+
+  /// message is valid only during the callback.
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// Larger messages close the connection with 1009, default 16MiB.
+  void setMaxMessageSize(size_t bytes)
+  { maxMessageSize_ = bytes; }
+
+  /// Outgoing messages are split into frames of this size, 0 for no limit.
+  void setMaxFrameSize(size_t bytes)
+  { maxFrameSize_ = bytes; }
+
+  /// Negotiate permessage-deflate, default true.
+  void setDeflate(bool on)
+  { deflate_ = on; }
+
+  /// Messages smaller than this are never compressed, default 256.
+  void setMinDeflateSize(size_t bytes)
+  { minDeflateSize_ = bytes; }
+
+  /// Sends message to every connection, encoding it once.
+  /// Thread safe.
+  void broadcast(StringPiece message, bool binary = false);
+
+  size_t numConnections() const;
+
+ private:
+  friend class WebSocketConnection;
+  typedef std::set<WebSocketConnectionPtr> ConnectionList;
+  typedef std::shared_ptr<ConnectionList> ConnectionListPtr;
+
+  bool onUpgrade(const TcpConnectionPtr& conn, const HttpRequest& req, Timestamp receiveTime);
+  void onConnection(const TcpConnectionPtr& conn);
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+  ConnectionListPtr getConnectionList() const;
+
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  size_t maxMessageSize_;
+  size_t maxFrameSize_;
+  size_t minDeflateSize_;
+  bool deflate_;
+  mutable MutexLock mutex_;
+  ConnectionListPtr connections_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_WEBSOCKETSERVER_H
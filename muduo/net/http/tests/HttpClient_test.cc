@@ -0,0 +1,48 @@
+#include "muduo/net/http/HttpClient.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/base/Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    printf("Usage: %s ip port path [count]\n", argv[0]);
+    return 0;
+  }
+  InetAddress serverAddr(argv[1], static_cast<uint16_t>(atoi(argv[2])));
+  int count = argc > 4 ? atoi(argv[4]) : 1;
+
+  EventLoop loop;
+  HttpClient client(&loop, "HttpClient");
+  client.setMaxPipelineDepth(16);
+  int remaining = count;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < count; ++i)
+  {
+    client.get(serverAddr, argv[3], [&](const HttpClientResponse& response) {
+      if (count == 1)
+      {
+        printf("%d %s\n", response.statusCode(), response.errorString());
+        for (const auto& header : response.headers())
+        {
+          printf("%s: %s\n", header.first.c_str(), header.second.c_str());
+        }
+        printf("\n%s", response.body().c_str());
+      }
+      if (--remaining == 0)
+      {
+        double seconds = timeDifference(Timestamp::now(), start);
+        LOG_INFO << count << " requests in " << seconds << " seconds, "
+                 << count / seconds << " req/s";
+        loop.quit();
+      }
+    });
+  }
+  loop.loop();
+}
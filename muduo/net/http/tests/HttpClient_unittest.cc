@@ -0,0 +1,224 @@
+#include "muduo/net/http/HttpClient.h"
+#include "muduo/net/http/HttpContext.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/http/HttpServer.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpServer.h"
+
+//#define BOOST_TEST_MODULE HttpClientTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <vector>
+
+using muduo::string;
+using muduo::Timestamp;
+using muduo::net::Buffer;
+using muduo::net::EventLoop;
+using muduo::net::HttpClient;
+using muduo::net::HttpClientResponse;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::HttpResponseContext;
+using muduo::net::HttpServer;
+using muduo::net::InetAddress;
+using muduo::net::TcpServer;
+
+BOOST_AUTO_TEST_CASE(testParseContentLength)
+{
+  string all("HTTP/1.1 200 OK\r\n"
+             "content-length: 5\r\n"
+             "Content-Type: text/plain\r\n"
+             "\r\n"
+             "hello");
+  // every split point
+  for (size_t sz1 = 0; sz1 < all.size(); ++sz1)
+  {
+    HttpResponseContext context;
+    Buffer input;
+    input.append(all.c_str(), sz1);
+    BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), false));
+    BOOST_CHECK(!context.gotAll());
+    input.append(all.c_str() + sz1, all.size() - sz1);
+    BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), false));
+    BOOST_CHECK(context.gotAll());
+    const HttpClientResponse& response = context.response();
+    BOOST_CHECK_EQUAL(response.statusCode(), 200);
+    BOOST_CHECK_EQUAL(response.statusMessage(), string("OK"));
+    BOOST_CHECK_EQUAL(response.getHeader("Content-Length"), string("5"));
+    BOOST_CHECK_EQUAL(response.body(), string("hello"));
+    BOOST_CHECK_EQUAL(input.readableBytes(), 0u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseChunked)
+{
+  HttpResponseContext context;
+  Buffer input;
+  input.append("HTTP/1.1 100 Continue\r\n\r\n"
+               "HTTP/1.1 200 OK\r\n"
+               "Transfer-Encoding: chunked\r\n"
+               "\r\n"
+               "5\r\nhello\r\n"
+               "7;ext=1\r\n, world\r\n"
+               "0\r\n"
+               "X-Trailer: yes\r\n"
+               "\r\n"
+               "HTTP/1.1 204 No Content\r\n\r\n");
+  BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), false));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(context.response().statusCode(), 200);
+  BOOST_CHECK_EQUAL(context.response().body(), string("hello, world"));
+  BOOST_CHECK_EQUAL(context.response().getHeader("x-trailer"), string("yes"));
+
+  // pipelined response left in buffer
+  context.reset();
+  BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), false));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(context.response().statusCode(), 204);
+}
+
+BOOST_AUTO_TEST_CASE(testParseUntilClose)
+{
+  HttpResponseContext context;
+  Buffer input;
+  input.append("HTTP/1.0 200 OK\r\n\r\nsome data");
+  BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), false));
+  BOOST_CHECK(!context.gotAll());
+  BOOST_CHECK(context.closeAfterResponse());
+  BOOST_CHECK(context.onConnectionClosed());
+  BOOST_CHECK_EQUAL(context.response().body(), string("some data"));
+}
+
+BOOST_AUTO_TEST_CASE(testParseHead)
+{
+  HttpResponseContext context;
+  Buffer input;
+  input.append("HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n");
+  BOOST_CHECK(context.parseResponse(&input, Timestamp::now(), true));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK(context.response().body().empty());
+}
+
+BOOST_AUTO_TEST_CASE(testParseBad)
+{
+  HttpResponseContext context;
+  Buffer input;
+  input.append("HTTP/2 200 OK\r\n\r\n");
+  BOOST_CHECK(!context.parseResponse(&input, Timestamp::now(), false));
+}
+
+namespace
+{
+
+void onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/plain");
+  resp->setBody(req.path());
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testPipelinedRequests)
+{
+  EventLoop loop;
+  InetAddress listenAddr("127.0.0.1", 18028);
+  HttpServer server(&loop, listenAddr, "HttpClientTest");
+  server.setHttpCallback(onRequest);
+  server.start();
+
+  std::unique_ptr<HttpClient> client(new HttpClient(&loop, "HttpClientTest"));
+  client->setMaxConnectionsPerHost(2);
+  client->setMaxPipelineDepth(8);
+  client->setTimeout(5.0);
+
+  const int kRequests = 20;
+  std::vector<string> bodies;
+  for (int i = 0; i < kRequests; ++i)
+  {
+    string path = "/path/" + std::to_string(i);
+    client->get(listenAddr, path, [&, path](const HttpClientResponse& response) {
+      BOOST_CHECK(response.ok());
+      BOOST_CHECK_EQUAL(response.statusCode(), 200);
+      BOOST_CHECK_EQUAL(response.body(), path);
+      bodies.push_back(response.body());
+      if (bodies.size() == kRequests)
+      {
+        BOOST_CHECK_LE(client->numConnections(listenAddr), 2u);
+        loop.quit();
+      }
+    });
+  }
+  loop.runAfter(10.0, [&loop] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK_EQUAL(bodies.size(), static_cast<size_t>(kRequests));
+
+  // ~TcpClient closes its connection in a queued functor, so destroy the
+  // client in the loop and let the connections close before quitting
+  loop.runAfter(0.0, [&client] { client.reset(); });
+  loop.runAfter(0.1, [&loop] { loop.quit(); });
+  loop.loop();
+}
+
+BOOST_AUTO_TEST_CASE(testTimeout)
+{
+  EventLoop loop;
+  // accepts, never responds
+  InetAddress serverAddr("127.0.0.1", 18029);
+  TcpServer server(&loop, serverAddr, "HttpClientTimeout");
+  server.start();
+
+  std::unique_ptr<HttpClient> client(new HttpClient(&loop, "HttpClientTimeout"));
+  client->setTimeout(0.5);
+  HttpClientResponse::Error error = HttpClientResponse::kNoError;
+  client->get(serverAddr, "/", [&](const HttpClientResponse& response) {
+    error = response.error();
+    loop.quit();
+  });
+  loop.runAfter(5.0, [&loop] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK_EQUAL(error, HttpClientResponse::kTimeout);
+
+  loop.runAfter(0.0, [&client] { client.reset(); });
+  loop.runAfter(0.1, [&loop] { loop.quit(); });
+  loop.loop();
+}
+
+BOOST_AUTO_TEST_CASE(testConnectFailed)
+{
+  EventLoop loop;
+  // nobody listens, requests fail long before the timeout
+  InetAddress serverAddr("127.0.0.1", 18030);
+  std::unique_ptr<HttpClient> client(new HttpClient(&loop, "HttpClientConnectFailed"));
+  client->setTimeout(5.0);
+  std::vector<HttpClientResponse::Error> errors;
+  Timestamp start = Timestamp::now();
+  for (int i = 0; i < 3; ++i)
+  {
+    client->get(serverAddr, "/", [&](const HttpClientResponse& response) {
+      errors.push_back(response.error());
+      if (errors.size() == 3)
+      {
+        loop.quit();
+      }
+    });
+  }
+  loop.runAfter(10.0, [&loop] { loop.quit(); });
+  loop.loop();
+  BOOST_CHECK_EQUAL(errors.size(), 3u);
+  for (HttpClientResponse::Error error : errors)
+  {
+    BOOST_CHECK_EQUAL(error, HttpClientResponse::kConnectFailed);
+  }
+  BOOST_CHECK_LT(timeDifference(Timestamp::now(), start), 1.0);
+  BOOST_CHECK_EQUAL(client->numConnections(serverAddr), 0u);
+
+  loop.runAfter(0.0, [&client] { client.reset(); });
+  loop.runAfter(0.1, [&loop] { loop.quit(); });
+  loop.loop();
+}
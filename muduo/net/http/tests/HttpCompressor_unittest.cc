@@ -0,0 +1,260 @@
+#include "muduo/net/http/HttpCompressor.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+
+//#define BOOST_TEST_MODULE HttpCompressorTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::net::Buffer;
+using muduo::net::HttpCompressionFilter;
+using muduo::net::HttpCompressor;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+
+namespace
+{
+
+// gzip or zlib, detected by header
+string inflateAll(const string& compressed)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof zs);
+  inflateInit2(&zs, MAX_WBITS + 32);
+  string result;
+  char buf[4096];
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  zs.avail_in = static_cast<uInt>(compressed.size());
+  int err = Z_OK;
+  while (err == Z_OK)
+  {
+    zs.next_out = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = sizeof buf;
+    err = inflate(&zs, Z_NO_FLUSH);
+    result.append(buf, sizeof buf - zs.avail_out);
+    if (err == Z_BUF_ERROR && zs.avail_in == 0)
+      break;
+  }
+  inflateEnd(&zs);
+  return result;
+}
+
+string dechunk(const string& chunked)
+{
+  string result;
+  size_t pos = 0;
+  while (pos < chunked.size())
+  {
+    size_t crlf = chunked.find("\r\n", pos);
+    size_t len = strtoul(chunked.c_str() + pos, NULL, 16);
+    result.append(chunked, crlf + 2, len);
+    pos = crlf + 2 + len + 2;
+  }
+  return result;
+}
+
+string makeBody()
+{
+  string body;
+  for (int i = 0; i < 1000; ++i)
+  {
+    body += "{\"id\": 12345, \"name\": \"muduo\"},";
+  }
+  return body;
+}
+
+HttpRequest makeRequest(const string& acceptEncoding)
+{
+  HttpRequest req;
+  const char kGet[] = "GET";
+  req.setMethod(kGet, kGet + 3);
+  const char kPath[] = "/api";
+  req.setPath(kPath, kPath + 4);
+  string line = "Accept-Encoding: " + acceptEncoding;
+  const char* begin = line.data();
+  req.addHeader(begin, begin + line.find(':'), begin + line.size());
+  return req;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testNegotiate)
+{
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate(""), HttpCompressor::kIdentity);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip, deflate, br"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("deflate"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip;q=0, deflate"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("gzip;q=0.5, deflate;q=0.8"), HttpCompressor::kDeflate);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("*"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("GZIP"), HttpCompressor::kGzip);
+  BOOST_CHECK_EQUAL(HttpCompressor::negotiate("br"), HttpCompressor::kIdentity);
+}
+
+BOOST_AUTO_TEST_CASE(testCompressor)
+{
+  string body = makeBody();
+  for (int encoding = HttpCompressor::kGzip; encoding <= HttpCompressor::kDeflate; ++encoding)
+  {
+    Buffer output;
+    HttpCompressor compressor(&output, static_cast<HttpCompressor::Encoding>(encoding), false);
+    BOOST_CHECK(compressor.write(body));
+    BOOST_CHECK(compressor.finish());
+    string compressed = output.retrieveAllAsString();
+    BOOST_CHECK_LT(compressed.size(), body.size());
+    BOOST_CHECK(inflateAll(compressed) == body);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testChunkedStreaming)
+{
+  string body = makeBody();
+  Buffer output;
+  HttpCompressor compressor(&output, HttpCompressor::kGzip, true);
+  BOOST_CHECK(compressor.write(StringPiece(body.data(), 100)));
+  BOOST_CHECK(compressor.flush());
+  // first chunk is decodable before the stream ends
+  string first = dechunk(output.toStringPiece().as_string());
+  BOOST_CHECK(inflateAll(first) == body.substr(0, 100));
+
+  BOOST_CHECK(compressor.write(StringPiece(body.data() + 100, static_cast<int>(body.size() - 100))));
+  BOOST_CHECK(compressor.finish());
+  string all = output.retrieveAllAsString();
+  BOOST_CHECK(all.size() >= 5 && all.substr(all.size() - 5) == "0\r\n\r\n");
+  BOOST_CHECK(inflateAll(dechunk(all)) == body);
+}
+
+BOOST_AUTO_TEST_CASE(testFilter)
+{
+  HttpCompressionFilter filter;
+  string body = makeBody();
+
+  HttpResponse resp(false);
+  resp.setStatusCode(HttpResponse::k200Ok);
+  resp.setContentType("application/json");
+  resp.addHeader("ETag", "\"abc\"");
+  resp.setBody(body);
+  filter.filter(makeRequest("gzip"), &resp);
+  BOOST_CHECK_EQUAL(resp.getHeader("Content-Encoding"), string("gzip"));
+  BOOST_CHECK_EQUAL(resp.getHeader("Vary"), string("Accept-Encoding"));
+  BOOST_CHECK_EQUAL(resp.getHeader("ETag"), string("W/\"abc\""));
+  BOOST_CHECK(inflateAll(resp.body()) == body);
+  size_t cached = filter.cachedBytes();
+  BOOST_CHECK_EQUAL(cached, resp.body().size());
+
+  HttpResponse resp2(false);
+  resp2.setStatusCode(HttpResponse::k200Ok);
+  resp2.setContentType("application/json");
+  resp2.addHeader("ETag", "\"abc\"");
+  resp2.setBody(body);
+  filter.filter(makeRequest("gzip"), &resp2);
+  BOOST_CHECK(resp2.body() == resp.body());
+  // shared with the cache, not copied
+  BOOST_CHECK(&resp2.body() == &resp.body());
+  BOOST_CHECK_EQUAL(filter.cachedBytes(), cached);
+
+  HttpResponse identity(false);
+  identity.setStatusCode(HttpResponse::k200Ok);
+  identity.setContentType("application/json");
+  identity.setBody(body);
+  filter.filter(makeRequest("identity"), &identity);
+  BOOST_CHECK(identity.getHeader("Content-Encoding").empty());
+  BOOST_CHECK(identity.body() == body);
+
+  HttpResponse small(false);
+  small.setStatusCode(HttpResponse::k200Ok);
+  small.setContentType("text/plain");
+  small.setBody("hello");
+  filter.filter(makeRequest("gzip"), &small);
+  BOOST_CHECK(small.getHeader("Content-Encoding").empty());
+
+  HttpResponse image(false);
+  image.setStatusCode(HttpResponse::k200Ok);
+  image.setContentType("image/png");
+  image.setBody(body);
+  filter.filter(makeRequest("gzip"), &image);
+  BOOST_CHECK(image.getHeader("Content-Encoding").empty());
+}
+
+BOOST_AUTO_TEST_CASE(testFilterFile)
+{
+  HttpCompressionFilter filter;
+  string body = makeBody();
+  char path[] = "/tmp/httpcompressor_unittestXXXXXX";
+  int fd = ::mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  ::unlink(path);
+  BOOST_REQUIRE_EQUAL(::write(fd, body.data(), body.size()), static_cast<ssize_t>(body.size()));
+
+  HttpResponse resp(false);
+  resp.setStatusCode(HttpResponse::k200Ok);
+  resp.setContentType("text/plain");
+  resp.addHeader("ETag", "\"file\"");
+  resp.setBodyFile(fd, 0, body.size(), std::shared_ptr<void>());
+  filter.filter(makeRequest("gzip"), &resp);
+  BOOST_CHECK(!resp.hasBodyFile());
+  BOOST_CHECK_EQUAL(resp.getHeader("Content-Encoding"), string("gzip"));
+  BOOST_CHECK(inflateAll(resp.body()) == body);
+  BOOST_CHECK_EQUAL(filter.cachedBytes(), resp.body().size());
+
+  // the second request does not read the file
+  ::ftruncate(fd, 0);
+  HttpResponse resp2(false);
+  resp2.setStatusCode(HttpResponse::k200Ok);
+  resp2.setContentType("text/plain");
+  resp2.addHeader("ETag", "\"file\"");
+  resp2.setBodyFile(fd, 0, body.size(), std::shared_ptr<void>());
+  filter.filter(makeRequest("gzip"), &resp2);
+  BOOST_CHECK(!resp2.hasBodyFile());
+  BOOST_CHECK(resp2.body() == resp.body());
+
+  // without an ETag, nothing to cache by
+  HttpResponse noEtag(false);
+  noEtag.setStatusCode(HttpResponse::k200Ok);
+  noEtag.setContentType("text/plain");
+  noEtag.setBodyFile(fd, 0, body.size(), std::shared_ptr<void>());
+  filter.filter(makeRequest("gzip"), &noEtag);
+  BOOST_CHECK(noEtag.hasBodyFile());
+  BOOST_CHECK(noEtag.getHeader("Content-Encoding").empty());
+
+  // a file shorter than its response is sent as is
+  HttpResponse shrunk(false);
+  shrunk.setStatusCode(HttpResponse::k200Ok);
+  shrunk.setContentType("text/plain");
+  shrunk.addHeader("ETag", "\"shrunk\"");
+  shrunk.setBodyFile(fd, 0, body.size(), std::shared_ptr<void>());
+  filter.filter(makeRequest("gzip"), &shrunk);
+  BOOST_CHECK(shrunk.hasBodyFile());
+  BOOST_CHECK(shrunk.getHeader("Content-Encoding").empty());
+  ::close(fd);
+}
+
+BOOST_AUTO_TEST_CASE(testFilterFileOverCache)
+{
+  HttpCompressionFilter filter;
+  string body = makeBody();
+  // an entry is at most 1/8 of the cache, smaller than the file
+  filter.setCacheSize(body.size());
+  char path[] = "/tmp/httpcompressor_unittestXXXXXX";
+  int fd = ::mkstemp(path);
+  BOOST_REQUIRE(fd >= 0);
+  ::unlink(path);
+  BOOST_REQUIRE_EQUAL(::write(fd, body.data(), body.size()), static_cast<ssize_t>(body.size()));
+
+  HttpResponse resp(false);
+  resp.setStatusCode(HttpResponse::k200Ok);
+  resp.setContentType("text/plain");
+  resp.addHeader("ETag", "\"file\"");
+  resp.setBodyFile(fd, 0, body.size(), std::shared_ptr<void>());
+  filter.filter(makeRequest("gzip"), &resp);
+  BOOST_CHECK(resp.hasBodyFile());
+  BOOST_CHECK(resp.getHeader("Content-Encoding").empty());
+  BOOST_CHECK_EQUAL(filter.cachedBytes(), 0u);
+  ::close(fd);
+}
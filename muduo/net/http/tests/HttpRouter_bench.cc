@@ -0,0 +1,84 @@
+#include "muduo/net/http/HttpRouter.h"
+#include "muduo/base/Timestamp.h"
+
+#include <vector>
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kRoutes = 1000;
+const int N = 1000000;
+
+int g_hits = 0;
+
+void onHit(const HttpRequest&, const HttpRouteParams& params, HttpResponse*)
+{
+  g_hits += params.size();
+}
+
+// what HttpServer_test.cc does, one comparison per route
+struct LinearRoute
+{
+  HttpRequest::Method method;
+  string path;
+};
+
+int linearMatch(const std::vector<LinearRoute>& routes,
+                HttpRequest::Method method, const string& path)
+{
+  for (size_t i = 0; i < routes.size(); ++i)
+  {
+    if (routes[i].method == method && routes[i].path == path)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+int main()
+{
+  const char* resources[] = { "users", "orders", "products", "accounts", "invoices" };
+  HttpRouter router;
+  std::vector<LinearRoute> linear;
+  std::vector<string> paths;
+  for (int i = 0; i < kRoutes; ++i)
+  {
+    char pattern[128];
+    char path[128];
+    const char* res = resources[i % 5];
+    snprintf(pattern, sizeof pattern, "/api/v%d/%s%d/:id", i % 4, res, i);
+    snprintf(path, sizeof path, "/api/v%d/%s%d/12345", i % 4, res, i);
+    router.add(HttpRequest::kGet, pattern, onHit);
+    LinearRoute r = { HttpRequest::kGet, path };
+    linear.push_back(r);
+    paths.push_back(path);
+  }
+
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < N; ++i)
+  {
+    const string& path = paths[(static_cast<size_t>(i) * 7919) % kRoutes];
+    HttpRouteParams params;
+    bool allowed;
+    const HttpRouter::Handler* handler =
+      router.match(HttpRequest::kGet, path, &params, &allowed);
+    if (handler)
+      (*handler)(HttpRequest(), params, NULL);
+  }
+  double routerSeconds = timeDifference(Timestamp::now(), start);
+
+  int found = 0;
+  start = Timestamp::now();
+  for (int i = 0; i < N; ++i)
+  {
+    const string& path = paths[(static_cast<size_t>(i) * 7919) % kRoutes];
+    if (linearMatch(linear, HttpRequest::kGet, path) >= 0)
+      ++found;
+  }
+  double linearSeconds = timeDifference(Timestamp::now(), start);
+
+  printf("%d routes, %d lookups, hits %d %d\n", kRoutes, N, g_hits, found);
+  printf("HttpRouter %8.1f ns/op\n", routerSeconds * 1e9 / N);
+  printf("linear     %8.1f ns/op\n", linearSeconds * 1e9 / N);
+}
@@ -0,0 +1,174 @@
+#include "muduo/net/http/HttpRouter.h"
+#include "muduo/net/http/HttpResponse.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::HttpRouteParams;
+using muduo::net::HttpRouter;
+
+namespace
+{
+
+HttpRouter::Handler tag(int* hit, int id)
+{
+  return [hit, id](const HttpRequest&, const HttpRouteParams&, HttpResponse*)
+  {
+    *hit = id;
+  };
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testStaticRoutes)
+{
+  int hit = 0;
+  HttpRouter router;
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/", tag(&hit, 1)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/users", tag(&hit, 2)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/user", tag(&hit, 3)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/usage", tag(&hit, 4)));
+  BOOST_CHECK_EQUAL(router.numRoutes(), 4u);
+
+  const char* paths[] = { "/", "/users", "/user", "/usage" };
+  for (int i = 0; i < 4; ++i)
+  {
+    HttpRouteParams params;
+    bool allowed = false;
+    hit = 0;
+    const HttpRouter::Handler* handler = router.match(HttpRequest::kGet, paths[i], &params, &allowed);
+    BOOST_REQUIRE(handler != NULL);
+    (*handler)(HttpRequest(), params, NULL);
+    BOOST_CHECK_EQUAL(hit, i + 1);
+    BOOST_CHECK(allowed);
+  }
+
+  HttpRouteParams params;
+  bool allowed = false;
+  BOOST_CHECK(router.match(HttpRequest::kGet, "/us", &params, &allowed) == NULL);
+  BOOST_CHECK(allowed);
+  BOOST_CHECK(router.match(HttpRequest::kGet, "/users/", &params, &allowed) == NULL);
+  BOOST_CHECK(router.match(HttpRequest::kGet, "", &params, &allowed) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(testParameters)
+{
+  int hit = 0;
+  HttpRouter router;
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/users/:id", tag(&hit, 1)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/users/:id/posts/:post", tag(&hit, 2)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/users/me", tag(&hit, 3)));
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/files/*path", tag(&hit, 4)));
+
+  HttpRouteParams params;
+  bool allowed;
+  const HttpRouter::Handler* handler = router.match(HttpRequest::kGet, "/users/42", &params, &allowed);
+  BOOST_REQUIRE(handler != NULL);
+  BOOST_CHECK_EQUAL(params.size(), 1);
+  BOOST_CHECK_EQUAL(params.get("id").as_string(), string("42"));
+
+  HttpRouteParams params2;
+  handler = router.match(HttpRequest::kGet, "/users/42/posts/7", &params2, &allowed);
+  BOOST_REQUIRE(handler != NULL);
+  BOOST_CHECK_EQUAL(params2.size(), 2);
+  BOOST_CHECK_EQUAL(params2.get("id").as_string(), string("42"));
+  BOOST_CHECK_EQUAL(params2.get("post").as_string(), string("7"));
+  BOOST_CHECK(params2.get("nonexist").empty());
+
+  // static wins over parameter
+  HttpRouteParams params3;
+  hit = 0;
+  handler = router.match(HttpRequest::kGet, "/users/me", &params3, &allowed);
+  BOOST_REQUIRE(handler != NULL);
+  (*handler)(HttpRequest(), params3, NULL);
+  BOOST_CHECK_EQUAL(hit, 3);
+  BOOST_CHECK_EQUAL(params3.size(), 0);
+
+  // backtracking from static to parameter
+  HttpRouteParams params4;
+  handler = router.match(HttpRequest::kGet, "/users/me/posts/1", &params4, &allowed);
+  BOOST_REQUIRE(handler != NULL);
+  BOOST_CHECK_EQUAL(params4.get("id").as_string(), string("me"));
+
+  HttpRouteParams params5;
+  handler = router.match(HttpRequest::kGet, "/files/a/b/c.txt", &params5, &allowed);
+  BOOST_REQUIRE(handler != NULL);
+  BOOST_CHECK_EQUAL(params5.get("path").as_string(), string("a/b/c.txt"));
+
+  HttpRouteParams params6;
+  BOOST_CHECK(router.match(HttpRequest::kGet, "/users/", &params6, &allowed) == NULL);
+  BOOST_CHECK_EQUAL(params6.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testMethodNotAllowed)
+{
+  int hit = 0;
+  HttpRouter router;
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/items/:id", tag(&hit, 1)));
+  BOOST_CHECK(router.add(HttpRequest::kPut, "/items/:id", tag(&hit, 2)));
+
+  HttpRouteParams params;
+  bool allowed = true;
+  BOOST_CHECK(router.match(HttpRequest::kPost, "/items/1", &params, &allowed) == NULL);
+  BOOST_CHECK(!allowed);
+
+  HttpRequest req;
+  req.setMethod(HttpRequest::kDelete);
+  req.setPath("/items/1", "/items/1" + 8);
+  HttpResponse resp(false);
+  router.onRequest(req, &resp);
+  BOOST_CHECK_EQUAL(resp.statusCode(), HttpResponse::k405MethodNotAllowed);
+  BOOST_CHECK_EQUAL(resp.getHeader("Allow"), string("GET, PUT"));
+
+  req.setPath("/nothing", "/nothing" + 8);
+  HttpResponse resp2(false);
+  router.onRequest(req, &resp2);
+  BOOST_CHECK_EQUAL(resp2.statusCode(), HttpResponse::k404NotFound);
+
+  req.setMethod(HttpRequest::kPut);
+  req.setPath("/items/1", "/items/1" + 8);
+  HttpResponse resp3(false);
+  router.onRequest(req, &resp3);
+  BOOST_CHECK_EQUAL(hit, 2);
+}
+
+BOOST_AUTO_TEST_CASE(testConflicts)
+{
+  int hit = 0;
+  HttpRouter router;
+  BOOST_CHECK(router.add(HttpRequest::kGet, "/a/:id", tag(&hit, 1)));
+  BOOST_CHECK(!router.add(HttpRequest::kGet, "/a/:id", tag(&hit, 2)));
+  BOOST_CHECK(!router.add(HttpRequest::kGet, "/a/:name/x", tag(&hit, 3)));
+  BOOST_CHECK(!router.add(HttpRequest::kGet, "/b/*rest/x", tag(&hit, 4)));
+  BOOST_CHECK(!router.add(HttpRequest::kGet, "/c/:", tag(&hit, 5)));
+  BOOST_CHECK(!router.add(HttpRequest::kGet, "noslash", tag(&hit, 6)));
+  BOOST_CHECK(router.add(HttpRequest::kPost, "/a/:id", tag(&hit, 7)));
+  BOOST_CHECK_EQUAL(router.numRoutes(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(testManyRoutes)
+{
+  int hit = 0;
+  HttpRouter router;
+  for (int i = 0; i < 1000; ++i)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "/api/v%d/resource%d/:id", i % 3, i);
+    BOOST_CHECK(router.add(HttpRequest::kGet, buf, tag(&hit, i + 1)));
+  }
+  for (int i = 0; i < 1000; ++i)
+  {
+    char buf[64];
+    snprintf(buf, sizeof buf, "/api/v%d/resource%d/abc", i % 3, i);
+    HttpRouteParams params;
+    bool allowed;
+    const HttpRouter::Handler* handler = router.match(HttpRequest::kGet, buf, &params, &allowed);
+    BOOST_REQUIRE(handler != NULL);
+    (*handler)(HttpRequest(), params, NULL);
+    BOOST_CHECK_EQUAL(hit, i + 1);
+  }
+}
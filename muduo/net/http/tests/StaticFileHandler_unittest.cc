@@ -0,0 +1,173 @@
+#include "muduo/net/http/StaticFileHandler.h"
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/Buffer.h"
+
+//#define BOOST_TEST_MODULE StaticFileHandlerTest
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using muduo::string;
+using muduo::net::Buffer;
+using muduo::net::HttpRequest;
+using muduo::net::HttpResponse;
+using muduo::net::StaticFileHandler;
+
+namespace
+{
+
+struct DocumentRoot
+{
+  DocumentRoot()
+  {
+    char tmpl[] = "/tmp/muduo_static_XXXXXX";
+    root = ::mkdtemp(tmpl);
+    content = "0123456789abcdefghijklmnopqrstuvwxyz";
+    FILE* fp = ::fopen((root + "/hello.txt").c_str(), "w");
+    ::fwrite(content.data(), 1, content.size(), fp);
+    ::fclose(fp);
+  }
+
+  ~DocumentRoot()
+  {
+    ::unlink((root + "/hello.txt").c_str());
+    ::rmdir(root.c_str());
+  }
+
+  string root;
+  string content;
+};
+
+HttpRequest makeRequest(const char* method, const string& path)
+{
+  HttpRequest req;
+  req.setMethod(method, method + strlen(method));
+  req.setPath(path.data(), path.data() + path.size());
+  return req;
+}
+
+void addHeader(HttpRequest* req, const string& line)
+{
+  const char* begin = line.data();
+  req->addHeader(begin, begin + line.find(':'), begin + line.size());
+}
+
+string headersOf(const HttpResponse& resp)
+{
+  Buffer buf;
+  resp.appendHeadersToBuffer(&buf);
+  return buf.retrieveAllAsString();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testGetInMemory)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  HttpRequest req = makeRequest("GET", "/hello.txt");
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.handle(req, &resp));
+  BOOST_CHECK_EQUAL(resp.statusCode(), HttpResponse::k200Ok);
+  BOOST_CHECK(!resp.hasBodyFile());
+  BOOST_CHECK_EQUAL(resp.body(), doc.content);
+  BOOST_CHECK(headersOf(resp).find("Content-Type: text/plain\r\n") != string::npos);
+  BOOST_CHECK_EQUAL(handler.cachedFiles(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(testGetSendfile)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  handler.setMaxInMemoryFileSize(0);
+  HttpRequest req = makeRequest("GET", "/hello.txt");
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.handle(req, &resp));
+  BOOST_CHECK(resp.hasBodyFile());
+  BOOST_CHECK_EQUAL(resp.bodyFileOffset(), 0);
+  BOOST_CHECK_EQUAL(resp.bodyFileLength(), doc.content.size());
+  BOOST_CHECK(headersOf(resp).find("Content-Length: 36\r\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testRange)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  handler.setMaxInMemoryFileSize(0);
+
+  HttpRequest req = makeRequest("GET", "/hello.txt");
+  addHeader(&req, "Range: bytes=10-19");
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.handle(req, &resp));
+  BOOST_CHECK_EQUAL(resp.statusCode(), HttpResponse::k206PartialContent);
+  BOOST_CHECK_EQUAL(resp.bodyFileOffset(), 10);
+  BOOST_CHECK_EQUAL(resp.bodyFileLength(), 10u);
+  BOOST_CHECK(headersOf(resp).find("Content-Range: bytes 10-19/36\r\n") != string::npos);
+
+  HttpRequest suffix = makeRequest("GET", "/hello.txt");
+  addHeader(&suffix, "Range: bytes=-6");
+  HttpResponse resp2(false);
+  BOOST_CHECK(handler.handle(suffix, &resp2));
+  BOOST_CHECK_EQUAL(resp2.bodyFileOffset(), 30);
+  BOOST_CHECK_EQUAL(resp2.bodyFileLength(), 6u);
+
+  HttpRequest bad = makeRequest("GET", "/hello.txt");
+  addHeader(&bad, "Range: bytes=100-");
+  HttpResponse resp3(false);
+  BOOST_CHECK(handler.handle(bad, &resp3));
+  BOOST_CHECK_EQUAL(resp3.statusCode(), HttpResponse::k416RangeNotSatisfiable);
+}
+
+BOOST_AUTO_TEST_CASE(testConditionalGet)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  HttpRequest req = makeRequest("GET", "/hello.txt");
+  HttpResponse resp(false);
+  BOOST_CHECK(handler.handle(req, &resp));
+  string headers = headersOf(resp);
+  size_t etag = headers.find("ETag: ");
+  BOOST_REQUIRE(etag != string::npos);
+  string etagLine = headers.substr(etag, headers.find("\r\n", etag) - etag);
+
+  HttpRequest cond = makeRequest("GET", "/hello.txt");
+  addHeader(&cond, "If-None-Match: " + etagLine.substr(6));
+  HttpResponse resp2(false);
+  BOOST_CHECK(handler.handle(cond, &resp2));
+  BOOST_CHECK_EQUAL(resp2.statusCode(), HttpResponse::k304NotModified);
+  BOOST_CHECK(resp2.body().empty());
+
+  HttpRequest since = makeRequest("GET", "/hello.txt");
+  addHeader(&since, "If-Modified-Since: " + StaticFileHandler::formatHttpDate(::time(NULL) + 60));
+  HttpResponse resp3(false);
+  BOOST_CHECK(handler.handle(since, &resp3));
+  BOOST_CHECK_EQUAL(resp3.statusCode(), HttpResponse::k304NotModified);
+}
+
+BOOST_AUTO_TEST_CASE(testNotFound)
+{
+  DocumentRoot doc;
+  StaticFileHandler handler(doc.root);
+  HttpResponse resp(false);
+  BOOST_CHECK(!handler.handle(makeRequest("GET", "/missing.txt"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("GET", "/../hello.txt"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("GET", "/%2e%2e/etc/passwd"), &resp));
+  BOOST_CHECK(!handler.handle(makeRequest("GET", "/"), &resp));
+}
+
+BOOST_AUTO_TEST_CASE(testHttpDate)
+{
+  time_t t = 784111777;
+  string date = StaticFileHandler::formatHttpDate(t);
+  BOOST_CHECK_EQUAL(date, string("Sun, 06 Nov 1994 08:49:37 GMT"));
+  time_t parsed = 0;
+  BOOST_CHECK(StaticFileHandler::parseHttpDate(date, &parsed));
+  BOOST_CHECK_EQUAL(parsed, t);
+  BOOST_CHECK(!StaticFileHandler::parseHttpDate("yesterday", &parsed));
+}
@@ -0,0 +1,29 @@
+#include "muduo/net/http/HttpServer.h"
+#include "muduo/net/http/StaticFileHandler.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/base/Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printf("Usage: %s document_root [num_threads]\n", argv[0]);
+    return 0;
+  }
+  int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+  Logger::setLogLevel(Logger::WARN);
+  StaticFileHandler handler(argv[1]);
+  EventLoop loop;
+  HttpServer server(&loop, InetAddress(8000), "static");
+  server.setHttpCallback(
+      std::bind(&StaticFileHandler::onRequest, &handler, _1, _2));
+  server.setThreadNum(numThreads);
+  server.start();
+  loop.loop();
+}
@@ -0,0 +1,183 @@
+#include "muduo/net/http/WebSocketCodec.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/ZlibStream.h"
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::string;
+using muduo::StringPiece;
+using muduo::net::Buffer;
+using muduo::net::WebSocketCodec;
+using muduo::net::ZlibInputStream;
+
+BOOST_AUTO_TEST_CASE(testAcceptKey)
+{
+  // RFC 6455 section 1.3
+  BOOST_CHECK_EQUAL(WebSocketCodec::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="),
+                    string("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+}
+
+BOOST_AUTO_TEST_CASE(testUnmask)
+{
+  const char key[4] = { '\x37', '\xfa', '\x21', '\x3d' };
+  for (size_t len = 0; len < 100; ++len)
+  {
+    string data;
+    for (size_t i = 0; i < len; ++i)
+    {
+      data += static_cast<char>(i * 7);
+    }
+    string masked(data);
+    WebSocketCodec::unmask(&*masked.begin(), len, key);
+    for (size_t i = 0; i < len; ++i)
+    {
+      BOOST_CHECK_EQUAL(masked[i], static_cast<char>(data[i] ^ key[i % 4]));
+    }
+    WebSocketCodec::unmask(&*masked.begin(), len, key);
+    BOOST_CHECK(masked == data);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseMaskedFrame)
+{
+  // RFC 6455 section 5.7, a single-frame masked text message "Hello"
+  const char frame[] = "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58";
+  WebSocketCodec::FrameHeader header;
+  for (size_t len = 0; len < 6; ++len)
+  {
+    BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader(frame, len, &header), 0);
+  }
+  BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader(frame, sizeof frame - 1, &header), 1);
+  BOOST_CHECK(header.fin);
+  BOOST_CHECK(header.masked);
+  BOOST_CHECK(!header.rsv1);
+  BOOST_CHECK_EQUAL(header.opcode, WebSocketCodec::kText);
+  BOOST_CHECK_EQUAL(header.headerLength, 6u);
+  BOOST_CHECK_EQUAL(header.payloadLength, 5u);
+
+  string payload(frame + header.headerLength, 5);
+  WebSocketCodec::unmask(&*payload.begin(), payload.size(), header.maskingKey);
+  BOOST_CHECK_EQUAL(payload, string("Hello"));
+}
+
+BOOST_AUTO_TEST_CASE(testAppendFrame)
+{
+  const size_t sizes[] = { 0, 125, 126, 65535, 65536, 100000 };
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i)
+  {
+    string payload(sizes[i], 'x');
+    Buffer buf;
+    WebSocketCodec::appendFrame(&buf, WebSocketCodec::kBinary, payload);
+    WebSocketCodec::FrameHeader header;
+    BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader(buf.peek(), buf.readableBytes(), &header), 1);
+    BOOST_CHECK(header.fin);
+    BOOST_CHECK(!header.masked);
+    BOOST_CHECK_EQUAL(header.opcode, WebSocketCodec::kBinary);
+    BOOST_CHECK_EQUAL(header.payloadLength, sizes[i]);
+    BOOST_CHECK_EQUAL(header.headerLength + sizes[i], buf.readableBytes());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testFragmentation)
+{
+  string payload(1000, 'y');
+  Buffer buf;
+  WebSocketCodec::appendMessage(&buf, WebSocketCodec::kText, payload, false, 300);
+  string received;
+  int frames = 0;
+  while (buf.readableBytes() > 0)
+  {
+    WebSocketCodec::FrameHeader header;
+    BOOST_REQUIRE_EQUAL(WebSocketCodec::parseFrameHeader(buf.peek(), buf.readableBytes(), &header), 1);
+    BOOST_CHECK_EQUAL(header.opcode, frames == 0 ? WebSocketCodec::kText : WebSocketCodec::kContinuation);
+    BOOST_CHECK_EQUAL(header.fin, frames == 3);
+    received.append(buf.peek() + header.headerLength, static_cast<size_t>(header.payloadLength));
+    buf.retrieve(header.headerLength + static_cast<size_t>(header.payloadLength));
+    ++frames;
+  }
+  BOOST_CHECK_EQUAL(frames, 4);
+  BOOST_CHECK(received == payload);
+}
+
+BOOST_AUTO_TEST_CASE(testBadFrames)
+{
+  WebSocketCodec::FrameHeader header;
+  // reserved opcode
+  BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader("\x83\x00", 2, &header), -1);
+  // RSV2
+  BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader("\xa1\x00", 2, &header), -1);
+  // fragmented ping
+  BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader("\x09\x00", 2, &header), -1);
+  // ping too long
+  BOOST_CHECK_EQUAL(WebSocketCodec::parseFrameHeader("\x89\x7e\x00\x80", 4, &header), -1);
+}
+
+BOOST_AUTO_TEST_CASE(testDeflate)
+{
+  string payload;
+  for (int i = 0; i < 100; ++i)
+  {
+    payload += "{\"price\": 100.25, \"symbol\": \"MUDUO\"}";
+  }
+  Buffer deflated;
+  BOOST_CHECK(WebSocketCodec::deflate(payload, &deflated));
+  BOOST_CHECK_LT(deflated.readableBytes(), payload.size());
+
+  // as done by the receiver, RFC 7692 section 7.2.2
+  Buffer inflated;
+  ZlibInputStream stream(&inflated, -MAX_WBITS);
+  BOOST_CHECK(stream.write(deflated.toStringPiece()));
+  BOOST_CHECK(stream.write(StringPiece("\x00\x00\xff\xff", 4)));
+  BOOST_CHECK(inflated.retrieveAllAsString() == payload);
+
+  // messages are independent, no context takeover
+  Buffer second;
+  BOOST_CHECK(WebSocketCodec::deflate(payload, &second));
+  BOOST_CHECK(second.toStringPiece() == deflated.toStringPiece());
+}
+
+BOOST_AUTO_TEST_CASE(testInflateLimit)
+{
+  // 32MiB of zeros deflates to about 32KiB
+  string payload(32 * 1024 * 1024, '\0');
+  Buffer deflated;
+  BOOST_REQUIRE(WebSocketCodec::deflate(payload, &deflated));
+  BOOST_CHECK_LT(deflated.readableBytes(), 64 * 1024);
+
+  const size_t maxSize = 1024 * 1024;
+  Buffer inflated;
+  ZlibInputStream stream(&inflated, -MAX_WBITS);
+  BOOST_CHECK_EQUAL(WebSocketCodec::inflate(&stream, &inflated, deflated.toStringPiece(), maxSize), 0);
+  // stopped right after the limit, not at 32MiB
+  BOOST_CHECK_GT(inflated.readableBytes(), maxSize);
+  BOOST_CHECK_LE(inflated.readableBytes(), maxSize + 128 * 1024);
+
+  Buffer all;
+  ZlibInputStream stream2(&all, -MAX_WBITS);
+  BOOST_CHECK_EQUAL(WebSocketCodec::inflate(&stream2, &all, deflated.toStringPiece(), payload.size()), 1);
+  BOOST_CHECK(all.toStringPiece() == payload);
+
+  Buffer corrupted;
+  ZlibInputStream stream3(&corrupted, -MAX_WBITS);
+  BOOST_CHECK_EQUAL(WebSocketCodec::inflate(&stream3, &corrupted, StringPiece("\xff\xff\xff\xff", 4), maxSize), -1);
+}
+
+BOOST_AUTO_TEST_CASE(testUtf8)
+{
+  BOOST_CHECK(WebSocketCodec::isValidUtf8(""));
+  BOOST_CHECK(WebSocketCodec::isValidUtf8("hello, websocket"));
+  BOOST_CHECK(WebSocketCodec::isValidUtf8("\xce\xba\xe1\xbd\xb9\xcf\x83\xce\xbc\xce\xb5"));
+  BOOST_CHECK(WebSocketCodec::isValidUtf8("\xf0\x9f\x98\x80 and more ascii after it"));
+  BOOST_CHECK(WebSocketCodec::isValidUtf8("\xf4\x8f\xbf\xbf"));  // U+10FFFF
+
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\x80"));
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xc0\xaf"));  // overlong '/'
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xe0\x80\xaf"));  // overlong
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xed\xa0\x80"));  // surrogate
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xf4\x90\x80\x80"));  // above U+10FFFF
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xf5\x80\x80\x80"));
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("twelve bytes\xce"));  // truncated
+  BOOST_CHECK(!WebSocketCodec::isValidUtf8("\xe1\xbd"));
+}
@@ -0,0 +1,71 @@
+#include "muduo/net/http/HttpRequest.h"
+#include "muduo/net/http/HttpResponse.h"
+#include "muduo/net/http/HttpServer.h"
+#include "muduo/net/http/WebSocketServer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/base/Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// A chat room, every message is broadcast to all browsers.
+
+const char* kPage =
+  "<html><body><pre id=log></pre><input id=msg autofocus>"
+  "<script>"
+  "var ws = new WebSocket('ws://' + location.host + '/chat');"
+  "ws.onmessage = function(e) { log.textContent += e.data + '\\n'; };"
+  "msg.onkeydown = function(e) { if (e.keyCode == 13) { ws.send(msg.value); msg.value = ''; } };"
+  "</script></body></html>";
+
+void onRequest(const HttpRequest& req, HttpResponse* resp)
+{
+  if (req.path() == "/")
+  {
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/html");
+    resp->setBody(kPage);
+  }
+  else
+  {
+    resp->setStatusCode(HttpResponse::k404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+  }
+}
+
+void onConnection(WebSocketServer* ws, const WebSocketConnectionPtr& conn)
+{
+  LOG_INFO << conn->connection()->peerAddress().toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN")
+           << ", " << ws->numConnections() << " online";
+}
+
+void onMessage(WebSocketServer* ws, const WebSocketConnectionPtr& conn,
+               StringPiece message, bool binary, Timestamp)
+{
+  if (binary)
+  {
+    conn->close(WebSocketCodec::kInvalidPayload, "text only");
+    return;
+  }
+  ws->broadcast(message);
+}
+
+int main(int argc, char* argv[])
+{
+  int numThreads = argc > 1 ? atoi(argv[1]) : 0;
+  EventLoop loop;
+  HttpServer server(&loop, InetAddress(8000), "websocket");
+  server.setHttpCallback(onRequest);
+  WebSocketServer ws(&server);
+  ws.setConnectionCallback(std::bind(onConnection, &ws, _1));
+  ws.setMessageCallback(std::bind(onMessage, &ws, _1, _2, _3, std::placeholders::_4));
+  server.setThreadNum(numThreads);
+  server.start();
+  loop.loop();
+}
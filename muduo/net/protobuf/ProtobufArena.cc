@@ -0,0 +1,47 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protobuf/ProtobufArena.h"
+
+#include "muduo/base/ThreadLocalSingleton.h"
+
+#include <google/protobuf/arena.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+ProtobufArena::ProtobufArena()
+  : initialBlock_(new char[kInitialBlockSize]),
+    depth_(0)
+{
+  google::protobuf::ArenaOptions options;
+  options.initial_block = initialBlock_.get();
+  options.initial_block_size = kInitialBlockSize;
+  arena_.reset(new google::protobuf::Arena(options));
+}
+
+ProtobufArena::~ProtobufArena()
+{
+  // arena_ must go before initialBlock_
+  arena_.reset();
+}
+
+size_t ProtobufArena::spaceUsed() const
+{
+  return static_cast<size_t>(arena_->SpaceUsed());
+}
+
+ProtobufArena& ProtobufArena::threadInstance()
+{
+  return ThreadLocalSingleton<ProtobufArena>::instance();
+}
+
+void ProtobufArena::reset()
+{
+  arena_->Reset();
+}
@@ -0,0 +1,86 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTOBUF_PROTOBUFARENA_H
+#define MUDUO_NET_PROTOBUF_PROTOBUFARENA_H
+
+#include "muduo/base/noncopyable.h"
+
+#include <memory>
+
+namespace google
+{
+namespace protobuf
+{
+class Arena;
+}
+}
+
+namespace muduo
+{
+namespace net
+{
+
+/// A google::protobuf::Arena per thread, so one per EventLoop,
+/// for parsing incoming messages without malloc() and free().
+///
+/// Messages live until the outermost Scope ends, then the arena is reset,
+/// the initial block is kept and reused by the next message.
+class ProtobufArena : noncopyable
+{
+ public:
+  static const size_t kInitialBlockSize = 64 * 1024;
+
+  ProtobufArena();
+  ~ProtobufArena();
+
+  google::protobuf::Arena* arena()
+  { return arena_.get(); }
+
+  /// Bytes allocated since last reset, for testing.
+  size_t spaceUsed() const;
+
+  /// Arena of calling thread.
+  static ProtobufArena& threadInstance();
+
+  /// Resets the arena on leaving, unless nested in another Scope.
+  class Scope : noncopyable
+  {
+   public:
+    explicit Scope(ProtobufArena& arena)
+      : arena_(arena)
+    {
+      ++arena_.depth_;
+    }
+
+    ~Scope()
+    {
+      if (--arena_.depth_ == 0)
+      {
+        arena_.reset();
+      }
+    }
+
+   private:
+    ProtobufArena& arena_;
+  };
+
+ private:
+  void reset();
+
+  std::unique_ptr<char[]> initialBlock_;
+  std::unique_ptr<google::protobuf::Arena> arena_;
+  int depth_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTOBUF_PROTOBUFARENA_H
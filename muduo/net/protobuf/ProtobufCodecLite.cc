@@ -9,9 +9,11 @@
 #include "muduo/net/protobuf/ProtobufCodecLite.h"
 // #include <muduo/net/protobuf/BufferStream.h>
 
+#include "muduo/base/Crc32c.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/Endian.h"
 #include "muduo/net/TcpConnection.h"
+#include "muduo/net/protobuf/ProtobufArena.h"
 #include "muduo/net/protorpc/google-inl.h"
 
 #include <google/protobuf/message.h>
@@ -33,7 +35,6 @@ namespace
 void ProtobufCodecLite::send(const TcpConnectionPtr& conn,
                              const ::google::protobuf::Message& message)
 {
-  // FIXME: serialize to TcpConnection::outputBuffer()
   muduo::net::Buffer buf;
   fillEmptyBuffer(&buf, message);
   conn->send(&buf);
@@ -43,12 +44,11 @@ void ProtobufCodecLite::fillEmptyBuffer(muduo::net::Buffer* buf,
                                         const google::protobuf::Message& message)
 {
   assert(buf->readableBytes() == 0);
-  // FIXME: can we move serialization & checksum to other thread?
   buf->append(tag_);
 
   int byte_size = serializeToBuffer(message, buf);
 
-  int32_t checkSum = checksum(buf->peek(), static_cast<int>(buf->readableBytes()));
+  int32_t checkSum = checksum(checksumType(), buf->peek(), static_cast<int>(buf->readableBytes()));
   buf->appendInt32(checkSum);
   assert(buf->readableBytes() == tag_.size() + byte_size + kChecksumLen); (void) byte_size;
   int32_t len = sockets::hostToNetwork32(static_cast<int32_t>(buf->readableBytes()));
@@ -74,13 +74,33 @@ void ProtobufCodecLite::onMessage(const TcpConnectionPtr& conn,
         buf->retrieve(kHeaderLen+len);
         continue;
       }
-      MessagePtr message(prototype_->New());
-      // FIXME: can we move deserialization & callback to other thread?
-      ErrorCode errorCode = parse(buf->peek()+kHeaderLen, len, message.get());
+      ErrorCode errorCode = kNoError;
+      if (useArena_)
+      {
+        ProtobufArena& arena = ProtobufArena::threadInstance();
+        ProtobufArena::Scope scope(arena);
+        // does not own the message, no control block is allocated
+        MessagePtr message(MessagePtr(), prototype_->New(arena.arena()));
+        errorCode = parse(buf->peek()+kHeaderLen, len, message.get());
+        if (errorCode == kNoError)
+        {
+          messageCallback_(conn, message, receiveTime);
+        }
+      }
+      else
+      {
+        MessagePtr message(prototype_->New());
+        // FIXME: can we move deserialization & callback to other thread?
+        errorCode = parse(buf->peek()+kHeaderLen, len, message.get());
+        if (errorCode == kNoError)
+        {
+          // FIXME: try { } catch (...) { }
+          messageCallback_(conn, message, receiveTime);
+        }
+      }
+
       if (errorCode == kNoError)
       {
-        // FIXME: try { } catch (...) { }
-        messageCallback_(conn, message, receiveTime);
         buf->retrieve(kHeaderLen+len);
       }
       else
@@ -182,10 +202,24 @@ int32_t ProtobufCodecLite::checksum(const void* buf, int len)
 }
 
 bool ProtobufCodecLite::validateChecksum(const char* buf, int len)
+{
+  return validateChecksum(kAdler32, buf, len);
+}
+
+int32_t ProtobufCodecLite::checksum(ChecksumType type, const void* buf, int len)
+{
+  if (type == kCrc32c)
+  {
+    return static_cast<int32_t>(crc32c::value(buf, len));
+  }
+  return checksum(buf, len);
+}
+
+bool ProtobufCodecLite::validateChecksum(ChecksumType type, const char* buf, int len)
 {
   // check sum
   int32_t expectedCheckSum = asInt32(buf + len - kChecksumLen);
-  int32_t checkSum = checksum(buf, len - kChecksumLen);
+  int32_t checkSum = checksum(type, buf, len - kChecksumLen);
   return checkSum == expectedCheckSum;
 }
 
@@ -195,7 +229,10 @@ ProtobufCodecLite::ErrorCode ProtobufCodecLite::parse(const char* buf,
 {
   ErrorCode error = kNoError;
 
-  if (validateChecksum(buf, len))
+  const ChecksumType type = checksumType();
+  if (validateChecksum(type, buf, len)
+      || (acceptAnyChecksum_
+          && validateChecksum(type == kAdler32 ? kCrc32c : kAdler32, buf, len)))
   {
     if (memcmp(buf, tag_.data(), tag_.size()) == 0)
     {
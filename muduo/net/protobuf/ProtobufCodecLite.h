@@ -14,6 +14,7 @@
 #ifndef MUDUO_NET_PROTOBUF_PROTOBUFCODECLITE_H
 #define MUDUO_NET_PROTOBUF_PROTOBUFCODECLITE_H
 
+#include "muduo/base/Atomic.h"
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Timestamp.h"
@@ -44,7 +45,7 @@ typedef std::shared_ptr<google::protobuf::Message> MessagePtr;
 // size      4-byte  M+N+4
 // tag       M-byte  could be "RPC0", etc.
 // payload   N-byte
-// checksum  4-byte  adler32 of tag+payload
+// checksum  4-byte  adler32 or crc32c of tag+payload
 //
 // This is an internal class, you should use ProtobufCodecT instead.
 class ProtobufCodecLite : noncopyable
@@ -64,6 +65,14 @@ class ProtobufCodecLite : noncopyable
     kParseError,
   };
 
+  // both ends must use the same one, unless the receiver accepts any,
+  // see RpcChannel::setChecksumType()
+  enum ChecksumType
+  {
+    kAdler32,
+    kCrc32c,  // several times faster, with SSE4.2
+  };
+
   // return false to stop parsing protobuf message
   typedef std::function<bool (const TcpConnectionPtr&,
                               StringPiece,
@@ -88,14 +97,33 @@ class ProtobufCodecLite : noncopyable
       messageCallback_(messageCb),
       rawCb_(rawCb),
       errorCallback_(errorCb),
-      kMinMessageLen(tagArg.size() + kChecksumLen)
+      kMinMessageLen(tagArg.size() + kChecksumLen),
+      useArena_(false),
+      acceptAnyChecksum_(false)
   {
+    checksumType_.getAndSet(kAdler32);
   }
 
   virtual ~ProtobufCodecLite() = default;
 
   const string& tag() const { return tag_; }
 
+  /// Parses messages into the ProtobufArena of the calling thread,
+  /// which is reset when the callback returns, so the MessagePtr
+  /// must not be kept after that. Not thread safe, set before use.
+  void setUseArena(bool on) { useArena_ = on; }
+
+  /// Thread safe, for messages encoded and parsed after it.
+  void setChecksumType(ChecksumType type) { checksumType_.getAndSet(type); }
+  ChecksumType checksumType() const
+  { return static_cast<ChecksumType>(checksumType_.get()); }
+
+  /// Accepts messages with either checksum, not only checksumType(),
+  /// so that the peer can switch at any time.  Not thread safe, set before use.
+  void setAcceptAnyChecksum(bool on) { acceptAnyChecksum_ = on; }
+
+  /// Serializes and checksums message in the calling thread, eg. a worker,
+  /// the encoded Buffer is then handed to the IO thread without copying.
   void send(const TcpConnectionPtr& conn,
             const ::google::protobuf::Message& message);
 
@@ -112,8 +140,11 @@ class ProtobufCodecLite : noncopyable
   ErrorCode parse(const char* buf, int len, ::google::protobuf::Message* message);
   void fillEmptyBuffer(muduo::net::Buffer* buf, const google::protobuf::Message& message);
 
+  // adler32
   static int32_t checksum(const void* buf, int len);
   static bool validateChecksum(const char* buf, int len);
+  static int32_t checksum(ChecksumType type, const void* buf, int len);
+  static bool validateChecksum(ChecksumType type, const char* buf, int len);
   static int32_t asInt32(const char* buf);
   static void defaultErrorCallback(const TcpConnectionPtr&,
                                    Buffer*,
@@ -127,6 +158,9 @@ class ProtobufCodecLite : noncopyable
   RawMessageCallback rawCb_;
   ErrorCallback errorCallback_;
   const int kMinMessageLen;
+  bool useArena_;
+  bool acceptAnyChecksum_;
+  mutable AtomicInt32 checksumType_;
 };
 
 template<typename MSG, const char* TAG, typename CODEC=ProtobufCodecLite>  // TAG must be a variable with external linkage, not a string literal
@@ -155,6 +189,12 @@ class ProtobufCodecLiteT
 
   const string& tag() const { return codec_.tag(); }
 
+  void setUseArena(bool on) { codec_.setUseArena(on); }
+
+  void setChecksumType(ProtobufCodecLite::ChecksumType type) { codec_.setChecksumType(type); }
+  ProtobufCodecLite::ChecksumType checksumType() const { return codec_.checksumType(); }
+  void setAcceptAnyChecksum(bool on) { codec_.setAcceptAnyChecksum(on); }
+
   void send(const TcpConnectionPtr& conn,
             const MSG& message)
   {
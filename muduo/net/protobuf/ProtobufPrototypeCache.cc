@@ -0,0 +1,101 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protobuf/ProtobufPrototypeCache.h"
+
+#include "muduo/base/ThreadLocalSingleton.h"
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+ProtobufPrototypeCache::ProtobufPrototypeCache()
+  : entries_(16),
+    size_(0)
+{
+}
+
+const google::protobuf::Message* ProtobufPrototypeCache::find(StringPiece typeName)
+{
+  return ThreadLocalSingleton<ProtobufPrototypeCache>::instance().lookup(typeName);
+}
+
+size_t ProtobufPrototypeCache::hash(StringPiece typeName)
+{
+  // FNV-1a
+  size_t h = 14695981039346656037ULL;
+  for (int i = 0; i < typeName.size(); ++i)
+  {
+    h ^= static_cast<unsigned char>(typeName[i]);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+const google::protobuf::Message* ProtobufPrototypeCache::lookup(StringPiece typeName)
+{
+  const size_t h = hash(typeName);
+  const size_t mask = entries_.size() - 1;
+  for (size_t i = h & mask; entries_[i].prototype; i = (i + 1) & mask)
+  {
+    if (entries_[i].hash == h && StringPiece(entries_[i].name) == typeName)
+    {
+      return entries_[i].prototype;
+    }
+  }
+
+  // unknown names are not cached, they come from broken or hostile peers
+  const google::protobuf::Message* prototype = NULL;
+  const google::protobuf::Descriptor* descriptor =
+    google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(typeName.as_string());
+  if (descriptor)
+  {
+    prototype = google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor);
+  }
+  if (prototype)
+  {
+    // keep load factor below 1/2
+    if ((size_ + 1) * 2 > entries_.size())
+    {
+      grow();
+    }
+    insert(h, typeName, prototype);
+  }
+  return prototype;
+}
+
+void ProtobufPrototypeCache::insert(size_t h, StringPiece typeName,
+                                    const google::protobuf::Message* prototype)
+{
+  const size_t mask = entries_.size() - 1;
+  size_t i = h & mask;
+  while (entries_[i].prototype)
+  {
+    i = (i + 1) & mask;
+  }
+  entries_[i].hash = h;
+  typeName.CopyToString(&entries_[i].name);
+  entries_[i].prototype = prototype;
+  ++size_;
+}
+
+void ProtobufPrototypeCache::grow()
+{
+  std::vector<Entry> old(entries_.size() * 2);
+  old.swap(entries_);
+  size_ = 0;
+  for (size_t i = 0; i < old.size(); ++i)
+  {
+    if (old[i].prototype)
+    {
+      insert(old[i].hash, old[i].name, old[i].prototype);
+    }
+  }
+}
@@ -0,0 +1,71 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTOBUF_PROTOBUFPROTOTYPECACHE_H
+#define MUDUO_NET_PROTOBUF_PROTOBUFPROTOTYPECACHE_H
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include <vector>
+
+namespace google
+{
+namespace protobuf
+{
+class Message;
+}
+}
+
+namespace muduo
+{
+namespace net
+{
+
+/// Maps full type names to generated prototypes, in front of
+/// DescriptorPool::FindMessageTypeByName() and MessageFactory::GetPrototype().
+///
+/// An open addressing table per thread, so lookups take no lock and
+/// do not build a std::string from the wire.
+class ProtobufPrototypeCache : noncopyable
+{
+ public:
+  ProtobufPrototypeCache();
+
+  /// NULL if typeName is not a generated message type.
+  /// Thread safe, uses the table of calling thread.
+  static const google::protobuf::Message* find(StringPiece typeName);
+
+  const google::protobuf::Message* lookup(StringPiece typeName);
+
+  size_t size() const
+  { return size_; }
+
+ private:
+  struct Entry
+  {
+    size_t hash;
+    string name;
+    const google::protobuf::Message* prototype;  // NULL if empty slot
+  };
+
+  static size_t hash(StringPiece typeName);
+  void insert(size_t h, StringPiece typeName, const google::protobuf::Message* prototype);
+  void grow();
+
+  std::vector<Entry> entries_;
+  size_t size_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTOBUF_PROTOBUFPROTOTYPECACHE_H
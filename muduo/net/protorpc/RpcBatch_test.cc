@@ -0,0 +1,226 @@
+#undef NDEBUG
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpctest.pb.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+class FunctionClosure : public google::protobuf::Closure
+{
+ public:
+  explicit FunctionClosure(std::function<void()> func)
+    : func_(std::move(func))
+  {
+  }
+
+  void Run() override
+  {
+    std::function<void()> func;
+    func.swap(func_);
+    delete this;
+    func();
+  }
+
+ private:
+  std::function<void()> func_;
+};
+
+class TestServiceImpl : public test::TestService
+{
+ public:
+  void Echo(google::protobuf::RpcController* controller,
+            const test::TestRequest* request,
+            test::TestResponse* response,
+            google::protobuf::Closure* done) override
+  {
+    response->set_payload(request->payload());
+    done->Run();
+  }
+};
+
+// echoes each message
+void onEcho(const RpcStreamPtr& stream)
+{
+  stream->setMessageCallback([](const RpcStreamPtr& s, StringPiece message)
+    {
+      s->write(message);
+    });
+  stream->setEndCallback([](const RpcStreamPtr& s)
+    {
+      s->writesDone();
+    });
+}
+
+const int kMessages = 1000;
+const size_t kLarge = 100 * 1024;  // over RpcChannel's batch of 64KiB
+
+EventLoop* g_loop;
+TestServiceImpl g_impl;
+std::vector<std::function<void()>> g_steps;
+size_t g_step = 0;
+
+void next()
+{
+  if (g_step < g_steps.size())
+  {
+    g_loop->queueInLoop(g_steps[g_step++]);
+  }
+  else
+  {
+    g_loop->quit();
+  }
+}
+
+struct Batching
+{
+  Batching(uint16_t port, double d)
+    : delay(d),
+      server(g_loop, InetAddress("127.0.0.1", port)),
+      client(g_loop, InetAddress("127.0.0.1", port), "RpcBatchClient"),
+      channel(new RpcChannel)
+  {
+    server.registerService(&g_impl);
+    server.registerStream("test.Batch", "Echo", onEcho);
+    server.enableBatching(delay);
+    server.start();
+    channel->enableBatching(delay);
+    client.setMessageCallback(
+        std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
+  }
+
+  const double delay;
+  RpcServer server;
+  TcpClient client;
+  RpcChannelPtr channel;
+};
+
+void call(const RpcChannelPtr& channel, const string& payload,
+          const std::function<void(const string&)>& cb)
+{
+  test::TestRequest request;
+  request.set_payload(payload);
+  test::TestResponse* response = new test::TestResponse;
+  test::TestService::Stub stub(get_pointer(channel));
+  stub.Echo(NULL, &request, response, new FunctionClosure([response, cb]
+    {
+      cb(response->payload());
+    }));
+}
+
+// calls and stream messages, interleaved, come back in the order sent
+void testOrder(Batching* b, const std::function<void()>& cb)
+{
+  std::shared_ptr<std::vector<int>> received(new std::vector<int>);
+  RpcStreamPtr stream = b->channel->openStream("test.Batch", "Echo");
+  auto onReply = [b, received, cb](const string& payload)
+    {
+      received->push_back(atoi(payload.c_str()));
+      if (static_cast<int>(received->size()) < kMessages)
+      {
+        return;
+      }
+      for (int i = 0; i < kMessages; ++i)
+      {
+        assert((*received)[i] == i);
+      }
+      printf("delay %.1f: %d in order\n", b->delay, kMessages);
+      cb();
+    };
+  stream->setMessageCallback([onReply](const RpcStreamPtr&, StringPiece message)
+    {
+      onReply(message.as_string());
+    });
+  stream->setCloseCallback([](const RpcStreamPtr&, ErrorCode error)
+    {
+      assert(error == NO_ERROR);
+    });
+  for (int i = 0; i < kMessages; ++i)
+  {
+    if (i == kMessages / 2)
+    {
+      // flushes what is before it right away, still in order
+      call(b->channel, std::to_string(i) + string(kLarge, ' '), onReply);
+    }
+    else if (i % 2 == 0)
+    {
+      call(b->channel, std::to_string(i), onReply);
+    }
+    else
+    {
+      stream->write(std::to_string(i));
+    }
+  }
+  stream->writesDone();
+}
+
+// a small call waits for the delay both ways, a large one does not
+void testLatency(Batching* b, const std::function<void()>& cb)
+{
+  Timestamp start(Timestamp::now());
+  call(b->channel, "small", [b, start, cb](const string& payload)
+    {
+      double small = timeDifference(Timestamp::now(), start);
+      assert(payload == "small");
+      assert(small >= 2 * b->delay - 0.01);
+
+      Timestamp start2(Timestamp::now());
+      call(b->channel, string(kLarge, 'x'), [b, small, start2, cb](const string& payload2)
+        {
+          double large = timeDifference(Timestamp::now(), start2);
+          printf("delay %.1f: small %.3fs, large %.3fs\n", b->delay, small, large);
+          assert(payload2.size() == kLarge);
+          assert(large < b->delay);
+          cb();
+        });
+    });
+}
+
+void run(Batching* b)
+{
+  b->client.setConnectionCallback([b](const TcpConnectionPtr& conn)
+    {
+      b->channel->onConnection(conn);
+      if (conn->connected())
+      {
+        // the next step starts once the connection is closed
+        auto done = [b] { b->client.disconnect(); };
+        testOrder(b, [b, done]
+          {
+            if (b->delay > 0)
+            {
+              testLatency(b, done);
+            }
+            else
+            {
+              done();
+            }
+          });
+      }
+      else
+      {
+        next();
+      }
+    });
+  b->client.connect();
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  Batching immediate(19986, 0.0);
+  Batching delayed(19987, 0.3);
+  g_steps = { std::bind(run, &immediate), std::bind(run, &delayed) };
+  next();
+  loop.runAfter(30.0, [] { printf("timeout\n"); abort(); });
+  loop.loop();
+  printf("all passed\n");
+}
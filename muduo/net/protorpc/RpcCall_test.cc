@@ -0,0 +1,325 @@
+#undef NDEBUG
+#include "muduo/base/CurrentThread.h"
+#include "muduo/base/Logging.h"
+#include "muduo/base/Thread.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpctest.pb.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+class FunctionClosure : public google::protobuf::Closure
+{
+ public:
+  explicit FunctionClosure(std::function<void()> func)
+    : func_(std::move(func))
+  {
+  }
+
+  void Run() override
+  {
+    std::function<void()> func;
+    func.swap(func_);
+    delete this;
+    func();
+  }
+
+ private:
+  std::function<void()> func_;
+};
+
+class TestServiceImpl : public test::TestService
+{
+ public:
+  void Echo(google::protobuf::RpcController* controller,
+            const test::TestRequest* request,
+            test::TestResponse* response,
+            google::protobuf::Closure* done) override
+  {
+    response->set_payload(request->payload());
+    response->set_server(CurrentThread::name());
+    if (request->delay() > 0)
+    {
+      EventLoop::getEventLoopOfCurrentThread()->runAfter(request->delay(), [done] { done->Run(); });
+    }
+    else
+    {
+      done->Run();
+    }
+  }
+};
+
+// one call and how it went
+struct Call
+{
+  Call() : doneCount(0), notified(0), error(NO_ERROR), doneThread(0) {}
+
+  RpcController controller;
+  int doneCount;
+  int notified;  // by NotifyOnCancel()
+  ErrorCode error;
+  string payload;
+  Timestamp start;
+  Timestamp done;
+  int doneThread;
+};
+typedef std::shared_ptr<Call> CallPtr;
+
+EventLoop* g_loop;
+RpcChannelPtr g_channel;
+std::vector<std::function<void()>> g_steps;
+size_t g_step = 0;
+
+void next()
+{
+  if (g_step < g_steps.size())
+  {
+    g_loop->queueInLoop(g_steps[g_step++]);
+  }
+}
+
+CallPtr call(google::protobuf::Service* stub, const string& payload, double delay,
+             double timeout, const std::function<void(const CallPtr&)>& cb)
+{
+  CallPtr c(new Call);
+  c->controller.setTimeout(timeout);
+  test::TestRequest request;
+  request.set_payload(payload);
+  request.set_delay(delay);
+  // deleted by the channel after done
+  test::TestResponse* response = new test::TestResponse;
+  c->start = Timestamp::now();
+  google::protobuf::Closure* done = new FunctionClosure([c, response, cb]
+    {
+      ++c->doneCount;
+      c->error = c->controller.errorCode();
+      c->payload = response->payload();
+      c->done = Timestamp::now();
+      c->doneThread = CurrentThread::tid();
+      if (cb)
+      {
+        cb(c);
+      }
+    });
+  c->controller.NotifyOnCancel(new FunctionClosure([c]
+    {
+      // after done
+      assert(c->doneCount == 1);
+      ++c->notified;
+    }));
+  const google::protobuf::MethodDescriptor* method = stub->GetDescriptor()->FindMethodByName("Echo");
+  stub->CallMethod(method, &c->controller, &request, response, done);
+  return c;
+}
+
+CallPtr echo(const string& payload, double delay, double timeout,
+             const std::function<void(const CallPtr&)>& cb)
+{
+  test::TestService::Stub stub(get_pointer(g_channel));
+  return call(&stub, payload, delay, timeout, cb);
+}
+
+void testEcho()
+{
+  echo("hello", 0, 0, [](const CallPtr& c)
+    {
+      printf("echo: %s\n", ErrorCode_Name(c->error).c_str());
+      assert(!c->controller.Failed());
+      assert(c->payload == "hello");
+      assert(c->notified == 0);
+      g_loop->queueInLoop([c] { assert(c->notified == 1); next(); });
+    });
+}
+
+void testTimeout()
+{
+  echo("late", 0.3, 0.1, [](const CallPtr& c)
+    {
+      double elapsed = timeDifference(c->done, c->start);
+      printf("timeout: %s after %.3f\n", ErrorCode_Name(c->error).c_str(), elapsed);
+      assert(c->error == TIMEOUT);
+      assert(c->controller.Failed());
+      assert(elapsed >= 0.09 && elapsed < 0.25);
+      assert(c->payload.empty());
+      // the response at 0.3s is dropped
+      g_loop->runAfter(0.4, [c]
+        {
+          assert(c->doneCount == 1);
+          assert(c->notified == 1);
+          assert(g_channel->numOutstandingCalls() == 0);
+          next();
+        });
+    });
+}
+
+void testCancel()
+{
+  CallPtr c = echo("cancel", 0.3, 0, nullptr);
+  // canceled by another thread, done runs there
+  std::shared_ptr<Thread> canceler(new Thread([c]
+    {
+      usleep(50 * 1000);
+      c->controller.StartCancel();
+    }, "canceler"));
+  canceler->start();
+  g_loop->runAfter(0.4, [c, canceler]
+    {
+      canceler->join();
+      printf("cancel: %s\n", ErrorCode_Name(c->error).c_str());
+      assert(c->error == CANCELED);
+      assert(c->controller.IsCanceled());
+      assert(c->doneThread != CurrentThread::tid());
+      // the response at 0.3s is dropped
+      assert(c->doneCount == 1);
+      assert(c->notified == 1);
+      assert(c->payload.empty());
+      // once done, nothing to cancel
+      c->controller.StartCancel();
+      assert(c->doneCount == 1);
+      assert(g_channel->numOutstandingCalls() == 0);
+      next();
+    });
+}
+
+void testServerError()
+{
+  test::MissingService::Stub stub(get_pointer(g_channel));
+  call(&stub, "missing", 0, 0, [](const CallPtr& c)
+    {
+      printf("missing: %s\n", c->controller.ErrorText().c_str());
+      assert(c->error == NO_SERVICE);
+      assert(c->controller.ErrorText() == "NO_SERVICE");
+      next();
+    });
+}
+
+// far more calls in flight than the initial table, some canceled,
+// some timed out, so the table grows and deletes in between
+void testGrowth()
+{
+  const int kCalls = 5000;
+  std::shared_ptr<int> finished(new int(0));
+  std::shared_ptr<std::vector<CallPtr>> calls(new std::vector<CallPtr>);
+  for (int i = 0; i < kCalls; ++i)
+  {
+    double timeout = i % 5 == 1 ? 0.1 : 0;
+    calls->push_back(echo(std::to_string(i), 0.2, timeout, [finished, calls](const CallPtr&)
+      {
+        if (++*finished < kCalls)
+        {
+          return;
+        }
+        // late responses are dropped
+        g_loop->runAfter(0.3, [calls]
+          {
+            int ok = 0, canceled = 0, timedOut = 0;
+            for (int j = 0; j < kCalls; ++j)
+            {
+              const Call& c = *(*calls)[j];
+              assert(c.doneCount == 1);
+              assert(c.notified == 1);
+              if (j % 3 == 0)
+              {
+                assert(c.error == CANCELED);
+                ++canceled;
+              }
+              else if (j % 5 == 1)
+              {
+                assert(c.error == TIMEOUT);
+                ++timedOut;
+              }
+              else
+              {
+                assert(c.error == NO_ERROR);
+                assert(c.payload == std::to_string(j));
+                ++ok;
+              }
+            }
+            printf("growth: %d ok, %d canceled, %d timed out\n", ok, canceled, timedOut);
+            assert(g_channel->numOutstandingCalls() == 0);
+            next();
+          });
+      }));
+  }
+  assert(g_channel->numOutstandingCalls() == static_cast<size_t>(kCalls));
+  for (int i = 0; i < kCalls; i += 3)
+  {
+    (*calls)[i]->controller.StartCancel();
+  }
+  assert(g_channel->numOutstandingCalls() == static_cast<size_t>(kCalls - (kCalls + 2) / 3));
+}
+
+CallPtr g_orphan;
+TcpClient* g_client;
+
+// the channel goes away with the connection, its controllers must not
+// reach into it
+void testChannelGone()
+{
+  g_orphan = echo("orphan", 1.0, 0, [](const CallPtr& c)
+    {
+      printf("orphan: %s\n", ErrorCode_Name(c->error).c_str());
+      assert(c->error == UNAVAILABLE);
+    });
+  g_channel->failOutstandingCalls(UNAVAILABLE);
+  assert(g_orphan->doneCount == 1);
+  g_client->disconnect();
+}
+
+void onChannelGone()
+{
+  std::weak_ptr<RpcChannel> weak(g_channel);
+  g_channel.reset();
+  assert(weak.expired());
+  g_orphan->controller.StartCancel();
+  assert(g_orphan->doneCount == 1);
+  assert(g_orphan->notified == 1);
+  // done already, runs right away
+  int notified = 0;
+  g_orphan->controller.NotifyOnCancel(new FunctionClosure([&notified] { ++notified; }));
+  assert(notified == 1);
+  g_loop->quit();
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress addr("127.0.0.1", 19982);
+  RpcServer server(&loop, addr);
+  TestServiceImpl impl;
+  server.registerService(&impl);
+  server.start();
+
+  g_steps = { testEcho, testTimeout, testCancel, testServerError, testGrowth, testChannelGone };
+
+  TcpClient client(&loop, addr, "RpcCallClient");
+  g_client = &client;
+  g_channel.reset(new RpcChannel);
+  client.setMessageCallback(
+      std::bind(&RpcChannel::onMessage, get_pointer(g_channel), _1, _2, _3));
+  client.setConnectionCallback([](const TcpConnectionPtr& conn)
+    {
+      if (conn->connected())
+      {
+        g_channel->setConnection(conn);
+        next();
+      }
+      else
+      {
+        onChannelGone();
+      }
+    });
+  client.connect();
+  loop.runAfter(30.0, [] { printf("timeout\n"); abort(); });
+  loop.loop();
+  printf("all passed\n");
+}
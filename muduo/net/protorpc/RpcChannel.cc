@@ -9,6 +9,10 @@
 #include "muduo/net/protorpc/RpcChannel.h"
 
 #include "muduo/base/Logging.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+#include "muduo/net/protorpc/RpcExecutor.h"
 #include "muduo/net/protorpc/rpc.pb.h"
 
 #include <google/protobuf/descriptor.h>
@@ -16,27 +20,313 @@
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+class FunctionClosure : public google::protobuf::Closure
+{
+ public:
+  explicit FunctionClosure(std::function<void()> func)
+    : func_(std::move(func))
+  {
+  }
+
+  void Run() override
+  {
+    std::function<void()> func;
+    func.swap(func_);
+    delete this;
+    func();
+  }
+
+ private:
+  std::function<void()> func_;
+};
+
+}  // namespace
+
+// Calls waiting for a response, keyed by call id.
+//
+// Ids are sequential, so they are spread over shards round-robin, each shard
+// an open-addressing table with linear probing under its own lock.
+// Concurrent callers seldom meet on a lock, and a lookup touches one slot.
+class RpcChannel::OutstandingCalls : noncopyable
+{
+ public:
+  OutstandingCalls()
+  {
+    for (Shard& shard : shards_)
+    {
+      shard.slots.resize(kInitialSlots);
+    }
+  }
+
+  void insert(const OutstandingCall& out)
+  {
+    Shard& shard = shardOf(out.id);
+    MutexLockGuard lock(shard.mutex);
+    if ((shard.size + 1) * 2 > shard.slots.size())
+    {
+      grow(&shard);
+    }
+    put(&shard.slots, out);
+    ++shard.size;
+  }
+
+  bool remove(int64_t id, OutstandingCall* out)
+  {
+    Shard& shard = shardOf(id);
+    MutexLockGuard lock(shard.mutex);
+    std::vector<OutstandingCall>& slots = shard.slots;
+    const size_t mask = slots.size() - 1;
+    size_t i = home(id, mask);
+    while (slots[i].id != id)
+    {
+      if (slots[i].id == 0)
+        return false;
+      i = (i + 1) & mask;
+    }
+    *out = slots[i];
+    // backward shift deletion, so no tombstones are left behind
+    size_t j = i;
+    while (true)
+    {
+      j = (j + 1) & mask;
+      if (slots[j].id == 0)
+        break;
+      size_t k = home(slots[j].id, mask);
+      // leave slots[j] if its home is cyclically in (i, j]
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+        continue;
+      slots[i] = slots[j];
+      i = j;
+    }
+    slots[i].id = 0;
+    --shard.size;
+    return true;
+  }
+
+  void setTimer(int64_t id, TimerId timer)
+  {
+    Shard& shard = shardOf(id);
+    MutexLockGuard lock(shard.mutex);
+    std::vector<OutstandingCall>& slots = shard.slots;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = home(id, mask); slots[i].id != 0; i = (i + 1) & mask)
+    {
+      if (slots[i].id == id)
+      {
+        slots[i].timer = timer;
+        slots[i].hasTimer = true;
+        break;
+      }
+    }
+  }
+
+  void removeAll(std::vector<OutstandingCall>* calls)
+  {
+    for (Shard& shard : shards_)
+    {
+      MutexLockGuard lock(shard.mutex);
+      for (OutstandingCall& out : shard.slots)
+      {
+        if (out.id != 0)
+        {
+          calls->push_back(out);
+          out.id = 0;
+        }
+      }
+      shard.size = 0;
+    }
+  }
+
+  size_t size() const
+  {
+    size_t n = 0;
+    for (const Shard& shard : shards_)
+    {
+      MutexLockGuard lock(shard.mutex);
+      n += shard.size;
+    }
+    return n;
+  }
+
+ private:
+  static const int kNumShards = 16;
+  static const size_t kInitialSlots = 64;
+
+  struct Shard
+  {
+    Shard() : size(0) {}
+
+    mutable MutexLock mutex;
+    std::vector<OutstandingCall> slots GUARDED_BY(mutex);  // power of 2
+    size_t size GUARDED_BY(mutex);
+    char padding[64];  // keeps shards off each other's cache line
+  };
+
+  Shard& shardOf(int64_t id)
+  {
+    return shards_[static_cast<uint64_t>(id) % kNumShards];
+  }
+
+  static size_t home(int64_t id, size_t mask)
+  {
+    return static_cast<size_t>(static_cast<uint64_t>(id) / kNumShards) & mask;
+  }
+
+  static void put(std::vector<OutstandingCall>* slots, const OutstandingCall& out)
+  {
+    const size_t mask = slots->size() - 1;
+    size_t i = home(out.id, mask);
+    while ((*slots)[i].id != 0)
+    {
+      i = (i + 1) & mask;
+    }
+    (*slots)[i] = out;
+  }
+
+  static void grow(Shard* shard) REQUIRES(shard->mutex)
+  {
+    std::vector<OutstandingCall> slots(shard->slots.size() * 2);
+    for (const OutstandingCall& out : shard->slots)
+    {
+      if (out.id != 0)
+      {
+        put(&slots, out);
+      }
+    }
+    shard->slots.swap(slots);
+  }
+
+  Shard shards_[kNumShards];
+};
+
+// Encoded messages waiting to be written together.
+//
+// Any thread appends, the IO thread writes the whole buffer with one
+// TcpConnection::send(), so messages keep the order they were appended in.
+class RpcChannel::Batch : noncopyable,
+                          public std::enable_shared_from_this<RpcChannel::Batch>
+{
+ public:
+  // flush right away beyond this, instead of waiting for the delay
+  static const size_t kMaxBytes = 64 * 1024;
+
+  explicit Batch(double delay)
+    : delay_(delay),
+      scheduled_(false),
+      flushQueued_(false)
+  {
+  }
+
+  void append(const TcpConnectionPtr& conn, Buffer* message)
+  {
+    EventLoop* loop = conn->getLoop();
+    bool schedule = false;
+    bool full = false;
+    {
+      MutexLockGuard lock(mutex_);
+      if (buffer_.readableBytes() == 0)
+      {
+        buffer_.swap(*message);
+      }
+      else
+      {
+        buffer_.append(message->peek(), message->readableBytes());
+      }
+      if (buffer_.readableBytes() >= kMaxBytes)
+      {
+        full = !flushQueued_;
+        flushQueued_ = true;
+      }
+      else if (!scheduled_)
+      {
+        schedule = scheduled_ = true;
+      }
+    }
+
+    std::function<void()> flush(std::bind(&Batch::flush, shared_from_this(), conn));
+    if (full)
+    {
+      loop->runInLoop(flush);
+    }
+    else if (schedule)
+    {
+      if (delay_ > 0)
+        loop->runAfter(delay_, flush);
+      else
+        // after the events of this loop iteration are handled
+        loop->queueInLoop(flush);
+    }
+  }
+
+ private:
+  void flush(const TcpConnectionPtr& conn)
+  {
+    Buffer buf;
+    {
+      MutexLockGuard lock(mutex_);
+      buf.swap(buffer_);
+      scheduled_ = false;
+      flushQueued_ = false;
+    }
+    // a stale timer may find nothing
+    if (buf.readableBytes() > 0)
+    {
+      conn->send(&buf);
+    }
+  }
+
+  const double delay_;
+  MutexLock mutex_;
+  Buffer buffer_ GUARDED_BY(mutex_);
+  bool scheduled_ GUARDED_BY(mutex_);
+  bool flushQueued_ GUARDED_BY(mutex_);
+};
+
+const size_t RpcChannel::Batch::kMaxBytes;
+
 RpcChannel::RpcChannel()
   : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
-    services_(NULL)
+    timeout_(0),
+    offerCrc32c_(false),
+    outstandings_(new OutstandingCalls),
+    services_(NULL),
+    executors_(NULL),
+    streamHandlers_(NULL),
+    writeCompleteHooked_(false),
+    waitingForWriteComplete_(false)
 {
+  codec_.setAcceptAnyChecksum(true);
   LOG_INFO << "RpcChannel::ctor - " << this;
 }
 
 RpcChannel::RpcChannel(const TcpConnectionPtr& conn)
   : codec_(std::bind(&RpcChannel::onRpcMessage, this, _1, _2, _3)),
     conn_(conn),
-    services_(NULL)
+    timeout_(0),
+    offerCrc32c_(false),
+    outstandings_(new OutstandingCalls),
+    services_(NULL),
+    executors_(NULL),
+    streamHandlers_(NULL),
+    writeCompleteHooked_(false),
+    waitingForWriteComplete_(false)
 {
+  codec_.setAcceptAnyChecksum(true);
   LOG_INFO << "RpcChannel::ctor - " << this;
 }
 
 RpcChannel::~RpcChannel()
 {
   LOG_INFO << "RpcChannel::dtor - " << this;
-  for (const auto& outstanding : outstandings_)
+  closeStreams(UNAVAILABLE);
+  // pending timers find nothing and do nothing
+  std::vector<OutstandingCall> calls;
+  outstandings_->removeAll(&calls);
+  for (const OutstandingCall& out : calls)
   {
-    OutstandingCall out = outstanding.second;
     delete out.response;
     delete out.done;
   }
@@ -61,12 +351,262 @@ void RpcChannel::CallMethod(const ::google::protobuf::MethodDescriptor* method,
   message.set_method(method->name());
   message.set_request(request->SerializeAsString()); // FIXME: error check
 
-  OutstandingCall out = { response, done };
+  RpcController* rpcController = dynamic_cast<RpcController*>(controller);
+  double timeout = timeout_;
+  if (rpcController)
+  {
+    rpcController->startCall(shared_from_this(), id);
+    if (rpcController->timeout() > 0)
+    {
+      timeout = rpcController->timeout();
+    }
+  }
+
+  OutstandingCall out = { id, response, done, rpcController, TimerId(), false };
+  outstandings_->insert(out);
+  if (timeout > 0)
+  {
+    // added after the call, so it can't fire before the call is there
+    std::weak_ptr<OutstandingCalls> weak(outstandings_);
+    TimerId timer = conn_->getLoop()->runAfter(
+        timeout, std::bind(&RpcChannel::onTimeout, weak, id));
+    outstandings_->setTimer(id, timer);
+  }
+  if (conn_->connected())
+  {
+    send(message);
+  }
+  else
+  {
+    // or failOutstandingCalls() has run already
+    failCall(id, UNAVAILABLE);
+  }
+}
+
+void RpcChannel::cancel(int64_t id)
+{
+  failCall(id, CANCELED);
+}
+
+void RpcChannel::failCall(int64_t id, ErrorCode error)
+{
+  OutstandingCall out;
+  if (outstandings_->remove(id, &out))
   {
-  MutexLockGuard lock(mutex_);
-  outstandings_[id] = out;
+    if (out.hasTimer)
+    {
+      conn_->getLoop()->cancel(out.timer);
+    }
+    finish(out, error, NULL);
+  }
+}
+
+void RpcChannel::onConnection(const TcpConnectionPtr& conn)
+{
+  if (conn->connected())
+  {
+    setConnection(conn);
+  }
+  else if (conn == conn_)
+  {
+    failOutstandingCalls(UNAVAILABLE);
+  }
+}
+
+void RpcChannel::failOutstandingCalls(ErrorCode error)
+{
+  closeStreams(error);
+  std::vector<OutstandingCall> calls;
+  outstandings_->removeAll(&calls);
+  for (const OutstandingCall& out : calls)
+  {
+    if (out.hasTimer)
+    {
+      conn_->getLoop()->cancel(out.timer);
+    }
+    finish(out, error, NULL);
+  }
+}
+
+RpcStreamPtr RpcChannel::openStream(const string& service, const string& method)
+{
+  return RpcStreamPtr(new RpcStream(shared_from_this(), conn_->getLoop(),
+                                    id_.incrementAndGet(), true, service, method));
+}
+
+void RpcChannel::onStreamMessage(const RpcMessage& message)
+{
+  const int64_t id = message.id();
+  if (message.type() == STREAM_RESPONSE)
+  {
+    std::map<int64_t, RpcStreamPtr>::iterator it = localStreams_.find(id);
+    if (it != localStreams_.end())
+    {
+      RpcStreamPtr stream(it->second);
+      stream->onMessage(message);
+    }
+    return;
+  }
+
+  std::map<int64_t, RpcStreamPtr>::iterator it = remoteStreams_.find(id);
+  if (it != remoteStreams_.end())
+  {
+    RpcStreamPtr stream(it->second);
+    stream->onMessage(message);
+  }
+  else if (message.has_service())
+  {
+    // opened by the peer
+    const RpcStream::Handler* handler = NULL;
+    if (streamHandlers_)
+    {
+      std::map<std::string, RpcStream::Handler>::const_iterator handlerIt =
+        streamHandlers_->find(message.service() + "." + message.method());
+      if (handlerIt != streamHandlers_->end())
+      {
+        handler = &handlerIt->second;
+      }
+    }
+    if (handler)
+    {
+      RpcStreamPtr stream(new RpcStream(shared_from_this(), conn_->getLoop(), id, false,
+                                        message.service(), message.method()));
+      remoteStreams_[id] = stream;
+      (*handler)(stream);
+      stream->onMessage(message);
+    }
+    else
+    {
+      RpcMessage response;
+      response.set_type(STREAM_RESPONSE);
+      response.set_id(id);
+      response.set_error(NO_METHOD);
+      send(response);
+    }
+  }
+  // else late data for a closed stream
+}
+
+void RpcChannel::addStream(const RpcStreamPtr& stream)
+{
+  (stream->initiator_ ? localStreams_ : remoteStreams_)[stream->id()] = stream;
+}
+
+void RpcChannel::removeStream(RpcStream* stream)
+{
+  (stream->initiator_ ? localStreams_ : remoteStreams_).erase(stream->id());
+}
+
+void RpcChannel::getStreams(std::vector<RpcStreamPtr>* streams) const
+{
+  for (const auto& stream : localStreams_)
+  {
+    streams->push_back(stream.second);
+  }
+  for (const auto& stream : remoteStreams_)
+  {
+    streams->push_back(stream.second);
+  }
+}
+
+void RpcChannel::closeStreams(ErrorCode error)
+{
+  std::vector<RpcStreamPtr> streams;
+  getStreams(&streams);
+  for (const RpcStreamPtr& stream : streams)
+  {
+    stream->close(error);
+  }
+  localStreams_.clear();
+  remoteStreams_.clear();
+}
+
+bool RpcChannel::outputBlocked() const
+{
+  return conn_->outputBuffer()->readableBytes() >= RpcStream::kHighWaterMark;
+}
+
+void RpcChannel::waitForWriteComplete()
+{
+  // hooked only once blocked, so unary calls don't pay for the callback
+  if (!writeCompleteHooked_)
+  {
+    writeCompleteHooked_ = true;
+    // chained, the application may have its own
+    WriteCompleteCallback previous(conn_->writeCompleteCallback());
+    std::weak_ptr<RpcChannel> weak(shared_from_this());
+    conn_->setWriteCompleteCallback([weak, previous](const TcpConnectionPtr& conn)
+      {
+        if (previous)
+        {
+          previous(conn);
+        }
+        RpcChannelPtr channel(weak.lock());
+        if (channel)
+        {
+          channel->onWriteComplete();
+        }
+      });
+  }
+  waitingForWriteComplete_ = true;
+}
+
+void RpcChannel::onWriteComplete()
+{
+  if (!waitingForWriteComplete_)
+  {
+    return;
+  }
+  waitingForWriteComplete_ = false;
+  std::vector<RpcStreamPtr> streams;
+  getStreams(&streams);
+  for (const RpcStreamPtr& stream : streams)
+  {
+    stream->flush();
+  }
+}
+
+size_t RpcChannel::numOutstandingCalls() const
+{
+  return outstandings_->size();
+}
+
+void RpcChannel::onTimeout(const std::weak_ptr<OutstandingCalls>& outstandings, int64_t id)
+{
+  std::shared_ptr<OutstandingCalls> calls(outstandings.lock());
+  OutstandingCall out;
+  if (calls && calls->remove(id, &out))
+  {
+    finish(out, TIMEOUT, NULL);
+  }
+}
+
+void RpcChannel::finish(const OutstandingCall& out, ErrorCode error, const RpcMessage* message)
+{
+  std::unique_ptr<google::protobuf::Message> d(out.response);
+  if (message && out.response && message->has_response()
+      && !out.response->ParseFromString(message->response()))
+  {
+    error = INVALID_RESPONSE;
+  }
+  google::protobuf::Closure* cancelCallback = NULL;
+  if (out.controller)
+  {
+    if (error != NO_ERROR)
+    {
+      out.controller->fail(error, ErrorCode_Name(error));
+    }
+    // done may delete the controller
+    cancelCallback = out.controller->finishCall();
+  }
+  if (out.done)
+  {
+    out.done->Run();
+  }
+  if (cancelCallback)
+  {
+    cancelCallback->Run();
   }
-  codec_.send(conn_, message);
 }
 
 void RpcChannel::onMessage(const TcpConnectionPtr& conn,
@@ -83,34 +623,25 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
   assert(conn == conn_);
   //printf("%s\n", message.DebugString().c_str());
   RpcMessage& message = *messagePtr;
+  if (message.crc32c() && offerCrc32c_
+      && codec_.checksumType() != ProtobufCodecLite::kCrc32c)
+  {
+    LOG_DEBUG << "RpcChannel " << this << " switches to crc32c";
+    codec_.setChecksumType(ProtobufCodecLite::kCrc32c);
+  }
   if (message.type() == RESPONSE)
   {
     int64_t id = message.id();
     assert(message.has_response() || message.has_error());
 
-    OutstandingCall out = { NULL, NULL };
-
-    {
-      MutexLockGuard lock(mutex_);
-      std::map<int64_t, OutstandingCall>::iterator it = outstandings_.find(id);
-      if (it != outstandings_.end())
-      {
-        out = it->second;
-        outstandings_.erase(it);
-      }
-    }
-
-    if (out.response)
+    OutstandingCall out;
+    if (outstandings_->remove(id, &out))
     {
-      std::unique_ptr<google::protobuf::Message> d(out.response);
-      if (message.has_response())
-      {
-        out.response->ParseFromString(message.response());
-      }
-      if (out.done)
+      if (out.hasTimer)
       {
-        out.done->Run();
+        conn->getLoop()->cancel(out.timer);
       }
+      finish(out, message.has_error() ? message.error() : NO_ERROR, &message);
     }
   }
   else if (message.type() == REQUEST)
@@ -135,9 +666,51 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
             google::protobuf::Message* response = service->GetResponsePrototype(method).New();
             // response is deleted in doneCallback
             int64_t id = message.id();
-            service->CallMethod(method, NULL, get_pointer(request), response,
-                                NewCallback(this, &RpcChannel::doneCallback, response, id));
-            error = NO_ERROR;
+            RpcExecutor* executor = NULL;
+            if (executors_)
+            {
+              std::map<const google::protobuf::MethodDescriptor*, RpcExecutor*>::const_iterator
+                executorIt = executors_->find(method);
+              if (executorIt != executors_->end())
+              {
+                executor = executorIt->second;
+              }
+            }
+            if (executor == NULL)
+            {
+              service->CallMethod(method, NULL, get_pointer(request), response,
+                                  NewCallback(this, &RpcChannel::doneCallback, response, id));
+              error = NO_ERROR;
+            }
+            else
+            {
+              // the response is serialized in the worker,
+              // TcpConnection::send() hands it over to the IO thread.
+              RpcChannelPtr self(shared_from_this());
+              std::shared_ptr<google::protobuf::Message> req(request.release());
+              google::protobuf::Closure* done = new FunctionClosure(
+                  [self, response, id, executor]
+                  {
+                    // before the response goes out, or the caller's
+                    // next call may find the executor still full
+                    executor->done();
+                    self->doneCallback(response, id);
+                  });
+              if (executor->submit([service, method, req, response, done]
+                                   {
+                                     service->CallMethod(method, NULL, get_pointer(req),
+                                                         response, done);
+                                   }))
+              {
+                error = NO_ERROR;
+              }
+              else
+              {
+                delete response;
+                delete done;
+                error = OVERLOADED;
+              }
+            }
           }
           else
           {
@@ -164,9 +737,13 @@ void RpcChannel::onRpcMessage(const TcpConnectionPtr& conn,
       response.set_type(RESPONSE);
       response.set_id(message.id());
       response.set_error(error);
-      codec_.send(conn_, response);
+      send(response);
     }
   }
+  else if (message.type() == STREAM_REQUEST || message.type() == STREAM_RESPONSE)
+  {
+    onStreamMessage(message);
+  }
   else if (message.type() == ERROR)
   {
   }
@@ -179,6 +756,39 @@ void RpcChannel::doneCallback(::google::protobuf::Message* response, int64_t id)
   message.set_type(RESPONSE);
   message.set_id(id);
   message.set_response(response->SerializeAsString()); // FIXME: error check
-  codec_.send(conn_, message);
+  send(message);
+}
+
+void RpcChannel::enableBatching(double delay)
+{
+  batch_.reset(new Batch(delay));
+}
+
+void RpcChannel::send(const RpcMessage& message)
+{
+  if (offerCrc32c_ && offered_.get() == 0 && offered_.getAndSet(1) == 0)
+  {
+    RpcMessage offer(message);
+    offer.set_crc32c(true);
+    write(offer);
+  }
+  else
+  {
+    write(message);
+  }
+}
+
+void RpcChannel::write(const RpcMessage& message)
+{
+  if (batch_)
+  {
+    Buffer buf;
+    codec_.fillEmptyBuffer(&buf, message);
+    batch_->append(conn_, &buf);
+  }
+  else
+  {
+    codec_.send(conn_, message);
+  }
 }
 
@@ -12,8 +12,10 @@
 #define MUDUO_NET_PROTORPC_RPCCHANNEL_H
 
 #include "muduo/base/Atomic.h"
-#include "muduo/base/Mutex.h"
+#include "muduo/net/TimerId.h"
 #include "muduo/net/protorpc/RpcCodec.h"
+#include "muduo/net/protorpc/RpcController.h"
+#include "muduo/net/protorpc/RpcStream.h"
 
 #include <google/protobuf/service.h>
 
@@ -88,7 +90,10 @@ namespace net
 //   RpcChannel* channel = new MyRpcChannel("remotehost.example.com:1234");
 //   MyService* service = new MyService::Stub(channel);
 //   service->MyMethod(request, &response, callback);
-class RpcChannel : public ::google::protobuf::RpcChannel
+class RpcExecutor;
+
+class RpcChannel : public ::google::protobuf::RpcChannel,
+                   public std::enable_shared_from_this<RpcChannel>
 {
  public:
   RpcChannel();
@@ -100,6 +105,8 @@ class RpcChannel : public ::google::protobuf::RpcChannel
   void setConnection(const TcpConnectionPtr& conn)
   {
     conn_ = conn;
+    writeCompleteHooked_ = false;
+    waitingForWriteComplete_ = false;
   }
 
   void setServices(const std::map<std::string, ::google::protobuf::Service*>* services)
@@ -107,11 +114,62 @@ class RpcChannel : public ::google::protobuf::RpcChannel
     services_ = services;
   }
 
+  /// Methods found in executors run there instead of in the IO thread,
+  /// the channel must then be owned by a shared_ptr.
+  void setExecutors(const std::map<const ::google::protobuf::MethodDescriptor*,
+                                   RpcExecutor*>* executors)
+  {
+    executors_ = executors;
+  }
+
+  /// Handlers of streams opened by the peer, keyed by "service.method".
+  void setStreamHandlers(const std::map<std::string, RpcStream::Handler>* handlers)
+  {
+    streamHandlers_ = handlers;
+  }
+
+  /// Opens a stream to method of service, nothing is sent before the
+  /// first write() or writesDone().  The channel must be owned by a
+  /// shared_ptr.  Thread safe.
+  RpcStreamPtr openStream(const string& service, const string& method);
+
+  /// Deadline of calls in seconds, unless set by the RpcController.
+  /// Expired calls are done with TIMEOUT.  Default 0, no deadline.
+  void setTimeout(double seconds)
+  {
+    timeout_ = seconds;
+  }
+
+  /// Offers kCrc32c to the peer, on the first message sent.  Both sides
+  /// switch to it once each has offered it, so a peer of an older version,
+  /// or one not set to it, keeps to adler32.  Either checksum is accepted
+  /// in between.  Not negotiated by the codec itself, because a frame
+  /// carries no room for it besides the RpcMessage.
+  /// Not thread safe, call before use.
+  void setChecksumType(ProtobufCodecLite::ChecksumType type)
+  {
+    offerCrc32c_ = type == ProtobufCodecLite::kCrc32c;
+  }
+
+  /// The one in use, kCrc32c after negotiation.
+  ProtobufCodecLite::ChecksumType checksumType() const
+  {
+    return codec_.checksumType();
+  }
+
+  /// Coalesces outgoing requests, responses and stream messages into one
+  /// write: those sent within one loop iteration, or within delay seconds
+  /// if delay > 0.  Fewer syscalls for many small messages, at the cost of
+  /// some latency with a delay.  Not thread safe, call before use.
+  void enableBatching(double delay = 0.0);
+
   // Call the given method of the remote service.  The signature of this
   // procedure looks the same as Service::CallMethod(), but the requirements
   // are less strict in one important way:  the request and response objects
   // need not be of any specific class as long as their descriptors are
   // method->input_type() and method->output_type().
+  // With a muduo RpcController, the channel must be owned by a shared_ptr,
+  // which the controller keeps a weak_ptr of until the call is done.
   void CallMethod(const ::google::protobuf::MethodDescriptor* method,
                   ::google::protobuf::RpcController* controller,
                   const ::google::protobuf::Message* request,
@@ -122,27 +180,81 @@ class RpcChannel : public ::google::protobuf::RpcChannel
                  Buffer* buf,
                  Timestamp receiveTime);
 
+  /// Completes call id with CANCELED, if it is still outstanding.
+  /// Thread safe, done runs in the calling thread.
+  void cancel(int64_t id);
+
+  /// A ConnectionCallback for a channel on a TcpClient: takes the
+  /// connection when it is up, fails calls and closes streams with
+  /// UNAVAILABLE when it goes down.  Without it, call
+  /// failOutstandingCalls() when the connection is lost.
+  void onConnection(const TcpConnectionPtr& conn);
+
+  /// Completes every outstanding call and closes every stream with error,
+  /// eg. UNAVAILABLE when the connection is lost.  Call in the loop thread.
+  void failOutstandingCalls(ErrorCode error);
+
+  /// Number of calls waiting for a response.
+  size_t numOutstandingCalls() const;
+
  private:
   void onRpcMessage(const TcpConnectionPtr& conn,
                     const RpcMessagePtr& messagePtr,
                     Timestamp receiveTime);
 
   void doneCallback(::google::protobuf::Message* response, int64_t id);
+  void send(const RpcMessage& message);
+  void write(const RpcMessage& message);
+  void failCall(int64_t id, ErrorCode error);
+
+  friend class RpcStream;
+  void onStreamMessage(const RpcMessage& message);
+  void addStream(const RpcStreamPtr& stream);
+  void removeStream(RpcStream* stream);
+  void getStreams(std::vector<RpcStreamPtr>* streams) const;
+  void closeStreams(ErrorCode error);
+  bool outputBlocked() const;
+  void waitForWriteComplete();
+  void onWriteComplete();
 
   struct OutstandingCall
   {
+    int64_t id;  // 0 for an empty slot
     ::google::protobuf::Message* response;
     ::google::protobuf::Closure* done;
+    RpcController* controller;
+    TimerId timer;
+    bool hasTimer;
   };
+  class OutstandingCalls;
+  class Batch;
+
+  static void onTimeout(const std::weak_ptr<OutstandingCalls>& outstandings, int64_t id);
+  static void finish(const OutstandingCall& out, ErrorCode error, const RpcMessage* message);
 
   RpcCodec codec_;
   TcpConnectionPtr conn_;
   AtomicInt64 id_;
+  double timeout_;
+  bool offerCrc32c_;
+  AtomicInt32 offered_;
 
-  MutexLock mutex_;
-  std::map<int64_t, OutstandingCall> outstandings_ GUARDED_BY(mutex_);
+  // outlives the channel in pending timers
+  std::shared_ptr<OutstandingCalls> outstandings_;
+  // NULL unless batching, outlives the channel in pending flushes
+  std::shared_ptr<Batch> batch_;
 
   const std::map<std::string, ::google::protobuf::Service*>* services_;
+  const std::map<const ::google::protobuf::MethodDescriptor*, RpcExecutor*>* executors_;
+  const std::map<std::string, RpcStream::Handler>* streamHandlers_;
+
+  // loop thread only
+  std::map<int64_t, RpcStreamPtr> localStreams_;   // opened by this side
+  std::map<int64_t, RpcStreamPtr> remoteStreams_;  // opened by the peer
+  // chained to the connection's WriteCompleteCallback, set yours before
+  // streams block on the connection
+  bool writeCompleteHooked_;
+  bool waitingForWriteComplete_;
 };
 typedef std::shared_ptr<RpcChannel> RpcChannelPtr;
 
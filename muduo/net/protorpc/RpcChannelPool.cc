@@ -0,0 +1,297 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcChannelPool.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/TcpClient.h"
+
+#include <google/protobuf/descriptor.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+struct RpcChannelPool::Backend : noncopyable
+{
+  Backend(EventLoop* loop, const InetAddress& addr, const string& name)
+    : address(addr),
+      client(loop, addr, name),
+      outstanding(0),
+      consecutiveErrors(0),
+      calls(0),
+      errors(0)
+  {
+  }
+
+  const InetAddress address;
+  TcpClient client;
+  RpcChannelPtr channel;  // NULL if not connected
+  int outstanding;
+  int consecutiveErrors;
+  Timestamp ejectedUntil;
+  int64_t calls;
+  int64_t errors;
+};
+
+struct RpcChannelPool::Call
+{
+  Backend* backend;
+  RpcController* controller;
+  bool ownsController;
+  ::google::protobuf::Closure* done;
+};
+
+RpcChannelPool::RpcChannelPool(EventLoop* loop,
+                               const std::vector<InetAddress>& backends,
+                               const string& name)
+  : policy_(kPowerOfTwoChoices),
+    maxErrors_(5),
+    ejectSeconds_(10.0),
+    timeout_(0),
+    checksumType_(ProtobufCodecLite::kAdler32),
+    next_(0)
+{
+  for (size_t i = 0; i < backends.size(); ++i)
+  {
+    backends_.emplace_back(new Backend(loop, backends[i], name + ":" + backends[i].toIpPort()));
+    Backend* backend = get_pointer(backends_.back());
+    backend->client.setConnectionCallback(
+        std::bind(&RpcChannelPool::onConnection, this, backend, _1));
+    backend->client.setMessageCallback(
+        std::bind(&RpcChannelPool::onMessage, this, _1, _2, _3));
+    backend->client.enableRetry();
+  }
+}
+
+RpcChannelPool::~RpcChannelPool()
+{
+}
+
+void RpcChannelPool::connect()
+{
+  for (const auto& backend : backends_)
+  {
+    backend->client.connect();
+  }
+}
+
+void RpcChannelPool::disconnect()
+{
+  for (const auto& backend : backends_)
+  {
+    backend->client.disconnect();
+  }
+}
+
+void RpcChannelPool::onConnection(Backend* backend, const TcpConnectionPtr& conn)
+{
+  LOG_INFO << "RpcChannelPool - " << backend->address.toIpPort() << " is "
+           << (conn->connected() ? "UP" : "DOWN");
+  if (conn->connected())
+  {
+    conn->setTcpNoDelay(true);
+    RpcChannelPtr channel(new muduo::net::RpcChannel(conn));
+    channel->setTimeout(timeout_);
+    channel->setChecksumType(checksumType_);
+    conn->setContext(channel);
+    MutexLockGuard lock(mutex_);
+    backend->channel = channel;
+    backend->consecutiveErrors = 0;
+  }
+  else
+  {
+    RpcChannelPtr channel;
+    {
+      MutexLockGuard lock(mutex_);
+      channel.swap(backend->channel);
+    }
+    conn->setContext(RpcChannelPtr());
+    if (channel)
+    {
+      // done callbacks lock mutex_ again
+      channel->failOutstandingCalls(UNAVAILABLE);
+    }
+  }
+}
+
+void RpcChannelPool::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+  const RpcChannelPtr& channel = boost::any_cast<const RpcChannelPtr&>(conn->getContext());
+  channel->onMessage(conn, buf, receiveTime);
+}
+
+int RpcChannelPool::pick(Timestamp now)
+{
+  candidates_.clear();
+  for (size_t i = 0; i < backends_.size(); ++i)
+  {
+    const Backend& backend = *backends_[i];
+    if (backend.channel && backend.ejectedUntil < now)
+    {
+      candidates_.push_back(static_cast<int>(i));
+    }
+  }
+  if (candidates_.empty())
+  {
+    // all ejected, better than failing every call
+    for (size_t i = 0; i < backends_.size(); ++i)
+    {
+      if (backends_[i]->channel)
+      {
+        candidates_.push_back(static_cast<int>(i));
+      }
+    }
+  }
+  return candidates_.empty() ? -1 : pickFrom(candidates_);
+}
+
+int RpcChannelPool::pickFrom(const std::vector<int>& candidates)
+{
+  const size_t n = candidates.size();
+  if (policy_ == kRoundRobin)
+  {
+    return candidates[next_++ % n];
+  }
+  else if (policy_ == kLeastOutstanding)
+  {
+    // start from a rotating offset, so ties are spread
+    const size_t start = next_++;
+    int best = candidates[start % n];
+    for (size_t i = 1; i < n; ++i)
+    {
+      int index = candidates[(start + i) % n];
+      if (backends_[index]->outstanding < backends_[best]->outstanding)
+      {
+        best = index;
+      }
+    }
+    return best;
+  }
+  else
+  {
+    if (n == 1)
+    {
+      return candidates[0];
+    }
+    size_t first = random_() % n;
+    size_t second = random_() % (n - 1);
+    if (second >= first)
+    {
+      ++second;
+    }
+    int a = candidates[first];
+    int b = candidates[second];
+    return backends_[b]->outstanding < backends_[a]->outstanding ? b : a;
+  }
+}
+
+void RpcChannelPool::CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                                ::google::protobuf::RpcController* controller,
+                                const ::google::protobuf::Message* request,
+                                ::google::protobuf::Message* response,
+                                ::google::protobuf::Closure* done)
+{
+  Call* call = new Call;
+  call->backend = NULL;
+  call->controller = dynamic_cast<RpcController*>(controller);
+  call->ownsController = call->controller == NULL;
+  if (call->ownsController)
+  {
+    // to learn how the call went
+    call->controller = new RpcController;
+  }
+  call->done = done;
+
+  RpcChannelPtr channel;
+  Timestamp now(Timestamp::now());
+  {
+    MutexLockGuard lock(mutex_);
+    int index = pick(now);
+    if (index >= 0)
+    {
+      call->backend = get_pointer(backends_[index]);
+      channel = call->backend->channel;
+      ++call->backend->outstanding;
+      ++call->backend->calls;
+    }
+  }
+
+  if (channel)
+  {
+    channel->CallMethod(method, call->controller, request, response,
+                        NewCallback(this, &RpcChannelPool::onCallDone, call));
+  }
+  else
+  {
+    call->controller->fail(UNAVAILABLE, ErrorCode_Name(UNAVAILABLE));
+    google::protobuf::Closure* cancelCallback = call->controller->finishCall();
+    onCallDone(call);
+    delete response;
+    if (cancelCallback)
+    {
+      cancelCallback->Run();
+    }
+  }
+}
+
+void RpcChannelPool::onCallDone(Call* call)
+{
+  std::unique_ptr<Call> d(call);
+  const ErrorCode error = call->controller->errorCode();
+  if (call->backend)
+  {
+    MutexLockGuard lock(mutex_);
+    Backend* backend = call->backend;
+    --backend->outstanding;
+    if (error == NO_ERROR || error == CANCELED)
+    {
+      backend->consecutiveErrors = 0;
+    }
+    else
+    {
+      ++backend->errors;
+      if (++backend->consecutiveErrors >= maxErrors_)
+      {
+        Timestamp now(Timestamp::now());
+        if (backend->ejectedUntil < now)
+        {
+          LOG_WARN << "RpcChannelPool - ejecting " << backend->address.toIpPort()
+                   << " after " << backend->consecutiveErrors << " errors";
+          backend->ejectedUntil = addTime(now, ejectSeconds_);
+        }
+        backend->consecutiveErrors = 0;
+      }
+    }
+  }
+  if (call->ownsController)
+  {
+    delete call->controller;
+  }
+  if (call->done)
+  {
+    call->done->Run();
+  }
+}
+
+std::vector<RpcChannelPool::BackendStats> RpcChannelPool::stats() const
+{
+  std::vector<BackendStats> result;
+  Timestamp now(Timestamp::now());
+  MutexLockGuard lock(mutex_);
+  for (const auto& backend : backends_)
+  {
+    BackendStats stats = { backend->address,
+                           backend->channel != NULL,
+                           now < backend->ejectedUntil,
+                           backend->outstanding,
+                           backend->calls,
+                           backend->errors };
+    result.push_back(stats);
+  }
+  return result;
+}
@@ -0,0 +1,121 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCHANNELPOOL_H
+#define MUDUO_NET_PROTORPC_RPCCHANNELPOOL_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+
+#include <random>
+#include <vector>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+
+/// An RpcChannel spreading calls over several backends.
+///
+/// Each backend is a TcpClient with retry, so a lost connection comes
+/// back with Connector's backoff.  Calls to a lost connection are done
+/// with UNAVAILABLE.  A backend failing maxErrors calls in a row is
+/// ejected for a while; if every connected backend is ejected, they are
+/// used anyway rather than failing all calls.
+///
+/// CallMethod() is thread safe.  Pass an RpcController to see errors,
+/// pool errors are reported as UNAVAILABLE.
+class RpcChannelPool : public ::google::protobuf::RpcChannel,
+                       noncopyable
+{
+ public:
+  enum Policy
+  {
+    kRoundRobin,
+    kLeastOutstanding,
+    kPowerOfTwoChoices,  // the less loaded of two random backends
+  };
+
+  struct BackendStats
+  {
+    InetAddress address;
+    bool connected;
+    bool ejected;
+    int outstanding;
+    int64_t calls;
+    int64_t errors;
+  };
+
+  RpcChannelPool(EventLoop* loop,
+                 const std::vector<InetAddress>& backends,
+                 const string& name);
+  ~RpcChannelPool() override;
+
+  /// Default kPowerOfTwoChoices.
+  void setPolicy(Policy policy)
+  { policy_ = policy; }
+
+  /// Default 5 errors, 10 seconds.
+  void setEjection(int maxErrors, double ejectSeconds)
+  {
+    maxErrors_ = maxErrors;
+    ejectSeconds_ = ejectSeconds;
+  }
+
+  /// Deadline of calls, see RpcChannel::setTimeout().
+  void setTimeout(double seconds)
+  { timeout_ = seconds; }
+
+  /// Offered to each backend, see RpcChannel::setChecksumType().
+  void setChecksumType(ProtobufCodecLite::ChecksumType type)
+  { checksumType_ = type; }
+
+  void connect();
+  void disconnect();
+
+  void CallMethod(const ::google::protobuf::MethodDescriptor* method,
+                  ::google::protobuf::RpcController* controller,
+                  const ::google::protobuf::Message* request,
+                  ::google::protobuf::Message* response,
+                  ::google::protobuf::Closure* done) override;
+
+  std::vector<BackendStats> stats() const;
+
+ private:
+  struct Backend;
+  struct Call;
+
+  void onConnection(Backend* backend, const TcpConnectionPtr& conn);
+  void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+  void onCallDone(Call* call);
+  int pick(Timestamp now) REQUIRES(mutex_);
+  int pickFrom(const std::vector<int>& candidates) REQUIRES(mutex_);
+
+  Policy policy_;
+  int maxErrors_;
+  double ejectSeconds_;
+  double timeout_;
+  ProtobufCodecLite::ChecksumType checksumType_;
+
+  mutable MutexLock mutex_;
+  // each Backend is guarded by mutex_, except its TcpClient
+  std::vector<std::unique_ptr<Backend>> backends_;
+  std::vector<int> candidates_ GUARDED_BY(mutex_);
+  size_t next_ GUARDED_BY(mutex_);
+  std::minstd_rand random_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCCHANNELPOOL_H
@@ -0,0 +1,362 @@
+#undef NDEBUG
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/protorpc/RpcChannelPool.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpctest.pb.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+class FunctionClosure : public google::protobuf::Closure
+{
+ public:
+  explicit FunctionClosure(std::function<void()> func)
+    : func_(std::move(func))
+  {
+  }
+
+  void Run() override
+  {
+    std::function<void()> func;
+    func.swap(func_);
+    delete this;
+    func();
+  }
+
+ private:
+  std::function<void()> func_;
+};
+
+// a backend that answers with its name, or never answers when stopped
+class TestServiceImpl : public test::TestService
+{
+ public:
+  explicit TestServiceImpl(const string& name)
+    : name_(name),
+      stopped_(false)
+  {
+  }
+
+  void setStopped(bool on)
+  { stopped_ = on; }
+
+  void Echo(google::protobuf::RpcController* controller,
+            const test::TestRequest* request,
+            test::TestResponse* response,
+            google::protobuf::Closure* done) override
+  {
+    if (stopped_)
+    {
+      // like a hung process, the connection stays up
+      return;
+    }
+    response->set_payload(request->payload());
+    response->set_server(name_);
+    if (request->delay() > 0)
+    {
+      EventLoop::getEventLoopOfCurrentThread()->runAfter(request->delay(), [done] { done->Run(); });
+    }
+    else
+    {
+      done->Run();
+    }
+  }
+
+ private:
+  const string name_;
+  bool stopped_;
+};
+
+struct Result
+{
+  ErrorCode error;
+  string server;
+};
+typedef std::vector<Result> Results;
+typedef std::function<void(const Results&)> ResultsCallback;
+
+const InetAddress g_addrA("127.0.0.1", 19984);
+const InetAddress g_addrB("127.0.0.1", 19985);
+const int kMaxErrors = 3;
+const double kEjectSeconds = 1.0;
+
+EventLoop* g_loop;
+RpcChannelPool* g_pool;
+TestServiceImpl g_implA("a");
+TestServiceImpl g_implB("b");
+std::unique_ptr<RpcServer> g_serverA;
+std::unique_ptr<RpcServer> g_serverB;
+std::vector<std::function<void()>> g_steps;
+size_t g_step = 0;
+
+void next()
+{
+  if (g_step < g_steps.size())
+  {
+    g_loop->queueInLoop(g_steps[g_step++]);
+  }
+  else
+  {
+    g_loop->quit();
+  }
+}
+
+void startServers()
+{
+  g_serverA.reset(new RpcServer(g_loop, g_addrA));
+  g_serverA->registerService(&g_implA);
+  g_serverA->start();
+  g_serverB.reset(new RpcServer(g_loop, g_addrB));
+  g_serverB->registerService(&g_implB);
+  g_serverB->start();
+}
+
+void call(double delay, const std::function<void(const Result&)>& cb)
+{
+  std::shared_ptr<RpcController> controller(new RpcController);
+  if (delay > 0)
+  {
+    // over the pool's deadline
+    controller->setTimeout(delay + 1.0);
+  }
+  test::TestRequest request;
+  request.set_delay(delay);
+  test::TestResponse* response = new test::TestResponse;
+  test::TestService::Stub stub(g_pool);
+  stub.Echo(get_pointer(controller), &request, response, new FunctionClosure([controller, response, cb]
+    {
+      Result result = { controller->errorCode(), response->server() };
+      cb(result);
+    }));
+}
+
+// n calls, one after another
+void sequence(int n, const ResultsCallback& cb)
+{
+  std::shared_ptr<Results> results(new Results);
+  std::shared_ptr<std::function<void()>> step(new std::function<void()>);
+  *step = [n, cb, results, step]
+    {
+      if (static_cast<int>(results->size()) == n)
+      {
+        cb(*results);
+        // breaks the cycle
+        g_loop->queueInLoop([step] { *step = nullptr; });
+        return;
+      }
+      call(0, [results, step](const Result& result)
+        {
+          results->push_back(result);
+          (*step)();
+        });
+    };
+  (*step)();
+}
+
+int count(const Results& results, const string& server)
+{
+  int n = 0;
+  for (const Result& r : results)
+  {
+    if (r.error == NO_ERROR && r.server == server)
+    {
+      ++n;
+    }
+  }
+  return n;
+}
+
+// with a slow call outstanding on one backend, the others get the calls
+void testLoadAware(RpcChannelPool::Policy policy, const char* name)
+{
+  g_pool->setPolicy(policy);
+  std::shared_ptr<string> busy(new string);
+  call(0.5, [busy](const Result& result)
+    {
+      assert(result.error == NO_ERROR);
+      *busy = result.server;
+    });
+  sequence(6, [busy, name](const Results& results)
+    {
+      assert(busy->empty());
+      int a = count(results, "a");
+      int b = count(results, "b");
+      printf("%s: %d a, %d b\n", name, a, b);
+      assert(a == 6 || b == 6);
+      // then both, once the slow call is done
+      g_loop->runAfter(0.6, [busy]
+        {
+          assert(!busy->empty());
+          sequence(20, [](const Results& results2)
+            {
+              assert(count(results2, "a") > 0);
+              assert(count(results2, "b") > 0);
+              next();
+            });
+        });
+    });
+}
+
+void testRoundRobin()
+{
+  g_pool->setPolicy(RpcChannelPool::kRoundRobin);
+  call(0.5, [](const Result& result) { assert(result.error == NO_ERROR); });
+  sequence(6, [](const Results& results)
+    {
+      printf("round robin: %d a, %d b\n", count(results, "a"), count(results, "b"));
+      assert(count(results, "a") == 3);
+      assert(count(results, "b") == 3);
+      for (size_t i = 1; i < results.size(); ++i)
+      {
+        assert(results[i].server != results[i-1].server);
+      }
+      // the slow call out of the way
+      g_loop->runAfter(0.6, next);
+    });
+}
+
+void testLeastOutstanding()
+{
+  testLoadAware(RpcChannelPool::kLeastOutstanding, "least outstanding");
+}
+
+void testPowerOfTwoChoices()
+{
+  testLoadAware(RpcChannelPool::kPowerOfTwoChoices, "power of two choices");
+}
+
+// b hangs, its calls time out until it is ejected
+void testEjection()
+{
+  g_pool->setPolicy(RpcChannelPool::kRoundRobin);
+  g_implB.setStopped(true);
+  sequence(12, [](const Results& results)
+    {
+      int timeouts = 0;
+      for (size_t i = 0; i < results.size(); ++i)
+      {
+        if (results[i].error == TIMEOUT)
+        {
+          ++timeouts;
+        }
+        else
+        {
+          assert(results[i].error == NO_ERROR);
+          assert(results[i].server == "a");
+        }
+      }
+      std::vector<RpcChannelPool::BackendStats> stats = g_pool->stats();
+      printf("ejection: %d timeouts, b %s, %d errors\n", timeouts,
+             stats[1].ejected ? "ejected" : "in use", static_cast<int>(stats[1].errors));
+      // then no more calls to b
+      assert(timeouts == kMaxErrors);
+      assert(stats[1].connected);
+      assert(stats[1].ejected);
+      assert(stats[1].errors == kMaxErrors);
+      assert(!stats[0].ejected);
+      assert(stats[0].errors == 0);
+      next();
+    });
+}
+
+// b is back once the ejection is over
+void testEjectionOver()
+{
+  g_implB.setStopped(false);
+  g_loop->runAfter(kEjectSeconds, []
+    {
+      assert(!g_pool->stats()[1].ejected);
+      sequence(4, [](const Results& results)
+        {
+          printf("ejection over: %d a, %d b\n", count(results, "a"), count(results, "b"));
+          assert(count(results, "a") == 2);
+          assert(count(results, "b") == 2);
+          next();
+        });
+    });
+}
+
+void waitUntil(bool connected, const std::function<void()>& cb)
+{
+  std::vector<RpcChannelPool::BackendStats> stats = g_pool->stats();
+  if (stats[0].connected == connected && stats[1].connected == connected)
+  {
+    cb();
+  }
+  else
+  {
+    g_loop->runAfter(0.05, [connected, cb] { waitUntil(connected, cb); });
+  }
+}
+
+// both backends stopped, calls fail right away until they come back
+void testReconnect()
+{
+  g_serverA.reset();
+  g_serverB.reset();
+  waitUntil(false, []
+    {
+      std::shared_ptr<int> unavailable(new int(0));
+      for (int i = 0; i < 3; ++i)
+      {
+        call(0, [unavailable](const Result& result)
+          {
+            assert(result.error == UNAVAILABLE);
+            assert(result.server.empty());
+            ++*unavailable;
+          });
+      }
+      // done within CallMethod()
+      printf("disconnected: %d unavailable\n", *unavailable);
+      assert(*unavailable == 3);
+      for (const RpcChannelPool::BackendStats& stats : g_pool->stats())
+      {
+        assert(stats.outstanding == 0);
+      }
+
+      startServers();
+      Timestamp start(Timestamp::now());
+      waitUntil(true, [start]
+        {
+          sequence(4, [start](const Results& results)
+            {
+              printf("reconnected after %.1fs: %d a, %d b\n",
+                     timeDifference(Timestamp::now(), start),
+                     count(results, "a"), count(results, "b"));
+              assert(count(results, "a") == 2);
+              assert(count(results, "b") == 2);
+              next();
+            });
+        });
+    });
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::ERROR);
+  EventLoop loop;
+  g_loop = &loop;
+  startServers();
+
+  std::vector<InetAddress> backends = { g_addrA, g_addrB };
+  RpcChannelPool pool(&loop, backends, "RpcChannelPoolTest");
+  g_pool = &pool;
+  pool.setTimeout(0.2);
+  pool.setEjection(kMaxErrors, kEjectSeconds);
+
+  g_steps = { testRoundRobin, testLeastOutstanding, testPowerOfTwoChoices,
+              testEjection, testEjectionOver, testReconnect };
+
+  pool.connect();
+  waitUntil(true, next);
+  loop.runAfter(30.0, [] { printf("timeout\n"); abort(); });
+  loop.loop();
+  pool.disconnect();
+  g_serverA.reset();
+  g_serverB.reset();
+  printf("all passed\n");
+}
@@ -34,7 +34,7 @@ extern const char rpctag[];// = "RPC0";
 // size      4-byte  N+8
 // "RPC0"    4-byte
 // payload   N-byte
-// checksum  4-byte  adler32 of "RPC0"+payload
+// checksum  4-byte  adler32 of "RPC0"+payload, or crc32c once negotiated
 //
 
 typedef ProtobufCodecLiteT<RpcMessage, rpctag> RpcCodec;
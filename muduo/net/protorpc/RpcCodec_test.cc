@@ -77,5 +77,39 @@ int main()
   assert(g_msgptr->DebugString() == message.DebugString());
   }
 
+  {
+  Buffer buf;
+  g_msgptr.reset();
+  ProtobufCodecLite codec(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  codec.setChecksumType(ProtobufCodecLite::kCrc32c);
+  codec.fillEmptyBuffer(&buf, message);
+  print(buf);
+  assert(buf.toStringPiece().as_string() != expected);
+  Buffer copy;
+  copy.append(buf.toStringPiece());
+  codec.onMessage(TcpConnectionPtr(), &buf, Timestamp::now());
+  assert(g_msgptr);
+  assert(g_msgptr->DebugString() == message.DebugString());
+
+  // adler32 peer rejects it
+  g_msgptr.reset();
+  ProtobufCodecLite::ErrorCode error = ProtobufCodecLite::kNoError;
+  ProtobufCodecLite adler(&RpcMessage::default_instance(), "RPC0", messageCallback);
+  RpcMessage parsed;
+  error = adler.parse(copy.peek() + ProtobufCodecLite::kHeaderLen,
+                      static_cast<int>(copy.readableBytes()) - ProtobufCodecLite::kHeaderLen,
+                      &parsed);
+  assert(error == ProtobufCodecLite::kCheckSumError);
+
+  // unless it accepts any
+  adler.setAcceptAnyChecksum(true);
+  error = adler.parse(copy.peek() + ProtobufCodecLite::kHeaderLen,
+                      static_cast<int>(copy.readableBytes()) - ProtobufCodecLite::kHeaderLen,
+                      &parsed);
+  assert(error == ProtobufCodecLite::kNoError);
+  assert(parsed.DebugString() == message.DebugString());
+  assert(adler.checksumType() == ProtobufCodecLite::kAdler32);
+  }
+
   google::protobuf::ShutdownProtobufLibrary();
 }
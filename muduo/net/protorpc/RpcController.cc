@@ -0,0 +1,102 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcController.h"
+
+#include "muduo/net/protorpc/RpcChannel.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+RpcController::RpcController()
+  : timeout_(0),
+    error_(NO_ERROR),
+    state_(kIdle),
+    callId_(0),
+    cancelCallback_(NULL)
+{
+}
+
+RpcController::~RpcController()
+{
+  delete cancelCallback_;
+}
+
+void RpcController::Reset()
+{
+  timeout_ = 0;
+  error_ = NO_ERROR;
+  errorText_.clear();
+  MutexLockGuard lock(mutex_);
+  state_ = kIdle;
+  channel_.reset();
+  callId_ = 0;
+  delete cancelCallback_;
+  cancelCallback_ = NULL;
+}
+
+void RpcController::StartCancel()
+{
+  std::shared_ptr<RpcChannel> channel;
+  int64_t id = 0;
+  {
+    MutexLockGuard lock(mutex_);
+    channel = channel_.lock();
+    id = callId_;
+  }
+  if (channel)
+  {
+    channel->cancel(id);
+  }
+}
+
+void RpcController::SetFailed(const std::string& reason)
+{
+  fail(INVALID_RESPONSE, reason);
+}
+
+void RpcController::NotifyOnCancel(::google::protobuf::Closure* callback)
+{
+  {
+    MutexLockGuard lock(mutex_);
+    if (state_ != kDone)
+    {
+      delete cancelCallback_;
+      cancelCallback_ = callback;
+      return;
+    }
+  }
+  callback->Run();
+}
+
+void RpcController::startCall(const std::weak_ptr<RpcChannel>& channel, int64_t id)
+{
+  error_ = NO_ERROR;
+  errorText_.clear();
+  MutexLockGuard lock(mutex_);
+  state_ = kCalling;
+  channel_ = channel;
+  callId_ = id;
+}
+
+::google::protobuf::Closure* RpcController::finishCall()
+{
+  MutexLockGuard lock(mutex_);
+  state_ = kDone;
+  channel_.reset();
+  callId_ = 0;
+  ::google::protobuf::Closure* callback = cancelCallback_;
+  cancelCallback_ = NULL;
+  return callback;
+}
+
+void RpcController::fail(ErrorCode error, const string& text)
+{
+  error_ = error;
+  errorText_ = text;
+}
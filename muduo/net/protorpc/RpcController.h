@@ -0,0 +1,91 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+#define MUDUO_NET_PROTORPC_RPCCONTROLLER_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Types.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+
+#include <google/protobuf/service.h>
+
+namespace muduo
+{
+namespace net
+{
+
+class RpcChannel;
+
+/// Per-call options and outcome of an RpcChannel::CallMethod().
+///
+/// Pass one to the stub to set a deadline or to cancel the call,
+/// and check Failed() in the done callback.  It must stay alive until
+/// the call is done.  The channel must be owned by a shared_ptr.
+class RpcController : public ::google::protobuf::RpcController
+{
+ public:
+  RpcController();
+  ~RpcController() override;
+
+  // client side
+  void Reset() override;
+  bool Failed() const override
+  { return error_ != NO_ERROR; }
+  std::string ErrorText() const override
+  { return errorText_; }
+  /// Completes the call with CANCELED, a late response is dropped.
+  /// Thread safe, done runs in the calling thread.  Does nothing once
+  /// the call is done or the channel is gone.
+  void StartCancel() override;
+
+  // server side
+  void SetFailed(const std::string& reason) override;
+  bool IsCanceled() const override
+  { return error_ == CANCELED; }
+  /// callback runs once, after done, when the call is done either way,
+  /// or right away if it is done already.  Cancellation is not sent to
+  /// the server, so this is of use to the caller only.
+  void NotifyOnCancel(::google::protobuf::Closure* callback) override;
+
+  /// Deadline of the next call in seconds, 0 for the channel default.
+  void setTimeout(double seconds)
+  { timeout_ = seconds; }
+
+  double timeout() const
+  { return timeout_; }
+
+  ErrorCode errorCode() const
+  { return error_; }
+
+ private:
+  friend class RpcChannel;
+  friend class RpcChannelPool;
+  void startCall(const std::weak_ptr<RpcChannel>& channel, int64_t id);
+  // returns the NotifyOnCancel() callback, to be run after done
+  ::google::protobuf::Closure* finishCall();
+  void fail(ErrorCode error, const string& text);
+
+  enum State { kIdle, kCalling, kDone };
+
+  double timeout_;
+  ErrorCode error_;
+  string errorText_;
+  mutable MutexLock mutex_;
+  State state_ GUARDED_BY(mutex_);
+  std::weak_ptr<RpcChannel> channel_ GUARDED_BY(mutex_);
+  int64_t callId_ GUARDED_BY(mutex_);
+  ::google::protobuf::Closure* cancelCallback_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCCONTROLLER_H
@@ -0,0 +1,76 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcExecutor.h"
+
+#include <algorithm>
+
+using namespace muduo;
+using namespace muduo::net;
+
+RpcExecutor::RpcExecutor(const string& name, int numThreads, int maxInFlight)
+  : name_(name),
+    numThreads_(numThreads),
+    maxInFlight_(maxInFlight),
+    pool_(name),
+    calls_(0),
+    totalQueueTime_(0),
+    maxQueueTime_(0)
+{
+}
+
+RpcExecutor::~RpcExecutor()
+{
+  pool_.stop();
+}
+
+void RpcExecutor::start()
+{
+  pool_.start(numThreads_);
+}
+
+bool RpcExecutor::submit(ThreadPool::Task task)
+{
+  if (inFlight_.incrementAndGet() > maxInFlight_ && maxInFlight_ > 0)
+  {
+    inFlight_.decrement();
+    rejected_.increment();
+    return false;
+  }
+  Timestamp queued(Timestamp::now());
+  pool_.run(std::bind(&RpcExecutor::runTask, this, std::move(task), queued));
+  return true;
+}
+
+void RpcExecutor::runTask(const ThreadPool::Task& task, Timestamp queued)
+{
+  int64_t queueTime = Timestamp::now().microSecondsSinceEpoch()
+                      - queued.microSecondsSinceEpoch();
+  {
+    MutexLockGuard lock(mutex_);
+    ++calls_;
+    totalQueueTime_ += queueTime;
+    maxQueueTime_ = std::max(maxQueueTime_, queueTime);
+  }
+  task();
+}
+
+RpcExecutor::Stats RpcExecutor::stats()
+{
+  Stats result;
+  {
+    MutexLockGuard lock(mutex_);
+    result.calls = calls_;
+    result.totalQueueTime = totalQueueTime_;
+    result.maxQueueTime = maxQueueTime_;
+  }
+  result.rejected = rejected_.get();
+  result.inFlight = inFlight_.get();
+  result.queueSize = pool_.queueSize();
+  return result;
+}
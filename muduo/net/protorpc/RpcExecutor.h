@@ -0,0 +1,81 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCEXECUTOR_H
+#define MUDUO_NET_PROTORPC_RPCEXECUTOR_H
+
+#include "muduo/base/Atomic.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/ThreadPool.h"
+#include "muduo/base/Timestamp.h"
+
+namespace muduo
+{
+namespace net
+{
+
+/// A ThreadPool running RPC methods off the IO threads,
+/// so slow methods don't hold up other connections on the same loop.
+///
+/// A call is in flight from submit() until its done closure runs.
+/// Calls over the limit are rejected instead of queued, since the
+/// IO thread must never block on a full queue.
+class RpcExecutor : noncopyable
+{
+ public:
+  struct Stats
+  {
+    int64_t calls;           // started on a worker
+    int64_t rejected;
+    int64_t totalQueueTime;  // microseconds, from submit() to start
+    int64_t maxQueueTime;    // microseconds
+    int inFlight;
+    size_t queueSize;
+  };
+
+  /// maxInFlight 0 for no limit.
+  RpcExecutor(const string& name, int numThreads, int maxInFlight);
+  ~RpcExecutor();
+
+  void start();
+
+  const string& name() const
+  { return name_; }
+
+  /// Queues task, returns false if maxInFlight calls are in flight.
+  /// Thread safe.
+  bool submit(ThreadPool::Task task);
+
+  /// Called when a submitted call is done.  Thread safe.
+  void done()
+  { inFlight_.decrement(); }
+
+  Stats stats();
+
+ private:
+  void runTask(const ThreadPool::Task& task, Timestamp queued);
+
+  const string name_;
+  const int numThreads_;
+  const int maxInFlight_;
+  ThreadPool pool_;
+  AtomicInt32 inFlight_;
+  AtomicInt64 rejected_;
+
+  MutexLock mutex_;
+  int64_t calls_ GUARDED_BY(mutex_);
+  int64_t totalQueueTime_ GUARDED_BY(mutex_);
+  int64_t maxQueueTime_ GUARDED_BY(mutex_);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCEXECUTOR_H
@@ -0,0 +1,188 @@
+#undef NDEBUG
+#include "muduo/base/CurrentThread.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcExecutor.h"
+#include "muduo/net/protorpc/RpcServer.h"
+#include "muduo/net/protorpc/rpctest.pb.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+class FunctionClosure : public google::protobuf::Closure
+{
+ public:
+  explicit FunctionClosure(std::function<void()> func)
+    : func_(std::move(func))
+  {
+  }
+
+  void Run() override
+  {
+    std::function<void()> func;
+    func.swap(func_);
+    delete this;
+    func();
+  }
+
+ private:
+  std::function<void()> func_;
+};
+
+class TestServiceImpl : public test::TestService
+{
+ public:
+  void Echo(google::protobuf::RpcController* controller,
+            const test::TestRequest* request,
+            test::TestResponse* response,
+            google::protobuf::Closure* done) override
+  {
+    response->set_payload(request->payload());
+    response->set_server(CurrentThread::name());
+    done->Run();
+  }
+
+  void Sleep(google::protobuf::RpcController* controller,
+             const test::TestRequest* request,
+             test::TestResponse* response,
+             google::protobuf::Closure* done) override
+  {
+    usleep(static_cast<useconds_t>(request->delay() * 1000 * 1000));
+    response->set_payload(request->payload());
+    response->set_server(CurrentThread::name());
+    done->Run();
+  }
+};
+
+EventLoop* g_loop;
+RpcServer* g_server;
+TcpClient* g_client;
+RpcChannelPtr g_channel;
+
+// the response is deleted by the channel, so keep what is needed
+void call(const string& method, const string& payload, double delay,
+          const std::function<void(ErrorCode, const string& payload, const string& server)>& cb)
+{
+  std::shared_ptr<RpcController> controller(new RpcController);
+  test::TestRequest request;
+  request.set_payload(payload);
+  request.set_delay(delay);
+  test::TestResponse* response = new test::TestResponse;
+  test::TestService::Stub stub(get_pointer(g_channel));
+  stub.CallMethod(stub.GetDescriptor()->FindMethodByName(method), get_pointer(controller),
+                  &request, response, new FunctionClosure([controller, response, cb]
+                    {
+                      cb(controller->errorCode(), response->payload(), response->server());
+                    }));
+}
+
+// TestService runs on "slow", 1 thread, 1 call in flight,
+// except Echo, which stays on the IO thread.
+void testExecutor()
+{
+  std::shared_ptr<int> finished(new int(0));
+  auto check = [finished]
+    {
+      if (++*finished < 4)
+      {
+        return;
+      }
+      RpcExecutor::Stats stats = g_server->getExecutor("slow")->stats();
+      printf("stats: %" PRId64 " calls, %" PRId64 " rejected, %d in flight\n",
+             stats.calls, stats.rejected, stats.inFlight);
+      assert(stats.calls == 2);
+      assert(stats.rejected == 1);
+      assert(stats.inFlight == 0);
+      assert(stats.queueSize == 0);
+      // quits once the connection is closed
+      g_client->disconnect();
+    };
+
+  std::shared_ptr<bool> echoed(new bool(false));
+  call("Sleep", "first", 0.3, [check, echoed](ErrorCode error, const string& payload,
+                                              const string& server)
+    {
+      printf("first: %s on %s\n", ErrorCode_Name(error).c_str(), server.c_str());
+      assert(error == NO_ERROR);
+      assert(payload == "first");
+      assert(server == "slow1");
+      // on the IO thread, not held up by the worker
+      assert(*echoed);
+      // the executor has room again as soon as the response is here
+      call("Sleep", "third", 0, [check](ErrorCode error3, const string& payload3,
+                                        const string& server3)
+        {
+          printf("third: %s on %s\n", ErrorCode_Name(error3).c_str(), server3.c_str());
+          assert(error3 == NO_ERROR);
+          assert(payload3 == "third");
+          assert(server3 == "slow1");
+          check();
+        });
+      check();
+    });
+  call("Sleep", "second", 0, [check](ErrorCode error, const string& payload,
+                                     const string&)
+    {
+      printf("second: %s\n", ErrorCode_Name(error).c_str());
+      assert(error == OVERLOADED);
+      assert(payload.empty());
+      check();
+    });
+  call("Echo", "echo", 0, [check, echoed](ErrorCode error, const string& payload,
+                                          const string& server)
+    {
+      printf("echo: %s on %s\n", ErrorCode_Name(error).c_str(), server.c_str());
+      assert(error == NO_ERROR);
+      assert(payload == "echo");
+      assert(server == CurrentThread::name());
+      *echoed = true;
+      check();
+    });
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress addr("127.0.0.1", 19983);
+  RpcServer server(&loop, addr);
+  g_server = &server;
+  TestServiceImpl impl;
+  server.registerService(&impl);
+  server.addExecutor("slow", 1, 1);
+  server.setServiceExecutor(impl.GetDescriptor()->full_name(), "slow");
+  // method over service, "" for the IO thread
+  server.setMethodExecutor(impl.GetDescriptor()->full_name(), "Echo", "");
+  server.start();
+
+  TcpClient client(&loop, addr, "RpcExecutorClient");
+  g_client = &client;
+  g_channel.reset(new RpcChannel);
+  client.setMessageCallback(
+      std::bind(&RpcChannel::onMessage, get_pointer(g_channel), _1, _2, _3));
+  client.setConnectionCallback([](const TcpConnectionPtr& conn)
+    {
+      if (conn->connected())
+      {
+        g_channel->setConnection(conn);
+        testExecutor();
+      }
+      else
+      {
+        g_channel.reset();
+        g_loop->quit();
+      }
+    });
+  client.connect();
+  loop.runAfter(10.0, [] { printf("timeout\n"); abort(); });
+  loop.loop();
+  printf("all passed\n");
+}
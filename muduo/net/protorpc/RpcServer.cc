@@ -10,6 +10,7 @@
 
 #include "muduo/base/Logging.h"
 #include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcExecutor.h"
 
 #include <google/protobuf/descriptor.h>
 #include <google/protobuf/service.h>
@@ -19,7 +20,9 @@ using namespace muduo::net;
 
 RpcServer::RpcServer(EventLoop* loop,
                      const InetAddress& listenAddr)
-  : server_(loop, listenAddr, "RpcServer")
+  : server_(loop, listenAddr, "RpcServer"),
+    batchDelay_(-1),
+    checksumType_(ProtobufCodecLite::kAdler32)
 {
   server_.setConnectionCallback(
       std::bind(&RpcServer::onConnection, this, _1));
@@ -27,14 +30,91 @@ RpcServer::RpcServer(EventLoop* loop,
 //       std::bind(&RpcServer::onMessage, this, _1, _2, _3));
 }
 
+RpcServer::~RpcServer()
+{
+}
+
 void RpcServer::registerService(google::protobuf::Service* service)
 {
   const google::protobuf::ServiceDescriptor* desc = service->GetDescriptor();
   services_[desc->full_name()] = service;
 }
 
+void RpcServer::registerStream(const string& service, const string& method,
+                               const RpcStream::Handler& handler)
+{
+  streamHandlers_[service + "." + method] = handler;
+}
+
+RpcExecutor* RpcServer::addExecutor(const string& name, int numThreads, int maxInFlight)
+{
+  std::unique_ptr<RpcExecutor>& executor = executors_[name];
+  executor.reset(new RpcExecutor(name, numThreads, maxInFlight));
+  return get_pointer(executor);
+}
+
+void RpcServer::setServiceExecutor(const string& service, const string& executor)
+{
+  serviceExecutors_[service] = executor;
+}
+
+void RpcServer::setMethodExecutor(const string& service, const string& method,
+                                  const string& executor)
+{
+  methodExecutors_[service + "." + method] = executor;
+}
+
+RpcExecutor* RpcServer::getExecutor(const string& name) const
+{
+  std::map<string, std::unique_ptr<RpcExecutor>>::const_iterator it = executors_.find(name);
+  return it != executors_.end() ? get_pointer(it->second) : NULL;
+}
+
+RpcExecutor* RpcServer::findExecutor(const string& name) const
+{
+  if (name.empty())
+  {
+    return NULL;
+  }
+  RpcExecutor* executor = getExecutor(name);
+  if (executor == NULL)
+  {
+    LOG_ERROR << "RpcServer - unknown executor " << name << ", running in IO thread";
+  }
+  return executor;
+}
+
 void RpcServer::start()
 {
+  // resolved once, so a request costs a lookup by MethodDescriptor
+  methodToExecutor_.clear();
+  for (const auto& service : services_)
+  {
+    const google::protobuf::ServiceDescriptor* desc = service.second->GetDescriptor();
+    std::map<string, string>::const_iterator serviceIt = serviceExecutors_.find(service.first);
+    for (int i = 0; i < desc->method_count(); ++i)
+    {
+      const google::protobuf::MethodDescriptor* method = desc->method(i);
+      std::map<string, string>::const_iterator methodIt = methodExecutors_.find(method->full_name());
+      RpcExecutor* executor = NULL;
+      if (methodIt != methodExecutors_.end())
+      {
+        executor = findExecutor(methodIt->second);
+      }
+      else if (serviceIt != serviceExecutors_.end())
+      {
+        executor = findExecutor(serviceIt->second);
+      }
+      if (executor)
+      {
+        methodToExecutor_[method] = executor;
+      }
+    }
+  }
+  for (const auto& executor : executors_)
+  {
+    executor.second->start();
+  }
   server_.start();
 }
 
@@ -47,6 +127,13 @@ void RpcServer::onConnection(const TcpConnectionPtr& conn)
   {
     RpcChannelPtr channel(new RpcChannel(conn));
     channel->setServices(&services_);
+    channel->setExecutors(&methodToExecutor_);
+    channel->setStreamHandlers(&streamHandlers_);
+    channel->setChecksumType(checksumType_);
+    if (batchDelay_ >= 0)
+    {
+      channel->enableBatching(batchDelay_);
+    }
     conn->setMessageCallback(
         std::bind(&RpcChannel::onMessage, get_pointer(channel), _1, _2, _3));
     conn->setContext(channel);
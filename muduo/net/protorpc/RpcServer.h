@@ -12,10 +12,13 @@
 #define MUDUO_NET_PROTORPC_RPCSERVER_H
 
 #include "muduo/net/TcpServer.h"
+#include "muduo/net/protorpc/RpcCodec.h"
+#include "muduo/net/protorpc/RpcStream.h"
 
 namespace google {
 namespace protobuf {
 
+class MethodDescriptor;
 class Service;
 
 }  // namespace protobuf
@@ -26,22 +29,66 @@ namespace muduo
 namespace net
 {
 
+class RpcExecutor;
+
 class RpcServer
 {
  public:
   RpcServer(EventLoop* loop,
             const InetAddress& listenAddr);
+  ~RpcServer();
 
   void setThreadNum(int numThreads)
   {
     server_.setThreadNum(numThreads);
   }
 
+  /// Offers type to each client, see RpcChannel::setChecksumType().
+  /// Not thread safe, call before start().
+  void setChecksumType(ProtobufCodecLite::ChecksumType type)
+  {
+    checksumType_ = type;
+  }
+
   void registerService(::google::protobuf::Service*);
+
+  /// Coalesces responses of each connection, see RpcChannel::enableBatching().
+  /// Not thread safe, call before start().
+  void enableBatching(double delay = 0.0)
+  {
+    batchDelay_ = delay;
+  }
+
+  /// handler is called with each stream a client opens to method of service.
+  /// Not thread safe, call before start().
+  void registerStream(const string& service, const string& method,
+                      const RpcStream::Handler& handler);
+
+  /// Adds a worker pool, to be named by setServiceExecutor() and
+  /// setMethodExecutor().  A pool named by several services is shared,
+  /// one named by a single method is dedicated to it.
+  /// At most maxInFlight calls are queued or running, others fail with
+  /// OVERLOADED right away, 0 for no limit.
+  /// Not thread safe, call before start().
+  RpcExecutor* addExecutor(const string& name, int numThreads, int maxInFlight = 0);
+
+  /// Runs all methods of service on executor, "" for the IO thread (default).
+  void setServiceExecutor(const string& service, const string& executor);
+
+  /// Runs one method on executor, overrides setServiceExecutor().
+  void setMethodExecutor(const string& service, const string& method,
+                         const string& executor);
+
+  /// NULL if not found.
+  RpcExecutor* getExecutor(const string& name) const;
+
   void start();
 
  private:
+  typedef std::map<const ::google::protobuf::MethodDescriptor*, RpcExecutor*> ExecutorMap;
+
   void onConnection(const TcpConnectionPtr& conn);
+  RpcExecutor* findExecutor(const string& name) const;
 
   // void onMessage(const TcpConnectionPtr& conn,
   //                Buffer* buf,
@@ -49,6 +96,13 @@ class RpcServer
 
   TcpServer server_;
   std::map<std::string, ::google::protobuf::Service*> services_;
+  std::map<std::string, RpcStream::Handler> streamHandlers_;
+  std::map<string, std::unique_ptr<RpcExecutor>> executors_;
+  std::map<string, string> serviceExecutors_;  // service -> executor
+  std::map<string, string> methodExecutors_;   // service.method -> executor
+  ExecutorMap methodToExecutor_;
+  double batchDelay_;  // negative for no batching
+  ProtobufCodecLite::ChecksumType checksumType_;
 };
 
 }  // namespace net
@@ -0,0 +1,259 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+
+#include "muduo/net/protorpc/RpcStream.h"
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int RpcStream::kInitialWindow;
+const size_t RpcStream::kHighWaterMark;
+
+RpcStream::RpcStream(const std::shared_ptr<RpcChannel>& channel,
+                     EventLoop* loop,
+                     int64_t id,
+                     bool initiator,
+                     const string& service,
+                     const string& method)
+  : channel_(channel),
+    loop_(loop),
+    id_(id),
+    initiator_(initiator),
+    service_(service),
+    method_(method),
+    opened_(!initiator),
+    closed_(false),
+    writesDone_(false),
+    endSent_(false),
+    endReceived_(false),
+    blocked_(false),
+    sendWindow_(kInitialWindow),
+    consumed_(0)
+{
+}
+
+RpcStream::~RpcStream()
+{
+}
+
+void RpcStream::write(StringPiece message)
+{
+  if (loop_->isInLoopThread())
+  {
+    writeInLoop(message.as_string());
+  }
+  else
+  {
+    loop_->queueInLoop(std::bind(&RpcStream::writeInLoop, shared_from_this(),
+                                 message.as_string()));
+  }
+}
+
+void RpcStream::write(const ::google::protobuf::Message& message)
+{
+  // serialized in the calling thread
+  write(message.SerializeAsString());
+}
+
+void RpcStream::writesDone()
+{
+  loop_->runInLoop(std::bind(&RpcStream::writesDoneInLoop, shared_from_this()));
+}
+
+void RpcStream::cancel(ErrorCode error)
+{
+  loop_->runInLoop(std::bind(&RpcStream::cancelInLoop, shared_from_this(), error));
+}
+
+bool RpcStream::isWritable() const
+{
+  std::shared_ptr<RpcChannel> channel(channel_.lock());
+  return !closed_ && !writesDone_ && pending_.empty() && canSend(channel);
+}
+
+bool RpcStream::canSend(const std::shared_ptr<RpcChannel>& channel) const
+{
+  return channel && sendWindow_ > 0 && !channel->outputBlocked();
+}
+
+void RpcStream::writeInLoop(const string& message)
+{
+  loop_->assertInLoopThread();
+  if (closed_ || writesDone_)
+  {
+    LOG_WARN << "RpcStream::write - stream " << id_ << " is done";
+    return;
+  }
+  pending_.push_back(message);
+  flush();
+  if (!closed_ && !isWritable())
+  {
+    blocked_ = true;
+  }
+}
+
+void RpcStream::writesDoneInLoop()
+{
+  if (closed_ || writesDone_)
+  {
+    return;
+  }
+  writesDone_ = true;
+  flush();
+}
+
+void RpcStream::cancelInLoop(ErrorCode error)
+{
+  if (closed_)
+  {
+    return;
+  }
+  std::shared_ptr<RpcChannel> channel(channel_.lock());
+  if (channel && opened_)
+  {
+    RpcMessage message;
+    message.set_error(error);
+    send(channel, &message);
+  }
+  close(error);
+}
+
+void RpcStream::send(const std::shared_ptr<RpcChannel>& channel, RpcMessage* message)
+{
+  message->set_type(initiator_ ? STREAM_REQUEST : STREAM_RESPONSE);
+  message->set_id(id_);
+  if (!opened_)
+  {
+    message->set_service(service_);
+    message->set_method(method_);
+    opened_ = true;
+    channel->addStream(shared_from_this());
+  }
+  channel->send(*message);
+}
+
+void RpcStream::flush()
+{
+  RpcStreamPtr guard(shared_from_this());
+  std::shared_ptr<RpcChannel> channel(channel_.lock());
+  if (closed_ || !channel)
+  {
+    return;
+  }
+
+  // a message may overdraw the window, so one larger than it still goes
+  while (!pending_.empty() && canSend(channel))
+  {
+    RpcMessage message;
+    string* data = initiator_ ? message.mutable_request() : message.mutable_response();
+    data->swap(pending_.front());
+    pending_.pop_front();
+    sendWindow_ -= static_cast<int64_t>(data->size());
+    send(channel, &message);
+  }
+
+  if (pending_.empty() && writesDone_ && !endSent_)
+  {
+    RpcMessage message;
+    message.set_end(true);
+    send(channel, &message);
+    endSent_ = true;
+    if (endReceived_)
+    {
+      close(NO_ERROR);
+      return;
+    }
+  }
+
+  if (!pending_.empty() && sendWindow_ > 0)
+  {
+    // blocked by the connection, not by the peer
+    channel->waitForWriteComplete();
+  }
+  else if (blocked_ && isWritable())
+  {
+    blocked_ = false;
+    if (writableCallback_)
+      writableCallback_(guard);
+  }
+}
+
+void RpcStream::onMessage(const RpcMessage& message)
+{
+  RpcStreamPtr guard(shared_from_this());
+  if (message.has_error() && message.error() != NO_ERROR)
+  {
+    close(message.error());
+    return;
+  }
+
+  if (initiator_ ? message.has_response() : message.has_request())
+  {
+    const string& data = initiator_ ? message.response() : message.request();
+    if (messageCallback_)
+      messageCallback_(guard, data);
+    consumed_ += static_cast<int64_t>(data.size());
+    std::shared_ptr<RpcChannel> channel(channel_.lock());
+    if (!closed_ && channel && consumed_ >= kInitialWindow / 2)
+    {
+      RpcMessage credit;
+      credit.set_window(static_cast<uint32_t>(consumed_));
+      send(channel, &credit);
+      consumed_ = 0;
+    }
+  }
+
+  if (message.has_window() && !closed_)
+  {
+    sendWindow_ += message.window();
+    flush();
+  }
+
+  if (message.end() && !closed_)
+  {
+    endReceived_ = true;
+    if (endCallback_)
+      endCallback_(guard);
+    if (endSent_ && !closed_)
+    {
+      close(NO_ERROR);
+    }
+  }
+}
+
+void RpcStream::close(ErrorCode error)
+{
+  if (closed_)
+  {
+    return;
+  }
+  closed_ = true;
+  pending_.clear();
+  std::shared_ptr<RpcChannel> channel(channel_.lock());
+  if (channel)
+  {
+    channel->removeStream(this);
+  }
+  RpcStreamPtr guard(shared_from_this());
+  if (closeCallback_)
+    closeCallback_(guard, error);
+  // callbacks often hold the stream, but one of them may be running now
+  loop_->queueInLoop(std::bind(&RpcStream::clearCallbacks, guard));
+}
+
+void RpcStream::clearCallbacks()
+{
+  messageCallback_ = MessageCallback();
+  endCallback_ = Callback();
+  writableCallback_ = Callback();
+  closeCallback_ = CloseCallback();
+}
@@ -0,0 +1,151 @@
+// Copyright 2010, Shuo Chen.  All rights reserved.
+// http://code.google.com/p/muduo/
+//
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// Author: Shuo Chen (chenshuo at chenshuo dot com)
+//
+// This is a public header file, it must only include public header files.
+
+#ifndef MUDUO_NET_PROTORPC_RPCSTREAM_H
+#define MUDUO_NET_PROTORPC_RPCSTREAM_H
+
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/protorpc/rpc.pb.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class RpcChannel;
+class RpcStream;
+typedef std::shared_ptr<RpcStream> RpcStreamPtr;
+
+/// A stream of messages in both directions, multiplexed with other
+/// streams and calls on one RpcChannel.
+///
+/// Client streaming, server streaming and bidirectional calls are all
+/// the same: each side writes any number of messages, then writesDone().
+/// The stream is closed when both sides are done, or when either side
+/// cancels it or the connection is lost.
+///
+/// Flow control: the peer grants a window of kInitialWindow bytes, and
+/// grants more as its message callback consumes data.  Writes are queued
+/// locally while the window is used up, or while the connection has more
+/// than kHighWaterMark bytes of output buffered.  A producer should stop
+/// when isWritable() is false and resume in the writable callback,
+/// so that a large result set is never all in memory.
+///
+/// Callbacks run in the connection's loop thread.
+class RpcStream : noncopyable,
+                  public std::enable_shared_from_this<RpcStream>
+{
+ public:
+  typedef std::function<void (const RpcStreamPtr&, StringPiece message)> MessageCallback;
+  typedef std::function<void (const RpcStreamPtr&)> Callback;
+  typedef std::function<void (const RpcStreamPtr&, ErrorCode)> CloseCallback;
+  /// Server side, called when a peer opens a stream.
+  typedef std::function<void (const RpcStreamPtr&)> Handler;
+
+  static const int kInitialWindow = 256 * 1024;
+  static const size_t kHighWaterMark = 1024 * 1024;
+
+  ~RpcStream();
+
+  int64_t id() const
+  { return id_; }
+
+  const string& service() const
+  { return service_; }
+
+  const string& method() const
+  { return method_; }
+
+  /// Set before the first write() on the client side,
+  /// and in the Handler on the server side.
+  void setMessageCallback(const MessageCallback& cb)
+  { messageCallback_ = cb; }
+
+  /// The peer called writesDone().
+  void setEndCallback(const Callback& cb)
+  { endCallback_ = cb; }
+
+  /// Writable again, after isWritable() was false.
+  void setWritableCallback(const Callback& cb)
+  { writableCallback_ = cb; }
+
+  /// NO_ERROR when both sides are done, otherwise why the stream failed.
+  void setCloseCallback(const CloseCallback& cb)
+  { closeCallback_ = cb; }
+
+  /// Thread safe.  The first write opens the stream on the client side.
+  void write(StringPiece message);
+  void write(const ::google::protobuf::Message& message);
+
+  /// No more writes.  Thread safe.
+  void writesDone();
+
+  /// Aborts the stream in both directions.  Thread safe.
+  void cancel(ErrorCode error = CANCELED);
+
+  /// Loop thread only.
+  bool isWritable() const;
+
+  bool closed() const
+  { return closed_; }
+
+ private:
+  friend class RpcChannel;
+
+  RpcStream(const std::shared_ptr<RpcChannel>& channel,
+            EventLoop* loop,
+            int64_t id,
+            bool initiator,
+            const string& service,
+            const string& method);
+
+  void writeInLoop(const string& message);
+  void writesDoneInLoop();
+  void cancelInLoop(ErrorCode error);
+  void onMessage(const RpcMessage& message);
+  void flush();
+  bool canSend(const std::shared_ptr<RpcChannel>& channel) const;
+  void send(const std::shared_ptr<RpcChannel>& channel, RpcMessage* message);
+  void close(ErrorCode error);
+  void clearCallbacks();
+
+  std::weak_ptr<RpcChannel> channel_;
+  EventLoop* loop_;
+  const int64_t id_;
+  const bool initiator_;  // opened by this side
+  const string service_;
+  const string method_;
+  bool opened_;
+  bool closed_;
+  bool writesDone_;
+  bool endSent_;
+  bool endReceived_;
+  bool blocked_;     // isWritable() was false, writable callback due
+  int64_t sendWindow_;
+  int64_t consumed_;   // received but not granted back yet
+  std::deque<string> pending_;
+
+  MessageCallback messageCallback_;
+  Callback endCallback_;
+  Callback writableCallback_;
+  CloseCallback closeCallback_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_PROTORPC_RPCSTREAM_H
@@ -0,0 +1,186 @@
+#undef NDEBUG
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/protorpc/RpcChannel.h"
+#include "muduo/net/protorpc/RpcServer.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int kChunk = 1024;
+
+// server streaming, writes as many chunks as asked while the stream is writable
+void onExport(const RpcStreamPtr& stream)
+{
+  std::shared_ptr<int> remaining(new int(0));
+  std::shared_ptr<size_t> maxQueued(new size_t(0));
+  auto produce = [remaining](const RpcStreamPtr& s)
+    {
+      while (*remaining > 0 && s->isWritable())
+      {
+        s->write(string(kChunk, 'x'));
+        --*remaining;
+      }
+      if (*remaining == 0)
+      {
+        s->writesDone();
+        *remaining = -1;
+      }
+    };
+  stream->setMessageCallback([remaining, produce](const RpcStreamPtr& s, StringPiece message)
+    {
+      *remaining = atoi(message.as_string().c_str());
+      produce(s);
+    });
+  stream->setWritableCallback(produce);
+  stream->setCloseCallback([](const RpcStreamPtr& s, ErrorCode error)
+    {
+      LOG_INFO << "export " << s->id() << " closed " << ErrorCode_Name(error);
+    });
+}
+
+// client streaming, replies with the sum when the client is done
+void onSum(const RpcStreamPtr& stream)
+{
+  std::shared_ptr<int64_t> sum(new int64_t(0));
+  stream->setMessageCallback([sum](const RpcStreamPtr&, StringPiece message)
+    {
+      *sum += atoi(message.as_string().c_str());
+    });
+  stream->setEndCallback([sum](const RpcStreamPtr& s)
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "%lld", static_cast<long long>(*sum));
+      s->write(buf);
+      s->writesDone();
+    });
+}
+
+EventLoop* g_loop;
+RpcChannelPtr g_channel;
+int g_closed = 0;
+
+TcpClient* g_client;
+
+// a stream open when the connection goes down is closed with it
+void testDisconnect()
+{
+  RpcStreamPtr summer = g_channel->openStream("test.Bulk", "Sum");
+  summer->setCloseCallback([](const RpcStreamPtr&, ErrorCode error)
+    {
+      printf("disconnect: %s\n", ErrorCode_Name(error).c_str());
+      assert(error == UNAVAILABLE);
+      g_loop->quit();
+    });
+  summer->write("1");
+  g_client->disconnect();
+}
+
+void closed()
+{
+  if (++g_closed == 4)
+  {
+    g_loop->queueInLoop(testDisconnect);
+  }
+}
+
+void runClients()
+{
+  // export 100k chunks, far more than the window
+  RpcStreamPtr exporter = g_channel->openStream("test.Bulk", "Export");
+  std::shared_ptr<int64_t> received(new int64_t(0));
+  exporter->setMessageCallback([received](const RpcStreamPtr&, StringPiece message)
+    {
+      assert(message.size() == kChunk);
+      *received += message.size();
+    });
+  exporter->setCloseCallback([received](const RpcStreamPtr&, ErrorCode error)
+    {
+      printf("export: %s, %lld bytes\n", ErrorCode_Name(error).c_str(),
+             static_cast<long long>(*received));
+      assert(error == NO_ERROR);
+      assert(*received == 100000LL * kChunk);
+      closed();
+    });
+  exporter->write("100000");
+  exporter->writesDone();
+
+  RpcStreamPtr summer = g_channel->openStream("test.Bulk", "Sum");
+  std::shared_ptr<string> result(new string);
+  summer->setMessageCallback([result](const RpcStreamPtr&, StringPiece message)
+    {
+      *result = message.as_string();
+    });
+  summer->setCloseCallback([result](const RpcStreamPtr&, ErrorCode error)
+    {
+      printf("sum: %s, %s\n", ErrorCode_Name(error).c_str(), result->c_str());
+      assert(error == NO_ERROR);
+      assert(*result == "500500");
+      closed();
+    });
+  for (int i = 1; i <= 1000; ++i)
+  {
+    summer->write(std::to_string(i));
+  }
+  summer->writesDone();
+
+  RpcStreamPtr canceled = g_channel->openStream("test.Bulk", "Export");
+  canceled->setMessageCallback([](const RpcStreamPtr& s, StringPiece)
+    {
+      s->cancel();
+    });
+  canceled->setCloseCallback([](const RpcStreamPtr&, ErrorCode error)
+    {
+      printf("cancel: %s\n", ErrorCode_Name(error).c_str());
+      assert(error == CANCELED);
+      closed();
+    });
+  canceled->write("1000000000");
+
+  RpcStreamPtr unknown = g_channel->openStream("test.Bulk", "NoSuchMethod");
+  unknown->setCloseCallback([](const RpcStreamPtr&, ErrorCode error)
+    {
+      printf("unknown: %s\n", ErrorCode_Name(error).c_str());
+      assert(error == NO_METHOD);
+      closed();
+    });
+  unknown->writesDone();
+}
+
+int main()
+{
+  Logger::setLogLevel(Logger::WARN);
+  EventLoop loop;
+  g_loop = &loop;
+  InetAddress addr("127.0.0.1", 19981);
+  RpcServer server(&loop, addr);
+  server.registerStream("test.Bulk", "Export", onExport);
+  server.registerStream("test.Bulk", "Sum", onSum);
+  server.setChecksumType(ProtobufCodecLite::kCrc32c);
+  server.start();
+
+  TcpClient client(&loop, addr, "RpcStreamClient");
+  g_client = &client;
+  g_channel.reset(new RpcChannel);
+  g_channel->setChecksumType(ProtobufCodecLite::kCrc32c);
+  client.setMessageCallback(
+      std::bind(&RpcChannel::onMessage, get_pointer(g_channel), _1, _2, _3));
+  client.setConnectionCallback([](const TcpConnectionPtr& conn)
+    {
+      g_channel->onConnection(conn);
+      if (conn->connected())
+      {
+        runClients();
+      }
+    });
+  client.connect();
+  loop.runAfter(30.0, [] { printf("timeout\n"); abort(); });
+  loop.loop();
+  // negotiated by the first messages
+  assert(g_channel->checksumType() == ProtobufCodecLite::kCrc32c);
+  printf("all passed\n");
+}
@@ -6,6 +6,8 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+
 #include <stdio.h>
 
 BOOST_AUTO_TEST_CASE(testZlibOutputStream)
@@ -89,3 +91,48 @@ BOOST_AUTO_TEST_CASE(testZlibOutputStream5)
   printf("total %zd\n", output.readableBytes());
   BOOST_CHECK_EQUAL(stream.zlibErrorCode(), Z_STREAM_END);
 }
+
+BOOST_AUTO_TEST_CASE(testZlibInputStream)
+{
+  muduo::string input;
+  for (int i = 0; i < 100000; ++i)
+  {
+    input += "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_-"[rand() % 64];
+  }
+
+  muduo::net::Buffer compressed;
+  {
+    muduo::net::ZlibOutputStream stream(&compressed);
+    BOOST_CHECK(stream.write(input));
+  }
+
+  muduo::net::Buffer output;
+  muduo::net::ZlibInputStream stream(&output);
+  // feed in small pieces
+  while (compressed.readableBytes() > 0)
+  {
+    size_t len = std::min(compressed.readableBytes(), static_cast<size_t>(100));
+    BOOST_CHECK(stream.write(muduo::StringPiece(compressed.peek(), static_cast<int>(len))));
+    compressed.retrieve(len);
+  }
+  BOOST_CHECK_EQUAL(stream.zlibErrorCode(), Z_STREAM_END);
+  BOOST_CHECK(stream.finish());
+  BOOST_CHECK(output.retrieveAllAsString() == input);
+}
+
+BOOST_AUTO_TEST_CASE(testZlibRawDeflate)
+{
+  muduo::net::Buffer compressed;
+  muduo::net::ZlibOutputStream out(&compressed, Z_DEFAULT_COMPRESSION, -MAX_WBITS);
+  BOOST_CHECK(out.write("hello hello hello hello"));
+  BOOST_CHECK(out.flush());
+
+  muduo::net::Buffer output;
+  muduo::net::ZlibInputStream in(&output, -MAX_WBITS);
+  BOOST_CHECK(in.write(&compressed));
+  BOOST_CHECK_EQUAL(output.retrieveAllAsString(), muduo::string("hello hello hello hello"));
+  BOOST_CHECK(out.write("world"));
+  BOOST_CHECK(out.flush());
+  BOOST_CHECK(in.write(&compressed));
+  BOOST_CHECK_EQUAL(output.retrieveAllAsString(), muduo::string("world"));
+}